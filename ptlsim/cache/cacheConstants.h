@@ -61,6 +61,13 @@ namespace Memory{
 	 */
 	const int MEM_BANKS = 64;
 
+	/*
+	 * Mesh and ring networks: packets in flight per network and
+	 * links for which utilization stats are kept (8x8 mesh)
+	 */
+	const int NOC_PACKETS = 512;
+	const int NOC_MAX_LINKS = 256;
+
 	/* Average wait dealy for retrying (general) */
 	const int AVG_WAIT_DELAY = 5;
 }
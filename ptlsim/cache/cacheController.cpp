@@ -56,7 +56,9 @@ CacheController::CacheController(W8 coreid, const char *name,
   , type_(type)
   , isLowestPrivate_(false)
   , wt_disabled_(true)
-  , prefetchEnabled_(false)
+  , prefetcher_(NULL)
+  , mrc_(NULL)
+  , shadows_(NULL)
   , prefetchDelay_(1)
   , new_stats(name, &memoryHierarchy->get_machine())
 {
@@ -73,6 +75,14 @@ CacheController::CacheController(W8 coreid, const char *name,
 
   cacheLines_->init();
 
+  memoryHierarchy_->get_machine().get_option(name, "prefetch_delay", prefetchDelay_);
+  prefetcher_ = PrefetcherBuilder::create_prefetcher(
+      memoryHierarchy_->get_machine(), name, &new_stats, cacheLineBits_);
+  mrc_ = MissRatioCurve::create(memoryHierarchy_->get_machine(), name,
+      &new_stats, cacheLineBits_);
+  shadows_ = ShadowTagSet::create(memoryHierarchy_->get_machine(), name,
+      &new_stats, cacheLines_->get_line_size());
+
   SET_SIGNAL_CB(name, "_Cache_Hit", cacheHit_, &CacheController::cache_hit_cb);
 
   SET_SIGNAL_CB(name, "_Cache_Miss", cacheMiss_, &CacheController::cache_miss_cb);
@@ -108,6 +118,12 @@ CacheController::CacheController(W8 coreid, const char *name,
 
 CacheController::~CacheController()
 {
+  if(prefetcher_)
+    delete prefetcher_;
+  if(mrc_)
+    delete mrc_;
+  if(shadows_)
+    delete shadows_;
 }
 
 CacheQueueEntry* CacheController::find_dependency(MemoryRequest *request)
@@ -158,6 +174,18 @@ CacheQueueEntry* CacheController::find_match(MemoryRequest *request)
   return NULL;
 }
 
+bool CacheController::is_line_in_use(W64 tag)
+{
+  CacheQueueEntry* queueEntry;
+  foreach_list_mutable(pendingRequests_.list(), queueEntry, entry,
+		       prevEntry) {
+    if(!queueEntry->annuled && get_line_address(queueEntry->request) == tag)
+      return true;
+  }
+
+  return false;
+}
+
 void CacheController::print(ostream& os) const
 {
   os << "---Cache-Controller: " << get_name() << endl;
@@ -214,8 +242,9 @@ bool CacheController::handle_interconnect_cb(void *arg)
     queueEntry->dest = (Controller*)msg->dest;
     queueEntry->request->incRefCounter();
     ADD_HISTORY_ADD(queueEntry->request);
+    mem_req_trace(queueEntry->request, MEM_REQ_TRACE_QUEUE, this);
 
-    queueEntry->request->get_history() << "{ " << get_name() << "_idx : " << queueEntry->idx << " }";
+    ADD_HISTORY(queueEntry->request, "{ ", get_name(), "_idx : ", queueEntry->idx, " }");
 
     /*
      * We are going to access the cache later, to make
@@ -242,7 +271,7 @@ bool CacheController::handle_interconnect_cb(void *arg)
       memdebug("dependent entry: " << *dependsOn << endl);
       dependsOn->depends = queueEntry->idx;
       dependsOn->dependsAddr = queueEntry->request->get_physical_address();
-      queueEntry->request->get_history() << "{ " << get_name() << "_cache_dep : " << dependsOn->idx << " }";
+      ADD_HISTORY(queueEntry->request, "{ ", get_name(), "_cache_dep : ", dependsOn->idx, " }");
       OP_TYPE type = queueEntry->request->get_type();
       bool kernel_req = queueEntry->request->is_kernel();
       if(type == MEMORY_OP_READ) {
@@ -304,6 +333,9 @@ bool CacheController::handle_interconnect_cb(void *arg)
 	if(queueEntry->prefetch) {
 	  /* In case of prefetch just wakeup the dependents entries */
 	  queueEntry->prefetchCompleted = true;
+	  prefetcher_->prefetch_complete(
+	      queueEntry->request->get_physical_address(), true,
+	      queueEntry->request->is_kernel());
 	  queueEntry->eventFlags[CACHE_INSERT_EVENT]++;
 	  marss_add_event(&cacheInsert_, 1,
 			  (void*)(queueEntry));
@@ -351,9 +383,9 @@ bool CacheController::handle_interconnect_cb(void *arg)
 	  newEntry->dest = (Controller*)msg->dest;
 	  newEntry->request->incRefCounter();
 	  ADD_HISTORY_ADD(newEntry->request);
+	  mem_req_trace(newEntry->request, MEM_REQ_TRACE_QUEUE, this);
 
 	  newEntry->eventFlags[CACHE_ACCESS_EVENT]++;
-	  ptl_logfile << "HELL";
 
 	  /* if its a L2 cache or L3 cache send to lower memory */
 	  if((type_ == L2_CACHE || type_ == L3_CACHE) &&
@@ -427,6 +459,8 @@ int CacheController::access_fast_path(Interconnect *interconnect,
   if(hit && (perfect_l1_dcache || request->get_type() != MEMORY_OP_WRITE)) {
     N_STAT_UPDATE(new_stats.cpurequest.count.hit.read.hit, ++,
 		  request->is_kernel());
+    if(prefetcher_)
+      do_prefetch(request, true);
     return cacheLines_->latency();
   }
 
@@ -487,10 +521,14 @@ bool CacheController::cache_hit_cb(void *arg)
     return true;
 
   queueEntry->eventFlags[CACHE_HIT_EVENT]--;
+  mem_req_trace(queueEntry->request, MEM_REQ_TRACE_HIT, this);
   memdebug("Cache: " << get_name() << " cache_hit_cb entry: " <<
 	   *queueEntry << endl);
 
   if(queueEntry->prefetch) {
+    prefetcher_->prefetch_complete(
+	queueEntry->request->get_physical_address(), false,
+	queueEntry->request->is_kernel());
     clear_entry_cb(queueEntry);
   } else if(queueEntry->sender == upperInterconnect_ ||
 	    queueEntry->sender == upperInterconnect2_) {
@@ -520,6 +558,7 @@ bool CacheController::cache_miss_cb(void *arg)
     return true;
 
   queueEntry->eventFlags[CACHE_MISS_EVENT]--;
+  mem_req_trace(queueEntry->request, MEM_REQ_TRACE_MISS, this);
 
   queueEntry->eventFlags[CACHE_WAIT_INTERCONNECT_EVENT]++;
   queueEntry->sendTo = lowerInterconnect_;
@@ -642,6 +681,8 @@ bool CacheController::cache_access_cb(void *arg)
     //		if(type_ == L2_CACHE)
     //			hit = true;
 
+    mem_req_trace(queueEntry->request, MEM_REQ_TRACE_LOOKUP, this, W64(hit));
+
     OP_TYPE type = queueEntry->request->get_type();
     bool kernel_req = queueEntry->request->is_kernel();
     Signal *signal = NULL;
@@ -726,9 +767,6 @@ bool CacheController::cache_access_cb(void *arg)
 		} else if(type == MEMORY_OP_WRITE) {
 		  N_STAT_UPDATE(new_stats.cpurequest.count.miss.write, ++, kernel_req);
 		}
-
-		if(!queueEntry->prefetch && type == MEMORY_OP_READ)
-		  do_prefetch(queueEntry->request);
    	  }
       /* else its update and its a cache miss, so ignore that */
       else {
@@ -745,6 +783,26 @@ bool CacheController::cache_access_cb(void *arg)
       }
     }
 
+    /* Train the prefetcher on demand accesses only */
+    if(prefetcher_ && !queueEntry->prefetch &&
+       (type == MEMORY_OP_READ || type == MEMORY_OP_WRITE))
+      do_prefetch(queueEntry->request, hit);
+
+    if(mrc_ && !queueEntry->prefetch &&
+       (type == MEMORY_OP_READ || type == MEMORY_OP_WRITE))
+      mrc_->access(queueEntry->request->get_physical_address(), kernel_req);
+
+    /* Shadow tags see every access that gets a port, prefetches included */
+    if(shadows_) {
+      W64 addr = queueEntry->request->get_physical_address();
+      if(type == MEMORY_OP_READ || type == MEMORY_OP_WRITE)
+	shadows_->access(addr, type == MEMORY_OP_WRITE, kernel_req);
+      else if(type == MEMORY_OP_UPDATE)
+	shadows_->update(addr, kernel_req);
+      else if(type == MEMORY_OP_EVICT && is_private())
+	shadows_->invalidate(addr);
+    }
+
     marss_add_event(signal, delay, (void*)queueEntry);
     return true;
   } else {
@@ -912,6 +970,9 @@ void CacheController::annul_request(MemoryRequest *request)
   foreach_list_mutable(pendingRequests_.list(), queueEntry,
 		       entry, nextentry) {
     if(queueEntry->request->is_same(request)) {
+      if(queueEntry->prefetch)
+	prefetcher_->prefetch_cancelled(
+	    queueEntry->request->get_physical_address());
       queueEntry->eventFlags.reset();
       clear_entry_cb(queueEntry);
       queueEntry->annuled = true;
@@ -948,6 +1009,7 @@ bool CacheController::send_update_message(CacheQueueEntry *queueEntry,
   new_entry->sendTo = lowerInterconnect_;
   request->incRefCounter();
   ADD_HISTORY_ADD(request);
+  mem_req_trace(request, MEM_REQ_TRACE_QUEUE, this);
 
   new_entry->eventFlags[CACHE_WAIT_INTERCONNECT_EVENT]++;
   marss_add_event(&waitInterconnect_, 0, (void*)new_entry);
@@ -955,42 +1017,57 @@ bool CacheController::send_update_message(CacheQueueEntry *queueEntry,
   return true;
 }
 
-void CacheController::do_prefetch(MemoryRequest *request, int additional_delay)
+void CacheController::do_prefetch(MemoryRequest *request, bool hit,
+				  int additional_delay)
 {
-  if(!prefetchEnabled_)
-    return;
+  bool kernel_req = request->is_kernel();
+  W64 addr;
+
+  prefetcher_->access(request->get_physical_address(),
+		      request->get_owner_rip(), hit, kernel_req);
 
   /*
    * Don't prefetch if our pending request queue is almost full
    * This makes sure that we have some space in queue for new requests
    */
-  if(pendingRequests_.count() > pendingRequests_.size() * 0.7)
-    return;
+  while(prefetcher_->next_prefetch(addr, pendingRequests_.count() <
+				   pendingRequests_.size() * 0.7, kernel_req)) {
 
-  MemoryRequest *new_request = memoryHierarchy_->get_free_request(
-								  request->get_coreid());
-  assert(new_request);
+    /* A pending request to the line will bring it in anyway */
+    if(is_line_in_use(addr >> cacheLineBits_)) {
+      prefetcher_->prefetch_complete(addr, false, kernel_req);
+      continue;
+    }
 
-  new_request->init(request);
+    MemoryRequest *new_request = memoryHierarchy_->get_free_request(
+								    request->get_coreid());
+    assert(new_request);
 
-  /* Now generate a new address for the prefetch */
-  W64 next_line_address = get_line_address(request);
-  next_line_address = (next_line_address + 1) << cacheLineBits_;
-  new_request->set_physical_address(next_line_address);
+    new_request->init(request);
+    new_request->set_op_type(MEMORY_OP_READ);
+    new_request->set_physical_address(addr);
 
-  CacheQueueEntry *new_entry = pendingRequests_.alloc();
-  assert(new_entry);
+    CacheQueueEntry *new_entry = pendingRequests_.alloc();
+    assert(new_entry);
 
-  new_entry->request = new_request;
-  new_entry->sender = NULL;
-  new_entry->sendTo = lowerInterconnect_;
-  new_entry->prefetch = true;
-  new_entry->annuled = false;
-  new_request->incRefCounter();
-  ADD_HISTORY_ADD(new_request);
+    /* set full flag if buffer is full */
+    if(pendingRequests_.isFull()) {
+      memoryHierarchy_->set_controller_full(this, true);
+    }
 
-  marss_add_event(&cacheAccess_, prefetchDelay_+additional_delay,
-		  new_entry);
+    new_entry->request = new_request;
+    new_entry->sender = NULL;
+    new_entry->sendTo = lowerInterconnect_;
+    new_entry->prefetch = true;
+    new_entry->annuled = false;
+    new_request->incRefCounter();
+    ADD_HISTORY_ADD(new_request);
+    mem_req_trace(new_request, MEM_REQ_TRACE_QUEUE, this);
+
+    new_entry->eventFlags[CACHE_ACCESS_EVENT]++;
+    marss_add_event(&cacheAccess_, prefetchDelay_+additional_delay,
+		    new_entry);
+  }
 }
 
 /**
@@ -1011,6 +1088,15 @@ void CacheController::dump_configuration(YAML::Emitter &out) const
   YAML_KEY_VAL(out, "pending_queue_size", pendingRequests_.size());
   YAML_KEY_VAL(out, "config", (wt_disabled_ ? "writeback" : "writethrough"));
 
+  if(prefetcher_)
+    prefetcher_->dump_configuration(out);
+
+  if(mrc_)
+    mrc_->dump_configuration(out);
+
+  if(shadows_)
+    shadows_->dump_configuration(out);
+
   out << YAML::EndMap;
 }
 
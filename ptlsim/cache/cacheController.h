@@ -35,6 +35,9 @@
 #include <cacheConstants.h>
 #include <memoryStats.h>
 #include <cacheLines.h>
+#include <prefetcher.h>
+#include <missRatioCurve.h>
+#include <shadowTags.h>
 
 #include <statsBuilder.h>
 
@@ -156,7 +159,9 @@ namespace Memory {
     bool wt_disabled_;
 
     // Prefetch related variables
-    bool prefetchEnabled_;
+    Prefetcher *prefetcher_;
+    MissRatioCurve *mrc_;
+    ShadowTagSet *shadows_;
     int prefetchDelay_;
 
     // This caches are connected to only two interconnects
@@ -187,6 +192,9 @@ namespace Memory {
     // same MemoryRequest or memory request with same address
     CacheQueueEntry* find_match(MemoryRequest *request);
 
+    // True if a pending request is for the line with this tag
+    bool is_line_in_use(W64 tag);
+
     W64 get_line_address(MemoryRequest *request) {
       return request->get_physical_address() >> cacheLineBits_;
     }
@@ -194,7 +202,8 @@ namespace Memory {
     bool send_update_message(CacheQueueEntry *queueEntry,
 			     W64 tag=-1);
 
-    void do_prefetch(MemoryRequest *request, int additional_delay=0);
+    void do_prefetch(MemoryRequest *request, bool hit,
+		     int additional_delay=0);
 
   public:
     CacheController(W8 coreid, const char *name,
@@ -0,0 +1,144 @@
+
+#include <coherenceLogic.h>
+
+#include <memoryRequest.h>
+#include <coherentCache.h>
+
+using namespace Memory;
+using namespace Memory::CoherentCache;
+
+/* Actions that create new messages, skipped as a group on plain hits */
+#define COH_MESSAGE_ACTIONS (COH_ACT_DIRECTORY | COH_ACT_INVALIDATE | \
+        COH_ACT_WRITEBACK | COH_ACT_EVICT_UPPER | COH_ACT_EVICT_LOWER | \
+        COH_ACT_UPDATE_UPPER)
+
+void CoherenceLogic::execute_transition(CacheQueueEntry *queueEntry,
+        int group)
+{
+    CacheLine *line   = queueEntry->line;
+    int oldState      = line->state;
+    bool kernel_req   = queueEntry->request->is_kernel();
+    int event         = coherence_event(group,
+            queueEntry->request->get_type());
+
+    const CoherenceTransition &t = transitions->lookup(
+            controller->is_lowest_private(), oldState, event);
+    W32 act      = t.actions;
+    int newState = t.next_state;
+
+    if (group == COH_SNOOP) {
+        // By default we mark the queueEntry's shared flag to false
+        queueEntry->isShared     = false;
+        queueEntry->responseData = true;
+    }
+
+    if (newState == COH_STATE_SAME) {
+        newState = oldState;
+    } else if (newState == COH_STATE_FROM_ARG) {
+        newState = *(W8*)(queueEntry->m_arg);
+    } else if unlikely (newState == COH_STATE_INVALID) {
+        invalid_transition(queueEntry, event);
+        return;
+    }
+
+    if unlikely (act & COH_ACT_CUSTOM)
+        newState = custom_transition(queueEntry, newState);
+
+    line->state = newState;
+
+    if (act & COH_ACT_NO_DATA) {
+        queueEntry->line         = NULL;
+        queueEntry->responseData = false;
+    }
+
+    if (act & COH_ACT_SHARED)
+        queueEntry->isShared = true;
+
+    if (act & COH_MESSAGE_ACTIONS) {
+        if (act & COH_ACT_DIRECTORY) {
+            queueEntry->dest = controller->get_directory();
+            controller->send_message(queueEntry,
+                    controller->get_lower_intrconn(), (OP_TYPE)t.message);
+        }
+
+        if (act & COH_ACT_INVALIDATE) {
+            controller->send_evict_to_upper(queueEntry);
+            controller->send_update_to_lower(queueEntry);
+        }
+
+        if (act & COH_ACT_WRITEBACK)
+            controller->send_update_to_lower(queueEntry);
+
+        if (act & COH_ACT_EVICT_UPPER)
+            controller->send_evict_to_upper(queueEntry);
+
+        if (act & COH_ACT_EVICT_LOWER)
+            controller->send_evict_to_lower(queueEntry);
+
+        if (act & COH_ACT_UPDATE_UPPER)
+            controller->send_update_to_upper(queueEntry);
+    }
+
+    if ((act & COH_ACT_STAT_ALWAYS) ||
+            ((act & COH_ACT_STAT) && oldState != newState)) {
+        update_transition_stats(oldState, newState, kernel_req);
+    }
+
+    if (act & COH_ACT_MISS_STAT)
+        update_miss_stats(oldState, kernel_req);
+
+    if (act & COH_ACT_CLEAR)
+        controller->clear_entry_cb(queueEntry);
+
+    if (act & COH_ACT_MISS)
+        controller->cache_miss_cb(queueEntry);
+
+    if (act & COH_ACT_FORWARD) {
+        queueEntry->dest   = controller->get_lower_cont();
+        queueEntry->sendTo = controller->get_lower_intrconn();
+        queueEntry->eventFlags[CACHE_WAIT_INTERCONNECT_EVENT]++;
+        controller->wait_interconnect_cb(queueEntry);
+    }
+
+    if (act & COH_ACT_TO_DIRECTORY) {
+        queueEntry->dest   = controller->get_directory();
+        queueEntry->sendTo = controller->get_lower_intrconn();
+        controller->wait_interconnect_cb(queueEntry);
+    }
+
+    if (act & (COH_ACT_RESPOND | COH_ACT_RESPOND_SRC)) {
+        /* send back the response */
+        queueEntry->sendTo = queueEntry->sender;
+        if (act & COH_ACT_RESPOND_SRC)
+            queueEntry->dest = queueEntry->source;
+        controller->wait_interconnect_cb(queueEntry);
+    }
+}
+
+void CoherenceLogic::complete_fill(CacheQueueEntry *queueEntry,
+        Message &message, int exclusiveState)
+{
+    if (controller->is_lowest_private()) {
+        /* We have received our cache request. Based on old state
+         * and shared flag find out the new state. */
+        execute_transition(queueEntry,
+                message.isShared ? COH_FILL_SHARED : COH_FILL);
+    } else if (message.request->get_type() == MEMORY_OP_EVICT) {
+        invalidate_line(queueEntry->line);
+    } else if (controller->is_private()) {
+        /* Message's argument holds correct line state */
+        queueEntry->line->state = *(W8*)(message.arg);
+    } else {
+        /* Message is from a shared cache or main memory */
+        queueEntry->line->state = exclusiveState;
+    }
+}
+
+void CoherenceLogic::invalid_transition(CacheQueueEntry *queueEntry,
+        int event)
+{
+    ptl_logfile << "Invalid " << transitions->get_name() <<
+        " transition: state " << (int)queueEntry->line->state <<
+        " event " << event << " Queueentry: " << *queueEntry << endl;
+    assert(0);
+}
@@ -33,6 +33,7 @@
 #include <controller.h>
 #include <statsBuilder.h>
 #include <cacheLines.h>
+#include <coherenceTable.h>
 
 namespace Memory {
 
@@ -47,10 +48,12 @@ namespace Memory {
         {
             public:
                 CoherenceLogic(const char*name, CacheController* cont,
-                        Statable *parent, MemoryHierarchy* mem)
+                        Statable *parent, MemoryHierarchy* mem,
+                        const CoherenceTable *table = NULL)
                     : Statable(name, parent)
                       , controller(cont)
                       , memoryHierarchy(mem)
+                      , transitions(table)
             {}
 
                 virtual void handle_local_hit(CacheQueueEntry *entry)      = 0;
@@ -68,8 +71,27 @@ namespace Memory {
                         Message &message) = 0;
 				virtual void dump_configuration(YAML::Emitter &out) const = 0;
 
+                /*
+                 * Table driven protocols: look up the transition for the
+                 * line state and request type in given event group and
+                 * perform its actions.
+                 */
+                void execute_transition(CacheQueueEntry *entry, int group);
+                void complete_fill(CacheQueueEntry *entry, Message &message,
+                        int exclusiveState);
+
+                /* Hooks used by execute_transition */
+                virtual int custom_transition(CacheQueueEntry *entry,
+                        int state) { return state; }
+                virtual void invalid_transition(CacheQueueEntry *entry,
+                        int event);
+                virtual void update_transition_stats(int oldState,
+                        int newState, bool kernel) {}
+                virtual void update_miss_stats(int state, bool kernel) {}
+
                 CacheController* controller;
                 MemoryHierarchy* memoryHierarchy;
+                const CoherenceTable* transitions;
         };
     };
 };
@@ -0,0 +1,38 @@
+
+#include <coherenceTable.h>
+
+using namespace Memory;
+using namespace Memory::CoherentCache;
+
+CoherenceTable::CoherenceTable(const char *name, int num_states,
+        const CoherenceRule *rules, int num_rules)
+    : name(name)
+    , num_states(num_states)
+{
+    assert(num_states <= COH_MAX_STATES);
+
+    foreach (lp, 2) {
+        foreach (state, COH_MAX_STATES) {
+            foreach (event, NUM_COHERENCE_EVENTS) {
+                CoherenceTransition &t = table[lp][state][event];
+                t.actions = 0;
+                t.next_state = COH_STATE_INVALID;
+                t.message = MEMORY_OP_EVICT;
+
+                if (state >= num_states)
+                    continue;
+
+                foreach (i, num_rules) {
+                    const CoherenceRule &r = rules[i];
+                    if ((r.states & COH_S(state)) && (r.events & COH_E(event))
+                            && (r.levels & (1 << lp))) {
+                        t.actions = r.actions;
+                        t.next_state = r.next_state;
+                        t.message = r.message;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,133 @@
+
+#ifndef COHERENCE_TABLE_H
+#define COHERENCE_TABLE_H
+
+#include <globals.h>
+#include <memoryRequest.h>
+
+namespace Memory {
+
+    namespace CoherentCache {
+
+        /*
+         * Events a coherence protocol reacts to on a line that is present
+         * in the cache. Each group has one event per memory operation so
+         * the event number is simply (group * NUM_MEMORY_OP + op).
+         */
+        enum CoherenceEventGroup {
+            COH_LOCAL = 0,    // request from upper level hit this cache
+            COH_SNOOP,        // request from lower interconnect hit
+            COH_FILL,         // response to our own miss, not shared
+            COH_FILL_SHARED,  // response to our own miss, shared
+            NUM_COHERENCE_GROUPS
+        };
+
+        enum CoherenceEvent {
+            COH_LOCAL_READ = 0, COH_LOCAL_WRITE, COH_LOCAL_UPDATE, COH_LOCAL_EVICT,
+            COH_SNOOP_READ, COH_SNOOP_WRITE, COH_SNOOP_UPDATE, COH_SNOOP_EVICT,
+            COH_FILL_READ, COH_FILL_WRITE, COH_FILL_UPDATE, COH_FILL_EVICT,
+            COH_FILL_SHARED_READ, COH_FILL_SHARED_WRITE,
+            COH_FILL_SHARED_UPDATE, COH_FILL_SHARED_EVICT,
+            NUM_COHERENCE_EVENTS
+        };
+
+        static inline int coherence_event(int group, OP_TYPE type) {
+            return group * NUM_MEMORY_OP + type;
+        }
+
+        /*
+         * Actions of a transition. They are executed by
+         * CoherenceLogic::execute_transition in the order listed here,
+         * after the line state is updated.
+         */
+        enum CoherenceAction {
+            COH_ACT_NO_DATA      = 1 << 0,  // drop line, respond without data
+            COH_ACT_SHARED       = 1 << 1,  // mark response as shared
+            COH_ACT_CUSTOM       = 1 << 2,  // protocol decides next state
+            COH_ACT_DIRECTORY    = 1 << 3,  // send 'message' to directory
+            COH_ACT_INVALIDATE   = 1 << 4,  // evict upper, then write back
+            COH_ACT_WRITEBACK    = 1 << 5,  // update lower level
+            COH_ACT_EVICT_UPPER  = 1 << 6,
+            COH_ACT_EVICT_LOWER  = 1 << 7,
+            COH_ACT_UPDATE_UPPER = 1 << 8,
+            COH_ACT_CLEAR        = 1 << 9,  // release the queue entry
+            COH_ACT_MISS         = 1 << 10, // handle as a cache miss
+            COH_ACT_FORWARD      = 1 << 11, // pass request to lower controller
+            COH_ACT_TO_DIRECTORY = 1 << 12, // pass request to directory
+            COH_ACT_RESPOND      = 1 << 13, // reply to sender
+            COH_ACT_RESPOND_SRC  = 1 << 14, // reply to sender, dest is source
+            COH_ACT_STAT         = 1 << 15, // count transition if changed
+            COH_ACT_STAT_ALWAYS  = 1 << 16, // count transition even if same
+            COH_ACT_MISS_STAT    = 1 << 17, // count miss on old state
+        };
+
+        /* Special values of CoherenceTransition::next_state */
+        enum {
+            COH_MAX_STATES     = 8,
+            COH_STATE_SAME     = 0xfd, // keep current state
+            COH_STATE_FROM_ARG = 0xfe, // state is passed in queue entry arg
+            COH_STATE_INVALID  = 0xff, // transition is a protocol error
+        };
+
+        /* Masks used in CoherenceRule */
+        #define COH_S(state) (1 << (state))
+        #define COH_E(event) (1 << (event))
+        #define COH_ANY_STATE      0xff
+        #define COH_ANY_LOCAL      0x000f
+        #define COH_ANY_SNOOP      0x00f0
+        #define COH_ANY_FILL       0x0f00
+        #define COH_ANY_FILL_SHARED 0xf000
+        #define COH_NOT_LOWEST_PRIVATE 1
+        #define COH_LOWEST_PRIVATE 2
+        #define COH_ANY_LEVEL      3
+
+        struct CoherenceTransition {
+            W32 actions;
+            W8  next_state;
+            W8  message;
+        };
+
+        /*
+         * One line of a protocol description. A rule applies to every
+         * state, event and level whose bit is set; the first matching rule
+         * wins, so specific rules go before the general ones.
+         */
+        struct CoherenceRule {
+            W8  states;
+            W16 events;
+            W8  levels;
+            W8  next_state;
+            W32 actions;
+            W8  message;
+        };
+
+        /*
+         * Dense transition table compiled from a list of rules. Lookup is
+         * a single indexed load, indexed by lowest-private flag, line state
+         * and event. Slots not covered by any rule are protocol errors.
+         */
+        class CoherenceTable
+        {
+            public:
+                CoherenceTable(const char *name, int num_states,
+                        const CoherenceRule *rules, int num_rules);
+
+                const CoherenceTransition& lookup(bool lowest_private,
+                        int state, int event) const {
+                    return table[lowest_private][state & (COH_MAX_STATES-1)]
+                        [event];
+                }
+
+                const char* get_name() const { return name; }
+                int get_num_states() const { return num_states; }
+
+            private:
+                const char *name;
+                int num_states;
+                CoherenceTransition table[2][COH_MAX_STATES]
+                    [NUM_COHERENCE_EVENTS];
+        };
+    };
+};
+
+#endif // COHERENCE_TABLE_H
@@ -51,6 +51,10 @@ CacheController::CacheController(W8 coreid, const char *name,
     , directory_(NULL)
     , lowerCont_(NULL)
     , coherence_logic_(NULL)
+    , prefetcher_(NULL)
+    , mrc_(NULL)
+    , shadows_(NULL)
+    , prefetchDelay_(1)
 {
     memoryHierarchy_->add_cache_mem_controller(this);
     new_stats = new MESIStats(name, &memoryHierarchy->get_machine());
@@ -66,6 +70,15 @@ CacheController::CacheController(W8 coreid, const char *name,
 
     cacheLines_->init();
 
+    memoryHierarchy_->get_machine().get_option(name, "prefetch_delay",
+            prefetchDelay_);
+    prefetcher_ = PrefetcherBuilder::create_prefetcher(
+            memoryHierarchy_->get_machine(), name, new_stats,
+            cacheLineBits_);
+    mrc_ = MissRatioCurve::create(memoryHierarchy_->get_machine(), name,
+            new_stats, cacheLineBits_);
+    shadows_ = ShadowTagSet::create(memoryHierarchy_->get_machine(), name,
+            new_stats, cacheLines_->get_line_size());
 
     SET_SIGNAL_CB(name, "_Cache_Hit", cacheHit_, &CacheController::cache_hit_cb);
 
@@ -92,6 +105,12 @@ CacheController::CacheController(W8 coreid, const char *name,
 
 CacheController::~CacheController()
 {
+    if(prefetcher_)
+        delete prefetcher_;
+    if(mrc_)
+        delete mrc_;
+    if(shadows_)
+        delete shadows_;
     delete new_stats;
 }
 
@@ -202,11 +221,17 @@ bool CacheController::handle_upper_interconnect(Message &message)
         } else if(type == MEMORY_OP_WRITE) {
             N_STAT_UPDATE(new_stats->cpurequest.stall.write.dependency, ++, kernel_req);
         }
+
+        /* Demand is waiting on a prefetch that has not returned yet */
+        if(prefetcher_)
+            prefetcher_->prefetch_waited(
+                    queueEntry->request->get_physical_address());
     } else {
         cache_access_cb(queueEntry);
     }
 
     ADD_HISTORY_ADD(queueEntry->request);
+    mem_req_trace(queueEntry->request, MEM_REQ_TRACE_QUEUE, this);
 
     memdebug("Cache: " << get_name() << " added queue entry: " <<
             *queueEntry << endl);
@@ -253,6 +278,7 @@ bool CacheController::handle_lower_interconnect(Message &message)
         marss_add_event(&cacheAccess_, 0,
                 newEntry);
         ADD_HISTORY_ADD(newEntry->request);
+        mem_req_trace(newEntry->request, MEM_REQ_TRACE_QUEUE, this);
     } else { // not lowestPrivate cache
         if(queueEntry == NULL) {
             /* check if request is cache eviction */
@@ -270,6 +296,7 @@ bool CacheController::handle_lower_interconnect(Message &message)
                 marss_add_event(&cacheAccess_, 1,
                         evictEntry);
                 ADD_HISTORY_ADD(evictEntry->request);
+                mem_req_trace(evictEntry->request, MEM_REQ_TRACE_QUEUE, this);
             }
         }
     }
@@ -313,6 +340,7 @@ void CacheController::send_message(CacheQueueEntry *queueEntry,
 
     //memdebug("Created Evict message: ", *evictEntry, endl);
     ADD_HISTORY_ADD(evictEntry->request);
+    mem_req_trace(evictEntry->request, MEM_REQ_TRACE_QUEUE, this);
 
     evictEntry->eventFlags[CACHE_WAIT_INTERCONNECT_EVENT]++;
     marss_add_event(&waitInterconnect_, 1, evictEntry);
@@ -390,9 +418,16 @@ bool CacheController::complete_request(Message &message,
     marss_add_event(&cacheInsert_, 0,
             (void*)(queueEntry));
 
-    /* send back the response */
-    queueEntry->sendTo = queueEntry->sender;
-    marss_add_event(&waitInterconnect_, 1, queueEntry);
+    if(queueEntry->prefetch) {
+        /* Prefetched lines are only inserted, nobody waits for them */
+        prefetcher_->prefetch_complete(
+                queueEntry->request->get_physical_address(), true,
+                queueEntry->request->is_kernel());
+    } else {
+        /* send back the response */
+        queueEntry->sendTo = queueEntry->sender;
+        marss_add_event(&waitInterconnect_, 1, queueEntry);
+    }
 
     memdebug("Cache Request completed: " << *queueEntry << endl);
 
@@ -436,6 +471,8 @@ int CacheController::access_fast_path(Interconnect *interconnect,
             request->get_type() != MEMORY_OP_WRITE) {
         N_STAT_UPDATE(new_stats->cpurequest.count.hit.read.hit, ++,
                 request->is_kernel());
+        if(prefetcher_)
+            do_prefetch(request, true);
         return cacheLines_->latency();
     }
 
@@ -528,8 +565,15 @@ bool CacheController::cache_hit_cb(void *arg)
         return true;
 
     queueEntry->eventFlags[CACHE_HIT_EVENT]--;
+    mem_req_trace(queueEntry->request, MEM_REQ_TRACE_HIT, this);
 
-    if(queueEntry->isSnoop) {
+    if(queueEntry->prefetch) {
+        /* Line is already present, drop the prefetch */
+        prefetcher_->prefetch_complete(
+                queueEntry->request->get_physical_address(), false,
+                queueEntry->request->is_kernel());
+        clear_entry_cb(queueEntry);
+    } else if(queueEntry->isSnoop) {
         if (pendingRequests_.count() >=  (
                     pendingRequests_.size() - 4)) {
             /* Snoop hit can cause eviction in local cache and if we dont have
@@ -552,6 +596,7 @@ bool CacheController::cache_miss_cb(void *arg)
         return true;
 
     queueEntry->eventFlags[CACHE_MISS_EVENT]--;
+    mem_req_trace(queueEntry->request, MEM_REQ_TRACE_MISS, this);
 
     if(queueEntry->request->get_type() == MEMORY_OP_EVICT &&
             !is_lowest_private()) {
@@ -642,17 +687,24 @@ bool CacheController::cache_access_cb(void *arg)
         if(line) hit = true;
         else hit = false;
 
+        /* Prefetches refetch lines that are present but not valid */
+        if(hit && queueEntry->prefetch)
+            hit = is_line_valid(line);
+
         // Testing 100 % L2 Hit
         // if(type_ == L2_CACHE)
         // hit = true;
 
+        mem_req_trace(queueEntry->request, MEM_REQ_TRACE_LOOKUP, this,
+                W64(hit));
+
         Signal *signal;
         int delay;
         if(hit) {
             signal = &cacheHit_;
             delay = cacheAccessLatency_;
 
-			if (!queueEntry->isSnoop) {
+			if (!queueEntry->isSnoop && !queueEntry->prefetch) {
 				if(type == MEMORY_OP_READ) {
 					N_STAT_UPDATE(new_stats->cpurequest.count.hit.read.hit, ++,
 							kernel_req);
@@ -668,7 +720,7 @@ bool CacheController::cache_access_cb(void *arg)
             N_STAT_UPDATE(new_stats->miss_state.cpu, [4]++,
                     kernel_req);
 
-			if (!queueEntry->isSnoop) {
+			if (!queueEntry->isSnoop && !queueEntry->prefetch) {
 				if(type == MEMORY_OP_READ) {
 					N_STAT_UPDATE(new_stats->cpurequest.count.miss.read, ++,
 							kernel_req);
@@ -678,6 +730,32 @@ bool CacheController::cache_access_cb(void *arg)
 				}
 			}
         }
+
+        /* Train the prefetcher on demand accesses only */
+        if(prefetcher_ && !queueEntry->isSnoop && !queueEntry->prefetch &&
+                (type == MEMORY_OP_READ || type == MEMORY_OP_WRITE)) {
+            do_prefetch(queueEntry->request, hit && is_line_valid(line));
+        }
+
+        if(mrc_ && !queueEntry->isSnoop && !queueEntry->prefetch &&
+                (type == MEMORY_OP_READ || type == MEMORY_OP_WRITE)) {
+            mrc_->access(queueEntry->request->get_physical_address(),
+                    kernel_req);
+        }
+
+        /* Shadow tags follow the local stream, snoops only invalidate */
+        if(shadows_) {
+            W64 addr = queueEntry->request->get_physical_address();
+            if(type == MEMORY_OP_EVICT) {
+                shadows_->invalidate(addr);
+            } else if(!queueEntry->isSnoop) {
+                if(type == MEMORY_OP_READ || type == MEMORY_OP_WRITE)
+                    shadows_->access(addr, type == MEMORY_OP_WRITE, kernel_req);
+                else if(type == MEMORY_OP_UPDATE)
+                    shadows_->update(addr, kernel_req);
+            }
+        }
+
         marss_add_event(signal, delay, (void*)queueEntry);
         return true;
     } else {
@@ -833,6 +911,9 @@ void CacheController::annul_request(MemoryRequest *request)
     foreach_list_mutable(pendingRequests_.list(), queueEntry,
             entry, nextentry) {
         if (queueEntry->request->is_same(request)) {
+            if(queueEntry->prefetch)
+                prefetcher_->prefetch_cancelled(
+                        queueEntry->request->get_physical_address());
             queueEntry->annuled = true;
             /* Fix dependency chain if this entry was waiting for
              * some other entry, else wakeup that entry.*/
@@ -859,6 +940,53 @@ void CacheController::annul_request(MemoryRequest *request)
     }
 }
 
+void CacheController::do_prefetch(MemoryRequest *request, bool hit)
+{
+    bool kernel_req = request->is_kernel();
+    W64 addr;
+
+    prefetcher_->access(request->get_physical_address(),
+            request->get_owner_rip(), hit, kernel_req);
+
+    /* Keep most of the queue for demand and coherence requests */
+    while(prefetcher_->next_prefetch(addr, pendingRequests_.count() <
+                pendingRequests_.size() * 0.7, kernel_req)) {
+
+        /* A pending request to the line will bring it in anyway */
+        if(is_line_in_use(addr >> cacheLineBits_)) {
+            prefetcher_->prefetch_complete(addr, false, kernel_req);
+            continue;
+        }
+
+        MemoryRequest *new_request = memoryHierarchy_->get_free_request(
+                request->get_coreid());
+        assert(new_request);
+
+        new_request->init(request);
+        new_request->set_op_type(MEMORY_OP_READ);
+        new_request->set_physical_address(addr);
+
+        CacheQueueEntry *newEntry = pendingRequests_.alloc();
+        assert(newEntry);
+
+        /* set full flag if buffer is full */
+        if(pendingRequests_.isFull()) {
+            memoryHierarchy_->set_controller_full(this, true);
+        }
+
+        newEntry->request  = new_request;
+        newEntry->sender   = NULL;
+        newEntry->isSnoop  = false;
+        newEntry->prefetch = true;
+        newEntry->request->incRefCounter();
+        ADD_HISTORY_ADD(newEntry->request);
+        mem_req_trace(newEntry->request, MEM_REQ_TRACE_QUEUE, this);
+
+        newEntry->eventFlags[CACHE_ACCESS_EVENT]++;
+        marss_add_event(&cacheAccess_, prefetchDelay_, newEntry);
+    }
+}
+
 CacheQueueEntry* CacheController::get_new_queue_entry()
 {
     CacheQueueEntry *queueEntry = pendingRequests_.alloc();
@@ -886,5 +1014,14 @@ void CacheController::dump_configuration(YAML::Emitter &out) const
 
 	coherence_logic_->dump_configuration(out);
 
+	if(prefetcher_)
+		prefetcher_->dump_configuration(out);
+
+	if(mrc_)
+		mrc_->dump_configuration(out);
+
+	if(shadows_)
+		shadows_->dump_configuration(out);
+
 	out << YAML::EndMap;
 }
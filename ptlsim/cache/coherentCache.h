@@ -36,6 +36,9 @@
 #include <memoryStats.h>
 #include <statsBuilder.h>
 #include <cacheLines.h>
+#include <prefetcher.h>
+#include <missRatioCurve.h>
+#include <shadowTags.h>
 
 namespace Memory {
 
@@ -81,6 +84,7 @@ namespace Memory {
                 bool isSnoop;
                 bool isShared;
                 bool responseData;
+                bool prefetch;
 
                 void init() {
                     request      = NULL;
@@ -96,6 +100,7 @@ namespace Memory {
                     isSnoop      = false;
                     isShared     = false;
                     responseData = false;
+                    prefetch     = false;
                     source       = NULL;
                     dest         = NULL;
                     eventFlags.reset();
@@ -147,6 +152,7 @@ namespace Memory {
                     os << "] isSnoop[" << isSnoop;
                     os << "] isShared[" << isShared;
                     os << "] responseData[" << responseData;
+                    os << "] prefetch[" << prefetch;
                     os << "] ";
                     os << endl;
                     return os;
@@ -205,6 +211,12 @@ namespace Memory {
 
                 CoherenceLogic *coherence_logic_;
 
+                // Prefetch related variables
+                Prefetcher *prefetcher_;
+                MissRatioCurve *mrc_;
+                ShadowTagSet *shadows_;
+                int prefetchDelay_;
+
                 CacheQueueEntry* find_dependency(MemoryRequest *request);
 
                 // This function is used to find pending request with either
@@ -229,6 +241,8 @@ namespace Memory {
 
                 void get_directory(Interconnect *interconn);
 
+                void do_prefetch(MemoryRequest *request, bool hit);
+
             public:
                 CacheController(W8 coreid, const char *name,
                         MemoryHierarchy *memoryHierarchy, CacheType type);
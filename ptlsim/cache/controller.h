@@ -31,6 +31,7 @@
 #include <globals.h>
 #include <superstl.h>
 #include <memoryRequest.h>
+#include <memoryRequestTrace.h>
 
 namespace Memory {
 
@@ -89,17 +90,37 @@ class Controller
 		MemoryHierarchy *memoryHierarchy_;
 		W8 idx;
 
+		/* Index in the MemoryHierarchy's controller list and the full
+		 * state last reported to it, maintained by MemoryHierarchy */
+		int hierarchyIdx_;
+		bool hierarchyFull_;
+
 		Controller(W8 coreid, const char *name,
 				MemoryHierarchy *memoryHierarchy)
 			: handle_interconnect_("handle_interconnect")
 			, memoryHierarchy_(memoryHierarchy)
 			, idx(coreid)
+			, hierarchyIdx_(-1)
+			, hierarchyFull_(false)
 		{
 			name_ << name;
 			isPrivate_ = false;
 
 			handle_interconnect_.connect(signal_mem_ptr \
-					(*this, &Controller::handle_interconnect_cb));
+					(*this, &Controller::interconnect_cb));
+		}
+
+		/* Delivers a message and traces it if the controller took it */
+		bool interconnect_cb(void *arg)
+		{
+			Message *msg = (Message*)arg;
+			MemoryRequest *request = msg->request;
+			void *sender = msg->sender;
+			bool accepted = handle_interconnect_cb(arg);
+
+			if(accepted && request)
+				mem_req_trace(request, MEM_REQ_TRACE_RECV, this, sender);
+			return accepted;
 		}
 
         virtual ~Controller()
@@ -183,8 +183,8 @@ int CPUController::access_fast_path(Interconnect *interconnect,
 
   CPUControllerQueueEntry* queueEntry = pendingRequests_.alloc();
   
-  request->get_history() << "{ " << hexstring(get_line_address(request), 64) << " }";
-  request->get_history() << "{ " << queueEntry->idx << " }";
+  ADD_HISTORY(request, "{ ", hexstring(get_line_address(request), 64), " }");
+  ADD_HISTORY(request, "{ ", queueEntry->idx, " }");
 
 
   if unlikely (queueEntry == NULL) {
@@ -202,6 +202,7 @@ int CPUController::access_fast_path(Interconnect *interconnect,
   }
 
   queueEntry->request = request;
+  mem_req_trace(request, MEM_REQ_TRACE_QUEUE, this);
 
   if(false /*dependentEntry &&
      dependentEntry->request->get_type() == request->get_type()*/) {
@@ -215,7 +216,7 @@ int CPUController::access_fast_path(Interconnect *interconnect,
     dependentEntry->depends = queueEntry->idx;
     queueEntry->waitFor = dependentEntry->idx;
 
-    request->get_history() << "{Dep " << dependentEntry->idx << " }";
+    ADD_HISTORY(request, "{Dep ", dependentEntry->idx, " }");
 
     queueEntry->cycles = -1;
     if unlikely(queueEntry->request->is_instruction()) {
@@ -298,7 +299,7 @@ void CPUController::wakeup_dependents(CPUControllerQueueEntry *queueEntry)
   if(entry->depends >= 0) {
     nextEntry = &pendingRequests_[entry->depends];
     assert(nextEntry->request);
-    nextEntry->request->get_history() << "{ wakeup_sig: " << sim_cycle << " }";
+    ADD_HISTORY(nextEntry->request, "{ wakeup_sig: ", sim_cycle, " }");
     queueEntry->request->wakeup(nextEntry->request->get_robid());
     memdebug("Setting cycles left to 1 for dependent\n");
     nextEntry->cycles = 1;
@@ -330,6 +331,7 @@ void CPUController::finalize_request(CPUControllerQueueEntry *queueEntry)
     N_STAT_UPDATE(stats.dcache_latency, [req_latency]++, kernel_req);
   }
   memoryHierarchy_->core_wakeup(request);
+  mem_req_trace(request, MEM_REQ_TRACE_DONE, this);
 
   memdebug("Entry finalized..\n");
 
@@ -397,6 +399,7 @@ bool CPUController::queue_access_cb(void *arg)
   }
 
   queueEntry->request = request;
+  mem_req_trace(request, MEM_REQ_TRACE_QUEUE, this);
 
   CPUControllerQueueEntry *dependentEntry = find_dependency(request);
 
@@ -436,6 +439,7 @@ void CPUController::clock()
 {
   CPUControllerQueueEntry* queueEntry;
 
+#ifdef ENABLE_MEM_REQUEST_HISTORY
   stringbuf a;
   {
     foreach_list_mutable(pendingRequests_.list(), queueEntry, entry_t,
@@ -443,14 +447,15 @@ void CPUController::clock()
       a << queueEntry->idx << ",";
     }
   }
+#endif
 
 
   foreach_list_mutable(pendingRequests_.list(), queueEntry, entry_t,
 		       prev_t) {
     queueEntry->cycles--;
     if(queueEntry->cycles == 0) {
-      queueEntry->request->get_history() << "{ wakeup : " << sim_cycle << " }";
-      queueEntry->request->get_history() << "{ pendingRequest : " << a << " }";
+      ADD_HISTORY(queueEntry->request, "{ wakeup : ", sim_cycle, " }");
+      ADD_HISTORY(queueEntry->request, "{ pendingRequest : ", a, " }");
       memdebug("Finalizing from clock\n");
       finalize_request(queueEntry);
       wakeup_dependents(queueEntry);
@@ -0,0 +1,119 @@
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <prefetcher.h>
+
+using namespace Memory;
+
+/*
+ * Delta correlating prediction table (DCPT, Grannaes et al.). Each entry
+ * keeps the recent line deltas of one instruction. The two most recent
+ * deltas are searched for in the older history; on a match the deltas
+ * that followed it are replayed from the current line to produce
+ * 'degree' prefetches. A constant stride is simply a pattern of period
+ * one, so this also covers what the stride prefetcher does.
+ */
+class DeltaPrefetcher : public Prefetcher
+{
+    public:
+        DeltaPrefetcher(Statable *parent, const PrefetcherConfig &config)
+            : Prefetcher("delta", parent, config)
+        {
+            DeltaEntry empty;
+            memset(&empty, 0, sizeof(empty));
+            table.resize(max(config.table_size, 1), empty);
+        }
+
+    protected:
+        void train(W64 addr, W64 rip, bool miss);
+
+    private:
+        enum { DELTA_HISTORY = 8 };
+
+        struct DeltaEntry {
+            W64 rip;
+            W64 last_line;
+            W64s deltas[DELTA_HISTORY];
+            int head;
+            int count;
+
+            /* i-th delta, oldest first */
+            W64s get(int i) const {
+                return deltas[(head - count + i + DELTA_HISTORY) %
+                    DELTA_HISTORY];
+            }
+
+            void push(W64s delta) {
+                deltas[head] = delta;
+                head = (head + 1) % DELTA_HISTORY;
+                if (count < DELTA_HISTORY)
+                    count++;
+            }
+        };
+
+        dynarray<DeltaEntry> table;
+};
+
+void DeltaPrefetcher::train(W64 addr, W64 rip, bool miss)
+{
+    DeltaEntry &e = table[(rip ^ (rip >> 12)) % table.count()];
+    W64 line = line_of(addr);
+
+    if (e.rip != rip) {
+        e.rip       = rip;
+        e.last_line = line;
+        e.head      = 0;
+        e.count     = 0;
+        return;
+    }
+
+    W64s delta = line - e.last_line;
+    if (delta == 0)
+        return;
+
+    e.last_line = line;
+    e.push(delta);
+
+    if (e.count < 3)
+        return;
+
+    W64s d1 = e.get(e.count - 2);
+    W64s d2 = e.get(e.count - 1);
+
+    /* Find the latest earlier occurrence of the last delta pair */
+    int match = -1;
+    for (int i = e.count - 2; i >= 1; i--) {
+        if (e.get(i - 1) == d1 && e.get(i) == d2) {
+            match = i;
+            break;
+        }
+    }
+
+    if (match < 0)
+        return;
+
+    int period = (e.count - 1) - match;
+    W64 next = line;
+    foreach (i, degree) {
+        next += e.get(match + 1 + (i % period));
+        prefetch(next);
+    }
+}
+
+struct DeltaPrefetcherBuilder : public PrefetcherBuilder
+{
+    DeltaPrefetcherBuilder(const char* name) :
+        PrefetcherBuilder(name)
+    {}
+
+    Prefetcher* get_new_prefetcher(Statable *parent,
+            const PrefetcherConfig &config) {
+        return new DeltaPrefetcher(parent, config);
+    }
+};
+
+DeltaPrefetcherBuilder deltaPrefetcherBuilder("delta");
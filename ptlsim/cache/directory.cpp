@@ -0,0 +1,313 @@
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <directory.h>
+
+using namespace Memory;
+
+static const char *encoding_names[] = {
+    "full_vector",
+    "limited_pointer",
+    "coarse_vector",
+};
+
+/**
+ * @brief Setup a sharer format for a number of cores
+ *
+ * @param encoding_ One of DirSharerEncoding
+ * @param cores_ Number of cores that can share a line
+ * @param pointers_ Core ids kept before the list overflows
+ * @param group_ Cores per bit of a coarse vector
+ *
+ * The vector is a single word, so with more than 64 cores each bit of a
+ * full vector covers several cores as well.
+ */
+void DirSharerFormat::setup(int encoding_, int cores_, int pointers_,
+        int group_)
+{
+    cores    = max(cores_, 1);
+    encoding = encoding_;
+    pointers = min(max(pointers_, 1), DIR_MAX_POINTERS);
+
+    int min_group = (cores + 63) / 64;
+
+    if (encoding == DIR_COARSE_VECTOR)
+        group = max(group_, min_group);
+    else
+        group = min_group;
+}
+
+bool DirSharerFormat::parse(const char *name)
+{
+    foreach (i, lengthof(encoding_names)) {
+        if (strcmp(name, encoding_names[i]) == 0) {
+            encoding = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char* DirSharerFormat::name() const
+{
+    return encoding_names[encoding];
+}
+
+void DirectorySharers::add(int core, const DirSharerFormat &fmt)
+{
+    if (fmt.encoding == DIR_FULL_VECTOR)
+        mode = VECTOR;
+
+    switch (mode) {
+        case POINTERS:
+            foreach (i, count) {
+                if (ptrs[i] == core)
+                    return;
+            }
+
+            if (count < fmt.pointers) {
+                ptrs[count++] = core;
+                return;
+            }
+
+            /* The list overflows */
+            if (fmt.encoding == DIR_LIMITED_POINTER) {
+                mode = ALL;
+                return;
+            }
+
+            mode = VECTOR;
+            vec  = 0;
+            foreach (i, count)
+                vec |= 1ULL << (ptrs[i] / fmt.group);
+            count = 0;
+
+            /* fall through */
+        case VECTOR:
+            vec |= 1ULL << (core / fmt.group);
+            return;
+        default:
+            return;
+    }
+}
+
+void DirectorySharers::remove(int core, const DirSharerFormat &fmt)
+{
+    switch (mode) {
+        case POINTERS:
+            foreach (i, count) {
+                if (ptrs[i] == core) {
+                    ptrs[i] = ptrs[--count];
+                    return;
+                }
+            }
+            return;
+        case VECTOR:
+            /* Other cores of the group can still have the line */
+            if (fmt.group == 1)
+                vec &= ~(1ULL << core);
+            return;
+        default:
+            return;
+    }
+}
+
+bool DirectorySharers::may_contain(int core,
+        const DirSharerFormat &fmt) const
+{
+    switch (mode) {
+        case POINTERS:
+            foreach (i, count) {
+                if (ptrs[i] == core)
+                    return true;
+            }
+            return false;
+        case VECTOR:
+            return bit(vec, core / fmt.group);
+        default:
+            return core < fmt.cores;
+    }
+}
+
+bool DirectorySharers::exact(const DirSharerFormat &fmt) const
+{
+    return mode == POINTERS || (mode == VECTOR && fmt.group == 1);
+}
+
+bool DirectorySharers::empty() const
+{
+    switch (mode) {
+        case POINTERS: return count == 0;
+        case VECTOR:   return vec == 0;
+        default:       return false;
+    }
+}
+
+/* True only if the core is known to be the single sharer */
+bool DirectorySharers::only(int core, const DirSharerFormat &fmt) const
+{
+    if (!exact(fmt))
+        return false;
+
+    if (mode == POINTERS)
+        return count == 1 && ptrs[0] == core;
+
+    return vec == (1ULL << core);
+}
+
+/* True if a core other than 'core' can have the line */
+bool DirectorySharers::others(int core, const DirSharerFormat &fmt) const
+{
+    return !empty() && !only(core, fmt);
+}
+
+/**
+ * @brief Number of cores to invalidate
+ *
+ * @param except Core left out of the count, -1 for none
+ */
+int DirectorySharers::candidates(int except,
+        const DirSharerFormat &fmt) const
+{
+    if (mode == POINTERS) {
+        int n = count;
+        foreach (i, count) {
+            if (ptrs[i] == except)
+                n--;
+        }
+        return n;
+    }
+
+    int n = 0;
+    foreach (i, fmt.cores) {
+        if (i != except && may_contain(i, fmt))
+            n++;
+    }
+    return n;
+}
+
+/* Lowest core that can have the line, -1 if none */
+int DirectorySharers::first(const DirSharerFormat &fmt) const
+{
+    foreach (i, fmt.cores) {
+        if (may_contain(i, fmt))
+            return i;
+    }
+    return -1;
+}
+
+ostream& DirectorySharers::print(ostream &os) const
+{
+    switch (mode) {
+        case POINTERS:
+            os << "[";
+            foreach (i, count)
+                os << (i ? " " : "") << ptrs[i];
+            os << "]";
+            break;
+        case VECTOR:
+            os << "vec:" << hexstring(vec, 64);
+            break;
+        default:
+            os << "all";
+    }
+    return os;
+}
+
+/**
+ * @brief Reset the directory entry
+ */
+void DirectoryEntry::reset()
+{
+    sharers.clear();
+    tag       = -1;
+    owner     = -1;
+    dirty     = 0;
+    locked    = 0;
+    acks      = 0;
+    last_used = 0;
+}
+
+void DirectoryEntry::init(W64 tag_)
+{
+    sharers.clear();
+    tag    = tag_;
+    dirty  = 0;
+    owner  = -1;
+    locked = 0;
+    acks   = 0;
+}
+
+Directory::Directory(int sets, int ways, int line_size)
+    : sets_(max(sets, 1))
+      , ways_(max(ways, 1))
+      , lineSize_(line_size)
+      , lineBits_(lsbindex(line_size))
+      , homes_(1)
+      , useCount_(0)
+{
+    entries_.resize(sets_ * ways_, DirectoryEntry());
+}
+
+DirectoryEntry* Directory::probe(W64 addr)
+{
+    W64 tag = tag_of(addr);
+    DirectoryEntry *set = &entries_[set_of(addr) * ways_];
+
+    foreach (i, ways_) {
+        if (set[i].tag == tag) {
+            set[i].last_used = ++useCount_;
+            return &set[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Allocate an entry for a line
+ *
+ * @param addr Physical address of the line
+ * @param old_tag Set to the tag of the replaced entry, or left unchanged
+ * if the entry was free
+ *
+ * @return New entry, NULL if all entries of the set are locked
+ *
+ * A free entry is used first, then the least recently used one that is
+ * not locked. The caller has to invalidate the sharers of the
+ * replaced entry before calling init() on it.
+ */
+DirectoryEntry* Directory::insert(W64 addr, W64 &old_tag)
+{
+    DirectoryEntry *set = &entries_[set_of(addr) * ways_];
+    DirectoryEntry *victim = NULL;
+
+    foreach (i, ways_) {
+        DirectoryEntry *entry = &set[i];
+
+        if (entry->locked)
+            continue;
+
+        if (entry->tag == (W64)-1) {
+            victim = entry;
+            break;
+        }
+
+        if (!victim || entry->last_used < victim->last_used)
+            victim = entry;
+    }
+
+    if (!victim)
+        return NULL;
+
+    if (victim->tag != (W64)-1 && !victim->sharers.empty())
+        old_tag = victim->tag;
+
+    victim->last_used = ++useCount_;
+    return victim;
+}
@@ -0,0 +1,153 @@
+#ifndef DIRECTORY_H
+#define DIRECTORY_H
+
+#include <globals.h>
+#include <superstl.h>
+
+#define DIR_MAX_POINTERS 8
+
+namespace Memory {
+
+    enum DirSharerEncoding {
+        DIR_FULL_VECTOR = 0,  // one bit per core (per group beyond 64 cores)
+        DIR_LIMITED_POINTER,  // core ids, broadcast once they overflow
+        DIR_COARSE_VECTOR,    // core ids, then one bit per group of cores
+    };
+
+    /*
+     * How the sharers of a line are recorded. Every format keeps the
+     * entry the same size whatever the number of cores; the price is
+     * that past a few sharers the set can name cores that don't have the
+     * line, which then get invalidations they simply acknowledge.
+     */
+    struct DirSharerFormat
+    {
+        int encoding;
+        int pointers;   // ids kept before overflowing
+        int group;      // cores per bit of the vector
+        int cores;
+
+        DirSharerFormat()
+            : encoding(DIR_FULL_VECTOR)
+              , pointers(4)
+              , group(1)
+              , cores(1)
+        {}
+
+        void setup(int encoding_, int cores_, int pointers_, int group_);
+        bool parse(const char *name);
+        const char* name() const;
+    };
+
+    /*
+     * Sharers of one directory entry. It starts as a list of core ids and
+     * changes to a vector or to 'everyone' when the list overflows; it
+     * goes back to the list only when the line is invalidated everywhere.
+     */
+    struct DirectorySharers
+    {
+        enum { POINTERS = 0, VECTOR, ALL };
+
+        W16 ptrs[DIR_MAX_POINTERS];
+        W8  count;
+        W8  mode;
+        W64 vec;
+
+        void clear() { count = 0; mode = POINTERS; vec = 0; }
+
+        void add(int core, const DirSharerFormat &fmt);
+        void remove(int core, const DirSharerFormat &fmt);
+        bool may_contain(int core, const DirSharerFormat &fmt) const;
+        bool exact(const DirSharerFormat &fmt) const;
+        bool empty() const;
+        bool only(int core, const DirSharerFormat &fmt) const;
+        bool others(int core, const DirSharerFormat &fmt) const;
+        int  candidates(int except, const DirSharerFormat &fmt) const;
+        int  first(const DirSharerFormat &fmt) const;
+
+        ostream& print(ostream &os) const;
+    };
+
+    static inline ostream& operator <<(ostream &os,
+            const DirectorySharers &sharers)
+    {
+        return sharers.print(os);
+    }
+
+    /**
+     * @brief A Directory entry containing information for one line
+     *
+     * 'acks' counts the invalidations still in flight for the line, the
+     * entry stays locked until all of them are answered.
+     */
+    struct DirectoryEntry {
+        DirectorySharers sharers;
+        bool dirty;
+        W64  tag;
+        W16  owner;
+        bool locked;
+        W16  acks;
+        W64  last_used;
+
+        DirectoryEntry() { reset(); }
+        void reset();
+        void init(W64 tag_);
+
+        bool has_owner() const { return owner != (W16)-1; }
+
+        ostream& print(ostream &os) const {
+            os << "tag:" << (void*)tag << " dirty:" << dirty;
+            os << " owner:" << (int)(has_owner() ? owner : -1);
+            os << " acks:" << acks << " sharers:" << sharers;
+            return os;
+        }
+    };
+
+    static inline ostream& operator <<(ostream &os, const DirectoryEntry &e)
+    {
+        return e.print(os);
+    }
+
+    /**
+     * @brief Sparse directory of one home node
+     *
+     * A set-associative array of entries replaced in LRU order. It only
+     * tracks the lines cached somewhere in the hierarchy, so an entry
+     * evicted for capacity must have its copies invalidated by the
+     * controller. Lines are interleaved over 'homes' home nodes and the
+     * set index skips the home bits so each home uses all its sets.
+     */
+    class Directory {
+        public:
+            Directory(int sets, int ways, int line_size);
+
+            DirectoryEntry *probe(W64 addr);
+            DirectoryEntry *insert(W64 addr, W64 &old_tag);
+
+            void set_interleave(int homes) { homes_ = max(homes, 1); }
+
+            W64 tag_of(W64 addr) const { return floor(addr, lineSize_); }
+            int sets() const { return sets_; }
+            int ways() const { return ways_; }
+            int line_size() const { return lineSize_; }
+
+            DirSharerFormat format;
+
+        private:
+            dynarray<DirectoryEntry> entries_;
+
+            int sets_;
+            int ways_;
+            int lineSize_;
+            int lineBits_;
+            int homes_;
+            W64 useCount_;
+
+            int set_of(W64 addr) const {
+                return ((addr >> lineBits_) / homes_) % sets_;
+            }
+    };
+
+};
+
+#endif // DIRECTORY_H
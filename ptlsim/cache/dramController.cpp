@@ -0,0 +1,543 @@
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#define PTLSIM_PUBLIC_ONLY
+#include <ptlhwdef.h>
+#endif
+
+#include <dramController.h>
+#include <memoryHierarchy.h>
+
+#include <machine.h>
+
+using namespace Memory;
+
+/* DDR3-1600 clock period */
+static const int DEFAULT_TCK_PS = 1250;
+
+/* Convert DRAM clocks of 'tck_ps' picoseconds to simulation cycles */
+static int dram_to_simcycles(int clocks, int tck_ps)
+{
+    if (clocks <= 0)
+        return 0;
+
+    double ps = double(clocks) * double(tck_ps);
+    return max(int(ceil(ps * double(config.core_freq_hz) / 1e12)), 1);
+}
+
+DRAMController::DRAMController(W8 coreid, const char *name,
+        MemoryHierarchy *memoryHierarchy) :
+    Controller(coreid, name, memoryHierarchy)
+    , cacheInterconnect_(NULL)
+    , timing_(NULL)
+    , readsQueued_(0)
+    , writesQueued_(0)
+    , draining_(false)
+    , drainStart_(false)
+    , scheduled_(false)
+    , scheduleCycle_(0)
+    , lastCycle_(0)
+    , new_stats(name, &memoryHierarchy->get_machine())
+{
+    memoryHierarchy_->add_cache_mem_controller(this);
+
+    DRAMConfig dram_config;
+    read_config(dram_config);
+    timing_ = new DRAMTiming(dram_config);
+
+    SET_SIGNAL_CB(name, "_Schedule", schedule_,
+            &DRAMController::schedule_cb);
+
+    SET_SIGNAL_CB(name, "_Access_Completed", accessCompleted_,
+            &DRAMController::access_completed_cb);
+
+    SET_SIGNAL_CB(name, "_Wait_Interconnect", waitInterconnect_,
+            &DRAMController::wait_interconnect_cb);
+}
+
+DRAMController::~DRAMController()
+{
+    delete timing_;
+}
+
+/**
+ * @brief Read DRAM organization and timing from the machine options
+ *
+ * @param dc Configuration to fill, keeps its defaults for missing options
+ *
+ * Timing parameters are given in DRAM clocks of 'tCK' picoseconds,
+ * 'static_latency' (controller and PHY overhead) in nanoseconds.
+ */
+void DRAMController::read_config(DRAMConfig &dc)
+{
+    BaseMachine &machine = memoryHierarchy_->get_machine();
+    const char *name = get_name();
+    stringbuf policy;
+
+    machine.get_option(name, "channels", dc.channels);
+    machine.get_option(name, "ranks", dc.ranks);
+    machine.get_option(name, "banks", dc.banks);
+    machine.get_option(name, "row_size", dc.row_size);
+
+    dc.channels = max(dc.channels, 1);
+    dc.ranks    = max(dc.ranks, 1);
+    dc.banks    = max(dc.banks, 1);
+
+    if (machine.get_option(name, "page_policy", policy)) {
+        dc.open_page = (strcmp(policy.buf, "closed") != 0);
+    }
+
+    policy.reset();
+    if (machine.get_option(name, "interleave", policy)) {
+        dc.line_interleave = (strcmp(policy.buf, "line") == 0);
+    }
+
+    int tck = DEFAULT_TCK_PS;
+    int tCL = 11, tCWL = 8, tRCD = 11, tRP = 11, tRAS = 28;
+    int tRRD = 5, tFAW = 24, tWR = 12, tWTR = 6, tRTP = 6, tBURST = 4;
+
+    machine.get_option(name, "tCK", tck);
+    machine.get_option(name, "tCL", tCL);
+    machine.get_option(name, "tCWL", tCWL);
+    machine.get_option(name, "tRCD", tRCD);
+    machine.get_option(name, "tRP", tRP);
+    machine.get_option(name, "tRAS", tRAS);
+    machine.get_option(name, "tRRD", tRRD);
+    machine.get_option(name, "tFAW", tFAW);
+    machine.get_option(name, "tWR", tWR);
+    machine.get_option(name, "tWTR", tWTR);
+    machine.get_option(name, "tRTP", tRTP);
+    machine.get_option(name, "tBURST", tBURST);
+
+    dc.tCL    = dram_to_simcycles(tCL, tck);
+    dc.tCWL   = dram_to_simcycles(tCWL, tck);
+    dc.tRCD   = dram_to_simcycles(tRCD, tck);
+    dc.tRP    = dram_to_simcycles(tRP, tck);
+    dc.tRAS   = dram_to_simcycles(tRAS, tck);
+    dc.tRRD   = dram_to_simcycles(tRRD, tck);
+    dc.tFAW   = dram_to_simcycles(tFAW, tck);
+    dc.tWR    = dram_to_simcycles(tWR, tck);
+    dc.tWTR   = dram_to_simcycles(tWTR, tck);
+    dc.tRTP   = dram_to_simcycles(tRTP, tck);
+    dc.tBURST = dram_to_simcycles(tBURST, tck);
+
+    readQueueSize_  = 64;
+    writeQueueSize_ = 64;
+    machine.get_option(name, "read_queue", readQueueSize_);
+    machine.get_option(name, "write_queue", writeQueueSize_);
+    readQueueSize_  = min(max(readQueueSize_, 1), MEM_REQ_NUM);
+    writeQueueSize_ = min(max(writeQueueSize_, 1), MEM_REQ_NUM);
+
+    writeHigh_ = (writeQueueSize_ * 3) / 4;
+    writeLow_  = writeQueueSize_ / 4;
+    machine.get_option(name, "write_high", writeHigh_);
+    machine.get_option(name, "write_low", writeLow_);
+    writeHigh_ = min(max(writeHigh_, 1), writeQueueSize_);
+    writeLow_  = min(max(writeLow_, 0), writeHigh_ - 1);
+
+    staticLatency_ = 10;
+    machine.get_option(name, "static_latency", staticLatency_);
+    staticLatency_ = ns_to_simcycles(staticLatency_);
+}
+
+void DRAMController::register_interconnect(Interconnect *interconnect,
+        int type)
+{
+    switch(type) {
+        case INTERCONN_TYPE_UPPER:
+            cacheInterconnect_ = interconnect;
+            break;
+        default:
+            assert(0);
+    }
+}
+
+bool DRAMController::handle_interconnect_cb(void *arg)
+{
+    Message *message = (Message*)arg;
+    MemoryRequest *request = message->request;
+    OP_TYPE type = request->get_type();
+
+    memdebug("Received message in DRAM controller: ", *message, endl);
+
+    if(message->hasData && type != MEMORY_OP_UPDATE)
+        return true;
+
+    if (type == MEMORY_OP_EVICT) {
+        /* We ignore all the evict messages */
+        return true;
+    }
+
+    bool kernel = request->is_kernel();
+    bool write = (type == MEMORY_OP_UPDATE || type == MEMORY_OP_WRITE);
+
+    /*
+     * A memory update to a line that already has an update waiting in the
+     * write queue is merged into it. Stop at the newest request to the
+     * line so updates are not reordered around reads and writes.
+     */
+    if(type == MEMORY_OP_UPDATE) {
+        DRAMQueueEntry *entry;
+        foreach_list_mutable_backwards(pendingRequests_.list(),
+                entry, entry_t, nextentry_t) {
+            if(entry->request->get_physical_address() ==
+                    request->get_physical_address()) {
+                if(!entry->issued && entry->request->get_type() ==
+                        MEMORY_OP_UPDATE) {
+                    N_STAT_UPDATE(new_stats.merged_writes, ++, kernel);
+                    return true;
+                }
+                break;
+            }
+        }
+    }
+
+    if((write && writesQueued_ >= writeQueueSize_) ||
+            (!write && readsQueued_ >= readQueueSize_)) {
+        memdebug("DRAM queue is full\n");
+        N_STAT_UPDATE(new_stats.queue_full, ++, kernel);
+        return false;
+    }
+
+    DRAMQueueEntry *queueEntry = pendingRequests_.alloc();
+
+    /* if queue is full return false to indicate failure */
+    if(queueEntry == NULL) {
+        memdebug("DRAM queue is full\n");
+        N_STAT_UPDATE(new_stats.queue_full, ++, kernel);
+        return false;
+    }
+
+    if(pendingRequests_.isFull()) {
+        memoryHierarchy_->set_controller_full(this, true);
+    }
+
+    queueEntry->request = request;
+    queueEntry->source = (Controller*)message->origin;
+    queueEntry->arrival = sim_cycle;
+    queueEntry->write = write;
+    timing_->decode(request->get_physical_address(), queueEntry->addr);
+
+    queueEntry->request->incRefCounter();
+    ADD_HISTORY_ADD(queueEntry->request);
+    mem_req_trace(queueEntry->request, MEM_REQ_TRACE_QUEUE, this);
+
+    if (write)
+        writesQueued_++;
+    else
+        readsQueued_++;
+
+    request_schedule(sim_cycle + 1);
+
+    return true;
+}
+
+/**
+ * @brief Make sure the scheduler runs at or before 'cycle'
+ *
+ * Only the latest requested schedule event does any work, the ones it
+ * replaced return immediately.
+ */
+void DRAMController::request_schedule(W64 cycle)
+{
+    if (scheduled_ && scheduleCycle_ <= cycle)
+        return;
+
+    scheduled_ = true;
+    scheduleCycle_ = cycle;
+    marss_add_event(&schedule_, cycle - sim_cycle, NULL);
+}
+
+bool DRAMController::schedule_cb(void *arg)
+{
+    if (!scheduled_ || sim_cycle != scheduleCycle_)
+        return true;
+
+    scheduled_ = false;
+
+    /* Write drain mode, with hysteresis between the watermarks */
+    if (!draining_ && writesQueued_ > 0 &&
+            (writesQueued_ >= writeHigh_ || readsQueued_ == 0)) {
+        draining_ = true;
+        drainStart_ = true;
+    } else if (draining_ && (writesQueued_ == 0 ||
+                (readsQueued_ > 0 && writesQueued_ <= writeLow_))) {
+        draining_ = false;
+    }
+
+    W64 next_ready = (W64)-1;
+    DRAMQueueEntry *entry = pick_request(draining_, next_ready);
+
+    if (entry)
+        issue_request(entry);
+
+    if (readsQueued_ + writesQueued_ > 0) {
+        request_schedule(entry ? sim_cycle + 1 :
+                max(next_ready, sim_cycle + 1));
+    }
+
+    return true;
+}
+
+/**
+ * @brief FR-FCFS selection among the read or the write queue
+ *
+ * @param write Select from the write queue
+ * @param next_ready Set to the earliest cycle a waiting request is ready
+ *
+ * @return Oldest ready row hit, else oldest ready request, else NULL
+ */
+DRAMQueueEntry* DRAMController::pick_request(bool write, W64 &next_ready)
+{
+    DRAMQueueEntry *first_ready = NULL;
+    DRAMQueueEntry *entry;
+
+    foreach_list_mutable(pendingRequests_.list(), entry, entry_t, prev_t) {
+        if (entry->issued || entry->write != write)
+            continue;
+
+        W64 ready = timing_->ready_cycle(entry->addr, write);
+        if (ready > sim_cycle) {
+            next_ready = min(next_ready, ready);
+            continue;
+        }
+
+        if (timing_->row_state(entry->addr) == DRAM_ROW_HIT)
+            return entry;
+
+        if (!first_ready)
+            first_ready = entry;
+    }
+
+    return first_ready;
+}
+
+void DRAMController::issue_request(DRAMQueueEntry *entry)
+{
+    const DRAMConfig &dc = timing_->get_config();
+    bool kernel = entry->request->is_kernel();
+    DRAMRowResult result;
+
+    W64 done = timing_->issue(entry->addr, entry->write, sim_cycle, result);
+    entry->issued = true;
+
+    N_STAT_UPDATE(new_stats.accesses, ++, kernel);
+
+    if (entry->write) {
+        writesQueued_--;
+        N_STAT_UPDATE(new_stats.writes, ++, kernel);
+        N_STAT_UPDATE(new_stats.write_queue_cycles,
+                += sim_cycle - entry->arrival, kernel);
+        N_STAT_UPDATE(new_stats.bytes_written, += 1 << dc.line_bits, kernel);
+
+        if (drainStart_) {
+            N_STAT_UPDATE(new_stats.write_drains, ++, kernel);
+            drainStart_ = false;
+        }
+    } else {
+        readsQueued_--;
+        N_STAT_UPDATE(new_stats.reads, ++, kernel);
+        N_STAT_UPDATE(new_stats.read_queue_cycles,
+                += sim_cycle - entry->arrival, kernel);
+        N_STAT_UPDATE(new_stats.bytes_read, += 1 << dc.line_bits, kernel);
+    }
+
+    switch (result) {
+        case DRAM_ROW_HIT:
+            N_STAT_UPDATE(new_stats.row_hit, ++, kernel);
+            break;
+        case DRAM_ROW_CLOSED:
+            N_STAT_UPDATE(new_stats.row_closed, ++, kernel);
+            N_STAT_UPDATE(new_stats.activates, ++, kernel);
+            break;
+        case DRAM_ROW_CONFLICT:
+            N_STAT_UPDATE(new_stats.row_conflict, ++, kernel);
+            N_STAT_UPDATE(new_stats.activates, ++, kernel);
+            N_STAT_UPDATE(new_stats.precharges, ++, kernel);
+            break;
+    }
+
+    if (!dc.open_page) {
+        N_STAT_UPDATE(new_stats.precharges, ++, kernel);
+    }
+
+    N_STAT_UPDATE(new_stats.data_bus_cycles, += dc.tBURST, kernel);
+
+    /* Time from the first command to the end of the latest transfer */
+    if (lastCycle_ == 0)
+        lastCycle_ = sim_cycle;
+    if (done > lastCycle_) {
+        N_STAT_UPDATE(new_stats.cycles, += done - lastCycle_, kernel);
+        lastCycle_ = done;
+    }
+
+    memdebug("DRAM issued: ", *entry, " done at ", done, endl);
+
+    marss_add_event(&accessCompleted_, done - sim_cycle + staticLatency_,
+            entry);
+}
+
+void DRAMController::print(ostream& os) const
+{
+    os << "---DRAM-Controller: ", get_name(), endl;
+    if(pendingRequests_.count() > 0)
+        os << "Queue : ", pendingRequests_, endl;
+    os << "reads queued: ", readsQueued_, " writes queued: ",
+       writesQueued_, " draining: ", draining_, endl;
+    os << "---End DRAM-Controller: ", get_name(), endl;
+}
+
+bool DRAMController::access_completed_cb(void *arg)
+{
+    DRAMQueueEntry *queueEntry = (DRAMQueueEntry*)arg;
+
+    if (!queueEntry->write) {
+        N_STAT_UPDATE(new_stats.read_latency,
+                += sim_cycle - queueEntry->arrival,
+                queueEntry->request->is_kernel());
+    }
+
+    if(!queueEntry->annuled) {
+        /* Send response back to cache */
+        memdebug("DRAM access done for Request: ", *queueEntry->request,
+                endl);
+
+        wait_interconnect_cb(queueEntry);
+    } else {
+        free_entry(queueEntry);
+    }
+
+    return true;
+}
+
+bool DRAMController::wait_interconnect_cb(void *arg)
+{
+    DRAMQueueEntry *queueEntry = (DRAMQueueEntry*)arg;
+
+    /* Don't send response if its a memory update request */
+    if(queueEntry->request->get_type() == MEMORY_OP_UPDATE) {
+        free_entry(queueEntry);
+        return true;
+    }
+
+    Message& message = *memoryHierarchy_->get_message();
+    message.sender = this;
+    message.dest = queueEntry->source;
+    message.request = queueEntry->request;
+    message.hasData = true;
+
+    memdebug("DRAM sending message: ", message);
+    bool success = cacheInterconnect_->get_controller_request_signal()->
+        emit(&message);
+    memoryHierarchy_->free_message(&message);
+
+    if(!success) {
+        /* Failed to response to cache, retry after 1 cycle */
+        marss_add_event(&waitInterconnect_, 1, queueEntry);
+    } else {
+        free_entry(queueEntry);
+    }
+
+    return true;
+}
+
+void DRAMController::free_entry(DRAMQueueEntry *entry)
+{
+    entry->request->decRefCounter();
+    ADD_HISTORY_REM(entry->request);
+    pendingRequests_.free(entry);
+
+    if(!pendingRequests_.isFull()) {
+        memoryHierarchy_->set_controller_full(this, false);
+    }
+}
+
+void DRAMController::annul_request(MemoryRequest *request)
+{
+    DRAMQueueEntry *queueEntry;
+    foreach_list_mutable(pendingRequests_.list(), queueEntry,
+            entry, nextentry) {
+        if(queueEntry->request->is_same(request)) {
+            queueEntry->annuled = true;
+            if(!queueEntry->issued) {
+                if (queueEntry->write)
+                    writesQueued_--;
+                else
+                    readsQueued_--;
+                free_entry(queueEntry);
+            }
+        }
+    }
+}
+
+int DRAMController::get_no_pending_request(W8 coreid)
+{
+    int count = 0;
+    DRAMQueueEntry *queueEntry;
+    foreach_list_mutable(pendingRequests_.list(), queueEntry,
+            entry, nextentry) {
+        if(queueEntry->request->get_coreid() == coreid)
+            count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Dump DRAM Controller in YAML Format
+ *
+ * @param out YAML Object
+ */
+void DRAMController::dump_configuration(YAML::Emitter &out) const
+{
+    const DRAMConfig &dc = timing_->get_config();
+
+    out << YAML::Key << get_name() << YAML::Value << YAML::BeginMap;
+
+    YAML_KEY_VAL(out, "type", "ddr_dram_cont");
+    YAML_KEY_VAL(out, "RAM_size", ram_size); /* ram_size is from QEMU */
+    YAML_KEY_VAL(out, "channels", dc.channels);
+    YAML_KEY_VAL(out, "ranks", dc.ranks);
+    YAML_KEY_VAL(out, "banks", dc.banks);
+    YAML_KEY_VAL(out, "row_size", dc.row_size);
+    YAML_KEY_VAL(out, "page_policy", (dc.open_page ? "open" : "closed"));
+    YAML_KEY_VAL(out, "interleave", (dc.line_interleave ? "line" : "row"));
+
+    /* Timings in simulation cycles */
+    YAML_KEY_VAL(out, "tCL", dc.tCL);
+    YAML_KEY_VAL(out, "tCWL", dc.tCWL);
+    YAML_KEY_VAL(out, "tRCD", dc.tRCD);
+    YAML_KEY_VAL(out, "tRP", dc.tRP);
+    YAML_KEY_VAL(out, "tRAS", dc.tRAS);
+    YAML_KEY_VAL(out, "tRRD", dc.tRRD);
+    YAML_KEY_VAL(out, "tFAW", dc.tFAW);
+    YAML_KEY_VAL(out, "tWR", dc.tWR);
+    YAML_KEY_VAL(out, "tWTR", dc.tWTR);
+    YAML_KEY_VAL(out, "tRTP", dc.tRTP);
+    YAML_KEY_VAL(out, "tBURST", dc.tBURST);
+    YAML_KEY_VAL(out, "static_latency", staticLatency_);
+
+    YAML_KEY_VAL(out, "read_queue_size", readQueueSize_);
+    YAML_KEY_VAL(out, "write_queue_size", writeQueueSize_);
+    YAML_KEY_VAL(out, "write_high", writeHigh_);
+    YAML_KEY_VAL(out, "write_low", writeLow_);
+    YAML_KEY_VAL(out, "pending_queue_size", pendingRequests_.size());
+
+    out << YAML::EndMap;
+}
+
+/* DRAM Controller Builder */
+struct DRAMControllerBuilder : public ControllerBuilder
+{
+    DRAMControllerBuilder(const char* name) :
+        ControllerBuilder(name)
+    {}
+
+    Controller* get_new_controller(W8 coreid, W8 type,
+            MemoryHierarchy& mem, const char *name) {
+        return new DRAMController(coreid, name, &mem);
+    }
+};
+
+DRAMControllerBuilder dramControllerBuilder("ddr_dram_cont");
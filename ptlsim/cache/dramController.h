@@ -0,0 +1,129 @@
+
+#ifndef DRAM_CONTROLLER_H
+#define DRAM_CONTROLLER_H
+
+#include <controller.h>
+#include <interconnect.h>
+#include <superstl.h>
+#include <memoryStats.h>
+#include <dramTiming.h>
+
+namespace Memory {
+
+    struct DRAMQueueEntry : public FixStateListObject
+    {
+        MemoryRequest *request;
+        Controller *source;
+        DRAMAddress addr;
+        W64 arrival;
+        bool write;
+        bool issued;
+        bool annuled;
+
+        void init() {
+            request = NULL;
+            source = NULL;
+            arrival = 0;
+            write = false;
+            issued = false;
+            annuled = false;
+        }
+
+        ostream& print(ostream &os) const {
+            if(request)
+                os << "Request{", *request, "} ";
+            if (source)
+                os << "source[", source->get_name(), "] ";
+            os << "channel[", addr.channel, "] ";
+            os << "rank[", addr.rank, "] ";
+            os << "bank[", addr.bank, "] ";
+            os << "row[", addr.row, "] ";
+            os << "arrival[", arrival, "] ";
+            os << "write[", write, "] ";
+            os << "issued[", issued, "] ";
+            os << "annuled[", annuled, "] ";
+            os << endl;
+            return os;
+        }
+    };
+
+    /*
+     * Memory controller with a DRAM timing model. Requests wait in a read
+     * or a write queue and are scheduled First-Ready First-Come-First-Serve:
+     * the oldest request that hits an open row and can issue now goes
+     * first, otherwise the oldest request whose bank is ready. Writes are
+     * buffered and drained in bursts once the write queue passes its high
+     * watermark, or when there are no reads to serve.
+     */
+    class DRAMController : public Controller
+    {
+        private:
+            Interconnect *cacheInterconnect_;
+
+            Signal schedule_;
+            Signal accessCompleted_;
+            Signal waitInterconnect_;
+
+            FixStateList<DRAMQueueEntry, MEM_REQ_NUM> pendingRequests_;
+
+            DRAMTiming *timing_;
+
+            int readQueueSize_;
+            int writeQueueSize_;
+            int writeHigh_;
+            int writeLow_;
+            int staticLatency_;
+
+            int readsQueued_;
+            int writesQueued_;
+            bool draining_;
+            bool drainStart_;
+
+            bool scheduled_;
+            W64 scheduleCycle_;
+            W64 lastCycle_;
+
+            DRAMStats new_stats;
+
+            void read_config(DRAMConfig &config);
+            void request_schedule(W64 cycle);
+            DRAMQueueEntry* pick_request(bool write, W64 &next_ready);
+            void issue_request(DRAMQueueEntry *entry);
+            void free_entry(DRAMQueueEntry *entry);
+
+        public:
+            DRAMController(W8 coreid, const char *name,
+                    MemoryHierarchy *memoryHierarchy);
+            ~DRAMController();
+
+            virtual bool handle_interconnect_cb(void *arg);
+            void print(ostream& os) const;
+
+            virtual void register_interconnect(Interconnect *interconnect,
+                    int type);
+
+            bool schedule_cb(void *arg);
+            virtual bool access_completed_cb(void *arg);
+            virtual bool wait_interconnect_cb(void *arg);
+
+            void annul_request(MemoryRequest *request);
+            virtual void dump_configuration(YAML::Emitter &out) const;
+
+            virtual int get_no_pending_request(W8 coreid);
+
+            bool is_full(bool fromInterconnect = false) const {
+                return pendingRequests_.isFull();
+            }
+
+            void print_map(ostream& os)
+            {
+                os << "DRAM Controller: ", get_name(), endl;
+                os << "\tconnected to:", endl;
+                os << "\t\tinterconnect: ", cacheInterconnect_->get_name(),
+                   endl;
+            }
+    };
+
+};
+
+#endif // DRAM_CONTROLLER_H
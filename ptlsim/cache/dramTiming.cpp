@@ -0,0 +1,176 @@
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <dramTiming.h>
+
+using namespace Memory;
+
+DRAMTiming::DRAMTiming(const DRAMConfig &config)
+    : config(config)
+{
+    Bank closed = {0, false, 0, 0, 0};
+    Rank idle;
+    memset(&idle, 0, sizeof(idle));
+
+    lines_per_row = max(config.row_size >> config.line_bits, 1);
+
+    banks.resize(config.channels * config.ranks * config.banks, closed);
+    ranks.resize(config.channels * config.ranks, idle);
+    bus_free.resize(config.channels, 0);
+}
+
+/**
+ * @brief Map a physical address to its channel, rank, bank and row
+ *
+ * @param addr Physical address
+ * @param da Decoded address
+ *
+ * By default consecutive lines fill a row before moving to the next
+ * channel and bank (row:rank:bank:channel:column), which favours row
+ * hits. With line interleaving consecutive lines go to different
+ * channels and banks first (row:column:rank:bank:channel).
+ */
+void DRAMTiming::decode(W64 addr, DRAMAddress &da) const
+{
+    W64 line = addr >> config.line_bits;
+
+    if (!config.line_interleave)
+        line /= lines_per_row;
+
+    da.channel = line % config.channels;
+    line /= config.channels;
+    da.bank = line % config.banks;
+    line /= config.banks;
+    da.rank = line % config.ranks;
+    line /= config.ranks;
+
+    if (config.line_interleave)
+        line /= lines_per_row;
+
+    da.row = line;
+}
+
+DRAMRowResult DRAMTiming::row_state(const DRAMAddress &da) const
+{
+    const Bank &bank = banks[bank_index(da)];
+
+    if (!bank.open)
+        return DRAM_ROW_CLOSED;
+
+    return (bank.row == da.row) ? DRAM_ROW_HIT : DRAM_ROW_CONFLICT;
+}
+
+/**
+ * @brief Earliest cycle the first command of an access can be issued
+ *
+ * @param da Decoded address
+ * @param write Access is a write
+ *
+ * @return Cycle of the column command for row hits, of the activate for
+ * closed banks and of the precharge for row conflicts
+ */
+W64 DRAMTiming::ready_cycle(const DRAMAddress &da, bool write) const
+{
+    const Bank &bank = banks[bank_index(da)];
+    const Rank &rank = ranks[rank_index(da)];
+
+    switch (row_state(da)) {
+        case DRAM_ROW_HIT:
+            return write ? bank.cas_ready : max(bank.cas_ready,
+                    rank.read_ready);
+        case DRAM_ROW_CLOSED:
+            return max(bank.act_ready, activate_ready(rank));
+        default:
+            return bank.pre_ready;
+    }
+}
+
+/**
+ * @brief Issue all commands of one access
+ *
+ * @param da Decoded address
+ * @param write Access is a write
+ * @param now Current cycle
+ * @param result Set to the row buffer outcome of the access
+ *
+ * @return Cycle the data transfer of the access ends
+ */
+W64 DRAMTiming::issue(const DRAMAddress &da, bool write, W64 now,
+        DRAMRowResult &result)
+{
+    Bank &bank = banks[bank_index(da)];
+    Rank &rank = ranks[rank_index(da)];
+    W64 cas;
+
+    result = row_state(da);
+
+    if (result == DRAM_ROW_HIT) {
+        cas = max(now, bank.cas_ready);
+    } else {
+        W64 act = max(now, bank.act_ready);
+
+        if (result == DRAM_ROW_CONFLICT)
+            act = max(act, max(now, bank.pre_ready) + config.tRP);
+
+        act = max(act, activate_ready(rank));
+        activate(rank, act);
+
+        bank.row = da.row;
+        bank.open = true;
+        bank.pre_ready = act + config.tRAS;
+        cas = max(act + config.tRCD, bank.cas_ready);
+    }
+
+    if (!write)
+        cas = max(cas, rank.read_ready);
+
+    /* The data bus is shared by all ranks of a channel */
+    W64 data = cas + (write ? config.tCWL : config.tCL);
+    W64 &bus = bus_free[da.channel];
+    if (data < bus) {
+        cas += bus - data;
+        data = bus;
+    }
+
+    W64 done = data + config.tBURST;
+    bus = done;
+    bank.cas_ready = cas + config.tBURST;
+
+    if (write) {
+        bank.pre_ready = max(bank.pre_ready, done + config.tWR);
+        rank.read_ready = max(rank.read_ready, done + config.tWTR);
+    } else {
+        bank.pre_ready = max(bank.pre_ready, cas + config.tRTP);
+    }
+
+    /* Closed page policy precharges as soon as the access allows it */
+    if (!config.open_page) {
+        bank.open = false;
+        bank.act_ready = bank.pre_ready + config.tRP;
+    }
+
+    return done;
+}
+
+W64 DRAMTiming::activate_ready(const Rank &rank) const
+{
+    if (rank.act_count < 4)
+        return rank.act_ready;
+
+    /* act_head points to the oldest of the last four activates */
+    return max(rank.act_ready, rank.acts[rank.act_head] + config.tFAW);
+}
+
+void DRAMTiming::activate(Rank &rank, W64 cycle)
+{
+    rank.acts[rank.act_head] = cycle;
+    rank.act_head = (rank.act_head + 1) % 4;
+    rank.act_ready = cycle + config.tRRD;
+
+    if (rank.act_count < 4)
+        rank.act_count++;
+}
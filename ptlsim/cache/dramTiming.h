@@ -0,0 +1,134 @@
+
+#ifndef DRAM_TIMING_H
+#define DRAM_TIMING_H
+
+#include <globals.h>
+#include <superstl.h>
+
+namespace Memory {
+
+    /*
+     * Organization and timing of a DRAM system. Timings are in simulation
+     * cycles; DRAMController converts them from DRAM clocks when it reads
+     * the machine options. The defaults are a DDR3-1600 11-11-11 part
+     * clocked at 1.25ns with a 2 GHz core.
+     */
+    struct DRAMConfig
+    {
+        int channels;
+        int ranks;          // per channel
+        int banks;          // per rank
+        int row_size;       // bytes in one row of a rank
+        int line_bits;
+        bool open_page;     // leave rows open after an access
+        bool line_interleave; // spread consecutive lines over banks
+
+        int tCL;            // read command to data
+        int tCWL;           // write command to data
+        int tRCD;           // activate to column command
+        int tRP;            // precharge to activate
+        int tRAS;           // activate to precharge
+        int tRRD;           // activate to activate, same rank
+        int tFAW;           // window holding at most four activates
+        int tWR;            // end of write data to precharge
+        int tWTR;           // end of write data to read command
+        int tRTP;           // read command to precharge
+        int tBURST;         // data bus cycles per line
+
+        DRAMConfig()
+            : channels(1)
+              , ranks(1)
+              , banks(8)
+              , row_size(8192)
+              , line_bits(6)
+              , open_page(true)
+              , line_interleave(false)
+              , tCL(28)
+              , tCWL(20)
+              , tRCD(28)
+              , tRP(28)
+              , tRAS(70)
+              , tRRD(13)
+              , tFAW(60)
+              , tWR(30)
+              , tWTR(15)
+              , tRTP(15)
+              , tBURST(10)
+        {}
+    };
+
+    struct DRAMAddress
+    {
+        int channel;
+        int rank;
+        int bank;
+        W64 row;
+    };
+
+    enum DRAMRowResult {
+        DRAM_ROW_HIT = 0,   // row already open
+        DRAM_ROW_CLOSED,    // bank precharged, needs an activate
+        DRAM_ROW_CONFLICT,  // other row open, needs precharge and activate
+    };
+
+    /*
+     * State of every bank, rank and channel of a DRAM system. A request is
+     * issued as a whole, the precharge, activate and column commands it
+     * needs are placed at the earliest cycles the timing constraints
+     * allow and issue() returns when its data transfer ends. The
+     * scheduler uses ready_cycle() to find requests whose first command
+     * could go out now.
+     */
+    class DRAMTiming
+    {
+        public:
+            DRAMTiming(const DRAMConfig &config);
+
+            void decode(W64 addr, DRAMAddress &da) const;
+
+            DRAMRowResult row_state(const DRAMAddress &da) const;
+            W64 ready_cycle(const DRAMAddress &da, bool write) const;
+            W64 issue(const DRAMAddress &da, bool write, W64 now,
+                    DRAMRowResult &result);
+
+            int get_bank_count() const { return banks.count(); }
+            const DRAMConfig& get_config() const { return config; }
+
+        private:
+            struct Bank {
+                W64 row;
+                bool open;
+                W64 act_ready;
+                W64 pre_ready;
+                W64 cas_ready;
+            };
+
+            struct Rank {
+                W64 acts[4];    // last four activates, for tFAW
+                int act_head;
+                int act_count;
+                W64 act_ready;  // tRRD
+                W64 read_ready; // tWTR
+            };
+
+            const DRAMConfig config;
+            int lines_per_row;
+
+            dynarray<Bank> banks;
+            dynarray<Rank> ranks;
+            dynarray<W64> bus_free;
+
+            int bank_index(const DRAMAddress &da) const {
+                return rank_index(da) * config.banks + da.bank;
+            }
+            int rank_index(const DRAMAddress &da) const {
+                return da.channel * config.ranks + da.rank;
+            }
+
+            W64 activate_ready(const Rank &rank) const;
+            void activate(Rank &rank, W64 cycle);
+    };
+
+};
+
+#endif // DRAM_TIMING_H
@@ -18,86 +18,28 @@ static W64 get_line_addr(W64 addr)
     return addr >> line_bits;
 }
 
-
-/**
- * @brief Reset the directory entry
- */
-void DirectoryEntry::reset()
-{
-    present.reset();
-    tag   = -1;
-    owner = -1;
-    dirty = 0;
-	locked = 0;
-}
-
-void DirectoryEntry::init(W64 tag_)
-{
-    tag   = tag_;
-    dirty = 0;
-    owner = -1;
-	locked = 0;
-    present.reset();
-}
-
-Directory::Directory()
-{
-    entries = new base_t();
-}
-
-DirectoryEntry* Directory::insert(MemoryRequest *req, W64& old_tag)
-{
-    W64 phys_addr = req->get_physical_address();
-    DirectoryEntry* entry = entries->select(phys_addr, old_tag);
-
-    return entry;
-}
-
-DirectoryEntry* Directory::probe(MemoryRequest *req)
-{
-    W64 phys_addr = req->get_physical_address();
-    DirectoryEntry* entry = entries->probe(phys_addr);
-
-    return entry;
-}
-
-int Directory::invalidate(MemoryRequest *req)
-{
-    return entries->invalidate(req->get_physical_address());
-}
-
-Directory* Directory::dir = NULL;
-FixStateList<DirContBufferEntry, REQ_Q_SIZE>*
-DirectoryController::pendingRequests_ = NULL;
-
-/**
- * @brief Get the global directory
- *
- * @return reference to global Directory
- */
-Directory& Directory::get_directory()
-{
-    if (dir == NULL) {
-        dir = new Directory();
-        DirectoryController::pendingRequests_ =
-            new FixStateList<DirContBufferEntry, REQ_Q_SIZE>();
-    }
-
-    return *dir;
-}
-
 Controller* DirectoryController::controllers[NUM_SIM_CORES] = {0};
 Controller* DirectoryController::lower_cont = NULL;
 
 DirectoryController* DirectoryController::dir_controllers[NUM_SIM_CORES] = {0};
+dynarray<DirectoryController*> DirectoryController::homes_;
 
 DirectoryController::DirectoryController(W8 idx, const char *name,
         MemoryHierarchy *memoryHierarchy)
     : Controller(idx, name, memoryHierarchy)
-      , dir_(Directory::get_directory())
+      , dir_(NULL)
+      , interconn_(NULL)
+      , new_stats(name, &memoryHierarchy->get_machine())
 {
     memoryHierarchy_->add_cache_mem_controller(this);
 
+    read_config();
+
+    /* Every directory controller is the home of a slice of the lines */
+    homes_.push(this);
+    foreach (i, homes_.count())
+        homes_[i]->dir_->set_interleave(homes_.count());
+
     req_handlers[MEMORY_OP_READ]   = &DirectoryController::
         handle_read_miss;
     req_handlers[MEMORY_OP_WRITE]  = &DirectoryController::
@@ -125,11 +67,83 @@ DirectoryController::DirectoryController(W8 idx, const char *name,
             &DirectoryController::send_msg_cb);
 }
 
+DirectoryController::~DirectoryController()
+{
+    delete dir_;
+
+    /* The tables are shared by the homes of one hierarchy only */
+    int homes = 0;
+    foreach (i, homes_.count()) {
+        if (homes_[i] != this)
+            homes_[homes++] = homes_[i];
+    }
+    homes_.resize(homes);
+    foreach (i, homes_.count())
+        homes_[i]->dir_->set_interleave(homes_.count());
+
+    foreach (i, NUM_SIM_CORES) {
+        if (dir_controllers[i] == this) {
+            dir_controllers[i] = NULL;
+            controllers[i] = NULL;
+        }
+    }
+
+    if (homes_.empty())
+        lower_cont = NULL;
+}
+
+/**
+ * @brief Create the directory of this home node from the machine options
+ */
+void DirectoryController::read_config()
+{
+    BaseMachine &machine = memoryHierarchy_->get_machine();
+    const char *name = get_name();
+    stringbuf encoding;
+
+    int sets = DIR_SET, ways = DIR_WAY;
+    int pointers = 4, group = 4;
+
+    machine.get_option(name, "sets", sets);
+    machine.get_option(name, "ways", ways);
+    machine.get_option(name, "pointers", pointers);
+    machine.get_option(name, "coarse_group", group);
+
+    dir_ = new Directory(sets, ways, DIR_LINE_SIZE);
+
+    DirSharerFormat &fmt = dir_->format;
+    if (machine.get_option(name, "sharers", encoding) &&
+            !fmt.parse(encoding.buf)) {
+        ptl_logfile << "ERROR: Unknown directory sharer encoding '" <<
+            encoding << "' for " << name << endl;
+        assert(0);
+    }
+
+    /* Machines add a CPU controller per core before the memory */
+    fmt.setup(fmt.encoding, memoryHierarchy_->get_cpu_controller_count(),
+            pointers, group);
+}
+
+/**
+ * @brief Home node of a physical address
+ */
+DirectoryController* DirectoryController::home_of(W64 addr)
+{
+    return homes_[get_line_addr(addr) % homes_.count()];
+}
+
 bool DirectoryController::handle_interconnect_cb(void *arg)
 {
     Message *message = (Message*)arg;
     MemoryRequest *request = message->request;
 
+    DirectoryController *home = home_of(request->get_physical_address());
+
+    if (home != this) {
+        N_STAT_UPDATE(new_stats.forwarded, ++, request->is_kernel());
+        return home->handle_interconnect_cb(arg);
+    }
+
 	if (is_full() && !find_entry(message->request)) {
 		return false;
 	}
@@ -201,7 +215,7 @@ bool DirectoryController::handle_read_miss(Message *msg)
         memdebug("Dir  request has completed, waking up dependents " <<
                 *queueEntry << endl);
         /* This request has completed.. So finalize it */
-        queueEntry->entry->present.set(queueEntry->cont->idx);
+        queueEntry->entry->sharers.add(queueEntry->cont->idx, dir_->format);
         if (!queueEntry->shared) {
             queueEntry->entry->owner = queueEntry->cont->idx;
             queueEntry->entry->dirty = 0;
@@ -210,7 +224,7 @@ bool DirectoryController::handle_read_miss(Message *msg)
         wakeup_dependent(queueEntry);
         ADD_HISTORY_REM(queueEntry->request);
         queueEntry->request->decRefCounter();
-        pendingRequests_->free(queueEntry);
+        pendingRequests_.free(queueEntry);
         return true;
     }
 
@@ -237,14 +251,14 @@ bool DirectoryController::handle_write_miss(Message *msg)
         memdebug("Dir  request has completed, waking up dependents " <<
                 *queueEntry << endl);
         /* This request has completed.. So finalize it */
-        queueEntry->entry->present.set(queueEntry->cont->idx);
+        queueEntry->entry->sharers.add(queueEntry->cont->idx, dir_->format);
         queueEntry->entry->owner = queueEntry->cont->idx;
         queueEntry->entry->dirty = 1;
 
         wakeup_dependent(queueEntry);
         ADD_HISTORY_REM(queueEntry->request);
         queueEntry->request->decRefCounter();
-        pendingRequests_->free(queueEntry);
+        pendingRequests_.free(queueEntry);
         return true;
     }
 
@@ -294,9 +308,9 @@ bool DirectoryController::handle_evict(Message *msg)
 bool DirectoryController::read_miss_cb(void *arg)
 {
     DirContBufferEntry *queueEntry = (DirContBufferEntry*)arg;
+    int cont_id = queueEntry->cont->idx;
 
-    DirectoryEntry *dir_entry      = get_directory_entry(queueEntry->request);
-    DirectoryController *sig_dir   = this;
+    DirectoryEntry *dir_entry = get_directory_entry(queueEntry->request);
 
     if (!dir_entry) {
         // Retry after 1 cycle
@@ -307,30 +321,31 @@ bool DirectoryController::read_miss_cb(void *arg)
     assert(dir_entry);
     queueEntry->entry = dir_entry;
 
+    N_STAT_UPDATE(new_stats.reads, ++, queueEntry->request->is_kernel());
+
     memdebug("Read miss handling in Directory with entry: " <<
             *dir_entry << endl);
 
-    if (dir_entry->dirty) {
+    if (dir_entry->dirty && dir_entry->has_owner()) {
         /* If owner is in same group then directly send message to
          * that controller, else let it writeback dirty line to lower
          * level cache and then complete this request. */
-        sig_dir = dir_controllers[dir_entry->owner];
-
-        if (sig_dir == this && dir_entry->owner != queueEntry->cont->idx) {
+        if (same_group(dir_entry->owner, cont_id) &&
+                dir_entry->owner != cont_id) {
             queueEntry->responder = controllers[dir_entry->owner];
             marss_add_event(&send_response, DIR_ACCESS_DELAY,
                     queueEntry);
         } else {
             queueEntry->responder = lower_cont;
-            marss_add_event(&sig_dir->send_update,
+            marss_add_event(&send_update,
                     DIR_ACCESS_DELAY, queueEntry);
         }
 
         return true;
     }
 
-    if (dir_entry->present.nonzero() &&
-            dir_controllers[dir_entry->owner] == this) {
+    if (!dir_entry->sharers.empty() && dir_entry->has_owner() &&
+            same_group(dir_entry->owner, cont_id)) {
         // Set Owner as responder if its in local group, else
         // set lower cache as responder
         queueEntry->responder = controllers[dir_entry->owner];
@@ -338,7 +353,7 @@ bool DirectoryController::read_miss_cb(void *arg)
         queueEntry->responder = lower_cont;
     }
 
-    if (dir_entry->present.test(queueEntry->cont->idx))
+    if (dir_entry->sharers.may_contain(cont_id, dir_->format))
         queueEntry->responder = lower_cont;
 
     // Send response back
@@ -354,7 +369,6 @@ bool DirectoryController::write_miss_cb(void *arg)
     int cont_id = queueEntry->cont->idx;
 
     DirectoryEntry *dir_entry = get_directory_entry(queueEntry->request);
-    DirectoryController *sig_dir = this;
 
     if (!dir_entry || dir_entry->locked) {
         // Retry after 1 cycle
@@ -365,36 +379,24 @@ bool DirectoryController::write_miss_cb(void *arg)
     assert(dir_entry);
     queueEntry->entry = dir_entry;
 
+    N_STAT_UPDATE(new_stats.writes, ++, queueEntry->request->is_kernel());
+
     memdebug("Write miss handling in Directory with entry: " <<
             *dir_entry << endl);
 
-    if (dir_entry->present.iszero()) {
+    if (dir_entry->sharers.empty()) {
         // Line is not cached.
         queueEntry->responder = lower_cont;
         dir_entry->dirty      = 1;
         dir_entry->owner      = cont_id;
-    } else if (!dir_entry->present.test(cont_id)) {
-        // Its not present in requested cache
+    } else if (dir_entry->sharers.others(cont_id, dir_->format)) {
+        // Other caches can have the line, send evict msg to them
         queueEntry->responder = lower_cont;
-        sig_dir               = dir_controllers[dir_entry->owner];
-        marss_add_event(&sig_dir->send_evict,
+        marss_add_event(&send_evict,
                 DIR_ACCESS_DELAY, queueEntry);
         return true;
     } else {
-        // Check if it was present in only requested cache
-        dir_entry->present.reset(cont_id);
-
-        if (dir_entry->present.nonzero()) {
-            // Send evict msg to other caches
-            queueEntry->responder = lower_cont;
-            sig_dir               = dir_controllers[dir_entry->owner];
-            marss_add_event(&sig_dir->send_evict,
-                    DIR_ACCESS_DELAY, queueEntry);
-            return true;
-        }
-
         dir_entry->dirty = 1;
-        dir_entry->present.set(cont_id);
 
         /* This line was present in only requested controller so
          * we send response back to same controller and set hasData
@@ -435,10 +437,7 @@ bool DirectoryController::update_cb(void *arg)
     if (queueEntry->origin != -1) {
         DirContBufferEntry *origEntry = get_entry(queueEntry->origin);
         if (origEntry) {
-            DirectoryController *sig_dir = dir_controllers[
-                origEntry->cont->idx];
-            marss_add_event(&sig_dir->send_response, 1,
-                    origEntry);
+            marss_add_event(&send_response, 1, origEntry);
         }
     }
 
@@ -446,7 +445,7 @@ bool DirectoryController::update_cb(void *arg)
     wakeup_dependent(queueEntry);
     ADD_HISTORY_REM(queueEntry->request);
     queueEntry->request->decRefCounter();
-    pendingRequests_->free(queueEntry);
+    pendingRequests_.free(queueEntry);
 
     return true;
 }
@@ -467,7 +466,7 @@ bool DirectoryController::evict_cb(void *arg)
             wakeup_dependent(queueEntry);
             ADD_HISTORY_REM(queueEntry->request);
             queueEntry->request->decRefCounter();
-            pendingRequests_->free(queueEntry);
+            pendingRequests_.free(queueEntry);
 
             return true;
         }
@@ -480,27 +479,44 @@ bool DirectoryController::evict_cb(void *arg)
     }
 
     int cont_id = queueEntry->cont->idx;
+    const DirSharerFormat &fmt = dir_->format;
 
-    dir_entry->present.reset(cont_id);
+    if (queueEntry->ack) {
+        /* A cache answered an evict sent by the directory, once all of
+         * them have answered no other cache has the line. */
+        assert(dir_entry->acks > 0);
+        dir_entry->acks--;
 
-    if (dir_entry->owner == cont_id) {
-        if (dir_entry->present.iszero()) {
+        if (dir_entry->acks == 0) {
+            dir_entry->sharers.clear();
             dir_entry->owner = -1;
             dir_entry->dirty = 0;
-        } else {
-            dir_entry->owner = dir_entry->present.lsb();
+
+            DirContBufferEntry *origEntry = NULL;
+            if (queueEntry->origin != -1)
+                origEntry = get_entry(queueEntry->origin);
+
+            if (origEntry) {
+                // If origin is present means, this was a cache_miss request
+                marss_add_event(&send_response, 1, origEntry);
+            } else if (is_dummy(dir_entry)) {
+                // Replaced entry is invalidated everywhere
+                dir_entry->reset();
+            } else {
+                dir_entry->locked = 0;
+            }
         }
-    }
+    } else {
+        dir_entry->sharers.remove(cont_id, fmt);
 
-    if (dir_entry->present.iszero() && queueEntry->origin != -1) {
-        // All cached lines are evicted.
-        // If origin is present means, this was a cache_miss request
-        DirContBufferEntry *origEntry = get_entry(queueEntry->origin);
-        if (origEntry) {
-            DirectoryController *sig_dir = dir_controllers[
-                origEntry->cont->idx];
-            marss_add_event(&sig_dir->send_response, 1,
-                    origEntry);
+        if (dir_entry->owner == cont_id) {
+            if (dir_entry->sharers.exact(fmt) &&
+                    !dir_entry->sharers.empty()) {
+                dir_entry->owner = dir_entry->sharers.first(fmt);
+            } else {
+                dir_entry->owner = -1;
+                dir_entry->dirty = 0;
+            }
         }
     }
 
@@ -508,7 +524,7 @@ bool DirectoryController::evict_cb(void *arg)
     wakeup_dependent(queueEntry);
     ADD_HISTORY_REM(queueEntry->request);
     queueEntry->request->decRefCounter();
-    pendingRequests_->free(queueEntry);
+    pendingRequests_.free(queueEntry);
 
     return true;
 }
@@ -527,7 +543,7 @@ bool DirectoryController::send_update_cb(void *arg)
     if (queueEntry->annuled)
         return true;
 
-    DirContBufferEntry *newEntry = pendingRequests_->alloc();
+    DirContBufferEntry *newEntry = pendingRequests_.alloc();
 
     if (!newEntry) {
         marss_add_event(&send_update, 1,
@@ -544,7 +560,9 @@ bool DirectoryController::send_update_cb(void *arg)
     newEntry->origin = (queueEntry->cont) ? queueEntry->idx : -1;
 
     ADD_HISTORY_ADD(newEntry->request);
+    mem_req_trace(newEntry->request, MEM_REQ_TRACE_QUEUE, this);
 
+    assert(queueEntry->entry->has_owner());
     newEntry->cont      = controllers[queueEntry->entry->owner];
     newEntry->responder = queueEntry->responder;
     send_msg_cb(newEntry);
@@ -558,6 +576,10 @@ bool DirectoryController::send_update_cb(void *arg)
  * @param arg Queue entry
  *
  * @return True on success
+ *
+ * The caches to invalidate are taken from the sharers when this is first
+ * called. With an overflowed sharer set that can be many caches, so if
+ * the queue runs out of entries the rest are sent on a later cycle.
  */
 bool DirectoryController::send_evict_cb(void *arg)
 {
@@ -565,53 +587,88 @@ bool DirectoryController::send_evict_cb(void *arg)
     if (queueEntry->annuled)
         return true;
 
-    /* Check if we have enough free entries in queue */
-    if (pendingRequests_->remaining() <
-            (int)queueEntry->entry->present.popcount()) {
-        marss_add_event(&send_evict, 1, queueEntry);
-        return true;
-    }
+    DirectoryEntry *dir_entry = queueEntry->entry;
+    const DirSharerFormat &fmt = dir_->format;
+    int except = (queueEntry->cont) ? queueEntry->cont->idx : -1;
+    bool kernel = queueEntry->request->is_kernel();
 
-	/* While handling this request, if all other cache lines are
-	 * evicted then send response to this request. */
-	if (queueEntry->entry->present.iszero()) {
-		DirectoryController *sig_dir = dir_controllers[
-			queueEntry->cont->idx];
-		marss_add_event(&sig_dir->send_response, 1, queueEntry);
-		return true;
-	}
+    if (queueEntry->next_target < 0) {
+        int count = dir_entry->sharers.candidates(except, fmt);
+
+        /* While handling this request, if all other cache lines are
+         * evicted then send response to this request. */
+        if (count == 0 && queueEntry->cont) {
+            marss_add_event(&send_response, 1, queueEntry);
+            return true;
+        }
 
-	queueEntry->entry->locked = 1;
+        if (count == 0) {
+            if (is_dummy(dir_entry))
+                dir_entry->reset();
+
+            if (queueEntry->free_on_success) {
+                ADD_HISTORY_REM(queueEntry->request);
+                queueEntry->request->decRefCounter();
+                pendingRequests_.free(queueEntry);
+            }
+            return true;
+        }
+
+        dir_entry->locked = 1;
+        dir_entry->acks   = count;
+
+        queueEntry->targets     = dir_entry->sharers;
+        queueEntry->next_target = 0;
+
+        if (queueEntry->cont) {
+            N_STAT_UPDATE(new_stats.invalidations, += count, kernel);
+        } else {
+            N_STAT_UPDATE(new_stats.back_invalidations, += count, kernel);
+        }
+
+        if (!dir_entry->sharers.exact(fmt)) {
+            N_STAT_UPDATE(new_stats.inexact_invalidations, += count,
+                    kernel);
+        }
+    }
 
     /* Now for each cached entry, send evict message to that
      * controller */
-    foreach (i, NUM_SIM_CORES) {
-        if (!queueEntry->entry->present.test(i))
+    for (int i = queueEntry->next_target; i < fmt.cores; i++) {
+        if (i == except || !queueEntry->targets.may_contain(i, fmt))
             continue;
 
-        DirContBufferEntry *newEntry = pendingRequests_->alloc();
+        DirContBufferEntry *newEntry = pendingRequests_.alloc();
 
-        assert(newEntry);
+        if (!newEntry) {
+            queueEntry->next_target = i;
+            marss_add_event(&send_evict, 1, queueEntry);
+            return true;
+        }
 
         newEntry->request = memoryHierarchy_->get_free_request(
                 queueEntry->request->get_coreid());
         newEntry->request->init(queueEntry->request);
         newEntry->request->incRefCounter();
         newEntry->request->set_op_type(MEMORY_OP_EVICT);
-        newEntry->entry  = queueEntry->entry;
+        newEntry->entry  = dir_entry;
         newEntry->origin = (queueEntry->cont) ? queueEntry->idx : -1;
+        newEntry->ack    = 1;
 
         ADD_HISTORY_ADD(newEntry->request);
+        mem_req_trace(newEntry->request, MEM_REQ_TRACE_QUEUE, this);
 
         newEntry->cont      = controllers[i];
         newEntry->responder = this;
-        dir_controllers[i]->send_msg_cb(newEntry);
+        send_msg_cb(newEntry);
     }
 
+    queueEntry->next_target = fmt.cores;
+
     if (queueEntry->free_on_success) {
         ADD_HISTORY_REM(queueEntry->request);
         queueEntry->request->decRefCounter();
-        pendingRequests_->free(queueEntry);
+        pendingRequests_.free(queueEntry);
     }
 
     return true;
@@ -626,9 +683,9 @@ bool DirectoryController::send_response_cb(void *arg)
     memdebug("Dir: Sending response: " << *queueEntry << endl);
 
     assert(queueEntry->entry);
-    queueEntry->entry->present.reset(queueEntry->cont->idx);
-    queueEntry->shared = queueEntry->entry->present.nonzero();
-    queueEntry->entry->present.set(queueEntry->cont->idx);
+    DirectorySharers &sharers = queueEntry->entry->sharers;
+    queueEntry->shared = sharers.others(queueEntry->cont->idx, dir_->format);
+    sharers.add(queueEntry->cont->idx, dir_->format);
 
 	queueEntry->entry->locked = 0;
 
@@ -671,8 +728,12 @@ bool DirectoryController::send_msg_cb(void *arg)
     if (queueEntry->annuled)
         return true;
 
+    /* Send on the interconnect of the destination cache's group */
+    DirectoryController *via = dir_controllers[queueEntry->cont->idx];
+    assert(via);
+
     Message& message  = *memoryHierarchy_->get_message();
-    message.sender    = this;
+    message.sender    = via;
     message.dest      = queueEntry->cont;
     message.request   = queueEntry->request;
     message.isShared  = queueEntry->shared;
@@ -682,13 +743,14 @@ bool DirectoryController::send_msg_cb(void *arg)
     memdebug("Directory sending msg, queue entry: " <<
             *queueEntry << "\n");
 
-    bool success = interconn_->get_controller_request_signal()->emit(&message);
+    bool success = via->interconn_->get_controller_request_signal()->emit(
+            &message);
 
     /* Free the message */
     memoryHierarchy_->free_message(&message);
 
     if (!success) {
-        int delay = interconn_->get_delay();
+        int delay = via->interconn_->get_delay();
         if (delay == 0) delay = AVG_WAIT_DELAY;
         if (queueEntry->request->get_type() == MEMORY_OP_EVICT)
             delay = 1;
@@ -700,7 +762,7 @@ bool DirectoryController::send_msg_cb(void *arg)
         ADD_HISTORY_REM(queueEntry->request);
         queueEntry->request->decRefCounter();
         wakeup_dependent(queueEntry);
-        pendingRequests_->free(queueEntry);
+        pendingRequests_.free(queueEntry);
     }
 
     return true;
@@ -708,9 +770,9 @@ bool DirectoryController::send_msg_cb(void *arg)
 
 DirContBufferEntry* DirectoryController::add_entry(Message *msg)
 {
-    DirContBufferEntry* queueEntry = pendingRequests_->alloc();
+    DirContBufferEntry* queueEntry = pendingRequests_.alloc();
 
-    if (pendingRequests_->isFull()) {
+    if (pendingRequests_.isFull()) {
         memoryHierarchy_->set_controller_full(this, true);
     }
 
@@ -723,6 +785,7 @@ DirContBufferEntry* DirectoryController::add_entry(Message *msg)
     queueEntry->cont = (Controller*)msg->origin;
 
     ADD_HISTORY_ADD(queueEntry->request);
+    mem_req_trace(queueEntry->request, MEM_REQ_TRACE_QUEUE, this);
 
     return queueEntry;
 }
@@ -730,7 +793,7 @@ DirContBufferEntry* DirectoryController::add_entry(Message *msg)
 DirContBufferEntry* DirectoryController::get_entry(int idx)
 {
     DirContBufferEntry* queueEntry;
-    foreach_list_mutable(pendingRequests_->list(), queueEntry, entry,
+    foreach_list_mutable(pendingRequests_.list(), queueEntry, entry,
             preventry) {
         if (idx == queueEntry->idx)
             return queueEntry;
@@ -742,7 +805,7 @@ DirContBufferEntry* DirectoryController::get_entry(int idx)
 DirContBufferEntry* DirectoryController::find_entry(MemoryRequest *req)
 {
     DirContBufferEntry* queueEntry;
-    foreach_list_mutable(pendingRequests_->list(), queueEntry, entry,
+    foreach_list_mutable(pendingRequests_.list(), queueEntry, entry,
             preventry) {
         if (req == queueEntry->request)
             return queueEntry;
@@ -757,7 +820,7 @@ DirContBufferEntry* DirectoryController::find_dependent_enry(
     W64 line_addr = get_line_addr(req->get_physical_address());
 
     DirContBufferEntry* queueEntry;
-    foreach_list_mutable(pendingRequests_->list(), queueEntry, entry,
+    foreach_list_mutable(pendingRequests_.list(), queueEntry, entry,
             preventry) {
 
         if (req == queueEntry->request || queueEntry->annuled)
@@ -766,9 +829,9 @@ DirContBufferEntry* DirectoryController::find_dependent_enry(
         if (get_line_addr(queueEntry->request->get_physical_address())
                 == line_addr) {
             while(queueEntry->depends >= 0) {
-                if ((*pendingRequests_)[queueEntry->depends].annuled)
+                if (pendingRequests_[queueEntry->depends].annuled)
                     break;
-                queueEntry = &(*pendingRequests_)[queueEntry->depends];
+                queueEntry = &pendingRequests_[queueEntry->depends];
             }
 
             return queueEntry;
@@ -781,10 +844,11 @@ DirContBufferEntry* DirectoryController::find_dependent_enry(
 DirectoryEntry* DirectoryController::get_directory_entry(
         MemoryRequest *req, bool must_present)
 {
-    DirectoryEntry *entry = dir_.probe(req);
+    W64 addr = req->get_physical_address();
+    DirectoryEntry *entry = dir_->probe(addr);
 
     if (!entry && must_present) {
-        W64 tag_t = dir_.tag_of(req->get_physical_address());
+        W64 tag_t = dir_->tag_of(addr);
         foreach (i, REQ_Q_SIZE) {
             DirectoryEntry* d_entry = &dummy_entries[i];
             if (d_entry->tag == tag_t) {
@@ -797,16 +861,30 @@ DirectoryEntry* DirectoryController::get_directory_entry(
 
     if (!entry) {
         W64 old_tag = InvalidTag<W64>::INVALID;
-        entry = dir_.insert(req, old_tag);
-        assert(entry);
+        entry = dir_->insert(addr, old_tag);
+
+        if (!entry) {
+            /* Every entry of the set is being invalidated */
+            N_STAT_UPDATE(new_stats.set_locked, ++, req->is_kernel());
+            return NULL;
+        }
 
         /* If we are removing any entry with cached line then we
          * must send evict signal to those caches. */
-        if ((old_tag != InvalidTag<W64>::INVALID && old_tag != (W64)-1) &&
-                entry->present.nonzero()) {
-            DirContBufferEntry *newEntry = pendingRequests_->alloc();
+        if (old_tag != InvalidTag<W64>::INVALID) {
+            DirectoryEntry *d_entry = get_dummy_entry(entry, old_tag);
+            DirContBufferEntry *newEntry = NULL;
+
+            if (d_entry)
+                newEntry = pendingRequests_.alloc();
+
+            if (!newEntry) {
+                /* Keep the old entry until it can be invalidated */
+                if (d_entry) d_entry->reset();
+                return NULL;
+            }
 
-            assert(newEntry);
+            N_STAT_UPDATE(new_stats.entry_evictions, ++, req->is_kernel());
 
             newEntry->request = memoryHierarchy_->get_free_request(
                     req->get_coreid());
@@ -814,10 +892,11 @@ DirectoryEntry* DirectoryController::get_directory_entry(
             newEntry->request->incRefCounter();
             newEntry->request->set_physical_address(old_tag);
             newEntry->request->set_op_type(MEMORY_OP_EVICT);
-            newEntry->entry = get_dummy_entry(entry, old_tag);
+            newEntry->entry = d_entry;
             newEntry->free_on_success = 1;
 
             ADD_HISTORY_ADD(newEntry->request);
+            mem_req_trace(newEntry->request, MEM_REQ_TRACE_QUEUE, this);
 
             DirContBufferEntry *depEntry = find_dependent_enry(
                     newEntry->request);
@@ -831,7 +910,8 @@ DirectoryEntry* DirectoryController::get_directory_entry(
             }
         }
 
-        entry->init(dir_.tag_of(req->get_physical_address()));
+        N_STAT_UPDATE(new_stats.entry_allocs, ++, req->is_kernel());
+        entry->init(dir_->tag_of(addr));
     }
 
     return entry;
@@ -840,39 +920,35 @@ DirectoryEntry* DirectoryController::get_directory_entry(
 /**
  * @brief Return a free dummy Directory Entry
  *
- * @return DirectoryEntry to be used for eviction
+ * @return DirectoryEntry to be used for eviction, NULL if all of them
+ * are in use
  *
  * These dummy entries are used for eviction. When a directory replaces
  * an old entry it uses this dummy entries to send evict signals to cache
- * controllers.
+ * controllers. A dummy entry is free again once all the caches have
+ * answered.
  */
 DirectoryEntry* DirectoryController::get_dummy_entry(DirectoryEntry *entry,
         W64 old_tag)
 {
     foreach (i, REQ_Q_SIZE) {
         DirectoryEntry* d_entry = &dummy_entries[i];
-        if (d_entry->present.iszero()) {
+        if (d_entry->tag == (W64)-1) {
             // This entry is free. So use it.
+            *d_entry       = *entry;
             d_entry->tag   = old_tag;
-            d_entry->dirty = entry->dirty;
-            d_entry->owner = entry->owner;
-
-            foreach (j, NUM_SIM_CORES)
-                d_entry->present.assign(j, entry->present[j]);
-
+            d_entry->acks  = 0;
             return d_entry;
         }
     }
 
-    /* We must have atleast one free entry */
-    assert(0);
     return NULL;
 }
 
 void DirectoryController::wakeup_dependent(DirContBufferEntry *queueEntry)
 {
     if (queueEntry->depends >= 0) {
-        DirContBufferEntry *depEntry = &(*pendingRequests_)[
+        DirContBufferEntry *depEntry = &pendingRequests_[
             queueEntry->depends];
 
         /* If dependent entry is annuled then dont process it */
@@ -905,6 +981,10 @@ void DirectoryController::print(ostream &os) const
     os << "Global Directory Controller: " << get_name();
     os << " [" << idx << "]\n";
 
+    os << "\tDirectory: sets[" << dir_->sets() << "] ways[";
+    os << dir_->ways() << "] sharers[" << dir_->format.name() << "] homes[";
+    os << homes_.count() << "]\n";
+
     os << "\tDirectory Controller: ";
     foreach (i, NUM_SIM_CORES) {
         os << "  [" << i << "] ";
@@ -926,13 +1006,13 @@ void DirectoryController::print(ostream &os) const
 
     os << endl;
 
-    os << "Queue:\n" << *pendingRequests_ << endl;
+    os << "Queue:\n" << pendingRequests_ << endl;
 }
 
 bool DirectoryController::is_full(bool flag) const
 {
-    if (pendingRequests_->count() >= (
-                pendingRequests_->size() - 10)) {
+    if (pendingRequests_.count() >= (
+                pendingRequests_.size() - 10)) {
         return true;
     }
     return false;
@@ -941,7 +1021,7 @@ bool DirectoryController::is_full(bool flag) const
 void DirectoryController::annul_request(MemoryRequest *request)
 {
     DirContBufferEntry *entry;
-    foreach_list_mutable (pendingRequests_->list(), entry,
+    foreach_list_mutable (pendingRequests_.list(), entry,
             entry_t, nextentry_t) {
         if (entry->request->is_same(request)) {
             entry->annuled = true;
@@ -950,7 +1030,7 @@ void DirectoryController::annul_request(MemoryRequest *request)
 
             wakeup_dependent(entry);
 
-            pendingRequests_->free(entry);
+            pendingRequests_.free(entry);
         }
     }
 }
@@ -965,10 +1045,14 @@ void DirectoryController::dump_configuration(YAML::Emitter &out) const
 	out << YAML::Key << get_name() << YAML::Value << YAML::BeginMap;
 
 	YAML_KEY_VAL(out, "type", "directory");
-	YAML_KEY_VAL(out, "size", DIR_SET * DIR_WAY);
-	YAML_KEY_VAL(out, "line_size", DIR_LINE_SIZE);
-	YAML_KEY_VAL(out, "sets", DIR_SET);
-	YAML_KEY_VAL(out, "ways", DIR_WAY);
+	YAML_KEY_VAL(out, "size", dir_->sets() * dir_->ways());
+	YAML_KEY_VAL(out, "line_size", dir_->line_size());
+	YAML_KEY_VAL(out, "sets", dir_->sets());
+	YAML_KEY_VAL(out, "ways", dir_->ways());
+	YAML_KEY_VAL(out, "home_nodes", homes_.count());
+	YAML_KEY_VAL(out, "sharers", dir_->format.name());
+	YAML_KEY_VAL(out, "pointers", dir_->format.pointers);
+	YAML_KEY_VAL(out, "coarse_group", dir_->format.group);
 
 	out << YAML::EndMap;
 }
@@ -18,76 +18,17 @@
 #include <memoryHierarchy.h>
 
 #include <machine.h>
+#include <directory.h>
 
 using namespace Memory;
 
+/* Default size of the directory of each home node */
 #define DIR_SET 4096
 #define DIR_WAY 16
 #define DIR_LINE_SIZE 64
 #define DIR_ACCESS_DELAY 10
 #define REQ_Q_SIZE 128
 
-/**
- * @brief A Directory entry containing information for one line
- */
-struct DirectoryEntry {
-    bitvec<NUM_SIM_CORES> present;
-    bool dirty;
-    W64  tag;
-    W8   owner;
-	bool locked;
-
-    DirectoryEntry() { reset(); }
-    void reset();
-    void init(W64 tag_);
-
-    ostream& print(ostream &os) const {
-        os << "tag:" << (void*)tag << " dirty:" << dirty << " owner:" << owner;
-        os << " present:" << present;
-        return os;
-    }
-};
-
-static inline ostream& operator <<(ostream &os, const DirectoryEntry &e)
-{
-    return e.print(os);
-}
-
-/**
- * @brief A Directory containing cacheline informations.
- *
- * This is a singleton class so there is only one Global directory.
- * All directory controllers get access to this directory and should
- * simulate appropriate access delay. This directory is a set-assoc
- * structure. The size of the directory is statically set.
- *
- * TODO:
- *	- Allow configuration options to dynamically set directory size.
- *	- Simulate limited port access
- */
-class Directory {
-    private:
-        Directory();
-        static Directory* dir;
-
-        typedef AssociativeArray<W64, DirectoryEntry, DIR_SET,
-                DIR_WAY, DIR_LINE_SIZE> base_t;
-        typedef FullyAssociativeArray<W64, DirectoryEntry, DIR_WAY,
-                NullAssociativeArrayStatisticsCollector<W64,
-                DirectoryEntry> > Set;
-
-        base_t* entries;
-
-    public:
-        static Directory& get_directory();
-
-        DirectoryEntry *insert(MemoryRequest *req, W64&old_tag);
-        DirectoryEntry *probe(MemoryRequest *req);
-        int             invalidate(MemoryRequest *req);
-
-        W64 tag_of(W64 addr) { return base_t::tagof(addr); }
-};
-
 struct DirContBufferEntry : public FixStateListObject
 {
     MemoryRequest  *request;
@@ -95,6 +36,9 @@ struct DirContBufferEntry : public FixStateListObject
     Controller     *cont;
     Controller     *responder;
     Signal         *wakeup_sig;
+    DirectorySharers targets;   // caches left to invalidate
+    int             next_target;
+    bool            ack;        // evict sent by the directory
     bool            annuled;
     bool            free_on_success;
     bool            shared;
@@ -113,6 +57,8 @@ struct DirContBufferEntry : public FixStateListObject
         hasData         = 0;
         responder       = NULL;
         wakeup_sig      = NULL;
+        next_target     = -1;
+        ack             = 0;
         free_on_success = 0;
     }
 
@@ -146,18 +92,27 @@ static inline ostream& operator << (ostream& os, const
 /**
  * @brief A Controller interface to access Global Directory
  *
- * All the instances of this controller are connected to each-other
- * for correctness. If the design allows multiple controllers that access
- * the global directory then in case of cache-eviction, the initiating
- * controller can send 'evict' message to all other controllers.
- * In such scenarios, each controller should simulate some delay.
+ * Each instance of this controller is the home node of a slice of the
+ * physical memory, lines are interleaved over all the instances. A home
+ * node has its own sparse directory and request queue and handles every
+ * request for its lines; a controller that receives a request for
+ * another home passes it on. Messages to a cache are sent on the
+ * interconnect of the controller in that cache's group.
+ *
+ * Options (in the machine configuration, per controller):
+ *   sets, ways:    size of the directory of this home node
+ *   sharers:       full_vector, limited_pointer or coarse_vector
+ *   pointers:      core ids kept per entry before overflowing (4)
+ *   coarse_group:  cores per bit of a coarse vector (4)
  */
 class DirectoryController : public Controller {
 
     private:
-        Directory    &dir_;
+        Directory    *dir_;
         Interconnect *interconn_;
 
+        FixStateList<DirContBufferEntry, REQ_Q_SIZE> pendingRequests_;
+
         DirectoryEntry dummy_entries[REQ_Q_SIZE];
 
         /* Simple function dispatcher to handle memory request */
@@ -173,15 +128,28 @@ class DirectoryController : public Controller {
         Signal send_response;
         Signal send_msg;
 
+        DirectoryStats new_stats;
+
         static Controller   *controllers[NUM_SIM_CORES];
         static Controller   *lower_cont;
 
         static DirectoryController *dir_controllers[NUM_SIM_CORES];
+        static dynarray<DirectoryController*> homes_;
+
+        DirectoryController* home_of(W64 addr);
+        bool same_group(int a, int b) const {
+            return dir_controllers[a] == dir_controllers[b];
+        }
+        bool is_dummy(DirectoryEntry *entry) const {
+            return entry >= dummy_entries &&
+                entry < dummy_entries + REQ_Q_SIZE;
+        }
+        void read_config();
+
     public:
         DirectoryController(W8 idx, const char *name,
                 MemoryHierarchy *memoryHierachy);
-
-        static FixStateList<DirContBufferEntry, REQ_Q_SIZE> *pendingRequests_;
+        ~DirectoryController();
 
         bool handle_interconnect_cb(void *arg);
         void register_interconnect(Interconnect *interconnect,
@@ -49,13 +49,34 @@ namespace Memory {
 
   public:
     MemoryHierarchy *memoryHierarchy_;
+
+    /* Index in the MemoryHierarchy's interconnect list and the full
+     * state last reported to it, maintained by MemoryHierarchy */
+    int hierarchyIdx_;
+    bool hierarchyFull_;
+
   Interconnect(const char *name, MemoryHierarchy *memoryHierarchy)
     : controller_request_("Controller Request")
       , memoryHierarchy_(memoryHierarchy)
+      , hierarchyIdx_(-1)
+      , hierarchyFull_(false)
     {
       name_ << name;
       controller_request_.connect(signal_mem_ptr(*this,
-						 &Interconnect::controller_request_cb));
+						 &Interconnect::request_cb));
+    }
+
+    /* Takes a controller's message and traces it if accepted */
+    bool request_cb(void *arg)
+    {
+      Message *msg = (Message*)arg;
+      MemoryRequest *request = msg->request;
+      void *sender = msg->sender;
+      bool accepted = controller_request_cb(arg);
+
+      if(accepted && request)
+	mem_req_trace(request, MEM_REQ_TRACE_SEND, this, sender);
+      return accepted;
     }
 
     virtual ~Interconnect()
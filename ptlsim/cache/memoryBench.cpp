@@ -0,0 +1,316 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Host performance benchmark of the memory hierarchy code
+ *
+ * The hierarchies are built here from controllers and interconnects, as
+ * the generated machines build them, but without any core. So they run
+ * before a machine is set up and need neither a guest nor a disk image.
+ */
+
+#include <ptlsim.h>
+#include <machine.h>
+#include <memoryHierarchy.h>
+#include <memoryTrace.h>
+#include <cpuController.h>
+
+using namespace Memory;
+
+namespace {
+
+    /*
+     * Patterns timed on each hierarchy, on all of its cores. The hierarchy
+     * keeps its state from one pattern to the next, as they run in this
+     * order.
+     */
+    struct MemBenchPattern {
+        const char *name;
+        const char *spec;
+    };
+
+    const MemBenchPattern mem_bench_patterns[] = {
+        {"hits",        "stream:footprint=8k:count=200k"},
+        {"stream",      "stream:footprint=256m:count=200k"},
+        {"pingpong",    "random:footprint=4k:shared=1:writes=50:count=100k"},
+        {"dram_random", "random:footprint=1g:count=50k"},
+        {"dram_chase",  "chase:footprint=1g:count=10k"},
+    };
+
+    /* Cache types are the ones of that name in the machine config */
+    int cache_type(const char *name, stringbuf &err)
+    {
+        int type = get_cache_type(name);
+        if (type < 0)
+            err << "::ERROR::-mem-bench needs cache '", name,
+                "' in the machine config", endl;
+        return type;
+    }
+
+    /*
+     * Options outlive machine.reset(), so every cache sets both of them
+     * rather than keep the ones of a previous hierarchy.
+     */
+    void add_caches(BaseMachine &machine, int count, const char *prefix,
+            const char *cont, int type, bool is_private, bool last_private)
+    {
+        foreach (i, count) {
+            machine.add_option(prefix, i, "private", is_private);
+            machine.add_option(prefix, i, "last_private", last_private);
+            ControllerBuilder::add_new_cont(machine, i, prefix, cont, type);
+        }
+    }
+
+    void add_memory(BaseMachine &machine)
+    {
+        machine.add_option("MEM_", 0, "latency", 50);
+        ControllerBuilder::add_new_cont(machine, 0, "MEM_",
+                "simple_dram_cont", 0);
+    }
+
+    void connect(BaseMachine &machine, const char *upper, int upper_type,
+            const char *lower, int lower_type)
+    {
+        stringbuf name;
+        name << "p2p_", upper, "_";
+
+        ConnectionDef *connDef = machine.get_new_connection_def("p2p",
+                name, upper_type);
+        machine.add_new_connection(connDef, upper, upper_type);
+        machine.add_new_connection(connDef, lower, lower_type);
+    }
+
+    /* CPU controller and private L1-I, L1-D and L2 of each core */
+    void add_cores(BaseMachine &machine, int cores, const char *cont,
+            int l1, int l2, bool l2_last_private)
+    {
+        foreach (i, cores) {
+            ControllerBuilder::add_new_cont(machine, i, "core_", "cpu", 0);
+
+            stringbuf core_;
+            core_ << "core_", i;
+            CPUController *cpuCont = (CPUController*)(
+                    *machine.controller_hash.get(core_));
+
+            // All the caches used here have 64 byte lines
+            cpuCont->set_icacheLineBits(6);
+            cpuCont->set_dcacheLineBits(6);
+        }
+
+        add_caches(machine, cores, "L1_I_", cont, l1, true, false);
+        add_caches(machine, cores, "L1_D_", cont, l1, true, false);
+        add_caches(machine, cores, "L2_", cont, l2, true, l2_last_private);
+
+        foreach (i, cores) {
+            stringbuf core_, L1_I_, L1_D_, L2_;
+            core_ << "core_", i;
+            L1_I_ << "L1_I_", i;
+            L1_D_ << "L1_D_", i;
+            L2_ << "L2_", i;
+
+            connect(machine, core_, INTERCONN_TYPE_I, L1_I_,
+                    INTERCONN_TYPE_UPPER);
+            connect(machine, core_, INTERCONN_TYPE_D, L1_D_,
+                    INTERCONN_TYPE_UPPER);
+            connect(machine, L1_I_, INTERCONN_TYPE_LOWER, L2_,
+                    INTERCONN_TYPE_UPPER);
+            connect(machine, L1_D_, INTERCONN_TYPE_LOWER, L2_,
+                    INTERCONN_TYPE_UPPER2);
+        }
+    }
+
+    /* One core, write back L1s, L2 and L3 in a chain of p2p links */
+    bool build_p2p(BaseMachine &machine, int cores, stringbuf &err)
+    {
+        int l1 = cache_type("l1_128K", err);
+        int l2 = cache_type("l2_2M", err);
+        int l3 = cache_type("l3_8M", err);
+        if (l1 < 0 || l2 < 0 || l3 < 0)
+            return false;
+
+        add_cores(machine, cores, "wb_cache", l1, l2, false);
+        add_caches(machine, 1, "L3_", "wb_cache", l3, false, false);
+        add_memory(machine);
+
+        connect(machine, "L2_0", INTERCONN_TYPE_LOWER, "L3_0",
+                INTERCONN_TYPE_UPPER);
+        connect(machine, "L3_0", INTERCONN_TYPE_LOWER, "MEM_0",
+                INTERCONN_TYPE_UPPER);
+        return true;
+    }
+
+    /* MESI private L1s and L2s, snooping on a bus to a shared L3 */
+    bool build_bus(BaseMachine &machine, int cores, stringbuf &err)
+    {
+        int l1 = cache_type("l1_128K_mesi", err);
+        int l2 = cache_type("l2_2M_mesi", err);
+        int l3 = cache_type("l3_8M", err);
+        if (l1 < 0 || l2 < 0 || l3 < 0)
+            return false;
+
+        add_cores(machine, cores, "mesi_cache", l1, l2, true);
+        add_caches(machine, 1, "L3_", "wb_cache", l3, false, false);
+        add_memory(machine);
+
+        ConnectionDef *connDef = machine.get_new_connection_def("split_bus",
+                "split_bus_", 0);
+        foreach (i, cores) {
+            stringbuf L2_;
+            L2_ << "L2_", i;
+            machine.add_new_connection(connDef, L2_, INTERCONN_TYPE_LOWER);
+        }
+        machine.add_new_connection(connDef, "L3_0", INTERCONN_TYPE_UPPER);
+
+        connect(machine, "L3_0", INTERCONN_TYPE_LOWER, "MEM_0",
+                INTERCONN_TYPE_UPPER);
+        return true;
+    }
+
+    /* MOESI private L1s and L2s, a switch to a shared L3 and directory */
+    bool build_switch(BaseMachine &machine, int cores, stringbuf &err)
+    {
+        int l1 = cache_type("l1_128K_moesi", err);
+        int l2 = cache_type("l2_2M_moesi", err);
+        int l3 = cache_type("l3_8M", err);
+        if (l1 < 0 || l2 < 0 || l3 < 0)
+            return false;
+
+        add_cores(machine, cores, "moesi_cache", l1, l2, true);
+        add_caches(machine, 1, "L3_", "wb_cache", l3, false, false);
+        ControllerBuilder::add_new_cont(machine, 0, "DIR_", "global_dir", 0);
+        add_memory(machine);
+
+        ConnectionDef *connDef = machine.get_new_connection_def("switch",
+                "switch_", 0);
+        foreach (i, cores) {
+            stringbuf L2_;
+            L2_ << "L2_", i;
+            machine.add_new_connection(connDef, L2_, INTERCONN_TYPE_LOWER);
+        }
+        machine.add_new_connection(connDef, "L3_0", INTERCONN_TYPE_UPPER);
+        machine.add_new_connection(connDef, "DIR_0",
+                INTERCONN_TYPE_DIRECTORY);
+
+        connect(machine, "L3_0", INTERCONN_TYPE_LOWER, "MEM_0",
+                INTERCONN_TYPE_UPPER);
+        return true;
+    }
+
+    typedef bool (*mem_bench_build)(BaseMachine &machine, int cores,
+            stringbuf &err);
+
+    struct MemBenchHierarchy {
+        const char *name;
+        int cores;
+        mem_bench_build build;
+    };
+
+    const MemBenchHierarchy mem_bench_hierarchies[] = {
+        {"p2p",    1,             build_p2p},
+        {"bus",    NUM_SIM_CORES, build_bus},
+        {"switch", NUM_SIM_CORES, build_switch},
+    };
+
+    /* Replay every pattern on the hierarchy built on machine */
+    void run_patterns(BaseMachine &machine, const MemBenchHierarchy &hier,
+            int max_misses, YAML::Emitter &out, stringbuf &err)
+    {
+        foreach (i, lengthof(mem_bench_patterns)) {
+            const MemBenchPattern &pattern = mem_bench_patterns[i];
+            stringbuf spec, name, label;
+            spec << pattern.spec, ":cores=", hier.cores;
+            name << "mem_bench_", hier.name, "_", pattern.name;
+            label << hier.name, ".", pattern.name;
+
+            SyntheticMemoryStream synth;
+            if (!synth.parse(spec)) {
+                err << "::ERROR::Invalid -mem-bench pattern '", spec, "'",
+                    endl;
+                return;
+            }
+
+            MemoryReplay replay(name, machine.memoryHierarchyPtr, hier.cores,
+                    max_misses);
+            W64 cycles = replay.run(synth, config.stop_at_cycle);
+            W64 requests = replay.issued();
+            W64 ns = replay.host_nanoseconds();
+            double ns_per_request = double(ns) / max(requests, W64(1));
+            double ns_per_cycle = double(ns) / max(cycles, W64(1));
+
+            out << YAML::BeginMap;
+            YAML_KEY_VAL(out, "name", pattern.name);
+            YAML_KEY_VAL(out, "spec", spec.buf);
+            YAML_KEY_VAL(out, "requests", requests);
+            YAML_KEY_VAL(out, "cycles", cycles);
+            YAML_KEY_VAL(out, "host_ns", ns);
+            YAML_KEY_VAL(out, "ns_per_request", ns_per_request);
+            YAML_KEY_VAL(out, "ns_per_cycle", ns_per_cycle);
+            out << YAML::EndMap;
+
+            cout << "  ", padstring(label, -20), " ", intstring(requests, 8),
+                 " requests ", intstring(cycles, 10), " cycles ",
+                 floatstring(ns_per_request, 10, 1), " ns/request ",
+                 floatstring(ns_per_cycle, 8, 1), " ns/cycle", endl;
+        }
+    }
+};
+
+/**
+ * @brief Time the memory hierarchy code on built-in hierarchies
+ *
+ * Each hierarchy is built on the base machine, which has no core yet, and
+ * torn down again after its patterns. Compare the files of two builds with
+ * util/mem_bench.py to catch host performance regressions.
+ *
+ * @return false if a hierarchy can't be built from this config
+ */
+bool Memory::run_memory_bench(const char *filename, int max_misses)
+{
+    BaseMachine &machine = *(BaseMachine*)PTLsimMachine::getmachine("base");
+    stringbuf err;
+
+    YAML::Emitter out;
+    out << YAML::BeginMap;
+    YAML_KEY_VAL(out, "max_misses", max_misses);
+    out << YAML::Key << "hierarchies" << YAML::Value << YAML::BeginSeq;
+
+    cout << "Running memory hierarchy benchmarks", endl;
+
+    foreach (i, lengthof(mem_bench_hierarchies)) {
+        const MemBenchHierarchy &hier = mem_bench_hierarchies[i];
+
+        machine.reset();
+        machine.memoryHierarchyPtr = new MemoryHierarchy(machine);
+
+        if (hier.build(machine, hier.cores, err)) {
+            machine.setup_interconnects();
+            machine.memoryHierarchyPtr->setup_full_flags();
+
+            out << YAML::BeginMap;
+            YAML_KEY_VAL(out, "name", hier.name);
+            YAML_KEY_VAL(out, "cores", hier.cores);
+            out << YAML::Key << "patterns" << YAML::Value << YAML::BeginSeq;
+            run_patterns(machine, hier, max_misses, out, err);
+            out << YAML::EndSeq << YAML::EndMap;
+        }
+
+        machine.reset();
+
+        if (err.size() > 0)
+            break;
+    }
+
+    out << YAML::EndSeq << YAML::EndMap;
+
+    if (err.size() > 0) {
+        ptl_logfile << err;
+        cerr << err;
+        return false;
+    }
+
+    ofstream os(filename);
+    os << out.c_str(), endl;
+    os.close();
+    return true;
+}
@@ -162,6 +162,7 @@ bool MemoryController::handle_interconnect_cb(void *arg)
 
   queueEntry->request->incRefCounter();
   ADD_HISTORY_ADD(queueEntry->request);
+  mem_req_trace(queueEntry->request, MEM_REQ_TRACE_QUEUE, this);
 
   int bank_no = get_bank_id(message->request->
 			    get_physical_address());
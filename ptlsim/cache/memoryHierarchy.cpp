@@ -40,6 +40,8 @@
 //#include <CacheConstants.h>
 #include <memoryStats.h>
 #include <memoryHierarchy.h>
+#include <memoryTrace.h>
+#include <hostprof.h>
 #include <statelist.h>
 
 #include <cpuController.h>
@@ -51,12 +53,15 @@ using namespace Memory;
 
 MemoryHierarchy::MemoryHierarchy(BaseMachine& machine) :
   machine_(machine)
+  , fullStructCount_(0)
   , someStructIsFull_(false)
 {
   coreNo_ = machine_.get_num_cores();
 
   foreach(i, NUM_SIM_CORES) {
-    RequestPool* pool = new RequestPool();
+    stringbuf pool_name;
+    pool_name << "request_pool_" << i;
+    RequestPool* pool = new RequestPool(pool_name.buf, &machine_);
     requestPool_.push(pool);
   }
 
@@ -65,7 +70,7 @@ MemoryHierarchy::MemoryHierarchy(BaseMachine& machine) :
   l2_icache_miss = false;
   itlb_miss = false;
 
-  foreach(i, OOO_ROB_SIZE) {
+  foreach(i, OOO_MAX_ROB_SIZE) {
     l1_dcache_miss[i] = false;
     l2_dcache_miss[i] = false;
     dtlb_miss[i] = false;
@@ -94,11 +99,19 @@ bool MemoryHierarchy::access_cache(MemoryRequest *request)
   CPUController *cpuController = (CPUController*)cpuControllers_[coreid];
   assert(cpuController != NULL);
 
+  if unlikely (config.mem_trace_filename)
+    mem_trace_writer.record(mem_trace_file, request);
+
+  mem_req_trace(request, MEM_REQ_TRACE_ACCESS, cpuController);
+
   int ret_val;
   ret_val = ((CPUController*)cpuController)->access(request);
 
-  if(ret_val == 0)
+  if(ret_val == 0) {
+    // Done at once, the core doesn't wait for a wakeup
+    mem_req_trace(request, MEM_REQ_TRACE_DONE, cpuController);
     return true;
+  }
   
   if(request->get_type() == MEMORY_OP_WRITE)
     return true;
@@ -109,10 +122,13 @@ bool MemoryHierarchy::access_cache(MemoryRequest *request)
 void MemoryHierarchy::clock()
 {
   // First clock all the cpu controllers
-  foreach(i, cpuControllers_.count()) {
-    CPUController *cpuController = (CPUController*)(
-						    cpuControllers_[i]);
-    cpuController->clock();
+  {
+    host_profile_scope(HOSTPROF_MEM_CLOCK);
+    foreach(i, cpuControllers_.count()) {
+      CPUController *cpuController = (CPUController*)(
+						      cpuControllers_[i]);
+      cpuController->clock();
+    }
   }
 
   Event *event;
@@ -121,7 +137,10 @@ void MemoryHierarchy::clock()
     if(event->get_clock() <= sim_cycle) {
       memdebug("Executing event: ", *event);
       eventQueue_.free(event);
-      assert(event->execute());
+      HostProfileScope prof(HOSTPROF_MEM_EVENT, event->get_signal());
+      bool ok = event->execute();
+      assert(ok);
+      (void)ok;
     } else {
       break;
     }
@@ -152,58 +171,25 @@ int MemoryHierarchy::flush(uint8_t coreid)
 void MemoryHierarchy::set_controller_full(Controller* controller,
 					  bool flag)
 {
+  // Controllers not registered with the hierarchy aren't tracked
+  if unlikely (controller->hierarchyIdx_ < 0)
+    return;
 
-  bool anyFull = false;
-  foreach(i, cpuControllers_.count()) {
-    if(cpuControllers_[i] == controller) {
-      cpuFullFlags_[i] = flag;
-    }
-    anyFull |= cpuFullFlags_[i];
-  }
-  foreach(j, allControllers_.count()) {
-    if(allControllers_[j] == controller) {
-      controllersFullFlags_[j] = flag;
-    }
-    anyFull |= controllersFullFlags_[j];
-  }
-  foreach(i, allInterconnects_.count()) {
-    anyFull |= interconnectsFullFlags_[i];
-  }
-  someStructIsFull_ = anyFull;
+  update_full_count(controller->hierarchyFull_, flag);
 }
 
 void MemoryHierarchy::set_interconnect_full(Interconnect* interconnect,
 					    bool flag)
 {
-  bool anyFull = false;
-  foreach(i, allInterconnects_.count()) {
-    if(allInterconnects_[i] == interconnect) {
-      interconnectsFullFlags_[i] = flag;
-    }
-    anyFull |= interconnectsFullFlags_[i];
-  }
-  foreach(i, cpuControllers_.count()) {
-    anyFull |= cpuFullFlags_[i];
-  }
-  foreach(j, allControllers_.count()) {
-    anyFull |= controllersFullFlags_[j];
-  }
-  someStructIsFull_ = anyFull;
+  if unlikely (interconnect->hierarchyIdx_ < 0)
+    return;
+
+  update_full_count(interconnect->hierarchyFull_, flag);
 }
 
 bool MemoryHierarchy::is_controller_full(Controller* controller)
 {
-  foreach(j, allControllers_.count()) {
-    if(allControllers_[j] == controller) {
-      return controllersFullFlags_[j];
-    }
-  }
-  foreach(i, cpuControllers_.count()) {
-    if(cpuControllers_[i] == controller) {
-      return cpuFullFlags_[i];
-    }
-  }
-  return false;
+  return controller->hierarchyFull_;
 }
 
 bool MemoryHierarchy::is_cache_available(W8 coreid, W8 threadid,
@@ -247,7 +233,8 @@ void MemoryHierarchy::dump_info(ostream& os)
     os << *(allInterconnects_[i]);
   }
 
-  os << "::someStructIsFull_: ", someStructIsFull_, endl;
+  os << "::someStructIsFull_: ", someStructIsFull_, " (",
+     fullStructCount_, " full)", endl;
 }
 
 void MemoryHierarchy::print_map(ostream& os)
@@ -327,7 +314,9 @@ void MemoryHierarchy::add_event(Signal *signal, int delay, void *arg)
   // If delay is 0, execute without sorting the queue
   if(delay == 0) {
     memdebug("Executing event: ", *event);
-    assert(event->execute());
+    bool ok = event->execute();
+    assert(ok);
+    (void)ok;
 
     eventQueue_.free(event);
     /* memdebug("Queue after add: \n", eventQueue_); */
@@ -42,9 +42,13 @@
 #include <ooo-const.h> //by vteori
 #include <cpuController.h>
 
+#ifndef DISABLE_LOGGING
 #define DEBUG_MEMORY
+#endif
 //#define DEBUG_WITH_FILE_NAME
+#ifndef DISABLE_CHECKS
 #define ENABLE_CHECKS
+#endif
 
 #ifdef DEBUG_MEMORY
 #ifdef DEBUG_WITH_FILE_NAME
@@ -59,7 +63,6 @@
 #define memdebug(...) (0)
 #endif
 
-#define ENABLE_MEM_REQUEST_HISTORY
 #ifdef ENABLE_MEM_REQUEST_HISTORY
 #define ADD_HISTORY(req, ...) req->get_history() << __VA_ARGS__
 #define ADD_HISTORY_ADD(req) ADD_HISTORY(req, "{+", get_name(), "} ")
@@ -69,7 +72,8 @@
 #define ADD_HISTORY_ADD(req) (0)
 #define ADD_HISTORY_REM(req) (0)
 #endif
-#ifndef ENABLE_CHECKS
+/* Asserts must not have side effects: release builds drop them */
+#if !defined(ENABLE_CHECKS) && !defined(DISABLE_ASSERT)
 #undef assert
 #define assert(x) (x)
 #endif
@@ -115,6 +119,10 @@ namespace Memory {
       return signal_->emit(arg_);
     }
 
+    Signal* get_signal() {
+      return signal_;
+    }
+
     W64 get_clock() {
       return clock_;
     }
@@ -235,24 +243,38 @@ namespace Memory {
     BaseMachine& get_machine() { return machine_; }
 
     void add_cpu_controller(Controller* cont) {
+      cont->hierarchyIdx_ = cpuControllers_.count();
       cpuControllers_.push(cont);
     }
 
+    int get_cpu_controller_count() const {
+      return cpuControllers_.count();
+    }
+
     void add_cache_mem_controller(Controller* cont) {
+      cont->hierarchyIdx_ = allControllers_.count();
       allControllers_.push(cont);
     }
 
     void add_interconnect(Interconnect* conn) {
+      conn->hierarchyIdx_ = allInterconnects_.count();
       allInterconnects_.push(conn);
     }
 
     void setup_full_flags() {
-      // Setup the full flags
-      cpuFullFlags_.resize(cpuControllers_.count(), false);
-      controllersFullFlags_.resize(allControllers_.count(), false);
-      interconnectsFullFlags_.resize(allInterconnects_.count(), false);
+      // Clear the full flags
+      foreach(i, cpuControllers_.count())
+        cpuControllers_[i]->hierarchyFull_ = false;
+      foreach(i, allControllers_.count())
+        allControllers_[i]->hierarchyFull_ = false;
+      foreach(i, allInterconnects_.count())
+        allInterconnects_[i]->hierarchyFull_ = false;
+      fullStructCount_ = 0;
+      someStructIsFull_ = false;
     }
 
+    bool is_some_struct_full() const { return someStructIsFull_; }
+
     bool grab_lock(W64 lockaddr, W8 ctx_id);
     bool probe_lock(W64 lockaddr, W8 ctx_id);
     void invalidate_lock(W64 lockaddr, W8 ctx_id);
@@ -307,13 +329,19 @@ namespace Memory {
     dynarray<Interconnect*> allInterconnects_;
     Controller* memoryController_;
 
-    // array to indicate if controller or interconnect buffers
-    // are full or not
-    dynarray<bool> cpuFullFlags_;
-    dynarray<bool> controllersFullFlags_;
-    dynarray<bool> interconnectsFullFlags_;
+    // number of controllers and interconnects whose buffers are full;
+    // each one keeps its own flag in hierarchyFull_
+    int fullStructCount_;
     bool someStructIsFull_;
 
+    void update_full_count(bool& structFull, bool flag) {
+      if(structFull == flag) return;
+      structFull = flag;
+      fullStructCount_ += (flag) ? 1 : -1;
+      assert(fullStructCount_ >= 0);
+      someStructIsFull_ = (fullStructCount_ > 0);
+    }
+
     // number of cores
     int coreNo_;
 
@@ -336,17 +364,17 @@ namespace Memory {
     // for FMTs
     bool l1_icache_miss;
     bool l2_icache_miss;
-    bool l1_dcache_miss[OOO_ROB_SIZE];
-    bool l2_dcache_miss[OOO_ROB_SIZE];
+    bool l1_dcache_miss[OOO_MAX_ROB_SIZE];
+    bool l2_dcache_miss[OOO_MAX_ROB_SIZE];
     bool itlb_miss;
-    bool dtlb_miss[OOO_ROB_SIZE];
+    bool dtlb_miss[OOO_MAX_ROB_SIZE];
 	// for traces
-	W64 cachelines[OOO_ROB_SIZE];
-	W64 l1cachelines[OOO_ROB_SIZE];
-	W64 l2cachelines[OOO_ROB_SIZE];
-	bool cacheline_sharing[OOO_ROB_SIZE];
-	bool l1cacheline_sharing[OOO_ROB_SIZE];
-	bool l2cacheline_sharing[OOO_ROB_SIZE];
+	W64 cachelines[OOO_MAX_ROB_SIZE];
+	W64 l1cachelines[OOO_MAX_ROB_SIZE];
+	W64 l2cachelines[OOO_MAX_ROB_SIZE];
+	bool cacheline_sharing[OOO_MAX_ROB_SIZE];
+	bool l1cacheline_sharing[OOO_MAX_ROB_SIZE];
+	bool l2cacheline_sharing[OOO_MAX_ROB_SIZE];
   };
 };
 
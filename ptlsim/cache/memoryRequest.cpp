@@ -35,6 +35,7 @@
 #endif
 
 #include <memoryRequest.h>
+#include <memoryRequestTrace.h>
 #include <statelist.h>
 #include <memoryHierarchy.h>
 
@@ -63,11 +64,17 @@ void MemoryRequest::init(W8 coreId,
 	opType_ = opType;
 	isData_ = !isInstruction;
 
+#ifdef ENABLE_MEM_REQUEST_HISTORY
 	if(history) delete history;
 	history = new stringbuf();
+#endif
 	wakeup_rob_Id_ = 0;
 	iswakeup = false;
 
+	traceId_ = 0;
+	if unlikely (mem_req_tracer.enabled())
+		mem_req_tracer.alloc(this);
+
 	memdebug("Init ", *this, endl);
 }
 
@@ -84,8 +91,14 @@ void MemoryRequest::init(MemoryRequest *request)
 	opType_ = request->opType_;
 	isData_ = request->isData_;
 
+#ifdef ENABLE_MEM_REQUEST_HISTORY
 	if(history) delete history;
 	history = new stringbuf();
+#endif
+
+	traceId_ = 0;
+	if unlikely (mem_req_tracer.enabled())
+		mem_req_tracer.alloc(this, request);
 
 	memdebug("Init ", *this, endl);
 }
@@ -125,35 +138,109 @@ bool MemoryRequest::is_same(MemoryRequest *request)
 }
 
 
-RequestPool::RequestPool()
+RequestPool::RequestPool(const char *name, Statable *parent)
+	: size_(0)
+	, highWater_(0)
+	, stats_(NULL)
+{
+	if(parent) {
+		stringbuf stats_name;
+		stats_name << (name ? name : "request_pool");
+		stats_ = new RequestPoolStats(stats_name, parent);
+		stats_->set_default_stats(user_stats);
+	}
+
+	add_slab();
+}
+
+RequestPool::~RequestPool()
 {
-	size_ = REQUEST_POOL_SIZE;
+	foreach(i, slabs_.count()) {
+		delete [] slabs_[i];
+	}
+	slabs_.clear();
+
+	if(stats_) delete stats_;
+}
+
+void RequestPool::add_slab()
+{
+	MemoryRequest* slab = new MemoryRequest[REQUEST_POOL_SIZE];
+	slabs_.push(slab);
+
 	foreach(i, REQUEST_POOL_SIZE) {
-		freeRequestList_.enqueue((selfqueuelink*)&((*this)[i]));
+		slab[i].pool_ = this;
+		freeRequestList_.enqueue((selfqueuelink*)&slab[i]);
+	}
+	size_ += REQUEST_POOL_SIZE;
+
+	if(stats_) {
+		W64 size = size_;
+		W64 slabs = slabs_.count();
+		stats_->size = size;
+		stats_->slabs = slabs;
 	}
+
+	memdebug("Request pool grown to ", size_, " requests\n");
+}
+
+/*
+ * Called when the free list is empty: first recover requests that were
+ * handed out but never referenced, and if that leaves the pool low then
+ * grow it by one slab.
+ */
+void RequestPool::refill()
+{
+	garbage_collection();
+
+	if(isPoolLow())
+		add_slab();
 }
 
 MemoryRequest* RequestPool::get_free_request()
 {
-	if (isPoolLow()){
-		garbage_collection();
-        /* if asserted here please increase REQUEST_POOL_SIZE */
-		assert(!isEmpty());
+	MemoryRequest* memoryRequest;
+
+	do {
+		if unlikely (isEmpty())
+			refill();
+
+		memoryRequest = (MemoryRequest*)freeRequestList_.peek();
+		freeRequestList_.remove((selfqueuelink*)memoryRequest);
+		usedRequestsList_.enqueue((selfqueuelink*)memoryRequest);
+		memoryRequest->inUse_ = true;
+
+		/*
+		 * A request that picked up a new reference after it was freed is
+		 * still live; leave it on the used list until it is released again.
+		 */
+	} while unlikely (memoryRequest->get_ref_counter() != 0);
+
+	if unlikely (usedRequestsList_.count > highWater_) {
+		highWater_ = usedRequestsList_.count;
+		if(stats_) {
+			W64 high_water = highWater_;
+			stats_->high_water = high_water;
+		}
 	}
-	MemoryRequest* memoryRequest = (MemoryRequest*)freeRequestList_.peek();
-	freeRequestList_.remove((selfqueuelink*)memoryRequest);
-	usedRequestsList_.enqueue((selfqueuelink*)memoryRequest);
 
 	return memoryRequest;
 }
 
-void RequestPool::freeRequest( MemoryRequest* memoryrequest)
+void RequestPool::free_request(MemoryRequest* memoryrequest)
 {
     /* we should free it only when no one refrence to it  */
 	assert(0 == memoryrequest->get_ref_counter());
+
+	/* Already on the free list */
+	if unlikely (!memoryrequest->inUse_)
+		return;
+
+	memoryrequest->inUse_ = false;
+	if unlikely (memoryrequest->get_trace_id())
+		mem_req_tracer.record(memoryrequest, MEM_REQ_TRACE_FREE, NULL, NULL);
 	usedRequestsList_.remove(memoryrequest);
 	freeRequestList_.enqueue(memoryrequest);
-	memoryrequest->set_ref_counter(0);
 }
 
 void RequestPool::garbage_collection()
@@ -163,10 +250,17 @@ void RequestPool::garbage_collection()
 	foreach_list_mutable(usedRequestsList_, memoryRequest, \
 			entry, nextentry){
 		if (0 == memoryRequest->get_ref_counter()){
-			freeRequest(memoryRequest);
+			free_request(memoryRequest);
 			cleaned++;
 		}
 	}
+
+	if(stats_) {
+		stats_->collections++;
+		W64 collected = cleaned;
+		stats_->collected += collected;
+	}
+
 	memdebug("number of Request cleaned by garbageCollector is: ",
 		   cleaned,	endl);
 }
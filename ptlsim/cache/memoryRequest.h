@@ -32,9 +32,20 @@
 #include <superstl.h>
 #include <statelist.h>
 #include <cacheConstants.h>
+#include <statsBuilder.h>
+
+/*
+ * Each request keeps a text history of the controllers it passed through,
+ * printed with the request when debugging. Release builds leave it out.
+ */
+#ifndef DISABLE_MEM_REQUEST_HISTORY
+#define ENABLE_MEM_REQUEST_HISTORY
+#endif
 
 namespace Memory {
 
+  class RequestPool;
+
   enum OP_TYPE {
     MEMORY_OP_READ,   /* Indicates cache miss on a read/load operation */
     MEMORY_OP_WRITE,  /* Indicates cache miss on a write/store operation */
@@ -67,17 +78,19 @@ namespace Memory {
       isData_ = 0;
       wakeup_rob_Id_ = 0;
       iswakeup = false;
-      history = new stringbuf();
+      history = NULL;
+      traceId_ = 0;
       coreSignal_ = NULL;
+      pool_ = NULL;
+      inUse_ = false;
     }
 
     void incRefCounter(){
       refCounter_++;
     }
 
-    void decRefCounter(){
-      refCounter_--;
-    }
+    /* Returns the request to its pool when the last reference is dropped */
+    inline void decRefCounter();
 
     void init(W8 coreId,
 	      W8 threadId,
@@ -132,6 +145,10 @@ namespace Memory {
 
     stringbuf& get_history() { return *history; }
 
+    /* Non-zero when the request is in the -mem-req-trace */
+    W64 get_trace_id() const { return traceId_; }
+    void set_trace_id(W64 id) { traceId_ = id; }
+
     bool is_kernel() {
       // based on owner RIP value
       if(bits(ownerRIP_, 48, 16) != 0) {
@@ -162,7 +179,9 @@ namespace Memory {
 		os << "isData[", isData_, "] ";
 		os << "ownerUUID[", ownerUUID_, "] ";
 		os << "ownerRIP[", (void*)ownerRIP_, "] ";
-		os << "History[ " << *history << "] ";
+		if(history) {
+		  os << "History[ " << *history << "] ";
+		}
 		if(coreSignal_) {
 		  os << "Signal[ " << coreSignal_->get_name() << "] ";
 		}
@@ -195,7 +214,12 @@ namespace Memory {
     int refCounter_;
     OP_TYPE opType_;
     stringbuf *history;
+    W64 traceId_;
     Signal *coreSignal_;
+    RequestPool *pool_;
+    bool inUse_;
+
+    friend class RequestPool;
   };
 
   static inline ostream& operator <<(ostream& os, const MemoryRequest& request)
@@ -203,19 +227,54 @@ namespace Memory {
     return request.print(os);
   }
 
-  class RequestPool: public array<MemoryRequest,REQUEST_POOL_SIZE>
+  struct RequestPoolStats : public Statable
+  {
+    StatObj<W64> size;
+    StatObj<W64> high_water;
+    StatObj<W64> slabs;
+    StatObj<W64> collections;
+    StatObj<W64> collected;
+
+    RequestPoolStats(stringbuf& name, Statable *parent)
+      : Statable(name, parent)
+      , size("size", this)
+      , high_water("high_water", this)
+      , slabs("slabs", this)
+      , collections("collections", this)
+      , collected("collected", this)
+    {}
+  };
+
+  /*
+   * Pool of MemoryRequests, allocated in slabs of REQUEST_POOL_SIZE.
+   *
+   * A request goes back to the free list as soon as its last reference is
+   * dropped. Requests that are handed out but never referenced (e.g.
+   * annul requests or fast path hits) are only recovered by
+   * garbage_collection(), which runs when the free list is empty. If that
+   * doesn't recover enough, another slab is added, so the pool grows
+   * instead of running out.
+   */
+  class RequestPool
     {
     public:
-      RequestPool();
+      RequestPool(const char *name=NULL, Statable *parent=NULL);
+      ~RequestPool();
+
       MemoryRequest* get_free_request();
+      void free_request(MemoryRequest* request);
       void garbage_collection();
 
       StateList& used_list() {
 	return usedRequestsList_;
       }
 
+      int get_size() const { return size_; }
+      int get_high_water() const { return highWater_; }
+
       void print(ostream& os) {
-	os << "Request pool : size[", size_, "]\n";
+	os << "Request pool : size[", size_, "] ";
+	os << "slabs[", slabs_.count(), "] high-water[", highWater_, "]\n";
 	os << "used requests : count[", usedRequestsList_.count,
 	  "]\n", flush;
 
@@ -240,10 +299,14 @@ namespace Memory {
 
     private:
       int size_;
+      int highWater_;
+      dynarray<MemoryRequest*> slabs_;
       StateList freeRequestList_;
       StateList usedRequestsList_;
+      RequestPoolStats *stats_;
 
-      void freeRequest(MemoryRequest* request);
+      void add_slab();
+      void refill();
 
       bool isEmpty()
       {
@@ -252,11 +315,17 @@ namespace Memory {
 
       bool isPoolLow()
       {
-	return (freeRequestList_.count < (
-					  REQUEST_POOL_SIZE * REQUEST_POOL_LOW_RATIO));
+	return (freeRequestList_.count < (size_ * REQUEST_POOL_LOW_RATIO));
       }
     };
 
+  inline void MemoryRequest::decRefCounter()
+  {
+    refCounter_--;
+    if (refCounter_ == 0 && pool_)
+      pool_->free_request(this);
+  }
+
   static inline ostream& operator <<(ostream& os, RequestPool &pool)
   {
     pool.print(os); 
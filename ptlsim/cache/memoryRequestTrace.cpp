@@ -0,0 +1,160 @@
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <memoryRequestTrace.h>
+#include <memoryRequest.h>
+
+using namespace Memory;
+
+MemoryRequestTracer Memory::mem_req_tracer;
+
+const char *Memory::mem_req_trace_event_names[NUM_MEM_REQ_TRACE_EVENTS] = {
+    "name", "alloc", "access", "queue", "lookup", "hit", "miss", "send",
+    "recv", "done", "free",
+};
+
+MemoryRequestTracer::MemoryRequestTracer()
+    : os_(NULL)
+      , used_(0)
+      , next_id_(1)
+{
+}
+
+/**
+ * @brief Write the file header and trace requests allocated from now on
+ */
+void MemoryRequestTracer::start(ostream& os,
+        const MemoryRequestTraceFilter& filter)
+{
+    MemoryRequestTraceHeader header;
+    setzero(header);
+    header.magic = MEM_REQ_TRACE_MAGIC;
+    header.version = MEM_REQ_TRACE_VERSION;
+    header.event_size = sizeof(MemoryRequestTraceEvent);
+
+    os.write((char*)&header, sizeof(header));
+    os_ = &os;
+    filter_ = filter;
+    used_ = 0;
+    next_id_ = 1;
+    units_.clear();
+    named_.clear();
+}
+
+void MemoryRequestTracer::stop()
+{
+    flush();
+    os_ = NULL;
+}
+
+void MemoryRequestTracer::flush()
+{
+    if unlikely (!os_)
+        return;
+
+    os_->write((char*)buf_, used_);
+    os_->flush();
+    used_ = 0;
+}
+
+void MemoryRequestTracer::put(const void *data, int size)
+{
+    if unlikely (used_ + size > MEM_REQ_TRACE_BUFFER)
+        flush();
+
+    memcpy(buf_ + used_, data, size);
+    used_ += size;
+}
+
+bool MemoryRequestTracer::filter(MemoryRequest *request) const
+{
+    W64 addr = request->get_physical_address();
+
+    if (filter_.coreid != infinity &&
+            filter_.coreid != W64(request->get_coreid()))
+        return false;
+
+    if (addr < filter_.addr_start || addr >= filter_.addr_end)
+        return false;
+
+    return (sim_cycle >= filter_.cycle_start &&
+            sim_cycle < filter_.cycle_end);
+}
+
+void MemoryRequestTracer::alloc(MemoryRequest *request, MemoryRequest *parent)
+{
+    W64 parent_id = (parent) ? parent->get_trace_id() : 0;
+
+    if (!parent_id && !filter(request)) {
+        request->set_trace_id(0);
+        return;
+    }
+
+    request->set_trace_id(next_id_++);
+    record(request, MEM_REQ_TRACE_ALLOC, NULL, NULL, parent_id);
+}
+
+/**
+ * @brief Number a unit the first time it is seen
+ *
+ * Peers are only known by their pointer, so a unit gets its name record
+ * the first time it is seen with a name.
+ */
+int MemoryRequestTracer::unit_id(const void *unit, const char *name)
+{
+    if (!unit)
+        return MEM_REQ_TRACE_NO_UNIT;
+
+    int id;
+    for (id = 0; id < units_.count(); id++) {
+        if (units_[id] == unit)
+            break;
+    }
+
+    if (id == units_.count()) {
+        units_.push(unit);
+        named_.push(false);
+    }
+
+    if (name && !named_[id]) {
+        MemoryRequestTraceEvent ev;
+        setzero(ev);
+        ev.cycle = sim_cycle;
+        ev.event = MEM_REQ_TRACE_NAME;
+        ev.unit = id;
+        ev.peer = MEM_REQ_TRACE_NO_UNIT;
+        ev.arg = strlen(name);
+
+        put(&ev, sizeof(ev));
+        put(name, ev.arg);
+        named_[id] = true;
+    }
+
+    return id;
+}
+
+void MemoryRequestTracer::record(MemoryRequest *request, int event,
+        const void *unit, const char *unit_name, W64 arg, const void *peer)
+{
+    if unlikely (!os_)
+        return;
+
+    MemoryRequestTraceEvent ev;
+    ev.unit = unit_id(unit, unit_name);
+    ev.peer = unit_id(peer, NULL);
+    ev.cycle = sim_cycle;
+    ev.id = request->get_trace_id();
+    ev.addr = request->get_physical_address();
+    ev.arg = arg;
+    ev.event = event;
+    ev.coreid = request->get_coreid();
+    ev.threadid = request->get_threadid();
+    ev.optype = request->get_type();
+    if (request->is_instruction())
+        ev.optype |= MEM_REQ_TRACE_IFETCH;
+
+    put(&ev, sizeof(ev));
+}
@@ -0,0 +1,155 @@
+#ifndef MEMORY_REQUEST_TRACE_H
+#define MEMORY_REQUEST_TRACE_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <config-parser.h>
+#include <memoryRequest.h>
+
+/*
+ * Memory request lifecycle trace, written with -mem-req-trace
+ *
+ * Records what happens to each MemoryRequest on its way through the
+ * hierarchy: allocation, the core's access, entering a controller queue,
+ * cache lookups with their hit or miss, messages accepted by interconnects
+ * and controllers, the core wakeup and the return to the request pool.
+ * Each event is a fixed size MemoryRequestTraceEvent. Controllers and
+ * interconnects are numbered as they are first seen, and a
+ * MEM_REQ_TRACE_NAME event carrying the name is written before the first
+ * event at each one. util/mem_req_trace.py converts the file to the Chrome
+ * trace event format for chrome://tracing or Perfetto.
+ *
+ * Whether a request is traced is decided when it is allocated, from its
+ * core, address and the current cycle, and a traced request keeps all of
+ * its events. Requests copied from a traced request are always traced.
+ */
+
+namespace Memory {
+
+    enum {
+        MEM_REQ_TRACE_NAME = 0,  // names a unit, followed by the name
+        MEM_REQ_TRACE_ALLOC,     // arg is the id of the copied request
+        MEM_REQ_TRACE_ACCESS,    // sent by the core to its CPU controller
+        MEM_REQ_TRACE_QUEUE,     // entered a controller's pending queue
+        MEM_REQ_TRACE_LOOKUP,    // cache array access
+        MEM_REQ_TRACE_HIT,
+        MEM_REQ_TRACE_MISS,
+        MEM_REQ_TRACE_SEND,      // message accepted by an interconnect
+        MEM_REQ_TRACE_RECV,      // message accepted by a controller
+        MEM_REQ_TRACE_DONE,      // core woken up
+        MEM_REQ_TRACE_FREE,      // back in the request pool
+        NUM_MEM_REQ_TRACE_EVENTS
+    };
+
+    extern const char *mem_req_trace_event_names[NUM_MEM_REQ_TRACE_EVENTS];
+
+    // Instruction fetch flag in MemoryRequestTraceEvent::optype
+    #define MEM_REQ_TRACE_IFETCH 0x80
+
+    // No unit, for events without a peer
+    #define MEM_REQ_TRACE_NO_UNIT 0xffff
+
+    struct MemoryRequestTraceEvent
+    {
+        W64 cycle;
+        W64 id;         // request, numbered from 1 in allocation order
+        W64 addr;       // physical address
+        W64 arg;        // event specific, name length for NAME
+        W16 unit;       // controller or interconnect the event happened at
+        W16 peer;       // sender of a SEND or RECV message
+        W8 event;
+        W8 coreid;
+        W8 threadid;
+        W8 optype;      // OP_TYPE and MEM_REQ_TRACE_IFETCH
+    };
+
+    struct MemoryRequestTraceHeader
+    {
+        W64 magic;
+        W32 version;
+        W32 event_size;
+    };
+
+    static const W64 MEM_REQ_TRACE_MAGIC = 0x3145434152545152ULL; // "RQTRACE1"
+    static const W32 MEM_REQ_TRACE_VERSION = 1;
+
+    // Bytes buffered before a write to the file
+    #define MEM_REQ_TRACE_BUFFER (64 * 1024)
+
+    /* Which requests are traced, ranges are [start, end) */
+    struct MemoryRequestTraceFilter
+    {
+        W64 coreid;         // infinity for all cores
+        W64 addr_start;
+        W64 addr_end;
+        W64 cycle_start;
+        W64 cycle_end;
+
+        MemoryRequestTraceFilter()
+            : coreid(infinity)
+              , addr_start(0)
+              , addr_end(infinity)
+              , cycle_start(0)
+              , cycle_end(infinity)
+        {}
+    };
+
+    class MemoryRequestTracer
+    {
+        public:
+            MemoryRequestTracer();
+
+            void start(ostream& os, const MemoryRequestTraceFilter& filter);
+            void stop();
+            void flush();
+
+            bool enabled() const { return os_ != NULL; }
+
+            // Numbers the request if it is traced, parent if it is a copy
+            void alloc(MemoryRequest *request, MemoryRequest *parent=NULL);
+
+            void record(MemoryRequest *request, int event, const void *unit,
+                    const char *unit_name, W64 arg=0, const void *peer=NULL);
+
+        private:
+            ostream *os_;
+            MemoryRequestTraceFilter filter_;
+            byte buf_[MEM_REQ_TRACE_BUFFER];
+            int used_;
+            W64 next_id_;
+            dynarray<const void*> units_;
+            dynarray<bool> named_;
+
+            bool filter(MemoryRequest *request) const;
+            int unit_id(const void *unit, const char *name);
+            void put(const void *data, int size);
+    };
+
+    extern MemoryRequestTracer mem_req_tracer;
+
+    /*
+     * Hooks called by the controllers and interconnects. Units are anything
+     * with get_name(); the check for an untraced request is inlined.
+     */
+    template <typename Unit>
+    static inline void mem_req_trace(MemoryRequest *request, int event,
+            const Unit *unit, W64 arg=0)
+    {
+        if unlikely (request->get_trace_id())
+            mem_req_tracer.record(request, event, unit, unit->get_name(),
+                    arg);
+    }
+
+    // Messages, the peer is the sender
+    template <typename Unit>
+    static inline void mem_req_trace(MemoryRequest *request, int event,
+            const Unit *unit, const void *peer)
+    {
+        if unlikely (request->get_trace_id())
+            mem_req_tracer.record(request, event, unit, unit->get_name(), 0,
+                    peer);
+    }
+
+};
+
+#endif // MEMORY_REQUEST_TRACE_H
@@ -238,6 +238,84 @@ struct BusStats : public Statable {
     {}
 };
 
+struct NetworkStats : public Statable {
+
+    StatObj<W64> packets;         // delivered
+    StatObj<W64> data_packets;
+    StatObj<W64> flits;
+    StatObj<W64> hops;
+    StatObj<W64> latency;         // injection to delivery, all packets
+    StatObj<W64> vc_stalls;       // waits for a free virtual channel
+    StatObj<W64> inject_full;     // sends refused, injection queue full
+    StatObj<W64> eject_retry;     // destination controller was busy
+    StatObj<W64> link_busy;       // flit cycles on all links
+    StatObj<W64> link_cycles;     // elapsed cycles times number of links
+    StatArray<W64, NOC_MAX_LINKS> link_flits;
+
+    StatEquation<W64, double, StatObjFormulaDiv> avg_latency;
+    StatEquation<W64, double, StatObjFormulaDiv> avg_hops;
+    StatEquation<W64, double, StatObjFormulaDiv> link_utilization;
+
+    NetworkStats(const char* name, Statable *parent)
+        : Statable(name, parent)
+          , packets("packets", this)
+          , data_packets("data_packets", this)
+          , flits("flits", this)
+          , hops("hops", this)
+          , latency("latency", this)
+          , vc_stalls("vc_stalls", this)
+          , inject_full("inject_full", this)
+          , eject_retry("eject_retry", this)
+          , link_busy("link_busy", this)
+          , link_cycles("link_cycles", this)
+          , link_flits("link_flits", this)
+          , avg_latency("avg_latency", this)
+          , avg_hops("avg_hops", this)
+          , link_utilization("link_utilization", this)
+    {
+        avg_latency.add_elem(&latency);
+        avg_latency.add_elem(&packets);
+
+        avg_hops.add_elem(&hops);
+        avg_hops.add_elem(&packets);
+
+        link_utilization.add_elem(&link_busy);
+        link_utilization.add_elem(&link_cycles);
+    }
+};
+
+struct DirectoryStats : public Statable {
+
+    StatObj<W64> reads;
+    StatObj<W64> writes;
+    StatObj<W64> forwarded;           // received for another home node
+    StatObj<W64> entry_allocs;
+    StatObj<W64> entry_evictions;     // replaced entries that had sharers
+    StatObj<W64> set_locked;          // retries, no entry could be replaced
+    StatObj<W64> invalidations;       // evicts sent for write misses
+    StatObj<W64> back_invalidations;  // evicts sent for replaced entries
+    StatObj<W64> inexact_invalidations; // sent from an overflowed sharer set
+
+    StatEquation<W64, double, StatObjFormulaDiv> eviction_rate;
+
+    DirectoryStats(const char* name, Statable *parent)
+        : Statable(name, parent)
+          , reads("reads", this)
+          , writes("writes", this)
+          , forwarded("forwarded", this)
+          , entry_allocs("entry_allocs", this)
+          , entry_evictions("entry_evictions", this)
+          , set_locked("set_locked", this)
+          , invalidations("invalidations", this)
+          , back_invalidations("back_invalidations", this)
+          , inexact_invalidations("inexact_invalidations", this)
+          , eviction_rate("eviction_rate", this)
+    {
+        eviction_rate.add_elem(&entry_evictions);
+        eviction_rate.add_elem(&entry_allocs);
+    }
+};
+
 struct RAMStats : public Statable {
 
     StatArray<W64, MEM_BANKS> bank_access;
@@ -254,6 +332,89 @@ struct RAMStats : public Statable {
     {}
 };
 
+struct DRAMStats : public Statable {
+
+    StatObj<W64> reads;
+    StatObj<W64> writes;
+    StatObj<W64> accesses;
+    StatObj<W64> merged_writes;
+    StatObj<W64> queue_full;
+
+    StatObj<W64> row_hit;
+    StatObj<W64> row_closed;
+    StatObj<W64> row_conflict;
+    StatObj<W64> activates;
+    StatObj<W64> precharges;
+    StatObj<W64> write_drains;
+
+    StatObj<W64> read_queue_cycles;  // arrival to first command
+    StatObj<W64> write_queue_cycles;
+    StatObj<W64> read_latency;       // arrival to data returned
+
+    StatObj<W64> bytes_read;
+    StatObj<W64> bytes_written;
+    StatObj<W64> data_bus_cycles;
+    StatObj<W64> cycles;             // first to last DRAM command
+
+    StatEquation<W64, double, StatObjFormulaDiv> row_hit_rate;
+    StatEquation<W64, double, StatObjFormulaDiv> avg_read_queue;
+    StatEquation<W64, double, StatObjFormulaDiv> avg_write_queue;
+    StatEquation<W64, double, StatObjFormulaDiv> avg_read_latency;
+    StatEquation<W64, double, StatObjFormulaDiv> read_bytes_per_cycle;
+    StatEquation<W64, double, StatObjFormulaDiv> write_bytes_per_cycle;
+    StatEquation<W64, double, StatObjFormulaDiv> bus_utilization;
+
+    DRAMStats(const char* name, Statable *parent)
+        : Statable(name, parent)
+          , reads("reads", this)
+          , writes("writes", this)
+          , accesses("accesses", this)
+          , merged_writes("merged_writes", this)
+          , queue_full("queue_full", this)
+          , row_hit("row_hit", this)
+          , row_closed("row_closed", this)
+          , row_conflict("row_conflict", this)
+          , activates("activates", this)
+          , precharges("precharges", this)
+          , write_drains("write_drains", this)
+          , read_queue_cycles("read_queue_cycles", this)
+          , write_queue_cycles("write_queue_cycles", this)
+          , read_latency("read_latency", this)
+          , bytes_read("bytes_read", this)
+          , bytes_written("bytes_written", this)
+          , data_bus_cycles("data_bus_cycles", this)
+          , cycles("cycles", this)
+          , row_hit_rate("row_hit_rate", this)
+          , avg_read_queue("avg_read_queue", this)
+          , avg_write_queue("avg_write_queue", this)
+          , avg_read_latency("avg_read_latency", this)
+          , read_bytes_per_cycle("read_bytes_per_cycle", this)
+          , write_bytes_per_cycle("write_bytes_per_cycle", this)
+          , bus_utilization("bus_utilization", this)
+    {
+        row_hit_rate.add_elem(&row_hit);
+        row_hit_rate.add_elem(&accesses);
+
+        avg_read_queue.add_elem(&read_queue_cycles);
+        avg_read_queue.add_elem(&reads);
+
+        avg_write_queue.add_elem(&write_queue_cycles);
+        avg_write_queue.add_elem(&writes);
+
+        avg_read_latency.add_elem(&read_latency);
+        avg_read_latency.add_elem(&reads);
+
+        read_bytes_per_cycle.add_elem(&bytes_read);
+        read_bytes_per_cycle.add_elem(&cycles);
+
+        write_bytes_per_cycle.add_elem(&bytes_written);
+        write_bytes_per_cycle.add_elem(&cycles);
+
+        bus_utilization.add_elem(&data_bus_cycles);
+        bus_utilization.add_elem(&cycles);
+    }
+};
+
 };
 
 #endif // MEMORY_STATS_H
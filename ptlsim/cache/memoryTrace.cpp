@@ -0,0 +1,551 @@
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <memoryTrace.h>
+#include <memoryHierarchy.h>
+#include <memoryRequest.h>
+
+using namespace Memory;
+
+MemoryTraceWriter Memory::mem_trace_writer;
+
+static inline W64 zigzag(W64 delta)
+{
+    return (delta << 1) ^ W64(W64s(delta) >> 63);
+}
+
+static inline W64 unzigzag(W64 v)
+{
+    return (v >> 1) ^ -(v & 1);
+}
+
+MemoryTraceWriter::MemoryTraceWriter()
+    : used_(0)
+      , started_(false)
+      , start_cycle_(0)
+{
+}
+
+/**
+ * @brief Write the file header, gaps of each core count from now
+ */
+void MemoryTraceWriter::start(ostream& os)
+{
+    MemoryTraceHeader header;
+    setzero(header);
+    header.magic = MEM_TRACE_MAGIC;
+    header.version = MEM_TRACE_VERSION;
+
+    os.write((char*)&header, sizeof(header));
+    used_ = 0;
+    started_ = true;
+    start_cycle_ = sim_cycle;
+    cores_.clear();
+}
+
+void MemoryTraceWriter::flush(ostream& os)
+{
+    os.write((char*)buf_, used_);
+    os.flush();
+    used_ = 0;
+}
+
+MemoryTraceCoreState& MemoryTraceWriter::core_state(int coreid)
+{
+    if unlikely (coreid >= cores_.count()) {
+        MemoryTraceCoreState st;
+        st.last_cycle = start_cycle_;
+        st.last_addr = 0;
+        st.last_rip = 0;
+        cores_.resize(coreid + 1, st);
+    }
+
+    return cores_[coreid];
+}
+
+void MemoryTraceWriter::put_varint(W64 v)
+{
+    while (v >= 0x80) {
+        buf_[used_++] = byte(v | 0x80);
+        v >>= 7;
+    }
+    buf_[used_++] = byte(v);
+}
+
+/**
+ * @brief Append a request a core sent to its CPU controller
+ */
+void MemoryTraceWriter::record(ostream& os, MemoryRequest *request)
+{
+    MemoryTraceRecord rec;
+    MemoryTraceCoreState &st = core_state(request->get_coreid());
+
+    rec.coreid = request->get_coreid();
+    rec.threadid = request->get_threadid();
+    rec.addr = request->get_physical_address();
+    rec.rip = request->get_owner_rip();
+    rec.dependent = false;
+    rec.gap = sim_cycle - st.last_cycle;
+    st.last_cycle = sim_cycle;
+
+    if (request->is_instruction())
+        rec.type = MEM_TRACE_IFETCH;
+    else if (request->get_type() == MEMORY_OP_WRITE)
+        rec.type = MEM_TRACE_WRITE;
+    else
+        rec.type = MEM_TRACE_READ;
+
+    record(os, rec);
+}
+
+void MemoryTraceWriter::record(ostream& os, const MemoryTraceRecord& rec)
+{
+    if unlikely (!started_)
+        return;
+
+    // Longest record: tag and five 10 byte varints
+    if unlikely (used_ > MEM_TRACE_BUFFER - 64)
+        flush(os);
+
+    MemoryTraceCoreState &st = core_state(rec.coreid);
+
+    byte tag = rec.type & MEM_TRACE_TYPE;
+    if (rec.dependent) tag |= MEM_TRACE_DEPENDENT;
+    if (rec.rip != st.last_rip) tag |= MEM_TRACE_RIP;
+    buf_[used_++] = tag;
+
+    put_varint(rec.coreid);
+    put_varint(rec.threadid);
+    put_varint(rec.gap);
+    put_varint(zigzag(rec.addr - st.last_addr));
+    if (tag & MEM_TRACE_RIP)
+        put_varint(zigzag(rec.rip - st.last_rip));
+
+    st.last_addr = rec.addr;
+    st.last_rip = rec.rip;
+}
+
+MemoryTraceReader::MemoryTraceReader(istream& is)
+    : is_(is)
+      , pos_(0)
+      , len_(0)
+      , header_ok_(false)
+{
+    MemoryTraceHeader header;
+    is.read((char*)&header, sizeof(header));
+
+    header_ok_ = (is.gcount() == sizeof(header) &&
+            header.magic == MEM_TRACE_MAGIC &&
+            header.version == MEM_TRACE_VERSION);
+}
+
+bool MemoryTraceReader::fill()
+{
+    if (!is_)
+        return false;
+
+    is_.read((char*)buf_, sizeof(buf_));
+    len_ = is_.gcount();
+    pos_ = 0;
+    return (len_ > 0);
+}
+
+bool MemoryTraceReader::getvarint(W64& v)
+{
+    byte b;
+    int shift = 0;
+    v = 0;
+
+    do {
+        if (!getbyte(b) || shift > 63)
+            return false;
+        v |= W64(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+
+    return true;
+}
+
+bool MemoryTraceReader::next(MemoryTraceRecord& rec)
+{
+    if (!header_ok_)
+        return false;
+
+    byte tag;
+    W64 coreid, threadid, v;
+
+    // A truncated file or an unknown tag ends the trace
+    if (!getbyte(tag) || (tag & ~(MEM_TRACE_TYPE | MEM_TRACE_DEPENDENT |
+                    MEM_TRACE_RIP)))
+        return false;
+
+    if ((tag & MEM_TRACE_TYPE) >= NUM_MEM_TRACE_TYPES)
+        return false;
+
+    if (!getvarint(coreid) || !getvarint(threadid) || coreid > 255 ||
+            threadid > 255)
+        return false;
+
+    if unlikely (coreid >= W64(cores_.count())) {
+        MemoryTraceCoreState st;
+        setzero(st);
+        cores_.resize(coreid + 1, st);
+    }
+
+    MemoryTraceCoreState &st = cores_[coreid];
+
+    rec.coreid = coreid;
+    rec.threadid = threadid;
+    rec.type = tag & MEM_TRACE_TYPE;
+    rec.dependent = (tag & MEM_TRACE_DEPENDENT);
+
+    if (!getvarint(rec.gap)) return false;
+    if (!getvarint(v)) return false;
+    rec.addr = st.last_addr + unzigzag(v);
+
+    if (tag & MEM_TRACE_RIP) {
+        if (!getvarint(v)) return false;
+        rec.rip = st.last_rip + unzigzag(v);
+    } else {
+        rec.rip = st.last_rip;
+    }
+
+    st.last_addr = rec.addr;
+    st.last_rip = rec.rip;
+    return true;
+}
+
+const char *Memory::synth_pattern_names[NUM_SYNTH_PATTERNS] = {
+    "stream", "random", "chase",
+};
+
+SyntheticMemoryStream::SyntheticMemoryStream()
+    : pattern_(SYNTH_STREAM)
+      , cores_(1)
+      , count_(100000)
+      , footprint_(64 * 1024 * 1024)
+      , stride_(64)
+      , writes_(0)
+      , gap_(1)
+      , shared_(false)
+      , seed_(1)
+      , issued_(0)
+{
+}
+
+static bool parse_size(const char *value, W64& size)
+{
+    char *end = NULL;
+    size = strtoull(value, &end, 0);
+    if (end == value)
+        return false;
+
+    switch (*end) {
+        case 'k': case 'K': size <<= 10; end++; break;
+        case 'm': case 'M': size <<= 20; end++; break;
+        case 'g': case 'G': size <<= 30; end++; break;
+    }
+
+    return (*end == 0);
+}
+
+bool SyntheticMemoryStream::set(const char *key, const char *value)
+{
+    W64 v;
+    if (!parse_size(value, v))
+        return false;
+
+    if (strcmp(key, "cores") == 0 && v > 0 && v <= 256) {
+        cores_ = v;
+    } else if (strcmp(key, "count") == 0) {
+        count_ = v;
+    } else if (strcmp(key, "footprint") == 0 && v >= 64) {
+        footprint_ = v;
+    } else if (strcmp(key, "stride") == 0 && v > 0) {
+        stride_ = v;
+    } else if (strcmp(key, "writes") == 0 && v <= 100) {
+        writes_ = v;
+    } else if (strcmp(key, "gap") == 0) {
+        gap_ = v;
+    } else if (strcmp(key, "shared") == 0) {
+        shared_ = (v != 0);
+    } else if (strcmp(key, "seed") == 0) {
+        seed_ = v;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Set up the stream from "pattern:key=value:..."
+ *
+ * @return false on an unknown pattern or key, or a bad value
+ */
+bool SyntheticMemoryStream::parse(const char *spec)
+{
+    stringbuf sb;
+    sb << spec;
+
+    dynarray<stringbuf*> parts;
+    sb.split(parts, ":");
+
+    bool ok = false;
+    if (parts.count() > 0) {
+        foreach (i, NUM_SYNTH_PATTERNS) {
+            if (strcmp(parts[0]->buf, synth_pattern_names[i]) == 0) {
+                pattern_ = SyntheticPattern(i);
+                ok = true;
+            }
+        }
+    }
+
+    for (int i = 1; ok && i < parts.count(); i++) {
+        char *eq = strchr(parts[i]->buf, '=');
+        if (!eq) {
+            ok = false;
+            break;
+        }
+        *eq = 0;
+        ok = set(parts[i]->buf, eq + 1);
+    }
+
+    foreach (i, parts.count()) delete parts[i];
+
+    issued_ = 0;
+    rng_.resize(cores_);
+    foreach (i, cores_) {
+        // xorshift must not start from zero
+        rng_[i] = (seed_ + i + 1) * 0x9e3779b97f4a7c15ULL;
+    }
+
+    return ok;
+}
+
+W64 SyntheticMemoryStream::random(int coreid)
+{
+    W64 &x = rng_[coreid];
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return x;
+}
+
+bool SyntheticMemoryStream::next(MemoryTraceRecord& rec)
+{
+    if (issued_ >= count_ * cores_)
+        return false;
+
+    int coreid = issued_ % cores_;
+    W64 n = issued_ / cores_;
+    W64 base = shared_ ? 0 : coreid * footprint_;
+    W64 offset;
+
+    if (pattern_ == SYNTH_STREAM)
+        offset = (n * stride_) % footprint_;
+    else
+        offset = (random(coreid) % (footprint_ >> 6)) << 6;
+
+    rec.coreid = coreid;
+    rec.threadid = 0;
+    rec.gap = gap_;
+    rec.addr = base + offset;
+    rec.rip = 0x400000;
+    rec.dependent = (pattern_ == SYNTH_CHASE);
+    rec.type = (writes_ && W64s(random(coreid) % 100) < writes_) ?
+        MEM_TRACE_WRITE : MEM_TRACE_READ;
+
+    issued_++;
+    return true;
+}
+
+MemoryReplay::MemoryReplay(const char *name, MemoryHierarchy *memoryHierarchy,
+        int cores, int max_misses)
+    : Statable(name)
+      , memoryHierarchy_(memoryHierarchy)
+      , max_misses_(max(max_misses, 1))
+      , source_(NULL)
+      , source_done_(true)
+      , queued_(0)
+      , outstanding_(0)
+      , issued_(0)
+      , host_ns_(0)
+      , cycles("cycles", this)
+      , dropped("dropped", this)
+      , host_ns("host_ns", this)
+{
+    foreach (i, cores) {
+        stringbuf name;
+        name << "core_" << i;
+
+        Core *c = new Core();
+        c->head = 0;
+        c->last_issue = 0;
+        c->uuid = 0;
+        c->outstanding = 0;
+        c->stats = new MemoryReplayStats(name.buf, this);
+        cores_.push(c);
+    }
+
+    set_default_stats(user_stats);
+
+    stringbuf sig_name;
+    sig_name << name, "-access-done";
+    accessDone_.set_name(sig_name.buf);
+    accessDone_.connect(signal_mem_ptr(*this,
+                &MemoryReplay::access_done_cb));
+}
+
+/* Read records until the window is full */
+void MemoryReplay::fill()
+{
+    MemoryTraceRecord rec;
+
+    while (!source_done_ && queued_ < MEM_REPLAY_WINDOW) {
+        if (!source_->next(rec)) {
+            source_done_ = true;
+            break;
+        }
+
+        if unlikely (rec.coreid >= cores_.count()) {
+            dropped++;
+            continue;
+        }
+
+        // dynarray grows 16 records at a time, copying all of them
+        dynarray<MemoryTraceRecord> &queue = cores_[rec.coreid]->queue;
+        if unlikely (queue.count() == queue.capacity())
+            queue.reserve(max(queue.capacity() * 2, 1024));
+
+        queue.push(rec);
+        queued_++;
+    }
+}
+
+void MemoryReplay::issue(int coreid)
+{
+    Core &c = *cores_[coreid];
+    if (c.head == c.queue.count())
+        return;
+
+    MemoryTraceRecord &rec = c.queue[c.head];
+    bool ifetch = (rec.type == MEM_TRACE_IFETCH);
+    bool write = (rec.type == MEM_TRACE_WRITE);
+
+    if (sim_cycle < c.last_issue + rec.gap)
+        return;
+
+    if (c.outstanding >= max_misses_ || (rec.dependent && c.outstanding)) {
+        c.stats->limit_stalls++;
+        return;
+    }
+
+    if (!memoryHierarchy_->is_cache_available(coreid, rec.threadid, ifetch)) {
+        c.stats->full_stalls++;
+        return;
+    }
+
+    MemoryRequest *request = memoryHierarchy_->get_free_request(coreid);
+    assert(request != NULL);
+
+    // The caches index their per-ROB entry tables with the ROB id
+    int robid = int(c.uuid % OOO_MAX_ROB_SIZE);
+    request->init(coreid, rec.threadid, rec.addr, robid, sim_cycle,
+            ifetch, rec.rip, c.uuid, write ? MEMORY_OP_WRITE : MEMORY_OP_READ);
+    request->set_coreSignal(&accessDone_);
+    c.uuid++;
+    issued_++;
+
+    c.stats->requests++;
+    if (ifetch) c.stats->ifetches++;
+    else if (write) c.stats->writes++;
+    else c.stats->reads++;
+
+    bool hit = memoryHierarchy_->access_cache(request);
+
+    if (write) {
+        // Stores retire into the hierarchy and never hold the core
+    } else if (hit) {
+        c.stats->hits++;
+    } else {
+        c.outstanding++;
+        outstanding_++;
+    }
+
+    c.last_issue = sim_cycle;
+    c.head++;
+    queued_--;
+
+    /*
+     * fill() keeps appending while the core issues, so the queue may never
+     * run empty. Drop the issued records once they are half of it, so it
+     * stays within twice the window and each move copies no more records
+     * than were issued since the last one.
+     */
+    if (c.head * 2 >= c.queue.count()) {
+        int left = c.queue.count() - c.head;
+        foreach (i, left) {
+            c.queue[i] = c.queue[c.head + i];
+        }
+        c.queue.resize(left);
+        c.head = 0;
+    }
+}
+
+bool MemoryReplay::access_done_cb(void *arg)
+{
+    MemoryRequest *request = (MemoryRequest*)arg;
+
+    if (request->get_type() == MEMORY_OP_WRITE)
+        return true;
+
+    Core &c = *cores_[request->get_coreid()];
+    if (c.outstanding > 0) {
+        c.outstanding--;
+        outstanding_--;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Clock the memory hierarchy until every request is done
+ */
+W64 MemoryReplay::run(MemoryTraceSource& source, W64 stop_cycle)
+{
+    W64 start = sim_cycle;
+    W64 tsc_at_start = rdtsc();
+
+    source_ = &source;
+    source_done_ = false;
+
+    foreach (i, cores_.count()) {
+        cores_[i]->last_issue = start;
+    }
+
+    while (sim_cycle < stop_cycle) {
+        fill();
+
+        foreach (i, cores_.count()) {
+            issue(i);
+        }
+
+        if (source_done_ && queued_ == 0 && outstanding_ == 0)
+            break;
+
+        memoryHierarchy_->clock();
+        sim_cycle++;
+    }
+
+    W64 ns = W64(ticks_to_native_seconds(rdtsc() - tsc_at_start) * 1e9);
+    host_ns_ += ns;
+    host_ns += ns;
+
+    cycles += sim_cycle - start;
+    source_ = NULL;
+    return sim_cycle - start;
+}
@@ -0,0 +1,267 @@
+#ifndef MEMORY_TRACE_H
+#define MEMORY_TRACE_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <statsBuilder.h>
+
+/*
+ * Memory request trace, written with -mem-trace and replayed with
+ * -mem-replay
+ *
+ * Every request a core sends to its CPU controller becomes a tag byte
+ * followed by LEB128 varints:
+ *
+ *   tag       MEM_TRACE_* type and the flags below
+ *   coreid
+ *   threadid
+ *   gap       cycles since the core's previous request
+ *   addr      physical address, zigzag delta from the core's previous one
+ *   rip       only with MEM_TRACE_RIP: rip of the uop, zigzag delta from
+ *             the core's previous rip
+ *
+ * Replaying a trace or a synthetic stream drives the memory hierarchy of
+ * the machine through each core's CPU controller, without running the
+ * cores or the guest. Each core keeps the recorded gaps between its
+ * requests and waits while it has the allowed number of misses
+ * outstanding, so the timing follows the hierarchy being studied.
+ */
+
+namespace Memory {
+
+    class MemoryHierarchy;
+    class MemoryRequest;
+
+    enum {
+        MEM_TRACE_READ = 0,
+        MEM_TRACE_WRITE,
+        MEM_TRACE_IFETCH,
+        NUM_MEM_TRACE_TYPES
+    };
+
+    enum {
+        MEM_TRACE_TYPE      = 0x03,
+        MEM_TRACE_DEPENDENT = 0x04,  // waits for the core's misses
+        MEM_TRACE_RIP       = 0x08,  // rip changed and follows
+    };
+
+    struct MemoryTraceHeader
+    {
+        W64 magic;
+        W32 version;
+        W32 reserved;
+    };
+
+    static const W64 MEM_TRACE_MAGIC = 0x3145434152544d4dULL; // "MMTRACE1"
+    static const W32 MEM_TRACE_VERSION = 1;
+
+    // Bytes buffered before a write to the file
+    #define MEM_TRACE_BUFFER (64 * 1024)
+
+    // Records read ahead of the slowest core during a replay
+    #define MEM_REPLAY_WINDOW (64 * 1024)
+
+    struct MemoryTraceRecord
+    {
+        W64 gap;
+        W64 addr;
+        W64 rip;
+        W8 coreid;
+        W8 threadid;
+        W8 type;
+        bool dependent;
+    };
+
+    /* Per core state kept by both ends to encode deltas */
+    struct MemoryTraceCoreState
+    {
+        W64 last_cycle;
+        W64 last_addr;
+        W64 last_rip;
+    };
+
+    class MemoryTraceWriter
+    {
+        public:
+            MemoryTraceWriter();
+
+            void start(ostream& os);
+            void record(ostream& os, MemoryRequest *request);
+            void record(ostream& os, const MemoryTraceRecord& rec);
+            void flush(ostream& os);
+
+        private:
+            byte buf_[MEM_TRACE_BUFFER];
+            int used_;
+            bool started_;
+            W64 start_cycle_;
+            dynarray<MemoryTraceCoreState> cores_;
+
+            MemoryTraceCoreState& core_state(int coreid);
+            void put_varint(W64 v);
+    };
+
+    extern MemoryTraceWriter mem_trace_writer;
+
+    /* Requests in the order the cores sent them */
+    class MemoryTraceSource
+    {
+        public:
+            virtual ~MemoryTraceSource() {}
+            virtual bool next(MemoryTraceRecord& rec) = 0;
+    };
+
+    class MemoryTraceReader : public MemoryTraceSource
+    {
+        public:
+            MemoryTraceReader(istream& is);
+
+            bool valid() const { return header_ok_; }
+            bool next(MemoryTraceRecord& rec);
+
+        private:
+            istream& is_;
+            byte buf_[MEM_TRACE_BUFFER];
+            int pos_;
+            int len_;
+            bool header_ok_;
+            dynarray<MemoryTraceCoreState> cores_;
+
+            bool getbyte(byte& b) {
+                if unlikely (pos_ == len_ && !fill())
+                    return false;
+                b = buf_[pos_++];
+                return true;
+            }
+
+            bool fill();
+            bool getvarint(W64& v);
+    };
+
+    enum SyntheticPattern {
+        SYNTH_STREAM = 0,  // stride through the footprint
+        SYNTH_RANDOM,      // random lines of the footprint
+        SYNTH_CHASE,       // random lines, each waiting for the last
+        NUM_SYNTH_PATTERNS
+    };
+
+    extern const char *synth_pattern_names[NUM_SYNTH_PATTERNS];
+
+    /**
+     * @brief Generated requests, from a spec like the branch predictors'
+     *
+     * "pattern:key=value:..." with pattern stream, random or chase and
+     * keys cores, count (requests per core), footprint (bytes, k/m/g
+     * suffixes allowed), stride, writes (percent), gap (cycles between a
+     * core's requests), shared (all cores use one region) and seed.
+     */
+    class SyntheticMemoryStream : public MemoryTraceSource
+    {
+        public:
+            SyntheticMemoryStream();
+
+            bool parse(const char *spec);
+            bool next(MemoryTraceRecord& rec);
+
+            int cores() const { return cores_; }
+
+        private:
+            SyntheticPattern pattern_;
+            int cores_;
+            W64 count_;
+            W64 footprint_;
+            W64 stride_;
+            int writes_;
+            W64 gap_;
+            bool shared_;
+            W64 seed_;
+
+            W64 issued_;
+            dynarray<W64> rng_;
+
+            bool set(const char *key, const char *value);
+            W64 random(int coreid);
+    };
+
+    struct MemoryReplayStats : public Statable
+    {
+        StatObj<W64> requests;
+        StatObj<W64> reads;
+        StatObj<W64> writes;
+        StatObj<W64> ifetches;
+        StatObj<W64> hits;          // done without a cache miss queue entry
+        StatObj<W64> limit_stalls;  // cycles spent at the miss limit
+        StatObj<W64> full_stalls;   // cycles the CPU controller was full
+
+        MemoryReplayStats(const char *name, Statable *parent)
+            : Statable(name, parent)
+              , requests("requests", this)
+              , reads("reads", this)
+              , writes("writes", this)
+              , ifetches("ifetches", this)
+              , hits("hits", this)
+              , limit_stalls("limit_stalls", this)
+              , full_stalls("full_stalls", this)
+        {}
+    };
+
+    /**
+     * @brief Feeds requests to the memory hierarchy in place of the cores
+     *
+     * Records of each core are queued as they are read, and a core sends
+     * its next one once its gap has passed, it has fewer than max_misses
+     * loads and fetches outstanding, and its CPU controller has room. A
+     * core sends at most one request a cycle.
+     */
+    class MemoryReplay : public Statable
+    {
+        public:
+            MemoryReplay(const char *name, MemoryHierarchy *memoryHierarchy,
+                    int cores, int max_misses);
+
+            // Returns the cycles taken, stopping early at stop_cycle
+            W64 run(MemoryTraceSource& source, W64 stop_cycle);
+
+            // Of all the runs so far
+            W64 issued() const { return issued_; }
+            W64 host_nanoseconds() const { return host_ns_; }
+
+            bool access_done_cb(void *arg);
+
+        private:
+            struct Core {
+                dynarray<MemoryTraceRecord> queue;
+                int head;
+                W64 last_issue;
+                W64 uuid;
+                int outstanding;
+                MemoryReplayStats *stats;
+            };
+
+            MemoryHierarchy *memoryHierarchy_;
+            int max_misses_;
+            dynarray<Core*> cores_;
+            Signal accessDone_;
+
+            MemoryTraceSource *source_;
+            bool source_done_;
+            int queued_;
+            int outstanding_;
+            W64 issued_;
+            W64 host_ns_;
+
+            StatObj<W64> cycles;
+            StatObj<W64> dropped;  // records of cores the machine lacks
+            StatObj<W64> host_ns;  // host time spent in run()
+
+            void fill();
+            void issue(int coreid);
+    };
+
+    // -mem-bench: replays synthetic patterns on hierarchies built in
+    // memoryBench.cpp and writes the host time they took to filename
+    bool run_memory_bench(const char *filename, int max_misses);
+
+};
+
+#endif // MEMORY_TRACE_H
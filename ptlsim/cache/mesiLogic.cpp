@@ -34,102 +34,97 @@
 using namespace Memory;
 using namespace Memory::CoherentCache;
 
-void MESILogic::handle_local_hit(CacheQueueEntry *queueEntry)
-{
-    MESICacheLineState oldState = (MESICacheLineState)queueEntry->line->state;
-    MESICacheLineState newState = NO_MESI_STATES;
-    OP_TYPE type                = queueEntry->request->get_type();
-    bool kernel_req             = queueEntry->request->is_kernel();
+#define I COH_S(MESI_INVALID)
+#define M COH_S(MESI_MODIFIED)
+#define E COH_S(MESI_EXCLUSIVE)
+#define S COH_S(MESI_SHARED)
+
+#define LP     COH_LOWEST_PRIVATE
+#define NOT_LP COH_NOT_LOWEST_PRIVATE
+#define ANY    COH_ANY_LEVEL
+
+/* MESI transitions, first matching rule wins */
+static const CoherenceRule mesi_rules[] = {
+    /* Local requests */
+    {COH_ANY_STATE, COH_E(COH_LOCAL_EVICT), ANY, MESI_INVALID,
+        COH_ACT_STAT_ALWAYS | COH_ACT_CLEAR},
+    {M, COH_ANY_LOCAL, ANY, COH_STATE_SAME, COH_ACT_RESPOND},
+    /* Update from upper cache on a non-modified line must have been
+     * initiated from this level, or lower level cache, so send it down */
+    {COH_ANY_STATE, COH_E(COH_LOCAL_UPDATE), ANY, COH_STATE_SAME,
+        COH_ACT_FORWARD},
+    {I, COH_E(COH_LOCAL_READ) | COH_E(COH_LOCAL_WRITE), ANY, COH_STATE_SAME,
+        COH_ACT_MISS_STAT | COH_ACT_MISS},
+    {E|S, COH_E(COH_LOCAL_READ), ANY, COH_STATE_SAME, COH_ACT_RESPOND},
+    {E, COH_E(COH_LOCAL_WRITE), LP, MESI_MODIFIED,
+        COH_ACT_STAT_ALWAYS | COH_ACT_RESPOND},
+    {S, COH_E(COH_LOCAL_WRITE), LP, MESI_MODIFIED,
+        COH_ACT_EVICT_LOWER | COH_ACT_STAT_ALWAYS | COH_ACT_RESPOND},
+    /* Treat it as miss so lower cache also update its line state */
+    {E|S, COH_E(COH_LOCAL_WRITE), NOT_LP, MESI_INVALID,
+        COH_ACT_STAT_ALWAYS | COH_ACT_MISS_STAT | COH_ACT_MISS},
+
+    /* Requests from lower interconnect */
+    {COH_ANY_STATE, COH_E(COH_SNOOP_EVICT), LP, MESI_INVALID,
+        COH_ACT_EVICT_UPPER | COH_ACT_STAT_ALWAYS | COH_ACT_CLEAR},
+    {COH_ANY_STATE, COH_E(COH_SNOOP_EVICT), NOT_LP, MESI_INVALID,
+        COH_ACT_STAT_ALWAYS | COH_ACT_CLEAR},
+    {COH_ANY_STATE, COH_E(COH_SNOOP_UPDATE), NOT_LP, COH_STATE_FROM_ARG,
+        COH_ACT_STAT_ALWAYS | COH_ACT_CLEAR},
+    {I, COH_ANY_SNOOP, ANY, MESI_INVALID,
+        COH_ACT_NO_DATA | COH_ACT_STAT_ALWAYS | COH_ACT_RESPOND},
+    {E, COH_E(COH_SNOOP_READ), ANY, MESI_SHARED,
+        COH_ACT_SHARED | COH_ACT_UPDATE_UPPER | COH_ACT_STAT_ALWAYS |
+            COH_ACT_RESPOND},
+    {S, COH_E(COH_SNOOP_READ), ANY, MESI_SHARED,
+        COH_ACT_SHARED | COH_ACT_STAT_ALWAYS | COH_ACT_RESPOND},
+    {M, COH_E(COH_SNOOP_READ), ANY, MESI_SHARED,
+        COH_ACT_SHARED | COH_ACT_WRITEBACK | COH_ACT_STAT_ALWAYS |
+            COH_ACT_RESPOND},
+    {E|S, COH_E(COH_SNOOP_WRITE), LP, MESI_INVALID,
+        COH_ACT_EVICT_UPPER | COH_ACT_STAT_ALWAYS | COH_ACT_RESPOND},
+    {E|S, COH_E(COH_SNOOP_WRITE), NOT_LP, MESI_INVALID,
+        COH_ACT_STAT_ALWAYS | COH_ACT_RESPOND},
+    {M, COH_E(COH_SNOOP_WRITE), LP, MESI_INVALID,
+        COH_ACT_WRITEBACK | COH_ACT_EVICT_UPPER | COH_ACT_STAT_ALWAYS |
+            COH_ACT_RESPOND},
+    {M, COH_E(COH_SNOOP_WRITE), NOT_LP, MESI_INVALID,
+        COH_ACT_WRITEBACK | COH_ACT_STAT_ALWAYS | COH_ACT_RESPOND},
+    {E|S, COH_E(COH_SNOOP_UPDATE), LP, COH_STATE_FROM_ARG,
+        COH_ACT_STAT_ALWAYS | COH_ACT_RESPOND},
+    {M, COH_E(COH_SNOOP_UPDATE), LP, COH_STATE_FROM_ARG,
+        COH_ACT_WRITEBACK | COH_ACT_STAT_ALWAYS | COH_ACT_RESPOND},
+
+    /* Responses to our own miss in lowest private cache */
+    {COH_ANY_STATE, COH_E(COH_FILL_EVICT) | COH_E(COH_FILL_SHARED_EVICT), LP,
+        MESI_INVALID, COH_ACT_EVICT_UPPER | COH_ACT_STAT_ALWAYS},
+    {COH_ANY_STATE, COH_E(COH_FILL_SHARED_READ), LP, MESI_SHARED,
+        COH_ACT_STAT_ALWAYS},
+    {E, COH_E(COH_FILL_SHARED_WRITE), LP, MESI_INVALID,
+        COH_ACT_EVICT_UPPER | COH_ACT_STAT_ALWAYS},
+    {I|E|S, COH_E(COH_FILL_READ), LP, MESI_EXCLUSIVE, COH_ACT_STAT_ALWAYS},
+    {M, COH_E(COH_FILL_READ), LP, MESI_MODIFIED, COH_ACT_STAT_ALWAYS},
+    {COH_ANY_STATE, COH_E(COH_FILL_WRITE), LP, MESI_MODIFIED,
+        COH_ACT_STAT_ALWAYS},
+};
 
-    N_STAT_UPDATE(hit_state.cpu, [oldState]++,
-                 kernel_req);
+#undef I
+#undef M
+#undef E
+#undef S
+#undef LP
+#undef NOT_LP
+#undef ANY
 
-    if(type == MEMORY_OP_EVICT) {
-        UPDATE_MESI_TRANS_STATS(oldState, MESI_INVALID, kernel_req);
-        queueEntry->line->state = MESI_INVALID;
-        controller->clear_entry_cb(queueEntry);
-        return;
-    }
+const CoherenceTable MESILogic::table("MESI", NO_MESI_STATES, mesi_rules,
+        lengthof(mesi_rules));
 
-	if (type == MEMORY_OP_UPDATE && oldState != MESI_MODIFIED) {
-		/* If we receive update from upper cache and local cache line state
-		 * is not MODIFIED, then send the response down because cache update
-		 * must have been initiated from this level, or lower level cache. */
-		queueEntry->dest = controller->get_lower_cont();
-		queueEntry->sendTo = controller->get_lower_intrconn();
-		queueEntry->eventFlags[CACHE_WAIT_INTERCONNECT_EVENT]++;
-		controller->wait_interconnect_cb(queueEntry);
-		return;
-	}
-
-    switch(oldState) {
-        case MESI_INVALID:
-            /* treat it as a miss */
-            N_STAT_UPDATE(miss_state.cpu, [oldState]++,
-                    kernel_req);
-            controller->cache_miss_cb(queueEntry);
-            break;
-        case MESI_EXCLUSIVE:
-            if(type == MEMORY_OP_WRITE) {
-                if(controller->is_lowest_private()) {
-                    queueEntry->line->state = MESI_MODIFIED;
-                    queueEntry->sendTo      = queueEntry->sender;
-                    newState                = MESI_MODIFIED;
-                    controller->wait_interconnect_cb(queueEntry);
-                } else {
-                    /*
-                     * treat it as miss so lower cache also update
-                     * its cache line state
-                     */
-                    queueEntry->line->state = MESI_INVALID;
-                    newState                = MESI_INVALID;
-                    N_STAT_UPDATE(miss_state.cpu, [oldState]++,
-                            kernel_req);
-                    controller->cache_miss_cb(queueEntry);
-                }
-            } else if(type == MEMORY_OP_READ) {
-                queueEntry->sendTo = queueEntry->sender;
-                assert(queueEntry->sendTo == queueEntry->sender);
-                controller->wait_interconnect_cb(queueEntry);
-            }
-            break;
-        case MESI_SHARED:
-            if(type == MEMORY_OP_WRITE) {
-                if(controller->is_lowest_private()) {
-                    queueEntry->line->state = MESI_MODIFIED;
-                    newState                = MESI_MODIFIED;
-                    queueEntry->sendTo      = queueEntry->sender;
-                    controller->send_evict_to_lower(queueEntry);
-                    controller->wait_interconnect_cb(queueEntry);
-                } else {
-                    /*
-                     * treat it as miss so lower cache also update
-                     * its cache line state
-                     */
-                    queueEntry->line->state = MESI_INVALID;
-                    newState                = MESI_INVALID;
-                    N_STAT_UPDATE(miss_state.cpu, [oldState]++,
-                            kernel_req);
-                    controller->cache_miss_cb(queueEntry);
-                }
-            } else if(type == MEMORY_OP_READ) {
-                queueEntry->sendTo = queueEntry->sender;
-                controller->wait_interconnect_cb(queueEntry);
-            }
-            break;
-        case MESI_MODIFIED:
-			/* we dont' change anything in this case */
-			queueEntry->sendTo = queueEntry->sender;
-			controller->wait_interconnect_cb(queueEntry);
-			break;
-        default:
-            memdebug("Invalid line state: " << oldState);
-            assert(0);
-    }
+void MESILogic::handle_local_hit(CacheQueueEntry *queueEntry)
+{
+    N_STAT_UPDATE(hit_state.cpu, [queueEntry->line->state]++,
+            queueEntry->request->is_kernel());
 
-    if(newState != NO_MESI_STATES) {
-        UPDATE_MESI_TRANS_STATS(oldState, newState, kernel_req);
-    }
+    execute_transition(queueEntry, COH_LOCAL);
 }
 
 void MESILogic::handle_local_miss(CacheQueueEntry *queueEntry)
@@ -141,103 +136,10 @@ void MESILogic::handle_local_miss(CacheQueueEntry *queueEntry)
 
 void MESILogic::handle_interconn_hit(CacheQueueEntry *queueEntry)
 {
-    MESICacheLineState oldState = (MESICacheLineState)queueEntry->line->state;
-    MESICacheLineState newState = NO_MESI_STATES;
-    OP_TYPE type                = queueEntry->request->get_type();
-    bool kernel_req             = queueEntry->request->is_kernel();
-
-    N_STAT_UPDATE(hit_state.snoop, [oldState]++,
-                 kernel_req);
-    if(type == MEMORY_OP_EVICT) {
-        if(controller->is_lowest_private())
-            controller->send_evict_to_upper(queueEntry);
-        UPDATE_MESI_TRANS_STATS(oldState, MESI_INVALID, kernel_req);
-        queueEntry->line->state = MESI_INVALID;
-        controller->clear_entry_cb(queueEntry);
-        return;
-    }
-
-    if (type == MEMORY_OP_UPDATE && !controller->is_lowest_private()) {
-        queueEntry->line->state = *(MESICacheLineState*)(queueEntry->m_arg);
-        UPDATE_MESI_TRANS_STATS(oldState, queueEntry->line->state, kernel_req);
-        controller->clear_entry_cb(queueEntry);
-        return;
-    }
+    N_STAT_UPDATE(hit_state.snoop, [queueEntry->line->state]++,
+            queueEntry->request->is_kernel());
 
-    // By default we mark the queueEntry's shared flat to false
-    queueEntry->isShared     = false;
-    queueEntry->responseData = true;
-
-    switch(oldState) {
-        case MESI_INVALID:
-            queueEntry->line         = NULL;
-            queueEntry->responseData = false;
-            newState                 = MESI_INVALID;
-            break;
-        case MESI_EXCLUSIVE:
-            if(type == MEMORY_OP_READ) {
-                queueEntry->line->state = MESI_SHARED;
-                queueEntry->isShared    = true;
-                newState                = MESI_SHARED;
-                controller->send_update_to_upper(queueEntry);
-            } else if(type == MEMORY_OP_WRITE) {
-                if(controller->is_lowest_private())
-                    controller->send_evict_to_upper(queueEntry);
-                queueEntry->line->state = MESI_INVALID;
-                newState = MESI_INVALID;
-            } else if(type == MEMORY_OP_UPDATE) {
-                newState = *(MESICacheLineState*)(queueEntry->m_arg);
-                queueEntry->line->state = newState;
-            } else {
-                assert(0);
-            }
-            break;
-        case MESI_SHARED:
-            if(type == MEMORY_OP_READ) {
-                queueEntry->isShared = true;
-                newState             = MESI_SHARED;
-            } else if(type == MEMORY_OP_WRITE) {
-                if(controller->is_lowest_private())
-                    controller->send_evict_to_upper(queueEntry);
-                queueEntry->line->state = MESI_INVALID;
-                newState                = MESI_INVALID;
-            } else if(type == MEMORY_OP_UPDATE) {
-                newState = *(MESICacheLineState*)(queueEntry->m_arg);
-                queueEntry->line->state = newState;
-            } else {
-                assert(0);
-            }
-            break;
-        case MESI_MODIFIED:
-            controller->send_update_to_lower(queueEntry);
-            if(type == MEMORY_OP_READ) {
-                queueEntry->line->state = MESI_SHARED;
-                queueEntry->isShared    = true;
-                newState                = MESI_SHARED;
-            } else if(type == MEMORY_OP_WRITE) {
-                if(controller->is_lowest_private())
-                    controller->send_evict_to_upper(queueEntry);
-                queueEntry->line->state = MESI_INVALID;
-                newState                = MESI_INVALID;
-            } else if(type == MEMORY_OP_UPDATE) {
-                newState = *(MESICacheLineState*)(queueEntry->m_arg);
-                queueEntry->line->state = newState;
-            } else {
-                assert(0);
-            }
-            break;
-        default:
-            memdebug("Invalid line state: " << oldState);
-            assert(0);
-    }
-
-    if(newState != NO_MESI_STATES) {
-        UPDATE_MESI_TRANS_STATS(oldState, newState, kernel_req);
-    }
-
-    /* send back the response */
-    queueEntry->sendTo = queueEntry->sender;
-    controller->wait_interconnect_cb(queueEntry);
+    execute_transition(queueEntry, COH_SNOOP);
 }
 
 void MESILogic::handle_interconn_miss(CacheQueueEntry *queueEntry)
@@ -293,141 +195,20 @@ void MESILogic::complete_request(CacheQueueEntry *queueEntry,
     assert(queueEntry->line);
     assert(message.hasData);
 
-    if(!controller->is_lowest_private()) {
-        if(message.request->get_type() == MEMORY_OP_EVICT) {
-            queueEntry->line->state = MESI_INVALID;
-        } else if(controller->is_private()) {
-            /*
-             * Message contains a valid argument that has
-             * the state of the line from lower cache
-             */
-            queueEntry->line->state = *((MESICacheLineState*)
-                    message.arg);
-        } else {
-            /*
-             * Message is from main memory simply set the
-             * line state as MESI_EXCLUSIVE
-             */
-            queueEntry->line->state = MESI_EXCLUSIVE;
-        }
-    } else {
-        queueEntry->line->state = get_new_state(queueEntry,
-                message.isShared);
-    }
+    /* Lower non-private caches and main memory return the line as
+     * MESI_EXCLUSIVE */
+    complete_fill(queueEntry, message, MESI_EXCLUSIVE);
 }
 
-MESICacheLineState MESILogic::get_new_state(
-        CacheQueueEntry *queueEntry, bool isShared)
+void MESILogic::update_transition_stats(int oldState, int newState,
+        bool kernel)
 {
-    MESICacheLineState oldState = (MESICacheLineState)queueEntry->line->state;
-    MESICacheLineState newState = MESI_INVALID;
-    OP_TYPE type                = queueEntry->request->get_type();
-    bool kernel_req             = queueEntry->request->is_kernel();
-
-    if(type == MEMORY_OP_EVICT) {
-        if(controller->is_lowest_private())
-            controller->send_evict_to_upper(queueEntry);
-        UPDATE_MESI_TRANS_STATS(oldState, MESI_INVALID, kernel_req);
-        return MESI_INVALID;
-    }
-
-    if(type == MEMORY_OP_UPDATE) {
-        ptl_logfile << "Queueentry: " << *queueEntry << endl;
-        assert(0);
-    }
+    UPDATE_MESI_TRANS_STATS(oldState, newState, kernel);
+}
 
-    switch(oldState) {
-        case MESI_INVALID:
-            if(isShared) {
-                if(type == MEMORY_OP_READ) {
-                    newState = MESI_SHARED;
-                } else { //if(type == MEMORY_OP_WRITE)
-                    assert(0);
-                }
-            } else {
-                if(type == MEMORY_OP_READ)
-                    newState = MESI_EXCLUSIVE;
-                else if(type == MEMORY_OP_WRITE)
-                    newState = MESI_MODIFIED;
-                else if(type == MEMORY_OP_EVICT)
-                    newState = MESI_INVALID;
-                else
-                    assert(0);
-            }
-            break;
-        case MESI_EXCLUSIVE:
-            if(isShared) {
-                if(type == MEMORY_OP_READ)
-                    newState = MESI_SHARED;
-                else {
-                    if(controller->is_lowest_private())
-                        controller->send_evict_to_upper(queueEntry);
-                    newState = MESI_INVALID;
-                }
-            } else {
-                if(type == MEMORY_OP_READ)
-                    newState = MESI_EXCLUSIVE;
-                else if(type == MEMORY_OP_WRITE)
-                    newState = MESI_MODIFIED;
-                else if(type == MEMORY_OP_EVICT) {
-                    if(controller->is_lowest_private())
-                        controller->send_evict_to_upper(queueEntry);
-                    newState = MESI_INVALID;
-                }
-                else
-                    assert(0);
-            }
-            break;
-        case MESI_SHARED:
-            if(isShared) {
-                if(type == MEMORY_OP_READ)
-                    newState = MESI_SHARED;
-                else if(type == MEMORY_OP_WRITE)
-                    assert(0);
-                else
-                    assert(0);
-            } else {
-                if(type == MEMORY_OP_READ)
-                    newState = MESI_EXCLUSIVE;
-                else if(type == MEMORY_OP_WRITE)
-                    newState = MESI_MODIFIED;
-                else if(type == MEMORY_OP_EVICT) {
-                    if(controller->is_lowest_private())
-                        controller->send_evict_to_upper(queueEntry);
-                    newState = MESI_INVALID;
-                }
-                else
-                    assert(0);
-            }
-            break;
-        case MESI_MODIFIED:
-            if(isShared) {
-                if(type == MEMORY_OP_READ)
-                    newState = MESI_SHARED;
-                else if(type == MEMORY_OP_WRITE)
-                    assert(0);
-                else
-                    assert(0);
-            } else {
-                if(type == MEMORY_OP_READ)
-                    newState = MESI_MODIFIED;
-                else if(type == MEMORY_OP_WRITE)
-                    newState = MESI_MODIFIED;
-                else if(type == MEMORY_OP_EVICT) {
-                    if(controller->is_lowest_private())
-                        controller->send_evict_to_upper(queueEntry);
-                    newState = MESI_INVALID;
-                }
-                else
-                    assert(0);
-            }
-            break;
-        default:
-            memdebug("Invalid line state: " << oldState);
-            assert(0);
-    }
-    UPDATE_MESI_TRANS_STATS(oldState, newState, kernel_req);
-    return newState;
+void MESILogic::update_miss_stats(int state, bool kernel)
+{
+    N_STAT_UPDATE(miss_state.cpu, [state]++, kernel);
 }
 
 void MESILogic::invalidate_line(CacheLine *line)
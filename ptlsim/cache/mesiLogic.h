@@ -67,7 +67,7 @@ namespace CoherentCache {
         public:
             MESILogic(CacheController *cont, Statable *parent,
                     MemoryHierarchy *mem_hierarchy)
-                : CoherenceLogic("mesi", cont, parent, mem_hierarchy)
+                : CoherenceLogic("mesi", cont, parent, mem_hierarchy, &table)
                   , miss_state("miss_state", this)
                   , hit_state("hit_state", this)
                   , state_transition("state_transition", this)
@@ -87,7 +87,11 @@ namespace CoherentCache {
             void invalidate_line(CacheLine *line);
 			void dump_configuration(YAML::Emitter &out) const;
 
-            MESICacheLineState get_new_state(CacheQueueEntry *queueEntry, bool isShared);
+            void update_transition_stats(int oldState, int newState,
+                    bool kernel);
+            void update_miss_stats(int state, bool kernel);
+
+            static const CoherenceTable table;
 
             /* Statistics */
 
@@ -0,0 +1,246 @@
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <missRatioCurve.h>
+#include <memoryStats.h>
+
+#include <machine.h>
+
+using namespace Memory;
+
+/* Line hashes are in [0, MRC_HASH_RANGE), a line is sampled when its
+ * hash is below the threshold */
+#define MRC_HASH_RANGE (1U << 24)
+
+/* Lines dropped at once when the sampling rate is lowered, 1/8 */
+#define MRC_DROP_SHIFT 3
+
+const char *Memory::mrc_size_labels[MRC_POINTS] = {
+    "4K", "6K", "8K", "12K", "16K", "24K", "32K", "48K",
+    "64K", "96K", "128K", "192K", "256K", "384K", "512K", "768K",
+    "1M", "1536K", "2M", "3M", "4M", "6M", "8M", "12M",
+    "16M", "24M", "32M", "48M", "64M", "96M", "128M", "192M",
+    "256M",
+};
+
+MissRatioCurve::MissRatioCurve(Statable *parent, int line_bits, int sample,
+        int max_lines)
+    : lineBits_(line_bits)
+      , maxLines_(max(max_lines, 64))
+      , sample_(max(sample, 1))
+      , now_(0)
+      , stats("mrc", parent)
+{
+    threshold_ = max(MRC_HASH_RANGE / sample_, 1U);
+
+    /* Times run up to twice the tracked lines between compactions */
+    tree_.resize(2 * maxLines_ + 1, 0);
+}
+
+/**
+ * @brief Create the profiler of a cache controller if it is enabled
+ *
+ * @param machine Machine holding the controller's options
+ * @param name Name of the cache controller
+ * @param parent Stats of the cache controller
+ * @param line_bits Line size bits of the cache
+ *
+ * @return New profiler or NULL if option 'mrc' is not set
+ */
+MissRatioCurve* MissRatioCurve::create(BaseMachine &machine,
+        const char *name, Statable *parent, int line_bits)
+{
+    bool enabled = false;
+    int sample = 100;
+    int max_lines = 8192;
+
+    if (!machine.get_option(name, "mrc", enabled) || !enabled)
+        return NULL;
+
+    machine.get_option(name, "mrc_sample", sample);
+    machine.get_option(name, "mrc_max_lines", max_lines);
+
+    return new MissRatioCurve(parent, line_bits, sample, max_lines);
+}
+
+/* Cache size in bytes of a point of the curve */
+W64 MissRatioCurve::size_of(int point)
+{
+    W64 base = (point & 1) ? 6144 : 4096;
+    return base << (point >> 1);
+}
+
+W32 MissRatioCurve::hash_of(W64 line)
+{
+    W64 x = line;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x & (MRC_HASH_RANGE - 1);
+}
+
+/**
+ * @brief Record a demand access
+ *
+ * @param addr Physical address
+ * @param kernel Access is from kernel mode
+ */
+void MissRatioCurve::access(W64 addr, bool kernel)
+{
+    N_STAT_UPDATE(stats.accesses, ++, kernel);
+
+    W64 line = addr >> lineBits_;
+    W32 hash = hash_of(line);
+
+    if (hash >= threshold_)
+        return;
+
+    if (now_ == (W64)tree_.count() - 1)
+        compact();
+
+    Line *l = lines_.get(line);
+
+    if (l) {
+        /* Distinct lines accessed since the last access to this one */
+        W64 distance = tree_sum(now_ - 1) - tree_sum(l->time);
+        tree_add(l->time, -1);
+        record(distance, false, kernel);
+    } else {
+        if (lines_.count >= maxLines_ && !make_room(hash, kernel))
+            return;
+
+        Line new_line;
+        new_line.hash = hash;
+        new_line.time = 0;
+        l = lines_.add(line, new_line);
+        record(0, true, kernel);
+    }
+
+    l->time = now_++;
+    tree_add(l->time, 1);
+}
+
+void MissRatioCurve::record(W64 distance, bool cold, bool kernel)
+{
+    W64 w = weight();
+
+    N_STAT_UPDATE(stats.sampled, ++, kernel);
+    N_STAT_UPDATE(stats.references, += w, kernel);
+
+    if (cold) {
+        N_STAT_UPDATE(stats.cold, += w, kernel);
+    }
+
+    /* An LRU cache of C lines misses when the distance is at least C */
+    W64 scaled = (distance * MRC_HASH_RANGE) / threshold_;
+
+    foreach (i, MRC_POINTS) {
+        if (!cold && (size_of(i) >> lineBits_) > scaled)
+            break;
+        N_STAT_UPDATE(stats.misses, [i] += w, kernel);
+    }
+}
+
+/* Accesses one sampled access stands for */
+W64 MissRatioCurve::weight() const
+{
+    return (MRC_HASH_RANGE + threshold_ / 2) / threshold_;
+}
+
+/**
+ * @brief Lower the sampling threshold to stay within max_lines
+ *
+ * @param hash Hash of the line about to be added
+ *
+ * @return true if that line is still sampled
+ *
+ * The new threshold drops about an eighth of the tracked lines, those
+ * with the highest hashes, found with a histogram of the hashes.
+ */
+bool MissRatioCurve::make_room(W32 hash, bool kernel)
+{
+    int buckets[256];
+    memset(buckets, 0, sizeof(buckets));
+
+    Hashtable<W64, Line, 4096>::Iterator iter(&lines_);
+    KeyValuePair<W64, Line> *kvp;
+    while ((kvp = iter.next())) {
+        buckets[((W64)kvp->value.hash * 256) / threshold_]++;
+    }
+
+    /* Keep the lowest bucket even if it holds all the lines, a zero
+     * threshold would stop sampling for good */
+    int drop = max(lines_.count >> MRC_DROP_SHIFT, 1);
+    int bucket = 256;
+    while (drop > 0 && bucket > 1)
+        drop -= buckets[--bucket];
+
+    threshold_ = max(((W64)bucket * threshold_) / 256, W64(1));
+
+    scratch_.clear();
+    iter.reset(&lines_);
+    while ((kvp = iter.next())) {
+        if (kvp->value.hash >= threshold_) {
+            tree_add(kvp->value.time, -1);
+            scratch_.push(kvp->key);
+        }
+    }
+
+    foreach (i, scratch_.count())
+        lines_.remove(scratch_[i]);
+
+    N_STAT_UPDATE(stats.rate_drops, ++, kernel);
+
+    return hash < threshold_;
+}
+
+/**
+ * @brief Renumber access times once they reach the end of the tree
+ *
+ * The new time of a line is its rank among the tracked lines, which
+ * keeps the order and so all distances.
+ */
+void MissRatioCurve::compact()
+{
+    Hashtable<W64, Line, 4096>::Iterator iter(&lines_);
+    KeyValuePair<W64, Line> *kvp;
+    while ((kvp = iter.next())) {
+        kvp->value.time = tree_sum(kvp->value.time) - 1;
+    }
+
+    tree_.fill(0);
+    now_ = lines_.count;
+
+    iter.reset(&lines_);
+    while ((kvp = iter.next())) {
+        tree_add(kvp->value.time, 1);
+    }
+}
+
+void MissRatioCurve::tree_add(W64 time, int delta)
+{
+    int size = tree_.count();
+    for (int i = time + 1; i < size; i += i & -i)
+        tree_[i] += delta;
+}
+
+/* Number of tracked lines last accessed at or before 'time' */
+int MissRatioCurve::tree_sum(W64 time) const
+{
+    int sum = 0;
+    for (int i = time + 1; i > 0; i -= i & -i)
+        sum += tree_[i];
+    return sum;
+}
+
+void MissRatioCurve::dump_configuration(YAML::Emitter &out) const
+{
+    YAML_KEY_VAL(out, "mrc_sample", sample_);
+    YAML_KEY_VAL(out, "mrc_max_lines", maxLines_);
+}
@@ -0,0 +1,109 @@
+#ifndef MISS_RATIO_CURVE_H
+#define MISS_RATIO_CURVE_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <statsBuilder.h>
+
+struct BaseMachine;
+
+/* Cache sizes of the curve: 4KB to 256MB in steps of 1x and 1.5x */
+#define MRC_POINTS 33
+
+namespace Memory {
+
+    extern const char *mrc_size_labels[MRC_POINTS];
+
+    struct MRCStats : public Statable
+    {
+        StatObj<W64> accesses;    // demand accesses seen
+        StatObj<W64> sampled;
+        StatObj<W64> references;  // sampled, scaled by the sampling rate
+        StatObj<W64> cold;        // scaled first references
+        StatObj<W64> rate_drops;  // sampling rate lowered to bound memory
+
+        /* Scaled misses of a fully associative LRU cache of each size,
+         * miss ratio is misses / references */
+        StatArray<W64, MRC_POINTS> misses;
+
+        MRCStats(const char *name, Statable *parent)
+            : Statable(name, parent)
+              , accesses("accesses", this)
+              , sampled("sampled", this)
+              , references("references", this)
+              , cold("cold", this)
+              , rate_drops("rate_drops", this)
+              , misses("misses", this, mrc_size_labels)
+        {}
+    };
+
+    /**
+     * @brief Miss ratio curve of a cache from sampled stack distances
+     *
+     * Follows SHARDS: a line is sampled when a hash of its address is
+     * below a threshold, so every access to a sampled line is seen. The
+     * LRU stack distance of a sampled access counts the distinct sampled
+     * lines touched since the previous access to it; scaled by the
+     * sampling rate it gives the smallest cache, in lines, that would
+     * hit. Distances come from a Fenwick tree over the time of the last
+     * access of each line.
+     *
+     * At most 'max_lines' lines are tracked. When a new line would go
+     * past that the threshold is lowered to drop the lines with the
+     * highest hashes, so the sampling rate adapts to the footprint.
+     *
+     * Options (on the cache in the machine configuration):
+     *   mrc:            enable the profiler
+     *   mrc_sample:     initial rate, one line in N (100)
+     *   mrc_max_lines:  lines tracked at most (8192)
+     */
+    class MissRatioCurve
+    {
+        public:
+            MissRatioCurve(Statable *parent, int line_bits, int sample,
+                    int max_lines);
+
+            static MissRatioCurve* create(BaseMachine &machine,
+                    const char *name, Statable *parent, int line_bits);
+
+            void access(W64 addr, bool kernel);
+
+            static W64 size_of(int point);
+            static W32 hash_of(W64 line);
+
+            W32  threshold() const { return threshold_; }
+            int  tracked() const { return lines_.count; }
+            const MRCStats& get_stats() const { return stats; }
+
+            void dump_configuration(YAML::Emitter &out) const;
+
+        private:
+            struct Line {
+                W64 time;
+                W32 hash;
+            };
+
+            Hashtable<W64, Line, 4096> lines_;
+            dynarray<int> tree_;
+            dynarray<W32> scratch_;
+
+            int lineBits_;
+            int maxLines_;
+            int sample_;
+            W32 threshold_;
+            W64 now_;
+
+            MRCStats stats;
+
+            void tree_add(W64 time, int delta);
+            int  tree_sum(W64 time) const;
+            W64  weight() const;
+
+            bool make_room(W32 hash, bool kernel);
+            void compact();
+            void record(W64 distance, bool cold, bool kernel);
+    };
+
+};
+
+#endif // MISS_RATIO_CURVE_H
@@ -34,75 +34,103 @@
 using namespace Memory;
 using namespace Memory::CoherentCache;
 
-void MOESILogic::handle_local_hit(CacheQueueEntry *queueEntry)
-{
-    MOESICacheLineState *state = (MOESICacheLineState*)(&queueEntry->line->state);
-    MOESICacheLineState oldState = *state;
-    OP_TYPE type = queueEntry->request->get_type();
-    bool k_req = queueEntry->request->is_kernel();
+#define I COH_S(MOESI_INVALID)
+#define M COH_S(MOESI_MODIFIED)
+#define O COH_S(MOESI_OWNER)
+#define E COH_S(MOESI_EXCLUSIVE)
+#define S COH_S(MOESI_SHARED)
 
-    N_STAT_UPDATE(hit_state, [oldState]++, k_req);
+#define LP     COH_LOWEST_PRIVATE
+#define NOT_LP COH_NOT_LOWEST_PRIVATE
+#define ANY    COH_ANY_LEVEL
 
-    if (type == MEMORY_OP_EVICT) {
-        *state = MOESI_INVALID;
-        controller->clear_entry_cb(queueEntry);
-        return;
-    }
+#define EVICT_ALL (COH_ACT_DIRECTORY | COH_ACT_INVALIDATE)
 
-	if (type == MEMORY_OP_UPDATE && oldState != MOESI_MODIFIED) {
-		/* If we receive update from upper cache and local cache line state
-		 * is not MODIFIED, then send the response down because cache update
-		 * must have been initiated from this level, or lower level cache. */
-		queueEntry->dest = controller->get_lower_cont();
-		queueEntry->sendTo = controller->get_lower_intrconn();
-		queueEntry->eventFlags[CACHE_WAIT_INTERCONNECT_EVENT]++;
-		controller->wait_interconnect_cb(queueEntry);
-		return;
-	}
-
-    switch (oldState) {
-        case MOESI_INVALID:
-            controller->cache_miss_cb(queueEntry);
-            break;
-
-        case MOESI_MODIFIED:
-            /* Local access on Modified line, no change */
-            send_response(queueEntry, queueEntry->sender);
-            break;
-
-        /* For Local hit Own/Exclusive/Shared does same thing,
-         * on READ no need to change anything,
-         * on WRITE evict from other caches. */
-        case MOESI_OWNER:
-        case MOESI_EXCLUSIVE:
-        case MOESI_SHARED:
-            if (type == MEMORY_OP_READ) {
-                send_response(queueEntry, queueEntry->sender);
-            } else if (type == MEMORY_OP_WRITE) {
-                if (controller->is_lowest_private()) {
-                    /* We need to update Directory, and directory
-                     * will send EVICT msg to other caches */
-                    queueEntry->dest = controller->get_directory();
-                    queueEntry->sendTo = controller->get_lower_intrconn();
-                    controller->wait_interconnect_cb(queueEntry);
-                } else {
-                    /* Change this line to invalid and treat it as
-                     * cache miss so lower cache can handle this
-                     * request properly. */
-                    *state = MOESI_INVALID;
-                    controller->cache_miss_cb(queueEntry);
-                }
-            }
-            break;
-
-        default:
-            memdebug("Invalid line state: " << oldState);
-            assert(0);
-    }
+/*
+ * MOESI transitions, first matching rule wins. A transition is counted
+ * in state_transition when it changes the line state.
+ */
+static const CoherenceRule moesi_rules[] = {
+    /* Local requests */
+    {COH_ANY_STATE, COH_E(COH_LOCAL_EVICT), ANY, MOESI_INVALID,
+        COH_ACT_CLEAR},
+    {M, COH_ANY_LOCAL, ANY, COH_STATE_SAME, COH_ACT_RESPOND},
+    /* Update from upper cache on a non-modified line must have been
+     * initiated from this level, or lower level cache, so send it down */
+    {COH_ANY_STATE, COH_E(COH_LOCAL_UPDATE), ANY, COH_STATE_SAME,
+        COH_ACT_FORWARD},
+    {I, COH_E(COH_LOCAL_READ) | COH_E(COH_LOCAL_WRITE), ANY, COH_STATE_SAME,
+        COH_ACT_MISS},
+    {O|E|S, COH_E(COH_LOCAL_READ), ANY, COH_STATE_SAME, COH_ACT_RESPOND},
+    /* Directory will send EVICT msg to other caches */
+    {O|E|S, COH_E(COH_LOCAL_WRITE), LP, COH_STATE_SAME,
+        COH_ACT_TO_DIRECTORY},
+    /* Treat it as miss so lower cache can handle this request properly */
+    {O|E|S, COH_E(COH_LOCAL_WRITE), NOT_LP, MOESI_INVALID,
+        COH_ACT_STAT | COH_ACT_MISS},
+
+    /* Requests from lower interconnect */
+    {COH_ANY_STATE, COH_E(COH_SNOOP_EVICT), NOT_LP, MOESI_INVALID,
+        COH_ACT_STAT_ALWAYS | COH_ACT_CLEAR},
+    {COH_ANY_STATE, COH_E(COH_SNOOP_UPDATE), NOT_LP, COH_STATE_FROM_ARG,
+        COH_ACT_STAT_ALWAYS | COH_ACT_CLEAR},
+    {I, COH_ANY_SNOOP, ANY, MOESI_INVALID,
+        COH_ACT_NO_DATA | EVICT_ALL | COH_ACT_STAT | COH_ACT_RESPOND_SRC,
+        MEMORY_OP_EVICT},
+    {M|O, COH_E(COH_SNOOP_READ), LP, MOESI_OWNER,
+        COH_ACT_SHARED | COH_ACT_UPDATE_UPPER | COH_ACT_STAT |
+            COH_ACT_RESPOND_SRC},
+    {M|O, COH_E(COH_SNOOP_READ), NOT_LP, MOESI_OWNER,
+        COH_ACT_SHARED | COH_ACT_STAT | COH_ACT_RESPOND_SRC},
+    /* No need to update directory when exclusive line becomes shared */
+    {E, COH_E(COH_SNOOP_READ), LP, MOESI_SHARED,
+        COH_ACT_SHARED | COH_ACT_UPDATE_UPPER | COH_ACT_STAT |
+            COH_ACT_RESPOND_SRC},
+    {E, COH_E(COH_SNOOP_READ), NOT_LP, MOESI_SHARED,
+        COH_ACT_SHARED | COH_ACT_STAT | COH_ACT_RESPOND_SRC},
+    {S, COH_E(COH_SNOOP_READ), ANY, COH_STATE_SAME,
+        COH_ACT_SHARED | COH_ACT_STAT | COH_ACT_RESPOND_SRC},
+    {M|O|E|S, COH_E(COH_SNOOP_WRITE), LP, MOESI_INVALID,
+        EVICT_ALL | COH_ACT_STAT | COH_ACT_RESPOND_SRC, MEMORY_OP_EVICT},
+    {M|O|E|S, COH_E(COH_SNOOP_WRITE), NOT_LP, MOESI_INVALID,
+        COH_ACT_STAT | COH_ACT_RESPOND_SRC},
+    /* Owner picks its new state from the update, see custom_transition */
+    {M|O, COH_E(COH_SNOOP_UPDATE), LP, COH_STATE_SAME,
+        COH_ACT_CUSTOM | COH_ACT_STAT | COH_ACT_RESPOND_SRC},
+    {E|S, COH_E(COH_SNOOP_UPDATE), LP, COH_STATE_FROM_ARG,
+        COH_ACT_CLEAR | COH_ACT_STAT | COH_ACT_RESPOND_SRC},
+    {M|O|E|S, COH_E(COH_SNOOP_EVICT), LP, MOESI_INVALID,
+        COH_ACT_INVALIDATE | COH_ACT_STAT | COH_ACT_RESPOND_SRC},
+
+    /* Responses to our own miss in lowest private cache. On read access
+     * a valid line is never treated as miss, so it must be a write. */
+    {I, COH_E(COH_FILL_SHARED_READ), LP, MOESI_SHARED, COH_ACT_STAT},
+    {I, COH_E(COH_FILL_READ), LP, MOESI_EXCLUSIVE, COH_ACT_STAT},
+    {I, COH_E(COH_FILL_WRITE), LP, MOESI_MODIFIED, COH_ACT_STAT},
+    {I, COH_E(COH_FILL_EVICT), LP, MOESI_INVALID, COH_ACT_STAT},
+    {O|E|S, COH_E(COH_FILL_WRITE) | COH_E(COH_FILL_SHARED_WRITE), LP,
+        MOESI_MODIFIED, COH_ACT_STAT},
+};
 
-    if (oldState != *state) {
-        UPDATE_MOESI_TRANS_STATS(oldState, *state, k_req);
-    }
+#undef I
+#undef M
+#undef O
+#undef E
+#undef S
+#undef LP
+#undef NOT_LP
+#undef ANY
+#undef EVICT_ALL
+
+const CoherenceTable MOESILogic::table("MOESI", NUM_MOESI_STATES,
+        moesi_rules, lengthof(moesi_rules));
+
+void MOESILogic::handle_local_hit(CacheQueueEntry *queueEntry)
+{
+    N_STAT_UPDATE(hit_state, [queueEntry->line->state]++,
+            queueEntry->request->is_kernel());
+
+    execute_transition(queueEntry, COH_LOCAL);
 }
 
 void MOESILogic::handle_local_miss(CacheQueueEntry *queueEntry)
@@ -126,132 +154,24 @@ void MOESILogic::handle_local_miss(CacheQueueEntry *queueEntry)
 
 void MOESILogic::handle_interconn_hit(CacheQueueEntry *queueEntry)
 {
-    MOESICacheLineState *state = (MOESICacheLineState*)(&queueEntry->line->state);
-    MOESICacheLineState oldState = *state;
-    OP_TYPE type = queueEntry->request->get_type();
-    bool k_req = queueEntry->request->is_kernel();
-
-    // By default we mark the queueEntry's shared flat to false
-    queueEntry->isShared     = false;
-    queueEntry->responseData = true;
-
     memdebug("MOESI:: Interconn Hit: " << *queueEntry << endl);
 
-    assert(type != MEMORY_OP_WRITE);
+    assert(queueEntry->request->get_type() != MEMORY_OP_WRITE);
 
-    if (!controller->is_lowest_private() && type == MEMORY_OP_EVICT) {
-        *state = MOESI_INVALID;
-        UPDATE_MOESI_TRANS_STATS(oldState, *state, k_req);
-        controller->clear_entry_cb(queueEntry);
-        return;
-    }
-
-    if (!controller->is_lowest_private() && type == MEMORY_OP_UPDATE) {
-        *state = *(MOESICacheLineState*)(queueEntry->m_arg);
-        UPDATE_MOESI_TRANS_STATS(oldState, *state, k_req);
-        controller->clear_entry_cb(queueEntry);
-        return;
-    }
-
-    switch (oldState) {
-        case MOESI_INVALID:
-            *state = MOESI_INVALID;
-            queueEntry->line = NULL;
-            queueEntry->responseData = false;
-            send_evict(queueEntry, -1, 1);
-            break;
-
-        case MOESI_MODIFIED:
-        case MOESI_OWNER:
-            if (type == MEMORY_OP_READ) {
-                *state = MOESI_OWNER;
-                queueEntry->isShared = true;
-
-                if (controller->is_lowest_private())
-                    controller->send_update_to_upper(queueEntry);
-            } else if (type == MEMORY_OP_WRITE) {
-                *state = MOESI_INVALID;
-
-                if (controller->is_lowest_private())
-                    send_evict(queueEntry, -1, 1);
-
-            } else if (type == MEMORY_OP_UPDATE) {
-                if (controller->is_lowest_private()) {
-                    /* In case of multiple directory controllers we
-                     * check if message argument is not set to this
-                     * controller then we need to update lower level
-                     * cache.  */
-                    if (queueEntry->sender ==
-                            controller->get_lower_intrconn()) {
-                        if (queueEntry->m_arg == this) {
-                            *state = MOESI_OWNER;
-                        } else {
-                            *state = MOESI_SHARED;
-                        }
-                        controller->send_update_to_upper(queueEntry);
-                    }
-                } else {
-                    *state = *(MOESICacheLineState*)(queueEntry->m_arg);
-                }
-            } else if (type == MEMORY_OP_EVICT) {
-                *state = MOESI_INVALID;
-                if (controller->is_lowest_private()) {
-                    send_evict(queueEntry);
-                }
-            }
-            break;
-
-        case MOESI_EXCLUSIVE:
-            if (type == MEMORY_OP_READ) {
-                /* In this case we dont need to update directory. */
-                *state = MOESI_SHARED;
-                queueEntry->isShared = true;
-                if (controller->is_lowest_private())
-                    controller->send_update_to_upper(queueEntry);
-            } else if (type == MEMORY_OP_WRITE) {
-                *state = MOESI_INVALID;
-                if (controller->is_lowest_private())
-                    send_evict(queueEntry, -1, 1);
-            } else if (type == MEMORY_OP_UPDATE) {
-                *state = *(MOESICacheLineState*)(queueEntry->m_arg);
-                controller->clear_entry_cb(queueEntry);
-            } else if (type == MEMORY_OP_EVICT) {
-                *state = MOESI_INVALID;
-                if (controller->is_lowest_private())
-                    send_evict(queueEntry);
-            }
-            break;
-
-        case MOESI_SHARED:
-            if (type == MEMORY_OP_READ) {
-                queueEntry->isShared = true;
-            } else if (type == MEMORY_OP_WRITE) {
-                *state = MOESI_INVALID;
-                if(controller->is_lowest_private())
-                    send_evict(queueEntry, -1, 1);
-            } else if (type == MEMORY_OP_UPDATE) {
-                *state = *(MOESICacheLineState*)(queueEntry->m_arg);
-                controller->clear_entry_cb(queueEntry);
-            } else if (type == MEMORY_OP_EVICT) {
-                *state = MOESI_INVALID;
-                if (controller->is_lowest_private())
-                    send_evict(queueEntry);
-            }
-            break;
-
-        default:
-            memdebug("Invalid line state: " << oldState);
-            assert(0);
-    }
+    execute_transition(queueEntry, COH_SNOOP);
+}
 
-    if (oldState != *state) {
-        UPDATE_MOESI_TRANS_STATS(oldState, *state, k_req);
+int MOESILogic::custom_transition(CacheQueueEntry *queueEntry, int state)
+{
+    /* In case of multiple directory controllers we check if message
+     * argument is not set to this controller then we need to update
+     * lower level cache.  */
+    if (queueEntry->sender == controller->get_lower_intrconn()) {
+        state = (queueEntry->m_arg == this) ? MOESI_OWNER : MOESI_SHARED;
+        controller->send_update_to_upper(queueEntry);
     }
 
-    /* send back the response */
-    queueEntry->sendTo = queueEntry->sender;
-    queueEntry->dest = queueEntry->source;
-    controller->wait_interconnect_cb(queueEntry);
+    return state;
 }
 
 void MOESILogic::handle_interconn_miss(CacheQueueEntry *queueEntry)
@@ -289,8 +209,8 @@ void MOESILogic::handle_cache_insert(CacheQueueEntry *queueEntry,
      * we need to write-back to lower cache. Also send msg to
      * directory that we have evicted a cache line if line is valid. */
 
-    MOESICacheLineState *state = (MOESICacheLineState*)(&queueEntry->line->state);
-    MOESICacheLineState oldState = *state;
+    W8 *state = &queueEntry->line->state;
+    MOESICacheLineState oldState = (MOESICacheLineState)(*state);
 
     if (oldTag != InvalidTag<W64>::INVALID && oldTag != (W64)-1) {
         if (oldState != MOESI_INVALID) {
@@ -309,74 +229,22 @@ void MOESILogic::handle_cache_insert(CacheQueueEntry *queueEntry,
 void MOESILogic::complete_request(CacheQueueEntry *queueEntry,
         Message &message)
 {
-    MOESICacheLineState *state = (MOESICacheLineState*)(&queueEntry->line->state);
-    MOESICacheLineState oldState = *state;
-    OP_TYPE type = queueEntry->request->get_type();
-    bool k_req = queueEntry->request->is_kernel();
-    bool isShared = message.isShared;
-
-    if (controller->is_lowest_private()) {
-        /* We have received our cache request. Based on old state
-         * and shared variable find out the new state. */
-        switch (oldState) {
-            case MOESI_INVALID:
-                if (isShared) {
-                    if (type == MEMORY_OP_READ) {
-                        *state = MOESI_SHARED;
-                    } else {
-                        // Other states are not possible
-                        assert(0);
-                    }
-                } else {
-                    switch (type) {
-                        case MEMORY_OP_READ:
-                            *state = MOESI_EXCLUSIVE; break;
-                        case MEMORY_OP_WRITE:
-                            *state = MOESI_MODIFIED; break;
-                        case MEMORY_OP_EVICT:
-                            *state = MOESI_INVALID; break;
-                        default: assert(0);
-                    }
-                }
-                break;
-
-            case MOESI_MODIFIED:
-                memoryHierarchy->get_machine().dump_state(ptl_logfile);
-                assert(0);
-
-            case MOESI_OWNER:
-            case MOESI_EXCLUSIVE:
-            case MOESI_SHARED:
-                /* On read access we dont need to treat it as cache miss
-                 * so this request must be write access.*/
-                if (type == MEMORY_OP_WRITE)
-                    *state = MOESI_MODIFIED;
-                else  {
-                    memoryHierarchy->get_machine().dump_state(ptl_logfile);
-                    assert(0);
-                }
-                break;
-
-            default:
-                memdebug("Invalid line state: " << oldState);
-                assert(0);
-        }
+    complete_fill(queueEntry, message, MOESI_EXCLUSIVE);
+}
 
-        if (oldState != *state) {
-            UPDATE_MOESI_TRANS_STATS(oldState, *state, k_req);
-        }
+void MOESILogic::invalid_transition(CacheQueueEntry *queueEntry, int event)
+{
+    /* A valid line is only refilled on write access */
+    if (event >= COH_FILL_READ && queueEntry->line->state != MOESI_INVALID)
+        memoryHierarchy->get_machine().dump_state(ptl_logfile);
 
-    } else {
-        if (message.request->get_type() == MEMORY_OP_EVICT) {
-            queueEntry->line->state = MOESI_INVALID;
-        } else if (controller->is_private()) {
-            /* Message's argument holds correct line state */
-            *state = *(MOESICacheLineState*)message.arg;
-        } else {
-            /* Its a shared cache */
-            *state = MOESI_EXCLUSIVE;
-        }
-    }
+    CoherenceLogic::invalid_transition(queueEntry, event);
+}
+
+void MOESILogic::update_transition_stats(int oldState, int newState,
+        bool kernel)
+{
+    UPDATE_MOESI_TRANS_STATS(oldState, newState, kernel);
 }
 
 void MOESILogic::invalidate_line(CacheLine *line)
@@ -438,7 +306,7 @@ void MOESILogic::send_to_cont(CacheQueueEntry *queueEntry,
         Interconnect *sendTo, Controller *dest)
 {
     queueEntry->dest = dest;
-    queueEntry->request->get_history() << "{MOESI} ";
+    ADD_HISTORY(queueEntry->request, "{MOESI} ");
 
     send_response(queueEntry, sendTo);
 }
@@ -77,7 +77,8 @@ namespace CoherentCache {
         public:
             MOESILogic(CacheController *cont, Statable *parent,
                     MemoryHierarchy *mem_hierarchy)
-                : CoherenceLogic("moesi", cont, parent, mem_hierarchy)
+                : CoherenceLogic("moesi", cont, parent, mem_hierarchy,
+                        &table)
                   , state_transition("state_trans", this)
                   , miss_state("miss_state", this, MOESIStateNames)
                   , hit_state("hit_state", this, MOESIStateNames)
@@ -105,6 +106,13 @@ namespace CoherentCache {
                     bool with_directory=0);
             void send_update(CacheQueueEntry *queueEntry, W64 oldTag=-1);
 
+            int custom_transition(CacheQueueEntry *queueEntry, int state);
+            void invalid_transition(CacheQueueEntry *queueEntry, int event);
+            void update_transition_stats(int oldState, int newState,
+                    bool kernel);
+
+            static const CoherenceTable table;
+
             /* Statistics */
             StatArray<W64,NUM_MOESI_STATE_TRANS> state_transition;
             StatArray<W64, NUM_MOESI_STATES> miss_state;
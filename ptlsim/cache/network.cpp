@@ -0,0 +1,525 @@
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <network.h>
+#include <memoryHierarchy.h>
+
+#include <machine.h>
+
+using namespace Memory;
+using namespace Memory::NetworkInterconnect;
+
+Network::Network(const char *name, MemoryHierarchy *memoryHierarchy)
+    : Interconnect(name, memoryHierarchy)
+    , tiles_(0)
+    , ports_(0)
+    , numLinks_(0)
+    , lastCycle_(0)
+{
+    BaseMachine &machine = memoryHierarchy_->get_machine();
+
+    memoryHierarchy_->add_interconnect(this);
+
+    new_stats = new NetworkStats(name, &machine);
+
+    SET_SIGNAL_CB(name, "_advance", advance_, &Network::advance_cb);
+
+    int line_size = 64;
+
+    linkWidth_   = 16;
+    routerDelay_ = 2;
+    linkLatency_ = 1;
+    vcs_         = 4;
+    injectQueue_ = 16;
+
+    machine.get_option(name, "link_width", linkWidth_);
+    machine.get_option(name, "line_size", line_size);
+    machine.get_option(name, "router_delay", routerDelay_);
+    machine.get_option(name, "link_latency", linkLatency_);
+    machine.get_option(name, "vcs", vcs_);
+    machine.get_option(name, "inject_queue", injectQueue_);
+    machine.get_option(name, "tile_map", tileMap_);
+
+    linkWidth_   = max(linkWidth_, 1);
+    routerDelay_ = max(routerDelay_, 1);
+    linkLatency_ = max(linkLatency_, 1);
+    vcs_         = max(vcs_, 1);
+    injectQueue_ = max(injectQueue_, 1);
+    vcsPerClass_ = vcs_;
+
+    dataFlits_ = (line_size + linkWidth_ - 1) / linkWidth_;
+}
+
+Network::~Network()
+{
+    delete new_stats;
+}
+
+void Network::setup_links(int tiles, int ports)
+{
+    Link none;
+    memset(&none, 0, sizeof(none));
+    none.to = -1;
+
+    tiles_ = max(tiles, 1);
+    ports_ = ports;
+
+    links_.resize(tiles_ * ports_, none);
+    injectUsed_.resize(tiles_, 0);
+}
+
+void Network::add_link(int from, int port, int to, bool wrap)
+{
+    Link &link = links_[from * ports_ + port];
+
+    link.to   = to;
+    link.wrap = wrap;
+    numLinks_++;
+}
+
+/**
+ * @brief Tile of a controller, from 'tile_map' or else its core id
+ *
+ * @param controller Controller connected to this network
+ */
+int Network::find_tile(Controller *controller)
+{
+    const char *name = controller->get_name();
+    int len = strlen(name);
+    const char *p = tileMap_.buf;
+
+    while (p && *p) {
+        while (*p == ' ' || *p == ',')
+            p++;
+
+        if (strncmp(p, name, len) == 0 && p[len] == ':') {
+            int tile = atoi(p + len + 1);
+            if (tile < 0 || tile >= tiles_) {
+                stringbuf err;
+                err << "::ERROR::Tile ", tile, " of controller ", name,
+                    " is outside network ", get_name(), endl;
+                ptl_logfile << err;
+                cout << err;
+                assert(0);
+            }
+            return tile;
+        }
+
+        p = strpbrk(p, " ,");
+    }
+
+    return controller->idx % tiles_;
+}
+
+void Network::register_controller(Controller *controller)
+{
+    tileOf_.add((W64)controller, find_tile(controller));
+    controllers_.push(controller);
+}
+
+int Network::get_tile(Controller *cont)
+{
+    int *tile = tileOf_.get((W64)cont);
+
+    if (!tile) {
+        stringbuf err;
+        err << "::ERROR::Network ", get_name(),
+            " can only deliver to a connected controller", endl;
+        ptl_logfile << err;
+        cout << err;
+        assert(tile);
+    }
+
+    return *tile;
+}
+
+int Network::access_fast_path(Controller *controller,
+        MemoryRequest *request)
+{
+    return -1;
+}
+
+/*
+ * Annuled packets still travel to their destination so the virtual
+ * channels they hold are released in order, they are dropped there.
+ */
+void Network::annul_request(MemoryRequest *request)
+{
+    Packet *packet;
+    foreach_list_mutable (packets_.list(), packet, entry_t, nextentry_t) {
+        if (packet->request->is_same(request))
+            packet->annuled = true;
+    }
+}
+
+bool Network::controller_request_cb(void *arg)
+{
+    Message *msg = (Message*)arg;
+    Controller *sender = (Controller*)msg->sender;
+    int src = get_tile(sender);
+    bool kernel = msg->request->is_kernel();
+
+    if (injectUsed_[src] >= injectQueue_ || packets_.isFull()) {
+        N_STAT_UPDATE(new_stats->inject_full, ++, kernel);
+        return false;
+    }
+
+    Packet *packet = packets_.alloc();
+    packet->setup(*msg);
+    ADD_HISTORY_ADD(packet->request);
+
+    packet->src_router  = src;
+    packet->router      = src;
+    packet->dest_router = get_tile((Controller*)msg->dest);
+    packet->flits       = msg->hasData ? 1 + dataFlits_ : 1;
+    packet->injected    = sim_cycle;
+
+    injectUsed_[src]++;
+
+    marss_add_event(&advance_, routerDelay_, packet);
+
+    return true;
+}
+
+/**
+ * @brief Move a packet that went through its current router pipeline
+ *
+ * The packet is delivered if it reached its destination tile, otherwise
+ * it gets a virtual channel on its output link and is sent, or it waits
+ * in the link's queue until a channel is released.
+ */
+bool Network::advance_cb(void *arg)
+{
+    Packet *packet = (Packet*)arg;
+    packet->wake_pending = false;
+
+    if (packet->router == packet->dest_router) {
+        deliver(packet);
+        return true;
+    }
+
+    bool kernel = packet->request->is_kernel();
+    int link_idx = route(packet->router, packet->dest_router);
+    Link &link = links_[link_idx];
+    int vc_class = link.wrap ? 1 : packet->vc_class;
+
+    assert(link.to >= 0);
+
+    /* Waiting packets get channels in arrival order */
+    Packet *head = link.wait_head[vc_class];
+    if ((head && head != packet) ||
+            link.vcs_used[vc_class] >= vcsPerClass_) {
+        if (!packet->queued) {
+            packet->queued = true;
+            packet->next_wait = NULL;
+            if (link.wait_tail[vc_class])
+                link.wait_tail[vc_class]->next_wait = packet;
+            else
+                link.wait_head[vc_class] = packet;
+            link.wait_tail[vc_class] = packet;
+            N_STAT_UPDATE(new_stats->vc_stalls, ++, kernel);
+        }
+        return true;
+    }
+
+    if (packet->queued) {
+        link.wait_head[vc_class] = packet->next_wait;
+        if (!packet->next_wait)
+            link.wait_tail[vc_class] = NULL;
+        packet->queued = false;
+        packet->next_wait = NULL;
+    }
+
+    /* Leaving the current channel lets the next packet behind us in */
+    release(packet);
+
+    link.vcs_used[vc_class]++;
+
+    /* Several channels may have been freed while the head waited */
+    if (link.vcs_used[vc_class] < vcsPerClass_)
+        wake(link, vc_class);
+
+    packet->held_link = link_idx;
+    packet->vc_class = vc_class;
+    packet->router = link.to;
+    packet->hops++;
+
+    W64 start = max(sim_cycle, link.free_at);
+    link.free_at = start + packet->flits;
+
+    if (sim_cycle > lastCycle_) {
+        N_STAT_UPDATE(new_stats->link_cycles,
+                += (sim_cycle - lastCycle_) * numLinks_, kernel);
+        lastCycle_ = sim_cycle;
+    }
+
+    N_STAT_UPDATE(new_stats->link_busy, += packet->flits, kernel);
+    if (link_idx < NOC_MAX_LINKS) {
+        N_STAT_UPDATE(new_stats->link_flits, [link_idx] += packet->flits,
+                kernel);
+    }
+
+    /* Head reaches the next router, at the destination wait for the tail */
+    W64 delay = (start - sim_cycle) + linkLatency_ + routerDelay_;
+    if (packet->router == packet->dest_router)
+        delay += packet->flits - 1;
+
+    marss_add_event(&advance_, delay, packet);
+
+    return true;
+}
+
+void Network::deliver(Packet *packet)
+{
+    bool kernel = packet->request->is_kernel();
+
+    if (packet->annuled) {
+        release(packet);
+        free_packet(packet);
+        return;
+    }
+
+    Message *msg = memoryHierarchy_->get_message();
+    msg->sender = this;
+    packet->fill(*msg);
+
+    bool success = packet->dest->get_interconnect_signal()->emit(msg);
+
+    memoryHierarchy_->free_message(msg);
+
+    memdebug("Network ", get_name(), " delivered: ", success, " ",
+            *packet, endl);
+
+    if (!success) {
+        /* Keep the channel, destination will be retried */
+        N_STAT_UPDATE(new_stats->eject_retry, ++, kernel);
+        marss_add_event(&advance_, 1, packet);
+        return;
+    }
+
+    N_STAT_UPDATE(new_stats->packets, ++, kernel);
+    N_STAT_UPDATE(new_stats->flits, += packet->flits, kernel);
+    N_STAT_UPDATE(new_stats->hops, += packet->hops, kernel);
+    N_STAT_UPDATE(new_stats->latency, += sim_cycle - packet->injected,
+            kernel);
+    if (packet->has_data) {
+        N_STAT_UPDATE(new_stats->data_packets, ++, kernel);
+    }
+
+    release(packet);
+    free_packet(packet);
+}
+
+/* Free the channel or injection queue slot the packet holds */
+void Network::release(Packet *packet)
+{
+    if (packet->held_link < 0) {
+        injectUsed_[packet->src_router]--;
+        return;
+    }
+
+    Link &link = links_[packet->held_link];
+    link.vcs_used[packet->vc_class]--;
+    wake(link, packet->vc_class);
+}
+
+void Network::wake(Link &link, int vc_class)
+{
+    Packet *head = link.wait_head[vc_class];
+
+    if (head && !head->wake_pending) {
+        head->wake_pending = true;
+        marss_add_event(&advance_, 1, head);
+    }
+}
+
+void Network::free_packet(Packet *packet)
+{
+    packet->request->decRefCounter();
+    ADD_HISTORY_REM(packet->request);
+    packets_.free(packet);
+}
+
+void Network::print(ostream& os) const
+{
+    os << "--", get_type(), "-Interconnect: ", get_name(), endl;
+    os << "Packets in flight: ", packets_.count(), endl;
+    os << packets_;
+    os << "--End-", get_type(), "-Interconnect\n";
+}
+
+void Network::print_map(ostream& os)
+{
+    os << get_type(), " Interconnect: ", get_name(), endl;
+    os << "\tconnected to: ", endl;
+
+    foreach (i, controllers_.count()) {
+        os << "\t\tcontroller[", i, "]: ";
+        os << controllers_[i]->get_name(), " tile ",
+           get_tile(controllers_[i]), endl;
+    }
+}
+
+/**
+ * @brief Dump Network Interconnect Configuration in YAML Format
+ *
+ * @param out YAML Object
+ */
+void Network::dump_configuration(YAML::Emitter &out) const
+{
+    out << YAML::Key << get_name() << YAML::Value << YAML::BeginMap;
+
+    YAML_KEY_VAL(out, "type", "interconnect");
+    YAML_KEY_VAL(out, "topology", get_type());
+    dump_topology(out);
+    YAML_KEY_VAL(out, "tiles", tiles_);
+    YAML_KEY_VAL(out, "links", numLinks_);
+    YAML_KEY_VAL(out, "link_width", linkWidth_);
+    YAML_KEY_VAL(out, "data_flits", dataFlits_);
+    YAML_KEY_VAL(out, "router_delay", routerDelay_);
+    YAML_KEY_VAL(out, "link_latency", linkLatency_);
+    YAML_KEY_VAL(out, "vcs", vcs_);
+    YAML_KEY_VAL(out, "inject_queue", injectQueue_);
+
+    out << YAML::Key << "tile_map" << YAML::Value << YAML::BeginMap;
+    foreach (i, controllers_.count()) {
+        int *tile = tileOf_.get((W64)controllers_[i]);
+        YAML_KEY_VAL(out, controllers_[i]->get_name(), (tile ? *tile : -1));
+    }
+    out << YAML::EndMap;
+
+    out << YAML::EndMap;
+}
+
+/* Mesh */
+
+Mesh::Mesh(const char *name, MemoryHierarchy *memoryHierarchy)
+    : Network(name, memoryHierarchy)
+{
+    BaseMachine &machine = memoryHierarchy_->get_machine();
+    int cores = max((int)machine.get_num_cores(), 1);
+
+    width_ = 1;
+    while (width_ * width_ < cores)
+        width_++;
+    height_ = (cores + width_ - 1) / width_;
+
+    machine.get_option(name, "width", width_);
+    machine.get_option(name, "height", height_);
+    width_  = max(width_, 1);
+    height_ = max(height_, 1);
+
+    setup_links(width_ * height_, MESH_PORTS);
+
+    foreach (y, height_) {
+        foreach (x, width_) {
+            int r = y * width_ + x;
+            if (x + 1 < width_)  add_link(r, EAST, r + 1);
+            if (x > 0)           add_link(r, WEST, r - 1);
+            if (y + 1 < height_) add_link(r, SOUTH, r + width_);
+            if (y > 0)           add_link(r, NORTH, r - width_);
+        }
+    }
+}
+
+/* XY routing: first along the row, then along the column */
+int Mesh::route(int router, int dest_router) const
+{
+    int x  = router % width_;
+    int y  = router / width_;
+    int dx = dest_router % width_;
+    int dy = dest_router / width_;
+    int port;
+
+    if (dx > x)
+        port = EAST;
+    else if (dx < x)
+        port = WEST;
+    else if (dy > y)
+        port = SOUTH;
+    else
+        port = NORTH;
+
+    return router * MESH_PORTS + port;
+}
+
+void Mesh::dump_topology(YAML::Emitter &out) const
+{
+    YAML_KEY_VAL(out, "width", width_);
+    YAML_KEY_VAL(out, "height", height_);
+}
+
+/* Ring */
+
+Ring::Ring(const char *name, MemoryHierarchy *memoryHierarchy)
+    : Network(name, memoryHierarchy)
+{
+    BaseMachine &machine = memoryHierarchy_->get_machine();
+    int tiles = machine.get_num_cores();
+
+    machine.get_option(name, "tiles", tiles);
+    tiles = max(tiles, 1);
+
+    /* Half of the channels are for packets past the dateline */
+    vcsPerClass_ = max(vcs_ / 2, 1);
+
+    setup_links(tiles, RING_PORTS);
+
+    if (tiles == 1)
+        return;
+
+    foreach (r, tiles) {
+        int next = (r + 1) % tiles;
+        int prev = (r + tiles - 1) % tiles;
+        add_link(r, CLOCKWISE, next, next == 0);
+        add_link(r, COUNTER_CLOCKWISE, prev, r == 0);
+    }
+}
+
+int Ring::route(int router, int dest_router) const
+{
+    int distance = (dest_router - router + tiles_) % tiles_;
+    int port = (distance <= tiles_ / 2) ? CLOCKWISE : COUNTER_CLOCKWISE;
+
+    return router * RING_PORTS + port;
+}
+
+void Ring::dump_topology(YAML::Emitter &out) const
+{
+}
+
+/* Builders */
+
+struct MeshBuilder : public InterconnectBuilder
+{
+    MeshBuilder(const char *name) :
+        InterconnectBuilder(name)
+    { }
+
+    Interconnect* get_new_interconnect(MemoryHierarchy &mem,
+            const char *name)
+    {
+        return new Mesh(name, &mem);
+    }
+};
+
+MeshBuilder meshBuilder("mesh");
+
+struct RingBuilder : public InterconnectBuilder
+{
+    RingBuilder(const char *name) :
+        InterconnectBuilder(name)
+    { }
+
+    Interconnect* get_new_interconnect(MemoryHierarchy &mem,
+            const char *name)
+    {
+        return new Ring(name, &mem);
+    }
+};
+
+RingBuilder ringBuilder("ring");
@@ -0,0 +1,258 @@
+
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <interconnect.h>
+#include <memoryStats.h>
+#include <superstl.h>
+
+namespace Memory {
+
+namespace NetworkInterconnect {
+
+    /**
+     * @brief A message travelling through a mesh or ring network
+     *
+     * The packet occupies one virtual channel of the link it arrived on
+     * (or an injection queue slot at its source tile) until it moves on
+     * to the next link or is delivered.
+     */
+    struct Packet : public FixStateListObject
+    {
+        MemoryRequest *request;
+        Controller    *source;
+        Controller    *dest;
+        void          *m_arg;
+        bool           has_data;
+        bool           shared;
+        bool           annuled;
+
+        int            flits;
+        int            src_router;
+        int            router;       // router the packet is at
+        int            dest_router;
+        int            held_link;    // -1 while in the injection queue
+        int            vc_class;
+        int            hops;
+        W64            injected;
+
+        bool           queued;       // waiting for a virtual channel
+        bool           wake_pending;
+        Packet        *next_wait;
+
+        void init() {
+            request      = NULL;
+            source       = NULL;
+            dest         = NULL;
+            m_arg        = NULL;
+            has_data     = 0;
+            shared       = 0;
+            annuled      = 0;
+            flits        = 1;
+            src_router   = 0;
+            router       = 0;
+            dest_router  = 0;
+            held_link    = -1;
+            vc_class     = 0;
+            hops         = 0;
+            injected     = 0;
+            queued       = 0;
+            wake_pending = 0;
+            next_wait    = NULL;
+        }
+
+        void setup(const Message &msg) {
+            source   = (Controller*)msg.sender;
+            dest     = (Controller*)msg.dest;
+            request  = msg.request;
+            m_arg    = msg.arg;
+            has_data = msg.hasData;
+            shared   = msg.isShared;
+            request->incRefCounter();
+        }
+
+        void fill(Message &msg) const {
+            msg.origin   = source;
+            msg.dest     = dest;
+            msg.request  = request;
+            msg.arg      = m_arg;
+            msg.hasData  = has_data;
+            msg.isShared = shared;
+        }
+
+        ostream& print(ostream& os) const {
+            if (!request) {
+                os << "Free packet";
+                return os;
+            }
+
+            os << "request[", *request, "] ";
+            os << "source[", source->get_name(), "] ";
+            os << "dest[", dest->get_name(), "] ";
+            os << "router[", router, "->", dest_router, "] ";
+            os << "flits[", flits, "] ";
+            os << "hops[", hops, "] ";
+            os << "queued[", queued, "] ";
+            os << "annuled[", annuled, "]";
+            return os;
+        }
+    };
+
+    static inline ostream& operator <<(ostream& os, const Packet &packet)
+    {
+        return packet.print(os);
+    }
+
+    /**
+     * @brief One direction of a connection between two routers
+     *
+     * free_at is the first cycle the link can start sending another
+     * packet; a packet of N flits keeps it busy for N cycles. Virtual
+     * channels are split in two classes so the ring can use a dateline,
+     * each class has its own queue of packets waiting for a channel.
+     */
+    struct Link {
+        int     to;         // -1 if the link doesn't exist
+        bool    wrap;       // crosses the ring's dateline
+        W64     free_at;
+        int     vcs_used[2];
+        Packet *wait_head[2];
+        Packet *wait_tail[2];
+    };
+
+    /**
+     * @brief Base of the packet switched on-chip networks
+     *
+     * Each controller is attached to the router of one tile. A message
+     * becomes a packet of one flit, or one header flit plus the cache
+     * line split in link_width sized flits when it carries data. Every
+     * hop costs the router pipeline plus the link latency, and a link
+     * sends one flit per cycle. Work is done per packet hop so the
+     * simulation cost does not depend on the number of tiles.
+     *
+     * Options (on the interconnect in the machine configuration):
+     *   link_width:    bytes per flit (16)
+     *   line_size:     bytes of data in a message (64)
+     *   router_delay:  router pipeline depth in cycles (2)
+     *   link_latency:  cycles (1)
+     *   vcs:           virtual channels per link (4)
+     *   inject_queue:  packets each tile can have waiting to enter (16)
+     *   tile_map:      "NAME:TILE ...", separated by spaces or commas,
+     *                  other controllers use the tile of their core id
+     */
+    class Network : public Interconnect
+    {
+        public:
+            Network(const char *name, MemoryHierarchy *memoryHierarchy);
+            virtual ~Network();
+
+            bool controller_request_cb(void *arg);
+            void register_controller(Controller *controller);
+            int  access_fast_path(Controller *controller,
+                    MemoryRequest *request);
+            void annul_request(MemoryRequest *request);
+            int  get_delay() { return routerDelay_ + linkLatency_; }
+            void dump_configuration(YAML::Emitter &out) const;
+
+            bool advance_cb(void *arg);
+
+            int get_tile(Controller *cont);
+
+            void print(ostream& os) const;
+            void print_map(ostream& os);
+
+        protected:
+            /* Index in links_ of the output link towards dest_router */
+            virtual int route(int router, int dest_router) const = 0;
+            virtual const char* get_type() const = 0;
+            virtual void dump_topology(YAML::Emitter &out) const = 0;
+
+            void setup_links(int tiles, int ports);
+            void add_link(int from, int port, int to, bool wrap = false);
+            Link get_link(int idx) const { return links_[idx]; }
+
+            int tiles_;
+            int ports_;
+            int vcsPerClass_;
+            int vcs_;
+
+        private:
+            Signal advance_;
+
+            dynarray<Link> links_;
+            int numLinks_;
+
+            dynarray<Controller*> controllers_;
+            Hashtable<W64, int, 64> tileOf_;
+            stringbuf tileMap_;
+
+            FixStateList<Packet, NOC_PACKETS> packets_;
+            dynarray<int> injectUsed_;
+
+            int linkWidth_;
+            int dataFlits_;
+            int routerDelay_;
+            int linkLatency_;
+            int injectQueue_;
+
+            W64 lastCycle_;
+
+            NetworkStats *new_stats;
+
+            void deliver(Packet *packet);
+            void release(Packet *packet);
+            void wake(Link &link, int vc_class);
+            void free_packet(Packet *packet);
+            int  find_tile(Controller *controller);
+    };
+
+    /**
+     * @brief 2D mesh with dimension order (XY) routing
+     *
+     * Tiles are numbered row by row. Options 'width' and 'height', by
+     * default the smallest near square grid that has a tile per core.
+     */
+    class Mesh : public Network
+    {
+        public:
+            Mesh(const char *name, MemoryHierarchy *memoryHierarchy);
+
+        protected:
+            int route(int router, int dest_router) const;
+            const char* get_type() const { return "mesh"; }
+            void dump_topology(YAML::Emitter &out) const;
+
+        private:
+            enum { EAST = 0, WEST, SOUTH, NORTH, MESH_PORTS };
+
+            int width_;
+            int height_;
+    };
+
+    /**
+     * @brief Bidirectional ring, packets take the shorter direction
+     *
+     * Option 'tiles', by default one per core. Packets switch to the
+     * second class of virtual channels when they cross the dateline
+     * between the last and the first tile, which keeps the ring free of
+     * deadlocks.
+     */
+    class Ring : public Network
+    {
+        public:
+            Ring(const char *name, MemoryHierarchy *memoryHierarchy);
+
+        protected:
+            int route(int router, int dest_router) const;
+            const char* get_type() const { return "ring"; }
+            void dump_topology(YAML::Emitter &out) const;
+
+        private:
+            enum { CLOCKWISE = 0, COUNTER_CLOCKWISE, RING_PORTS };
+    };
+
+};
+
+};
+
+#endif // NETWORK_H
@@ -0,0 +1,335 @@
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <prefetcher.h>
+#include <memoryStats.h>
+
+#include <machine.h>
+
+using namespace Memory;
+
+Prefetcher::Prefetcher(const char *name, Statable *parent,
+        const PrefetcherConfig &config)
+    : config(config)
+    , degree(max(config.degree, 1))
+    , name(name)
+    , stats("prefetch", parent)
+    , queue_head(0)
+    , queue_count(0)
+    , inflight(0)
+    , trigger_page(0)
+    , trigger_kernel(false)
+    , interval_issued(0)
+    , interval_useful(0)
+{
+    Tracked empty = {0, PF_FREE, false, false};
+
+    queue.resize(max(config.queue_size, 1));
+    tracker.resize(max(config.filter_size, 1), empty);
+}
+
+Prefetcher::~Prefetcher()
+{
+}
+
+void Prefetcher::access(W64 addr, W64 rip, bool hit, bool kernel)
+{
+    W64 line = line_of(addr);
+    Tracked &t = track(line);
+    bool first_use = (t.state != PF_FREE && t.line == line && !t.used);
+
+    N_STAT_UPDATE(stats.trained, ++, kernel);
+
+    if (first_use) {
+        /* A miss the prefetcher removed, or at least shortened */
+        N_STAT_UPDATE(stats.useful, ++, kernel);
+        N_STAT_UPDATE(stats.demand_miss, ++, kernel);
+        if (t.state == PF_INFLIGHT || t.late)
+            N_STAT_UPDATE(stats.late, ++, kernel);
+
+        interval_useful++;
+        t.used = true;
+        if (t.state == PF_FILLED)
+            release(t);
+    } else if (!hit) {
+        N_STAT_UPDATE(stats.demand_miss, ++, kernel);
+    }
+
+    trigger_page   = addr & ~(W64)(PAGE_SIZE - 1);
+    trigger_kernel = kernel;
+
+    train(addr, rip, !hit || first_use);
+}
+
+void Prefetcher::prefetch(W64 line)
+{
+    N_STAT_UPDATE(stats.candidates, ++, trigger_kernel);
+
+    /* Physical addresses are only contiguous within a page */
+    if (((line << config.line_bits) & ~(W64)(PAGE_SIZE - 1)) !=
+            trigger_page) {
+        N_STAT_UPDATE(stats.page_cross, ++, trigger_kernel);
+        return;
+    }
+
+    Tracked &t = track(line);
+    if (t.state != PF_FREE && t.line == line) {
+        N_STAT_UPDATE(stats.redundant, ++, trigger_kernel);
+        return;
+    }
+
+    int size = queue.count();
+    foreach (i, queue_count) {
+        if (queue[(queue_head + i) % size] == line) {
+            N_STAT_UPDATE(stats.redundant, ++, trigger_kernel);
+            return;
+        }
+    }
+
+    /* Queue is full, newer requests are more likely to be timely */
+    if (queue_count == size) {
+        N_STAT_UPDATE(stats.dropped, ++, trigger_kernel);
+        queue_head = (queue_head + 1) % size;
+        queue_count--;
+    }
+
+    queue[(queue_head + queue_count) % size] = line;
+    queue_count++;
+}
+
+bool Prefetcher::next_prefetch(W64 &addr, bool room, bool kernel)
+{
+    if (queue_count == 0)
+        return false;
+
+    if (!room || inflight >= config.max_inflight) {
+        N_STAT_UPDATE(stats.throttled, ++, kernel);
+        return false;
+    }
+
+    W64 line = queue[queue_head];
+    queue_head = (queue_head + 1) % queue.count();
+    queue_count--;
+
+    Tracked &t = track(line);
+    if (t.state == PF_FILLED && !t.used)
+        N_STAT_UPDATE(stats.useless, ++, kernel);
+    release(t);
+
+    t.line  = line;
+    t.state = PF_INFLIGHT;
+    inflight++;
+
+    N_STAT_UPDATE(stats.issued, ++, kernel);
+
+    if (config.throttle && ++interval_issued >= THROTTLE_INTERVAL) {
+        int old_degree = degree;
+        adjust_degree();
+
+        if (degree > old_degree) {
+            N_STAT_UPDATE(stats.degree_up, ++, kernel);
+        } else if (degree < old_degree) {
+            N_STAT_UPDATE(stats.degree_down, ++, kernel);
+        }
+    }
+
+    addr = line << config.line_bits;
+    return true;
+}
+
+void Prefetcher::prefetch_complete(W64 addr, bool filled, bool kernel)
+{
+    W64 line = line_of(addr);
+    Tracked &t = track(line);
+
+    if (t.line != line || t.state != PF_INFLIGHT)
+        return;
+
+    if (!filled) {
+        /* Line was already in the cache */
+        N_STAT_UPDATE(stats.redundant, ++, kernel);
+        release(t);
+    } else if (t.used) {
+        release(t);
+    } else {
+        inflight--;
+        t.state = PF_FILLED;
+    }
+}
+
+void Prefetcher::prefetch_waited(W64 addr)
+{
+    W64 line = line_of(addr);
+    Tracked &t = track(line);
+
+    if (t.line == line && t.state == PF_INFLIGHT)
+        t.late = true;
+}
+
+void Prefetcher::prefetch_cancelled(W64 addr)
+{
+    W64 line = line_of(addr);
+    Tracked &t = track(line);
+
+    if (t.line == line && t.state == PF_INFLIGHT)
+        release(t);
+}
+
+void Prefetcher::release(Tracked &t)
+{
+    if (t.state == PF_INFLIGHT)
+        inflight--;
+
+    t.state = PF_FREE;
+    t.used  = false;
+    t.late  = false;
+}
+
+/*
+ * Feedback directed throttling: after every interval of issued prefetches
+ * lower the degree if most of them were not used, and raise it back
+ * towards the configured degree when they are.
+ */
+void Prefetcher::adjust_degree()
+{
+    int accuracy = (interval_useful * 100) / interval_issued;
+
+    if (accuracy < 40 && degree > 1)
+        degree--;
+    else if (accuracy >= 75 && degree < config.degree)
+        degree++;
+
+    interval_issued = 0;
+    interval_useful = 0;
+}
+
+/**
+ * @brief Dump Prefetcher Configuration in YAML Format
+ *
+ * @param out YAML Object
+ */
+void Prefetcher::dump_configuration(YAML::Emitter &out) const
+{
+    YAML_KEY_VAL(out, "prefetcher", name);
+    YAML_KEY_VAL(out, "prefetch_degree", config.degree);
+    YAML_KEY_VAL(out, "prefetch_distance", config.distance);
+    YAML_KEY_VAL(out, "prefetch_queue", queue.count());
+    YAML_KEY_VAL(out, "prefetch_inflight", config.max_inflight);
+    YAML_KEY_VAL(out, "prefetch_table", config.table_size);
+    YAML_KEY_VAL(out, "prefetch_filter", tracker.count());
+    YAML_KEY_VAL(out, "prefetch_throttle", config.throttle);
+}
+
+void PrefetcherConfig::read_options(BaseMachine &machine, const char *name)
+{
+    machine.get_option(name, "prefetch_degree", degree);
+    machine.get_option(name, "prefetch_distance", distance);
+    machine.get_option(name, "prefetch_queue", queue_size);
+    machine.get_option(name, "prefetch_inflight", max_inflight);
+    machine.get_option(name, "prefetch_table", table_size);
+    machine.get_option(name, "prefetch_filter", filter_size);
+    machine.get_option(name, "prefetch_throttle", throttle);
+}
+
+/* Prefetcher Builders */
+
+PrefetcherBuilder::PrefetcherBuilder(const char* name)
+{
+    if(!prefetcherBuilders) {
+        prefetcherBuilders = new Hashtable<const char*,
+            PrefetcherBuilder*, 1>();
+    }
+    prefetcherBuilders->add(name, this);
+}
+
+Hashtable<const char*, PrefetcherBuilder*, 1>
+    *PrefetcherBuilder::prefetcherBuilders = NULL;
+
+Prefetcher* PrefetcherBuilder::create_prefetcher(const char *type,
+        Statable *parent, const PrefetcherConfig &config)
+{
+    PrefetcherBuilder** builder = NULL;
+
+    if(prefetcherBuilders)
+        builder = prefetcherBuilders->get(type);
+
+    if(!builder) {
+        stringbuf err;
+        err << "::ERROR::Can't find Prefetcher '" << type
+            << "'. Please check your config file." << endl;
+        ptl_logfile << err;
+        cout << err;
+        assert(builder);
+    }
+
+    return (*builder)->get_new_prefetcher(parent, config);
+}
+
+/**
+ * @brief Create the prefetcher selected for a cache controller
+ *
+ * @param machine Machine holding the controller's options
+ * @param name Name of the cache controller
+ * @param parent Stats of the cache controller
+ * @param line_bits Line size bits of the cache
+ *
+ * @return New prefetcher or NULL if the cache has no prefetcher
+ */
+Prefetcher* PrefetcherBuilder::create_prefetcher(BaseMachine &machine,
+        const char *name, Statable *parent, int line_bits)
+{
+    stringbuf type;
+
+    if(!machine.get_option(name, "prefetcher", type) ||
+            strcmp(type.buf, "none") == 0) {
+        return NULL;
+    }
+
+    PrefetcherConfig config(line_bits);
+    config.read_options(machine, name);
+
+    return create_prefetcher(type.buf, parent, config);
+}
+
+/*
+ * Next line prefetcher: on a miss, or on first use of a prefetched line,
+ * fetch the following 'degree' lines. This is the tagged version of the
+ * prefetcher the write-back cache used to have built in.
+ */
+class NextLinePrefetcher : public Prefetcher
+{
+    public:
+        NextLinePrefetcher(Statable *parent, const PrefetcherConfig &config)
+            : Prefetcher("next_line", parent, config)
+        {}
+
+    protected:
+        void train(W64 addr, W64 rip, bool miss)
+        {
+            if (!miss)
+                return;
+
+            W64 line = line_of(addr);
+            foreach (i, degree) {
+                prefetch(line + i + 1);
+            }
+        }
+};
+
+struct NextLinePrefetcherBuilder : public PrefetcherBuilder
+{
+    NextLinePrefetcherBuilder(const char* name) :
+        PrefetcherBuilder(name)
+    {}
+
+    Prefetcher* get_new_prefetcher(Statable *parent,
+            const PrefetcherConfig &config) {
+        return new NextLinePrefetcher(parent, config);
+    }
+};
+
+NextLinePrefetcherBuilder nextLinePrefetcherBuilder("next_line");
@@ -0,0 +1,203 @@
+
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <statsBuilder.h>
+
+struct BaseMachine;
+
+namespace Memory {
+
+    struct PrefetcherStats : public Statable
+    {
+        StatObj<W64> trained;      // demand accesses seen by the prefetcher
+        StatObj<W64> candidates;   // addresses generated by the algorithm
+        StatObj<W64> redundant;    // already prefetched or present in cache
+        StatObj<W64> page_cross;   // candidates outside the trigger's page
+        StatObj<W64> dropped;      // pushed out of a full prefetch queue
+        StatObj<W64> throttled;    // issue attempts held back
+        StatObj<W64> issued;
+        StatObj<W64> useful;       // demand access to a prefetched line
+        StatObj<W64> late;         // useful, but data was still in flight
+        StatObj<W64> useless;      // prefetched line aged out unused
+        StatObj<W64> demand_miss;  // misses without prefetch, useful + missed
+        StatObj<W64> degree_up;
+        StatObj<W64> degree_down;
+
+        StatEquation<W64, double, StatObjFormulaDiv> accuracy;
+        StatEquation<W64, double, StatObjFormulaDiv> coverage;
+        StatEquation<W64, double, StatObjFormulaDiv> lateness;
+
+        PrefetcherStats(const char *name, Statable *parent)
+            : Statable(name, parent)
+              , trained("trained", this)
+              , candidates("candidates", this)
+              , redundant("redundant", this)
+              , page_cross("page_cross", this)
+              , dropped("dropped", this)
+              , throttled("throttled", this)
+              , issued("issued", this)
+              , useful("useful", this)
+              , late("late", this)
+              , useless("useless", this)
+              , demand_miss("demand_miss", this)
+              , degree_up("degree_up", this)
+              , degree_down("degree_down", this)
+              , accuracy("accuracy", this)
+              , coverage("coverage", this)
+              , lateness("lateness", this)
+        {
+            accuracy.add_elem(&useful);
+            accuracy.add_elem(&issued);
+
+            coverage.add_elem(&useful);
+            coverage.add_elem(&demand_miss);
+
+            lateness.add_elem(&late);
+            lateness.add_elem(&useful);
+        }
+    };
+
+    /*
+     * Prefetcher parameters, read from the cache's 'option' entries in
+     * the machine configuration:
+     *
+     *   prefetcher:          stride | stream | delta | next_line
+     *   prefetch_degree:     maximum prefetches per trigger
+     *   prefetch_distance:   how far ahead of the demand stream to run
+     *   prefetch_queue:      prefetch queue entries
+     *   prefetch_inflight:   maximum outstanding prefetches
+     *   prefetch_table:      entries in the algorithm's training table
+     *   prefetch_filter:     recently prefetched lines tracked for stats
+     *   prefetch_throttle:   adjust degree based on measured accuracy
+     */
+    struct PrefetcherConfig
+    {
+        int line_bits;
+        int degree;
+        int distance;
+        int queue_size;
+        int max_inflight;
+        int table_size;
+        int filter_size;
+        bool throttle;
+
+        PrefetcherConfig(int line_bits = 6)
+            : line_bits(line_bits)
+              , degree(2)
+              , distance(4)
+              , queue_size(16)
+              , max_inflight(8)
+              , table_size(64)
+              , filter_size(64)
+              , throttle(true)
+        {}
+
+        void read_options(BaseMachine &machine, const char *name);
+    };
+
+    /*
+     * Base class of hardware prefetchers attached to a cache controller.
+     *
+     * The controller reports every demand access with access() and then
+     * drains the prefetch queue with next_prefetch(), issuing each address
+     * as a normal read through its own queue so prefetches use the same
+     * ports, interconnects and memory bandwidth as demand misses. When a
+     * prefetch finds the line already cached, or its data arrives, the
+     * controller calls prefetch_complete().
+     *
+     * Algorithms implement train() and call prefetch() for each line they
+     * want fetched. This class takes care of the bounded queue, the
+     * outstanding limit, accuracy based throttling and the stats.
+     */
+    class Prefetcher
+    {
+        public:
+            Prefetcher(const char *name, Statable *parent,
+                    const PrefetcherConfig &config);
+            virtual ~Prefetcher();
+
+            void access(W64 addr, W64 rip, bool hit, bool kernel);
+            bool next_prefetch(W64 &addr, bool room, bool kernel);
+            void prefetch_complete(W64 addr, bool filled, bool kernel);
+            void prefetch_waited(W64 addr);
+            void prefetch_cancelled(W64 addr);
+
+            const char* get_name() const { return name; }
+            int get_degree() const { return degree; }
+            int get_inflight() const { return inflight; }
+            int get_queued() const { return queue_count; }
+
+            void dump_configuration(YAML::Emitter &out) const;
+
+        protected:
+            /*
+             * Observe a demand access. 'addr' is the byte address, 'miss'
+             * is set for demand misses and for hits on lines brought in by
+             * this prefetcher, which most algorithms treat alike.
+             */
+            virtual void train(W64 addr, W64 rip, bool miss) = 0;
+
+            void prefetch(W64 line);
+
+            W64 line_of(W64 addr) const { return addr >> config.line_bits; }
+
+            const PrefetcherConfig config;
+            int degree;
+
+        private:
+            enum { PF_FREE = 0, PF_INFLIGHT, PF_FILLED };
+
+            enum { THROTTLE_INTERVAL = 128 };
+
+            struct Tracked {
+                W64 line;
+                W8  state;
+                bool used;
+                bool late;
+            };
+
+            const char *name;
+            PrefetcherStats stats;
+
+            dynarray<W64> queue;
+            int queue_head;
+            int queue_count;
+            dynarray<Tracked> tracker;
+            int inflight;
+
+            W64 trigger_page;
+            bool trigger_kernel;
+
+            int interval_issued;
+            int interval_useful;
+
+            Tracked& track(W64 line) {
+                return tracker[line % tracker.count()];
+            }
+
+            void release(Tracked &t);
+            void adjust_degree();
+    };
+
+    /*
+     * Prefetchers register a builder under the name used for the
+     * 'prefetcher' option, like the cache controllers do.
+     */
+    struct PrefetcherBuilder {
+        PrefetcherBuilder(const char* name);
+        virtual Prefetcher* get_new_prefetcher(Statable *parent,
+                const PrefetcherConfig &config) = 0;
+        static Hashtable<const char*, PrefetcherBuilder*, 1>
+            *prefetcherBuilders;
+
+        static Prefetcher* create_prefetcher(const char *type,
+                Statable *parent, const PrefetcherConfig &config);
+        static Prefetcher* create_prefetcher(BaseMachine &machine,
+                const char *name, Statable *parent, int line_bits);
+    };
+};
+
+#endif // PREFETCHER_H
@@ -0,0 +1,327 @@
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <shadowTags.h>
+#include <memoryStats.h>
+
+#include <machine.h>
+
+using namespace Memory;
+
+const char *Memory::shadow_policy_names[NUM_SHADOW_POLICIES] = {
+    "lru", "plru", "fifo", "random",
+};
+
+ShadowTags::ShadowTags(const char *name, Statable *parent, int sets,
+        int ways, int line_size, ShadowPolicy policy)
+    : sets_(sets)
+      , ways_(ways)
+      , lineBits_(lsbindex(line_size))
+      , policy_(policy)
+      , clock_(0)
+      , random_(0x9e3779b97f4a7c15ULL)
+      , stats(name, parent)
+{
+    Way empty;
+    empty.tag = (W64)-1;
+    empty.stamp = 0;
+    empty.dirty = false;
+    empty.used = false;
+
+    lines_.resize(sets_ * ways_, empty);
+}
+
+/* Index of the way holding addr, -1 if none */
+int ShadowTags::find(W64 addr) const
+{
+    W64 tag = tag_of(addr);
+    int base = set_of(addr) * ways_;
+
+    foreach (i, ways_) {
+        if (lines_[base + i].tag == tag)
+            return base + i;
+    }
+
+    return -1;
+}
+
+void ShadowTags::touch(int idx)
+{
+    Way &way = lines_[idx];
+
+    if (policy_ == SHADOW_LRU)
+        way.stamp = clock_++;
+
+    if (policy_ == SHADOW_PLRU) {
+        /* When every MRU bit would be set clear all the others */
+        int base = idx - (idx % ways_);
+        way.used = true;
+
+        foreach (i, ways_) {
+            if (!lines_[base + i].used)
+                return;
+        }
+
+        foreach (i, ways_) {
+            lines_[base + i].used = (base + i == idx);
+        }
+    }
+}
+
+int ShadowTags::victim(int set)
+{
+    int base = set * ways_;
+
+    foreach (i, ways_) {
+        if (lines_[base + i].tag == (W64)-1)
+            return base + i;
+    }
+
+    switch (policy_) {
+        case SHADOW_RANDOM:
+            random_ ^= random_ << 13;
+            random_ ^= random_ >> 7;
+            random_ ^= random_ << 17;
+            return base + (random_ % ways_);
+
+        case SHADOW_PLRU:
+            foreach (i, ways_) {
+                if (!lines_[base + i].used)
+                    return base + i;
+            }
+            return base;
+
+        default: {
+            /* LRU and FIFO both replace the oldest stamp */
+            int oldest = base;
+            foreach (i, ways_) {
+                if (lines_[base + i].stamp < lines_[oldest].stamp)
+                    oldest = base + i;
+            }
+            return oldest;
+        }
+    }
+}
+
+/**
+ * @brief Look up a demand access, allocating on a miss
+ *
+ * @param addr Physical address
+ * @param write Access is a write
+ * @param kernel Access is from kernel mode
+ *
+ * @return true on a hit
+ */
+bool ShadowTags::access(W64 addr, bool write, bool kernel)
+{
+    int idx = find(addr);
+    bool hit = (idx >= 0);
+
+    N_STAT_UPDATE(stats.accesses, ++, kernel);
+
+    if (hit) {
+        if (write) {
+            N_STAT_UPDATE(stats.write_hit, ++, kernel);
+        } else {
+            N_STAT_UPDATE(stats.read_hit, ++, kernel);
+        }
+    } else {
+        N_STAT_UPDATE(stats.misses, ++, kernel);
+        if (write) {
+            N_STAT_UPDATE(stats.write_miss, ++, kernel);
+        } else {
+            N_STAT_UPDATE(stats.read_miss, ++, kernel);
+        }
+
+        idx = victim(set_of(addr));
+        Way &way = lines_[idx];
+
+        if (way.tag != (W64)-1) {
+            N_STAT_UPDATE(stats.evictions, ++, kernel);
+            if (way.dirty) {
+                N_STAT_UPDATE(stats.writebacks, ++, kernel);
+            }
+        }
+
+        way.tag = tag_of(addr);
+        way.dirty = false;
+        way.used = false;
+        way.stamp = clock_++;
+    }
+
+    if (write)
+        lines_[idx].dirty = true;
+
+    touch(idx);
+
+    return hit;
+}
+
+/**
+ * @brief Write back from an upper cache
+ *
+ * Marks a held line dirty, like the real cache it does not allocate and
+ * a missing line is passed on below.
+ */
+void ShadowTags::update(W64 addr, bool kernel)
+{
+    int idx = find(addr);
+
+    if (idx >= 0) {
+        N_STAT_UPDATE(stats.update_hit, ++, kernel);
+        lines_[idx].dirty = true;
+    } else {
+        N_STAT_UPDATE(stats.update_miss, ++, kernel);
+        N_STAT_UPDATE(stats.writebacks, ++, kernel);
+    }
+}
+
+void ShadowTags::invalidate(W64 addr)
+{
+    int idx = find(addr);
+
+    if (idx >= 0) {
+        lines_[idx].tag = (W64)-1;
+        lines_[idx].dirty = false;
+        lines_[idx].used = false;
+    }
+}
+
+void ShadowTags::dump_configuration(YAML::Emitter &out) const
+{
+    out << YAML::BeginMap;
+    YAML_KEY_VAL(out, "sets", sets_);
+    YAML_KEY_VAL(out, "ways", ways_);
+    YAML_KEY_VAL(out, "size", (sets_ * ways_) << lineBits_);
+    YAML_KEY_VAL(out, "policy", shadow_policy_names[policy_]);
+    out << YAML::EndMap;
+}
+
+ShadowTagSet::~ShadowTagSet()
+{
+    foreach (i, shadows_.count())
+        delete shadows_[i];
+}
+
+/**
+ * @brief Create the shadow tag arrays of a cache controller
+ *
+ * @param machine Machine holding the controller's options
+ * @param name Name of the cache controller
+ * @param parent Stats of the cache controller
+ * @param line_size Line size of the cache, shared by its shadows
+ *
+ * @return New set of arrays or NULL if option 'shadow' is not set
+ */
+ShadowTagSet* ShadowTagSet::create(BaseMachine &machine, const char *name,
+        Statable *parent, int line_size)
+{
+    stringbuf spec;
+
+    if (!machine.get_option(name, "shadow", spec))
+        return NULL;
+
+    ShadowTagSet *set = new ShadowTagSet();
+
+    if (!set->parse(spec.buf, parent, line_size)) {
+        stringbuf err;
+        err << "::ERROR::Invalid shadow option '" << spec << "' of "
+            << name << ", expected SETSxWAYS[:policy],..." << endl;
+        ptl_logfile << err;
+        cout << err;
+        assert(0);
+    }
+
+    if (!set->count()) {
+        delete set;
+        return NULL;
+    }
+
+    return set;
+}
+
+/**
+ * @brief Add the arrays listed in spec
+ *
+ * @return false if spec is malformed
+ */
+bool ShadowTagSet::parse(const char *spec, Statable *parent, int line_size)
+{
+    const char *p = spec;
+
+    while (*p) {
+        if (*p == ' ' || *p == ',') {
+            p++;
+            continue;
+        }
+
+        char *end;
+        long sets = strtol(p, &end, 10);
+        if (end == p || *end != 'x' || sets <= 0)
+            return false;
+
+        p = end + 1;
+        long ways = strtol(p, &end, 10);
+        if (end == p || ways <= 0)
+            return false;
+        p = end;
+
+        ShadowPolicy policy = SHADOW_LRU;
+        if (*p == ':') {
+            p++;
+            int len = strcspn(p, " ,");
+            int found = -1;
+
+            foreach (i, NUM_SHADOW_POLICIES) {
+                if (strlen(shadow_policy_names[i]) == (size_t)len &&
+                        strncmp(p, shadow_policy_names[i], len) == 0)
+                    found = i;
+            }
+
+            if (found < 0)
+                return false;
+
+            policy = (ShadowPolicy)found;
+            p += len;
+        }
+
+        stringbuf name;
+        name << "shadow_" << sets << "x" << ways << "_"
+             << shadow_policy_names[policy];
+
+        shadows_.push(new ShadowTags(name.buf, parent, sets, ways,
+                    line_size, policy));
+    }
+
+    return true;
+}
+
+void ShadowTagSet::access(W64 addr, bool write, bool kernel)
+{
+    foreach (i, shadows_.count())
+        shadows_[i]->access(addr, write, kernel);
+}
+
+void ShadowTagSet::update(W64 addr, bool kernel)
+{
+    foreach (i, shadows_.count())
+        shadows_[i]->update(addr, kernel);
+}
+
+void ShadowTagSet::invalidate(W64 addr)
+{
+    foreach (i, shadows_.count())
+        shadows_[i]->invalidate(addr);
+}
+
+void ShadowTagSet::dump_configuration(YAML::Emitter &out) const
+{
+    out << YAML::Key << "shadow" << YAML::Value << YAML::BeginSeq;
+    foreach (i, shadows_.count())
+        shadows_[i]->dump_configuration(out);
+    out << YAML::EndSeq;
+}
@@ -0,0 +1,147 @@
+#ifndef SHADOW_TAGS_H
+#define SHADOW_TAGS_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <statsBuilder.h>
+
+struct BaseMachine;
+
+namespace Memory {
+
+    enum ShadowPolicy {
+        SHADOW_LRU = 0,
+        SHADOW_PLRU,     // MRU bit pseudo-LRU, like the real caches
+        SHADOW_FIFO,
+        SHADOW_RANDOM,
+        NUM_SHADOW_POLICIES
+    };
+
+    extern const char *shadow_policy_names[NUM_SHADOW_POLICIES];
+
+    struct ShadowStats : public Statable
+    {
+        StatObj<W64> read_hit;
+        StatObj<W64> read_miss;
+        StatObj<W64> write_hit;
+        StatObj<W64> write_miss;
+        StatObj<W64> update_hit;   // write backs from above to a held line
+        StatObj<W64> update_miss;  // passed on below
+        StatObj<W64> evictions;    // valid lines replaced
+        StatObj<W64> writebacks;   // dirty data sent below
+        StatObj<W64> accesses;     // demand reads and writes
+        StatObj<W64> misses;
+
+        StatEquation<W64, double, StatObjFormulaDiv> miss_rate;
+
+        ShadowStats(const char *name, Statable *parent)
+            : Statable(name, parent)
+              , read_hit("read_hit", this)
+              , read_miss("read_miss", this)
+              , write_hit("write_hit", this)
+              , write_miss("write_miss", this)
+              , update_hit("update_hit", this)
+              , update_miss("update_miss", this)
+              , evictions("evictions", this)
+              , writebacks("writebacks", this)
+              , accesses("accesses", this)
+              , misses("misses", this)
+              , miss_rate("miss_rate", this)
+        {
+            miss_rate.add_elem(&misses);
+            miss_rate.add_elem(&accesses);
+        }
+    };
+
+    /**
+     * @brief Tag only copy of a cache with a different geometry
+     *
+     * Sees the same accesses as the cache it shadows and keeps only tags
+     * and dirty bits, so its stats tell how another size, associativity
+     * or replacement policy would have done in the same run. It allocates
+     * on read and write misses and never changes timing or data.
+     */
+    class ShadowTags
+    {
+        public:
+            ShadowTags(const char *name, Statable *parent, int sets,
+                    int ways, int line_size, ShadowPolicy policy);
+
+            bool access(W64 addr, bool write, bool kernel);
+            void update(W64 addr, bool kernel);
+            void invalidate(W64 addr);
+
+            bool probe(W64 addr) const { return find(addr) >= 0; }
+
+            int sets() const { return sets_; }
+            int ways() const { return ways_; }
+            ShadowPolicy policy() const { return policy_; }
+            const ShadowStats& get_stats() const { return stats; }
+
+            void dump_configuration(YAML::Emitter &out) const;
+
+        private:
+            struct Way {
+                W64 tag;
+                W64 stamp;  // last use for LRU, fill for FIFO
+                bool dirty;
+                bool used;  // MRU bit for PLRU
+            };
+
+            dynarray<Way> lines_;
+
+            int sets_;
+            int ways_;
+            int lineBits_;
+            ShadowPolicy policy_;
+            W64 clock_;
+            W64 random_;
+
+            ShadowStats stats;
+
+            int find(W64 addr) const;
+            int victim(int set);
+            void touch(int idx);
+
+            W64 tag_of(W64 addr) const { return addr >> lineBits_; }
+            int set_of(W64 addr) const { return tag_of(addr) % sets_; }
+    };
+
+    /**
+     * @brief Shadow tag arrays of one cache controller
+     *
+     * Built from the cache's 'shadow' option, a list of SETSxWAYS with an
+     * optional replacement policy, for example:
+     *
+     *   shadow: "4096x16:lru, 2048x8:random"
+     *
+     * Policies are lru, plru, fifo and random (lru by default). Each
+     * array reports under 'shadow_SETSxWAYS_POLICY' in the cache's stats.
+     */
+    class ShadowTagSet
+    {
+        public:
+            ShadowTagSet() {}
+            ~ShadowTagSet();
+
+            static ShadowTagSet* create(BaseMachine &machine,
+                    const char *name, Statable *parent, int line_size);
+
+            bool parse(const char *spec, Statable *parent, int line_size);
+
+            void access(W64 addr, bool write, bool kernel);
+            void update(W64 addr, bool kernel);
+            void invalidate(W64 addr);
+
+            int count() const { return shadows_.count(); }
+            ShadowTags* get(int i) const { return shadows_[i]; }
+
+            void dump_configuration(YAML::Emitter &out) const;
+
+        private:
+            dynarray<ShadowTags*> shadows_;
+    };
+
+};
+
+#endif // SHADOW_TAGS_H
@@ -43,6 +43,8 @@ using namespace Memory::SplitPhaseBus;
 BusInterconnect::BusInterconnect(const char *name,
         MemoryHierarchy *memoryHierarchy) :
     Interconnect(name,memoryHierarchy)
+    , allControllersMask_(0)
+    , pendingQueuesMask_(0)
     , lastAccessQueue(NULL)
     , busBusy_(false)
     , dataBusBusy_(false)
@@ -96,8 +98,30 @@ void BusInterconnect::register_controller(Controller *controller)
         entry->controllerQueue = busControllerQueue;
     }
 
+    /* Response and pending state is kept in one W64 mask per bus */
+    assert(controllers.count() < BUS_MAX_CONTROLLERS);
+
     busControllerQueue->idx = controllers.count();
     controllers.push(busControllerQueue);
+    allControllersMask_ = bitmask(controllers.count());
+}
+
+BusControllerQueue* BusInterconnect::get_controller_queue(
+        Controller *controller)
+{
+    foreach(i, controllers.count()) {
+        if(controllers[i]->controller == controller)
+            return controllers[i];
+    }
+    return NULL;
+}
+
+void BusInterconnect::update_pending_mask(BusControllerQueue *queue)
+{
+    if(queue->queue.count() > 0)
+        pendingQueuesMask_ |= (1ULL << queue->idx);
+    else
+        pendingQueuesMask_ &= ~(1ULL << queue->idx);
 }
 
 int BusInterconnect::access_fast_path(Controller *controller,
@@ -118,6 +142,7 @@ void BusInterconnect::annul_request(MemoryRequest *request)
                 controllers[i]->queue.free(entry);
             }
         }
+        update_pending_mask(controllers[i]);
     }
     PendingQueueEntry *queueEntry;
     foreach_list_mutable(pendingRequests_.list(), queueEntry,
@@ -148,16 +173,11 @@ bool BusInterconnect::controller_request_cb(void *arg)
             entry, nextentry) {
         if(pendingEntry->request == message->request) {
             memdebug("Bus Response received for: ", *pendingEntry);
-            int idx = -1;
             Controller *sender = (Controller*)message->sender;
-            foreach(i, controllers.count()) {
-                if(sender == controllers[i]->controller) {
-                    idx = i;
-                    break;
-                }
-            }
+            BusControllerQueue *senderQueue = get_controller_queue(sender);
+            assert(senderQueue);
 
-            pendingEntry->responseReceived[idx] = true;
+            pendingEntry->responseReceived |= (1ULL << senderQueue->idx);
 
             /* If response has data mark this controller */
             if(message->hasData) {
@@ -173,20 +193,20 @@ bool BusInterconnect::controller_request_cb(void *arg)
                  * controllers that are working on this request
                  */
                 if(message->hasData) {
-                    foreach(x, controllers.count()) {
-                        if(!pendingEntry->responseReceived[x]) {
-                            controllers[x]->controller->annul_request(pendingEntry->request);
-                            pendingEntry->responseReceived[x] = true;
-                        }
+                    W64 waiting = allControllersMask_ &
+                        ~pendingEntry->responseReceived;
+                    while(waiting) {
+                        int x = lsbindex64(waiting);
+                        waiting &= waiting - 1;
+                        controllers[x]->controller->annul_request(pendingEntry->request);
+                        pendingEntry->responseReceived |= (1ULL << x);
                     }
                 }
             }
 
             if(!dataBusBusy_) {
-                bool all_set = true;
-                foreach(x, pendingEntry->responseReceived.count()) {
-                    all_set &= pendingEntry->responseReceived[x];
-                }
+                bool all_set = (pendingEntry->responseReceived ==
+                        allControllersMask_);
                 if(all_set || (snoopDisabled_ && pendingEntry->controllerWithData)) {
                     dataBusBusy_ = true;
                     marss_add_event(&dataBroadcast_, 1,
@@ -201,14 +221,9 @@ bool BusInterconnect::controller_request_cb(void *arg)
     }
 
     /* its a new request, add entry into controllerqueues */
-    BusControllerQueue* busControllerQueue = NULL;
-    foreach(i, controllers.count()) {
-        if(controllers[i]->controller ==
-                (Controller*)message->sender) {
-            busControllerQueue = controllers[i];
-            break;
-        }
-    }
+    BusControllerQueue* busControllerQueue = get_controller_queue(
+            (Controller*)message->sender);
+    assert(busControllerQueue);
 
     if (busControllerQueue->queue.isFull()) {
         N_STAT_UPDATE(new_stats->bus_not_ready, ++, kernel);
@@ -218,6 +233,7 @@ bool BusInterconnect::controller_request_cb(void *arg)
 
     BusQueueEntry *busQueueEntry;
     busQueueEntry = busControllerQueue->queue.alloc();
+    pendingQueuesMask_ |= (1ULL << busControllerQueue->idx);
     if(busControllerQueue->queue.isFull()) {
         memoryHierarchy_->set_interconnect_full(this, true);
     }
@@ -241,28 +257,26 @@ bool BusInterconnect::controller_request_cb(void *arg)
 BusQueueEntry* BusInterconnect::arbitrate_round_robin()
 {
     memdebug("BUS:: doing arbitration.. \n");
-    BusControllerQueue *controllerQueue;
-    int i;
-    if(lastAccessQueue)
-        i = lastAccessQueue->idx;
-    else
-        i = 0;
-
-    do {
-        i = (i + 1) % controllers.count();
-        controllerQueue = controllers[i];
-
-        if(controllerQueue->queue.count() > 0) {
-            BusQueueEntry *queueEntry = (BusQueueEntry*)
-                controllerQueue->queue.peek();
-            assert(queueEntry);
-            assert(!queueEntry->annuled);
-            lastAccessQueue = controllerQueue;
-            return queueEntry;
-        }
-    } while(controllerQueue != lastAccessQueue);
+    if(!pendingQueuesMask_)
+        return NULL;
 
-    return NULL;
+    /*
+     * Round robin: first queue with a pending entry after the last one
+     * served, wrapping around to (and including) the last one itself.
+     */
+    int last = (lastAccessQueue) ? lastAccessQueue->idx : 0;
+    W64 after = pendingQueuesMask_ & ~bitmask(last + 1);
+    int i = lsbindex64((after) ? after : pendingQueuesMask_);
+
+    BusControllerQueue *controllerQueue = controllers[i];
+    assert(controllerQueue->queue.count() > 0);
+
+    BusQueueEntry *queueEntry = (BusQueueEntry*)
+        controllerQueue->queue.peek();
+    assert(queueEntry);
+    assert(!queueEntry->annuled);
+    lastAccessQueue = controllerQueue;
+    return queueEntry;
 }
 
 bool BusInterconnect::can_broadcast(BusControllerQueue *queue)
@@ -357,7 +371,6 @@ bool BusInterconnect::broadcast_completed_cb(void *arg)
         pendingEntry->request = queueEntry->request;
         pendingEntry->request->incRefCounter();
         pendingEntry->controllerQueue = queueEntry->controllerQueue;
-        pendingEntry->set_num_controllers(controllers.count());
 
         ADD_HISTORY_ADD(pendingEntry->request);
         memdebug("Created pending entry: ", *pendingEntry, endl);
@@ -382,7 +395,7 @@ bool BusInterconnect::broadcast_completed_cb(void *arg)
              * response received flag to true
              */
             if(pendingEntry)
-                pendingEntry->responseReceived[i] = true;
+                pendingEntry->responseReceived |= (1ULL << i);
         }
     }
 
@@ -392,6 +405,7 @@ bool BusInterconnect::broadcast_completed_cb(void *arg)
     queueEntry->request->decRefCounter();
     if(!queueEntry->annuled) {
         queueEntry->controllerQueue->queue.free(queueEntry);
+        update_pending_mask(queueEntry->controllerQueue);
     }
     if(!queueEntry->controllerQueue->queue.isFull()) {
         memoryHierarchy_->set_interconnect_full(this, false);
@@ -436,10 +450,8 @@ void BusInterconnect::set_data_bus()
     PendingQueueEntry *pendingEntry;
     foreach_list_mutable(pendingRequests_.list(), pendingEntry,
             entry, nextentry) {
-        bool all_set = true;
-        foreach(x, pendingEntry->responseReceived.count()) {
-            all_set &= pendingEntry->responseReceived[x];
-        }
+        bool all_set = (pendingEntry->responseReceived ==
+                allControllersMask_);
         if(all_set || (snoopDisabled_ && pendingEntry->controllerWithData)) {
             dataBusBusy_ = true;
             marss_add_event(&dataBroadcast_, 1,
@@ -37,6 +37,9 @@ namespace Memory {
 const int BUS_ARBITRATE_DELAY = 1;
 const int BUS_BROADCASTS_DELAY = 6;
 
+// Controllers per bus, bounded by the width of the response/pending masks
+const int BUS_MAX_CONTROLLERS = 64;
+
 namespace SplitPhaseBus {
 
 struct BusControllerQueue;
@@ -78,7 +81,7 @@ struct PendingQueueEntry : public FixStateListObject
     Controller *controllerWithData;
 	bool shared;
 	bool hasData;
-	dynarray<bool> responseReceived;
+	W64 responseReceived; // bit per controller index on the bus
 	bool annuled;
     W64 initCycle;
 
@@ -89,12 +92,7 @@ struct PendingQueueEntry : public FixStateListObject
 		annuled = false;
         initCycle = sim_cycle;
         controllerWithData = NULL;
-	}
-
-	void set_num_controllers(int no) {
-		responseReceived.resize(no, false);
-		foreach(i, responseReceived.count())
-			responseReceived[i] = false;
+		responseReceived = 0;
 	}
 
 	ostream& print(ostream& os) const {
@@ -105,7 +103,7 @@ struct PendingQueueEntry : public FixStateListObject
 		os << "request{", *request, "} ";
 		os << "shared[", shared, "]";
 		os << "hasData[", hasData, "]";
-		os << "responseReceived[", responseReceived, "]";
+		os << "responseReceived[", hexstring(responseReceived, 64), "]";
         os << "initCycle[", initCycle, "]";
         if(controllerWithData) {
             os << "controllerWithData[", controllerWithData->get_name(), "]";
@@ -133,6 +131,8 @@ class BusInterconnect : public Interconnect
 {
 	private:
 		dynarray<BusControllerQueue*> controllers;
+		W64 allControllersMask_;  // one bit per registered controller
+		W64 pendingQueuesMask_;   // controllers with a non-empty queue
 		BusControllerQueue* lastAccessQueue;
 		FixStateList<PendingQueueEntry, 32> pendingRequests_;
 		bool busBusy_;
@@ -149,6 +149,8 @@ class BusInterconnect : public Interconnect
 
 		BusQueueEntry *arbitrate_round_robin();
 		bool can_broadcast(BusControllerQueue *queue);
+		BusControllerQueue* get_controller_queue(Controller *controller);
+		void update_pending_mask(BusControllerQueue *queue);
 
 	public:
 		BusInterconnect(const char *name, MemoryHierarchy *memoryHierarchy);
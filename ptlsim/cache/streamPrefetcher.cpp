@@ -0,0 +1,143 @@
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <prefetcher.h>
+
+using namespace Memory;
+
+/*
+ * Stream prefetcher. Misses that fall within 'distance' lines of a
+ * tracked stream train it; after three misses in the same direction the
+ * stream is confirmed and the prefetcher keeps up to 'distance' lines
+ * ahead of the latest miss, fetching at most 'degree' lines per trigger.
+ * Misses that match no stream replace the least recently used one.
+ */
+class StreamPrefetcher : public Prefetcher
+{
+    public:
+        StreamPrefetcher(Statable *parent, const PrefetcherConfig &config)
+            : Prefetcher("stream", parent, config)
+            , clock(0)
+        {
+            Stream empty = {0, 0, 0, 0, 0, false};
+            streams.resize(max(config.table_size, 1), empty);
+        }
+
+    protected:
+        void train(W64 addr, W64 rip, bool miss);
+
+    private:
+        enum { STREAM_CONFIRMED = 3 };
+
+        struct Stream {
+            W64 last_line;
+            W64 next_line;
+            W64 lru;
+            int dir;
+            int confidence;
+            bool valid;
+        };
+
+        dynarray<Stream> streams;
+        W64 clock;
+
+        Stream* find_stream(W64 line);
+};
+
+StreamPrefetcher::Stream* StreamPrefetcher::find_stream(W64 line)
+{
+    W64s window = max(config.distance, 1);
+
+    foreach (i, streams.count()) {
+        Stream &s = streams[i];
+        if (!s.valid)
+            continue;
+
+        W64s delta = line - s.last_line;
+        if (delta >= -window && delta <= window)
+            return &s;
+    }
+
+    return NULL;
+}
+
+void StreamPrefetcher::train(W64 addr, W64 rip, bool miss)
+{
+    if (!miss)
+        return;
+
+    W64 line  = line_of(addr);
+    Stream *s = find_stream(line);
+    clock++;
+
+    if (!s) {
+        Stream *victim = &streams[0];
+        foreach (i, streams.count()) {
+            if (!streams[i].valid) {
+                victim = &streams[i];
+                break;
+            }
+            if (streams[i].lru < victim->lru)
+                victim = &streams[i];
+        }
+
+        victim->valid      = true;
+        victim->last_line  = line;
+        victim->next_line  = line;
+        victim->dir        = 0;
+        victim->confidence = 1;
+        victim->lru        = clock;
+        return;
+    }
+
+    s->lru = clock;
+
+    W64s delta = line - s->last_line;
+    if (delta == 0)
+        return;
+
+    int dir = (delta > 0) ? 1 : -1;
+    if (dir == s->dir) {
+        if (s->confidence < STREAM_CONFIRMED)
+            s->confidence++;
+    } else {
+        s->dir        = dir;
+        s->confidence = 2;
+        s->next_line  = line;
+    }
+
+    s->last_line = line;
+
+    if (s->confidence < STREAM_CONFIRMED)
+        return;
+
+    /* Restart from the demand line if it overtook the prefetches */
+    if (W64s(s->next_line - line) * dir <= 0)
+        s->next_line = line + dir;
+
+    int count = 0;
+    while (count < degree &&
+            W64s(s->next_line - line) * dir <= config.distance) {
+        prefetch(s->next_line);
+        s->next_line += dir;
+        count++;
+    }
+}
+
+struct StreamPrefetcherBuilder : public PrefetcherBuilder
+{
+    StreamPrefetcherBuilder(const char* name) :
+        PrefetcherBuilder(name)
+    {}
+
+    Prefetcher* get_new_prefetcher(Statable *parent,
+            const PrefetcherConfig &config) {
+        return new StreamPrefetcher(parent, config);
+    }
+};
+
+StreamPrefetcherBuilder streamPrefetcherBuilder("stream");
@@ -0,0 +1,99 @@
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <prefetcher.h>
+
+using namespace Memory;
+
+/*
+ * IP indexed stride prefetcher, a reference prediction table in the
+ * style of Chen and Baer. Each entry follows the accesses of one
+ * instruction; once the same stride is seen twice in a row the next
+ * 'degree' lines along the stride are prefetched.
+ */
+class StridePrefetcher : public Prefetcher
+{
+    public:
+        StridePrefetcher(Statable *parent, const PrefetcherConfig &config)
+            : Prefetcher("stride", parent, config)
+        {
+            StrideEntry empty = {0, 0, 0, 0};
+            table.resize(max(config.table_size, 1), empty);
+        }
+
+    protected:
+        void train(W64 addr, W64 rip, bool miss);
+
+    private:
+        enum { STRIDE_MAX_CONFIDENCE = 3, STRIDE_CONFIDENT = 2 };
+
+        struct StrideEntry {
+            W64 rip;
+            W64 last_addr;
+            W64s stride;
+            int confidence;
+        };
+
+        dynarray<StrideEntry> table;
+};
+
+void StridePrefetcher::train(W64 addr, W64 rip, bool miss)
+{
+    StrideEntry &e = table[(rip ^ (rip >> 12)) % table.count()];
+
+    if (e.rip != rip) {
+        e.rip        = rip;
+        e.last_addr  = addr;
+        e.stride     = 0;
+        e.confidence = 0;
+        return;
+    }
+
+    W64s stride = addr - e.last_addr;
+    if (stride == 0)
+        return;
+
+    e.last_addr = addr;
+
+    if (stride == e.stride) {
+        if (e.confidence < STRIDE_MAX_CONFIDENCE)
+            e.confidence++;
+    } else if (e.confidence > 0) {
+        e.confidence--;
+        return;
+    } else {
+        e.stride = stride;
+        return;
+    }
+
+    if (e.confidence < STRIDE_CONFIDENT)
+        return;
+
+    /* Strides smaller than a line still walk through consecutive lines */
+    W64s step = e.stride;
+    W64s line_size = W64s(1) << config.line_bits;
+    if (step > -line_size && step < line_size)
+        step = (step < 0) ? -line_size : line_size;
+
+    foreach (i, degree) {
+        prefetch(line_of(addr + step * (i + 1)));
+    }
+}
+
+struct StridePrefetcherBuilder : public PrefetcherBuilder
+{
+    StridePrefetcherBuilder(const char* name) :
+        PrefetcherBuilder(name)
+    {}
+
+    Prefetcher* get_new_prefetcher(Statable *parent,
+            const PrefetcherConfig &config) {
+        return new StridePrefetcher(parent, config);
+    }
+};
+
+StridePrefetcherBuilder stridePrefetcherBuilder("stride");
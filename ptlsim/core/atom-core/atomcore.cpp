@@ -1548,6 +1548,15 @@ void AtomOp::writeback_eom()
 
         thread->branchpred.update(predinfo, seq_eip,
                 thread->ctx.eip);
+        thread->shadow_branchpred.commit(predinfo, seq_eip,
+                last_uop.riptaken, thread->ctx.eip);
+        if unlikely (config.branch_trace_filename) {
+            W64 insns = thread->st_commit.insns(user_stats) +
+                thread->st_commit.insns(kernel_stats);
+            thread->branch_trace.record(branch_trace_file, predinfo.flags,
+                    seq_eip, last_uop.riptaken, thread->ctx.eip, insns,
+                    thread->ctx.kernel_mode);
+        }
         thread->st_branch_predictions.updates++;
     }
 
@@ -1713,6 +1722,8 @@ AtomThread::AtomThread(AtomCore& core, W8 threadid, Context& ctx)
     th_name << "thread_" << threadid;
     update_name(th_name.buf);
 
+    branch_trace.init(core.coreid, threadid);
+
     // Set decoder stats
     set_decoder_stats(this, ctx.cpu_index);
 
@@ -1801,7 +1812,8 @@ void AtomThread::reset()
     op_waiting_to_writeback_list.reset();
     op_ready_to_writeback_list.reset();
 
-    branchpred.init(core.coreid, threadid);
+    branchpred.init(core.bp_config, core.coreid, threadid);
+    shadow_branchpred.reset();
     branches_in_flight = 0;
 
     foreach(i, NUM_ATOM_OPS_PER_THREAD) {
@@ -2968,6 +2980,7 @@ AtomCore::AtomCore(BaseMachine& machine, int num_threads, const char* name)
     threadcount = th_count;
 
     coreid = machine.get_next_coreid();
+    bp_config.read_options(machine, name);
 
     threads = (AtomThread**)qemu_mallocz(threadcount*sizeof(AtomThread*));
 
@@ -2982,6 +2995,9 @@ AtomCore::AtomCore(BaseMachine& machine, int num_threads, const char* name)
 
         AtomThread* thread = new AtomThread(*this, i, ctx);
         threads[i] = thread;
+        thread->shadow_branchpred.init(machine, name,
+                &thread->st_branch_predictions,
+                &thread->st_commit.insns, coreid, i);
     }
 
     reset();
@@ -3384,6 +3400,10 @@ void AtomCore::dump_configuration(YAML::Emitter &out) const
 	YAML_KEY_VAL(out, "store_buf_size", ATOM_STORE_BUF_SIZE);
 	out << YAML::EndMap;
 
+	out << YAML::Key << "branchpred" << YAML::Value;
+	threads[0]->branchpred.impl->dump_configuration(out);
+	threads[0]->shadow_branchpred.dump_configuration(out);
+
 	out << YAML::EndMap;
 }
 
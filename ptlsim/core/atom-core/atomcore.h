@@ -13,6 +13,7 @@
 
 #include <basecore.h>
 #include <branchpred.h>
+#include <branchtrace.h>
 #include <statelist.h>
 #include <decode.h>
 
@@ -801,6 +802,8 @@ namespace ATOM_CORE_MODEL {
         W64     last_commit_cycle;
 
         BranchPredictorInterface branchpred;
+        ShadowBranchPredictors shadow_branchpred;
+        BranchTraceWriter branch_trace;
 
         /**
          * @brief Track no of un-resolved branch instructions in pipeline
@@ -1055,6 +1058,9 @@ namespace ATOM_CORE_MODEL {
         W8   threadcount;
         bool in_thread_switch;
 
+        // Branch predictor of every thread, from the core options
+        BranchPredictorConfig bp_config;
+
         AtomThread** threads;
         AtomThread*  running_thread;
 
@@ -17,6 +17,7 @@ using namespace Core;
 BaseCore::BaseCore(BaseMachine& machine, const char* name)
     : Statable(name, &machine)
       , machine(machine)
+      , rip_profiles(NULL)
 {
 }
 
@@ -18,6 +18,7 @@
 #include <memoryHierarchy.h>
 
 #include <interval.h>
+#include <ripprofile.h>
 
 namespace Core {
 
@@ -42,6 +43,7 @@ namespace Core {
 		Interval* intervals; // by vteori
 		Interval* periodic_intervals; // by vteori
 		int intervalcount;
+		RIPProfile* rip_profiles; // one per thread, see -rip-profile
     };
 
 };
@@ -0,0 +1,304 @@
+// -*- c++ -*-
+//
+// Branch Prediction: parts shared by the predictor implementations
+//
+// This program is free software; it is licensed under the
+// GNU General Public License, Version 2.
+//
+
+#ifndef _BRANCHPRED_IMPL_H_
+#define _BRANCHPRED_IMPL_H_
+
+#include <branchpred.h>
+
+// Largest return address stack, ras_size sets how much of it is used
+#define MAX_RAS_SIZE 1024
+
+template <int SIZE> struct ReturnAddressStack;
+
+template <int SIZE>
+ostream& operator <<(ostream& os, ReturnAddressStack<SIZE>& ras);
+
+// Enable to debug the return address stack (RAS) predictor mechanism
+// #define DEBUG_RAS
+
+template <int SIZE>
+struct ReturnAddressStack: public Queue<ReturnAddressStackEntry, SIZE> {
+  typedef Queue<ReturnAddressStackEntry, SIZE> base_t;
+  W8 coreid;
+  W8 threadid;
+  void reset(){
+    Queue<ReturnAddressStackEntry, SIZE>::reset();
+  }
+  void reset(W8 coreid, W8 threadid){
+    this->coreid = coreid;
+    this->threadid = threadid;
+    reset();
+  }
+
+  void push(W64 uuid, W64 rip, ReturnAddressStackEntry& old) {
+#ifdef DEBUG_RAS
+    if (logable(5)) ptl_logfile << "ReturnAddressStack::push(uuid ", uuid, ", rip ", (void*)(Waddr)rip, "):", endl;
+#endif
+    if (base_t::full()) {
+      if (logable(5)) ptl_logfile << "  Return address stack overflow: removing oldest entry to make space", endl;
+      base_t::pophead();
+    }
+
+    ReturnAddressStackEntry& e =* base_t::push();
+    assert(&e);
+
+    old = e;
+#ifdef DEBUG_RAS
+    if (logable(5)) ptl_logfile << "  Old entry: ", old, endl;
+#endif
+
+    e.uuid = uuid;
+    e.rip = rip;
+
+#ifdef DEBUG_RAS
+    if (logable(5)) { ptl_logfile << *this; }
+#endif
+  }
+
+  ReturnAddressStackEntry& pop(ReturnAddressStackEntry& old) {
+#ifdef DEBUG_RAS
+    if (logable(5)) ptl_logfile << "ReturnAddressStack::pop():", endl;
+#endif
+    if (base_t::empty()) {
+      if (logable(5)) ptl_logfile << "  Return address stack underflow: returning entry with zero fields", endl;
+      old.idx = -1;
+      old.uuid = 0;
+      old.rip = 0;
+      return old;
+    }
+
+    ReturnAddressStackEntry& e =* base_t::pop();
+    assert(&e);
+    old = e;
+#ifdef DEBUG_RAS
+    if (logable(5)) { ptl_logfile << "  Old entry: ", old, endl; ptl_logfile << *this; }
+#endif
+
+
+    return e;
+  }
+
+  W64 peek() {
+#ifdef DEBUG_RAS
+    if (logable(5)) ptl_logfile << "ReturnAddressStack::peek():", endl;
+#endif
+    if (base_t::empty()) {
+      if (logable(5)) ptl_logfile << "  Return address stack is empty: returning bogus rip 0", endl;
+      return 0;
+    }
+
+#ifdef DEBUG_RAS
+    if (logable(5)) { ptl_logfile << "  Peeking entry ", (*base_t::peektail()); }
+#endif
+
+    return base_t::peektail()->rip;
+  }
+
+  //
+  // Pop a speculative push from the stack
+  //
+  void annulpush(const ReturnAddressStackEntry& old) {
+#ifdef DEBUG_RAS
+    if (logable(5)) ptl_logfile << "ReturnAddressStack::annulpush(old index ", old.idx, ", uuid ", old.uuid, ", rip ", (void*)(Waddr)old.rip, "):", endl;
+#endif
+
+    if (base_t::empty()) {
+#ifdef DEBUG_RAS
+      if (logable(5)) ptl_logfile << "  Cannot annul: return address stack is empty", endl;
+#endif
+      return;
+    }
+
+    ReturnAddressStackEntry& e =* base_t::peektail();
+    e.uuid = old.uuid;
+    e.rip = old.rip;
+
+    ReturnAddressStackEntry dummy;
+    pop(dummy);
+#ifdef DEBUG_RAS
+    if (logable(5)) ptl_logfile << "  Popped speculative push; e.index = ", e.index(), " vs tail ", base_t::tail, endl;
+    assert(e.index() == base_t::tail);
+#endif
+
+  }
+
+  //
+  // Push the old data back on the stack
+  //
+  void annulpop(const ReturnAddressStackEntry& old) {
+#ifdef DEBUG_RAS
+    if (logable(5)) ptl_logfile << "ReturnAddressStack::annulpop(old index ", old.idx, ", uuid ", old.uuid, ", rip ", (void*)(Waddr)old.rip, "):", endl;
+#endif
+
+    if (base_t::full()) {
+#ifdef DEBUG_RAS
+      if (logable(5)) ptl_logfile << "  Cannot annul: stack is full", endl;
+#endif
+      return;
+    }
+    ReturnAddressStackEntry dummy;
+
+#ifdef DEBUG_RAS
+    if (logable(5)) ptl_logfile << "  Pushed speculative pop; old.index = ", old.index(), " vs tail ", base_t::tail, endl;
+    assert(old.index() == base_t::tail);
+#endif
+    push(old.uuid, old.rip, dummy);
+  }
+};
+
+template <int SIZE>
+ostream& operator <<(ostream& os, ReturnAddressStack<SIZE>& ras) {
+  ras.print(os);
+  return os;
+}
+
+//
+// Branch target buffer with sets and ways picked at runtime. It is
+// replaced with the MRU bit pseudo-LRU of AssociativeArray, and keeps the
+// tags of a set next to each other so a lookup touches one cache line.
+//
+struct BranchTargetBuffer {
+  dynarray<W64> tags;
+  dynarray<W64> targets;
+  dynarray<W64> mru;   // MRU bit per way, one word per set
+  int sets;
+  int ways;
+
+  void setup(int sets, int ways);
+  void reset();
+  W64* probe(W64 branchaddr);
+  W64* select(W64 branchaddr);
+  W64 storage_bits() const;
+};
+
+//
+// Saturating counter update within [lo, hi]
+//
+template <typename T>
+static inline void satupdate(T& ctr, bool up, int lo, int hi) {
+  ctr = clipto(int(ctr) + (up ? +1 : -1), lo, hi);
+}
+
+//
+// Global history of 'original' branches folded down to 'compressed' bits,
+// updated incrementally as the history shifts (Michaud's PPM/TAGE trick).
+// The history is a ring of one branch per byte where the newest is at ptr.
+//
+struct FoldedHistory {
+  W32 comp;
+  int clength;
+  int olength;
+  int outpoint;
+
+  void setup(int original, int compressed) {
+    comp = 0;
+    olength = original;
+    clength = compressed;
+    outpoint = (clength) ? (olength % clength) : 0;
+  }
+
+  void update(const dynarray<byte>& hist, int ptr) {
+    int mask = hist.count() - 1;
+    comp = (comp << 1) ^ hist[ptr & mask];
+    comp ^= hist[(ptr + olength) & mask] << outpoint;
+    comp ^= (comp >> clength);
+    comp &= (1 << clength) - 1;
+  }
+};
+
+//
+// State an implementation keeps from predict() until update() at commit.
+// Branches update in order long after they predict, so it is kept in a
+// ring indexed by PredictorUpdate::slot and matched by uuid: a slot that
+// was reused by a younger branch (only after thousands of predictions)
+// makes the update fall back to training without it.
+//
+template <typename T>
+struct PredictorCheckpoints {
+  dynarray<T> slots;
+  W32 next;
+
+  void setup(int size) {
+    slots.resize(size);
+    next = 0;
+  }
+
+  T& alloc(PredictorUpdate& update) {
+    update.slot = next++ & (slots.count() - 1);
+    T& cp = slots[update.slot];
+    cp.uuid = update.uuid;
+    return cp;
+  }
+
+  T* find(const PredictorUpdate& update) {
+    T& cp = slots[update.slot & (slots.count() - 1)];
+    return (cp.uuid == update.uuid) ? &cp : NULL;
+  }
+};
+
+// Checkpoints kept per predictor, more than the branches ever in flight
+#define PREDICTOR_CHECKPOINTS 4096
+
+//
+// BTB, RAS and the handling of each branch type shared by all predictors;
+// an implementation only supplies the conditional branch direction.
+//
+struct FrontendPredictor: public BranchPredictorImplementation {
+  BranchPredictorConfig config;
+  BranchTargetBuffer btb;
+  ReturnAddressStack<MAX_RAS_SIZE> ras;
+  W8 coreid;
+  W8 threadid;
+
+  FrontendPredictor(const BranchPredictorConfig& config, W8 coreid, W8 threadid);
+
+  void reset();
+  W64 predict(PredictorUpdate& update, int type, W64 branchaddr, W64 target);
+  void update(PredictorUpdate& update, W64 branchaddr, W64 target);
+  void updateras(PredictorUpdate& predinfo, W64 rip);
+  void annulras(const PredictorUpdate& predinfo);
+  ostream& print(ostream& os);
+  W64 storage_bits() const;
+  void dump_configuration(YAML::Emitter& out) const;
+
+  virtual void reset_direction() = 0;
+  virtual bool predict_cond(PredictorUpdate& update, W64 branchaddr) = 0;
+  virtual void update_cond(PredictorUpdate& update, W64 branchaddr, bool taken) = 0;
+  virtual W64 direction_bits() const = 0;
+  virtual void dump_direction(YAML::Emitter& out) const { }
+};
+
+//
+// Builder of an implementation with preset sizes; options set in the
+// config override the preset.
+//
+template <typename P>
+struct PresetBranchPredictorBuilder: public BranchPredictorBuilder {
+  BranchPredictorConfig preset;
+
+  PresetBranchPredictorBuilder(const char* name, int table_bits = -1, int history = -1,
+      int tables = -1, int local_bits = -1, int btb_sets = -1)
+    : BranchPredictorBuilder(name), preset(name)
+  {
+    preset.table_bits = table_bits;
+    preset.history = history;
+    preset.tables = tables;
+    preset.local_bits = local_bits;
+    preset.btb_sets = btb_sets;
+  }
+
+  BranchPredictorImplementation* get_new_predictor(const BranchPredictorConfig& config,
+      W8 coreid, W8 threadid) {
+    BranchPredictorConfig c = preset;
+    c.merge(config);
+    return new P(c, coreid, threadid);
+  }
+};
+
+#endif // _BRANCHPRED_IMPL_H_
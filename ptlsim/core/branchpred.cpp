@@ -9,429 +9,441 @@
 //
 
 #include <branchpred.h>
+#include <branchpred-impl.h>
+#include <machine.h>
 
 const char* branchpred_outcome_names[2] = {"mispred", "correct"};
 
-template <int SIZE>
-struct BimodalPredictor {
-  array<byte, SIZE> table;
-  W8 coreid;
-  W8 threadid;
-  void reset(W8 coreid, W8 threadid){
-    this->coreid = coreid;
-    this->threadid = threadid;
-    reset();
-  }
-  
-  void reset() {
-    foreach (i, SIZE) table[i] = bit(i, 0) + 1;
-  }
+ostream& operator <<(ostream& os, const ReturnAddressStackEntry& e) {
+  os << "  ", intstring(e.idx, 4), ": uuid ", intstring(e.uuid, 16), ", rip ", (void*)(Waddr)e.rip, endl;
+  return os;
+}
 
-  inline int hash(W64 branchaddr) {
-    return lowbits((branchaddr >> 16) ^ branchaddr, log2(SIZE));
-  }
+//
+// Predictor configuration
+//
+struct BranchPredictorOption {
+  const char* key;
+  const char* option;
+  int BranchPredictorConfig::*field;
+};
 
-  byte* predict(W64 branchaddr) {
-    return &table[hash(branchaddr)];
-  }
+static const BranchPredictorOption branchpred_options[] = {
+  {"table_bits", "bp_table_bits", &BranchPredictorConfig::table_bits},
+  {"tables", "bp_tables", &BranchPredictorConfig::tables},
+  {"history", "bp_history", &BranchPredictorConfig::history},
+  {"local_bits", "bp_local_bits", &BranchPredictorConfig::local_bits},
+  {"btb_sets", "btb_sets", &BranchPredictorConfig::btb_sets},
+  {"btb_ways", "btb_ways", &BranchPredictorConfig::btb_ways},
+  {"ras_size", "ras_size", &BranchPredictorConfig::ras_size},
 };
 
-template <int L1SIZE, int L2SIZE, int SHIFTWIDTH, bool HISTORYXOR>
-struct TwoLevelPredictor {
-  array<int, L1SIZE> shiftregs; // L1 history shift register(s)
-  array<byte, L2SIZE> L2table;  // L2 prediction state table
-  W8 coreid;
-  W8 threadid;
-  void reset(W8 coreid, W8 threadid){
-    this->coreid = coreid;
-    this->threadid = threadid;
-    reset();
-  }
+BranchPredictorConfig::BranchPredictorConfig(const char* type) {
+  strncpy(this->type, type, sizeof(this->type) - 1);
+  this->type[sizeof(this->type) - 1] = 0;
+  foreach (i, lengthof(branchpred_options)) this->*branchpred_options[i].field = -1;
+}
 
-  void reset() {
-    // initialize counters to weakly this-or-that
-    foreach (i, L2SIZE) L2table[i] = bit(i, 0) + 1;
+void BranchPredictorConfig::read_options(BaseMachine& machine, const char* core_name) {
+  stringbuf name;
+  if (machine.get_option(core_name, "branchpred", name)) {
+    strncpy(type, name.buf, sizeof(type) - 1);
   }
 
-  byte* predict(W64 branchaddr) {
-    int L1index = lowbits(branchaddr, log2(L1SIZE));
-    int L2index = shiftregs[L1index];
-
-    if (HISTORYXOR) {
-      L2index ^= branchaddr;
-    } else {
-      L2index |= branchaddr << SHIFTWIDTH;
-	  }
+  foreach (i, lengthof(branchpred_options)) {
+    machine.get_option(core_name, branchpred_options[i].option, this->*branchpred_options[i].field);
+  }
+}
 
-    L2index = lowbits(L2index, log2(L2SIZE));
+bool BranchPredictorConfig::set(const char* key, int value) {
+  foreach (i, lengthof(branchpred_options)) {
+    if (strcmp(key, branchpred_options[i].key) == 0) {
+      this->*branchpred_options[i].field = value;
+      return true;
+    }
+  }
+  return false;
+}
 
-    return &L2table[L2index];
+void BranchPredictorConfig::merge(const BranchPredictorConfig& other) {
+  foreach (i, lengthof(branchpred_options)) {
+    int v = other.*branchpred_options[i].field;
+    if (v != -1) this->*branchpred_options[i].field = v;
   }
-};
+}
 
-struct BTBEntry {
-  W64 target;		// last destination of branch when taken
+//
+// Parse "type[:key=value]...", e.g. "tage_sc_l:table_bits=9:tables=8"
+//
+bool BranchPredictorConfig::parse(const char* spec) {
+  stringbuf sb;
+  sb << spec;
 
-  void reset() {
-    target = 0;
-  }
+  dynarray<stringbuf*> parts;
+  sb.split(parts, ":");
 
-  ostream& print(ostream& os, W64 tag) const {
-    os << (void*)(Waddr)target;
-    return os;
+  bool ok = (parts.count() > 0);
+  if (ok) {
+    strncpy(type, parts[0]->buf, sizeof(type) - 1);
+    type[sizeof(type) - 1] = 0;
   }
-};
 
-template <int SETCOUNT, int WAYCOUNT>
-struct BranchTargetBuffer: public AssociativeArray<W64, BTBEntry, SETCOUNT, WAYCOUNT, 1> {
-  W8 coreid;
-  W8 threadid;
-  void reset(){
-    AssociativeArray<W64, BTBEntry, SETCOUNT, WAYCOUNT, 1>::reset();
-  }
-  void reset(W8 coreid, W8 threadid){
-    this->coreid = coreid;
-    this->threadid = threadid;
-    reset();
+  for (int i = 1; ok && i < parts.count(); i++) {
+    char* eq = strchr(parts[i]->buf, '=');
+    char* end = NULL;
+    if (!eq) {
+      ok = false;
+      break;
+    }
+    *eq = 0;
+    int value = strtol(eq + 1, &end, 0);
+    ok = (end != eq + 1) && set(parts[i]->buf, value);
   }
-};
-
-template <int SIZE> struct ReturnAddressStack;
 
-template <int SIZE>
-ostream& operator <<(ostream& os, ReturnAddressStack<SIZE>& ras);
+  foreach (i, parts.count()) delete parts[i];
+  return ok;
+}
 
-ostream& operator <<(ostream& os, const ReturnAddressStackEntry& e) {
-  os << "  ", intstring(e.idx, 4), ": uuid ", intstring(e.uuid, 16), ", rip ", (void*)(Waddr)e.rip, endl;
-  return os;
+//
+// Branch target buffer
+//
+void BranchTargetBuffer::setup(int sets, int ways) {
+  this->sets = 1 << msbindex(max(sets, 1));
+  this->ways = clipto(ways, 1, 64);
+  tags.resize(this->sets * this->ways);
+  targets.resize(this->sets * this->ways);
+  mru.resize(this->sets);
+  reset();
 }
 
-// Enable to debug the return address stack (RAS) predictor mechanism
-// #define DEBUG_RAS
+void BranchTargetBuffer::reset() {
+  tags.fill(InvalidTag<W64>::INVALID);
+  targets.fill(0);
+  mru.fill(0);
+}
 
-template <int SIZE>
-struct ReturnAddressStack: public Queue<ReturnAddressStackEntry, SIZE> {
-  typedef Queue<ReturnAddressStackEntry, SIZE> base_t;
-  W8 coreid;
-  W8 threadid;
-  void reset(){
-    Queue<ReturnAddressStackEntry, SIZE>::reset();
-  }
-  void reset(W8 coreid, W8 threadid){
-    this->coreid = coreid;
-    this->threadid = threadid;
-    reset();
-  }
+W64* BranchTargetBuffer::probe(W64 branchaddr) {
+  int set = lowbits(branchaddr, lsbindex(sets));
+  int base = set * ways;
 
-  void push(W64 uuid, W64 rip, ReturnAddressStackEntry& old) {
-#ifdef DEBUG_RAS
-    if (logable(5)) ptl_logfile << "ReturnAddressStack::push(uuid ", uuid, ", rip ", (void*)(Waddr)rip, "):", endl;
-#endif
-    if (base_t::full()) {
-      if (logable(5)) ptl_logfile << "  Return address stack overflow: removing oldest entry to make space", endl;
-      base_t::pophead();
+  foreach (way, ways) {
+    if (tags[base + way] == branchaddr) {
+      mru[set] |= (1ULL << way);
+      return &targets[base + way];
     }
+  }
 
-    ReturnAddressStackEntry& e =* base_t::push();
-    assert(&e);
+  return NULL;
+}
 
-    old = e;
-#ifdef DEBUG_RAS
-    if (logable(5)) ptl_logfile << "  Old entry: ", old, endl;
-#endif
+W64* BranchTargetBuffer::select(W64 branchaddr) {
+  int set = lowbits(branchaddr, lsbindex(sets));
+  int base = set * ways;
+  W64 allset = (ways == 64) ? W64(-1) : ((1ULL << ways) - 1);
+  W64& used = mru[set];
 
-    e.uuid = uuid;
-    e.rip = rip;
+  int way = -1;
+  foreach (i, ways) {
+    if (tags[base + i] == branchaddr) way = i;
+  }
 
-#ifdef DEBUG_RAS
-    if (logable(5)) { ptl_logfile << *this; }
-#endif
+  if (way < 0) {
+    way = (used == allset) ? 0 : lsbindex64(~used);
+    if (used == allset) used = 0;
+    tags[base + way] = branchaddr;
   }
 
-  ReturnAddressStackEntry& pop(ReturnAddressStackEntry& old) {
-#ifdef DEBUG_RAS
-    if (logable(5)) ptl_logfile << "ReturnAddressStack::pop():", endl;
-#endif
-    if (base_t::empty()) {
-      if (logable(5)) ptl_logfile << "  Return address stack underflow: returning entry with zero fields", endl;
-      old.idx = -1;
-      old.uuid = 0;
-      old.rip = 0;
-      return old;
-    }
+  used |= (1ULL << way);
+  if (used == allset) used = (1ULL << way);
 
-    ReturnAddressStackEntry& e =* base_t::pop();
-    assert(&e);
-    old = e;
-#ifdef DEBUG_RAS
-    if (logable(5)) { ptl_logfile << "  Old entry: ", old, endl; ptl_logfile << *this; }
-#endif
+  return &targets[base + way];
+}
 
+W64 BranchTargetBuffer::storage_bits() const {
+  // Tag above the set index and target of a 48 bit address, MRU bit
+  int tagbits = 48 - lsbindex(sets);
+  return W64(sets) * ways * (tagbits + 48 + 1);
+}
 
-    return e;
-  }
+//
+// Branch type handling shared by all implementations
+//
+FrontendPredictor::FrontendPredictor(const BranchPredictorConfig& config_, W8 coreid_, W8 threadid_)
+  : config(config_), coreid(coreid_), threadid(threadid_)
+{
+  if (config.btb_sets < 0) config.btb_sets = 1024;
+  if (config.btb_ways < 0) config.btb_ways = 4;
+  if (config.ras_size < 0) config.ras_size = MAX_RAS_SIZE;
+  config.ras_size = clipto(config.ras_size, 2, MAX_RAS_SIZE);
+
+  btb.setup(config.btb_sets, config.btb_ways);
+  ras.set_capacity(config.ras_size);
+}
 
-  W64 peek() {
-#ifdef DEBUG_RAS
-    if (logable(5)) ptl_logfile << "ReturnAddressStack::peek():", endl;
-#endif
-    if (base_t::empty()) {
-      if (logable(5)) ptl_logfile << "  Return address stack is empty: returning bogus rip 0", endl;
-      return 0;
-    }
+void FrontendPredictor::reset() {
+  reset_direction();
+  btb.reset();
+  ras.reset(coreid, threadid);
+}
 
-#ifdef DEBUG_RAS
-    if (logable(5)) { ptl_logfile << "  Peeking entry ", (*base_t::peektail()); }
-#endif
+void FrontendPredictor::updateras(PredictorUpdate& predinfo, W64 rip) {
+  if unlikely (predinfo.flags & BRANCH_HINT_RET) {
+    predinfo.ras_push = 0;
+    ras.pop(predinfo.ras_old);
+  } else if likely (predinfo.flags & BRANCH_HINT_CALL) {
+    predinfo.ras_push = 1;
+    ras.push(predinfo.uuid, rip, predinfo.ras_old);
+  }
+}
 
-    return base_t::peektail()->rip;
+//
+// NOTE: branchaddr should point to first byte *after* branching insn,
+// since x86 has variable length instructions.
+//
+W64 FrontendPredictor::predict(PredictorUpdate& update, int type, W64 branchaddr, W64 target) {
+  update.cp1 = NULL;
+  update.cp2 = NULL;
+  update.cpmeta = NULL;
+  update.flags = type;
+
+  if unlikely ((type & (BRANCH_HINT_COND|BRANCH_HINT_INDIRECT)) == 0) {
+    // Unconditional: always return target
+    return target;
+  }
+
+  bool taken = false;
+  if likely (type & BRANCH_HINT_COND) {
+    taken = predict_cond(update, branchaddr);
   }
 
   //
-  // Pop a speculative push from the stack
+  // If this is a return, find next entry that would be popped
+  // Caller is responsible for using updateras() to update the
+  // RAS once annulable resources have been allocated for this
+  // return insn.
   //
-  void annulpush(const ReturnAddressStackEntry& old) {
+  if unlikely (type & BRANCH_HINT_RET) {
 #ifdef DEBUG_RAS
-    if (logable(5)) ptl_logfile << "ReturnAddressStack::annulpush(old index ", old.idx, ", uuid ", old.uuid, ", rip ", (void*)(Waddr)old.rip, "):", endl;
+    if (logable(5)) ptl_logfile << "Peeking RAS for uuid ", update.uuid, ":", endl;
 #endif
+    return ras.peek();
+  }
 
-    if (base_t::empty()) {
-#ifdef DEBUG_RAS
-      if (logable(5)) ptl_logfile << "  Cannot annul: return address stack is empty", endl;
-#endif
-      return;
-    }
+  W64* pbtb = btb.probe(branchaddr);
 
-    ReturnAddressStackEntry& e =* base_t::peektail();
-    e.uuid = old.uuid;
-    e.rip = old.rip;
+  // if this is a jump, ignore predicted direction; we know it's taken.
+  if unlikely (!(type & BRANCH_HINT_COND)) {
+    return (pbtb ? *pbtb : target);
+  }
 
-    ReturnAddressStackEntry dummy;
-    pop(dummy);
-#ifdef DEBUG_RAS
-    if (logable(5)) ptl_logfile << "  Popped speculative push; e.index = ", e.index(), " vs tail ", base_t::tail, endl;
-    assert(e.index() == base_t::tail);
-#endif
+  return (taken) ? target : branchaddr;
+}
 
-  }
+void FrontendPredictor::update(PredictorUpdate& update, W64 branchaddr, W64 target) {
+  int type = update.flags;
+
+  bool taken = (target != branchaddr);
 
   //
-  // Push the old data back on the stack
+  // keep stats about JMPs; also, but don't change any pred state for JMPs
+  // which are returns.
   //
-  void annulpop(const ReturnAddressStackEntry& old) {
-#ifdef DEBUG_RAS
-    if (logable(5)) ptl_logfile << "ReturnAddressStack::annulpop(old index ", old.idx, ", uuid ", old.uuid, ", rip ", (void*)(Waddr)old.rip, "):", endl;
-#endif
+  if unlikely (type & BRANCH_HINT_INDIRECT) {
+    if unlikely (type & BRANCH_HINT_RET) return;
+  }
 
-    if (base_t::full()) {
-#ifdef DEBUG_RAS
-      if (logable(5)) ptl_logfile << "  Cannot annul: stack is full", endl;
-#endif
-      return;
-    }
-    ReturnAddressStackEntry dummy;
+  if likely (type & BRANCH_HINT_COND) {
+    update_cond(update, branchaddr, taken);
+  }
+
+  //
+  // Update BTB entry if it's a taken branch (don't allocate for non-taken),
+  // either the matching entry or the pseudo-LRU one of its set.
+  //
+  if (taken) {
+    *btb.select(branchaddr) = target;
+  }
+}
 
+//
+// Speculative execution can corrupt the RAS, since entries will be pushed
+// as call insns are fetched. If those call insns were along an incorrect
+// branch path, they must be annulled.
+//
+void FrontendPredictor::annulras(const PredictorUpdate& predinfo) {
 #ifdef DEBUG_RAS
-    if (logable(5)) ptl_logfile << "  Pushed speculative pop; old.index = ", old.index(), " vs tail ", base_t::tail, endl;
-    assert(old.index() == base_t::tail);
+  if (logable(5)) ptl_logfile << "Update RAS for uuid ", predinfo.uuid, ":", endl;
 #endif
-    push(old.uuid, old.rip, dummy);
-  }
-};
+  if (predinfo.ras_push)
+    ras.annulpush(predinfo.ras_old);
+  else ras.annulpop(predinfo.ras_old);
+}
 
-template <int SIZE>
-ostream& operator <<(ostream& os, ReturnAddressStack<SIZE>& ras) {
-  ras.print(os);
+ostream& FrontendPredictor::print(ostream& os) {
+  os << ras;
   return os;
 }
 
-template <int METASIZE, int BIMODSIZE, int L1SIZE, int L2SIZE, int SHIFTWIDTH, bool HISTORYXOR, int BTBSETS, int BTBWAYS, int RASSIZE>
-struct CombinedPredictor {
-  TwoLevelPredictor<L1SIZE, L2SIZE, SHIFTWIDTH, HISTORYXOR> twolevel;
-  BimodalPredictor<BIMODSIZE> bimodal;
-  BimodalPredictor<METASIZE> meta;
-
-  BranchTargetBuffer<BTBSETS, BTBWAYS> btb;
-  ReturnAddressStack<RASSIZE> ras;
-  W8 coreid;
-  W8 threadid; 
-  CombinedPredictor(W8 coreid_, W8 threadid_): coreid(coreid_), threadid(threadid_){};
-  void reset() {
-//     twolevel.reset();
-//     bimodal.reset();
-//     meta.reset();
-//     btb.reset();
-//     ras.reset();
-    twolevel.reset(coreid, threadid);
-    bimodal.reset(coreid, threadid);
-    meta.reset(coreid, threadid);
-    btb.reset(coreid, threadid);
-    ras.reset(coreid, threadid);
-  }
+W64 FrontendPredictor::storage_bits() const {
+  return direction_bits() + btb.storage_bits() + W64(config.ras_size) * 48;
+}
 
+void FrontendPredictor::dump_configuration(YAML::Emitter& out) const {
+  out << YAML::BeginMap;
+  YAML_KEY_VAL(out, "type", config.type);
+  dump_direction(out);
+  YAML_KEY_VAL(out, "btb_sets", btb.sets);
+  YAML_KEY_VAL(out, "btb_ways", btb.ways);
+  YAML_KEY_VAL(out, "ras_size", config.ras_size);
+  YAML_KEY_VAL(out, "direction_kb", (double(direction_bits()) / 8192.0));
+  YAML_KEY_VAL(out, "storage_kb", (double(storage_bits()) / 8192.0));
+  out << YAML::EndMap;
+}
 
-  void updateras(PredictorUpdate& predinfo, W64 rip) {
-    if unlikely (predinfo.flags & BRANCH_HINT_RET) {
-      predinfo.ras_push = 0;
-      ras.pop(predinfo.ras_old);
-    } else if likely (predinfo.flags & BRANCH_HINT_CALL) {
-      predinfo.ras_push = 1;
-      ras.push(predinfo.uuid, rip, predinfo.ras_old);
-    }
+//
+// Combined bimodal and two-level predictor with a meta predictor to choose
+// between them. The two-level part uses one global history xor'ed with the
+// branch address (gshare) or, with local_bits, per branch histories
+// concatenated with the address.
+//
+struct CombinedPredictor: public FrontendPredictor {
+  dynarray<byte> bimodal;
+  dynarray<byte> meta;
+  dynarray<byte> twolevel;     // L2 prediction state table
+  dynarray<int> shiftregs;     // L1 history shift register(s)
+  int tablebits;
+  int histbits;
+  int localbits;
+
+  static BranchPredictorConfig defaults(const BranchPredictorConfig& c) {
+    BranchPredictorConfig d = c;
+    if (d.table_bits < 0) d.table_bits = 16;
+    if (d.history < 0) d.history = d.table_bits;
+    if (d.local_bits < 0) d.local_bits = 0;
+    d.table_bits = clipto(d.table_bits, 4, 24);
+    d.history = clipto(d.history, 1, 30);
+    d.local_bits = clipto(d.local_bits, 0, 20);
+    return d;
   }
 
-  //
-  // NOTE: branchaddr should point to first byte *after* branching insn,
-  // since x86 has variable length instructions.
-  //
-  W64 predict(PredictorUpdate& update, int type, W64 branchaddr, W64 target) {
-    update.cp1 = NULL;
-    update.cp2 = NULL;
-    update.cpmeta = NULL;
-    update.flags = type;
-
-    if unlikely ((type & (BRANCH_HINT_COND|BRANCH_HINT_INDIRECT)) == 0) {
-      // Unconditional: always return target
-      return target;
-    }
+  CombinedPredictor(const BranchPredictorConfig& config, W8 coreid, W8 threadid)
+    : FrontendPredictor(defaults(config), coreid, threadid)
+  {
+    tablebits = this->config.table_bits;
+    histbits = this->config.history;
+    localbits = this->config.local_bits;
+
+    bimodal.resize(1 << tablebits);
+    meta.resize(1 << tablebits);
+    twolevel.resize(1 << tablebits);
+    shiftregs.resize(1 << localbits, 0);
+  }
 
-    if likely (type & BRANCH_HINT_COND) {
-      byte& bimodalctr = *bimodal.predict(branchaddr);
-      byte& twolevelctr = *twolevel.predict(branchaddr);
-      byte& metactr = *meta.predict(branchaddr);
-      update.cpmeta = &metactr;
-      update.meta  = (metactr >= 2);
-      update.bimodal = (bimodalctr >= 2);
-      update.twolevel  = (twolevelctr >= 2);
-      if (metactr >= 2) {
-        update.cp1 = &twolevelctr;
-	      update.cp2 = &bimodalctr;
-	    } else {
-	      update.cp1 = &bimodalctr;
-	      update.cp2 = &twolevelctr;
-	    }
+  void reset_direction() {
+    // initialize counters to weakly this-or-that
+    foreach (i, bimodal.count()) {
+      bimodal[i] = bit(i, 0) + 1;
+      meta[i] = bit(i, 0) + 1;
+      twolevel[i] = bit(i, 0) + 1;
     }
+  }
 
-    //
-    // If this is a return, find next entry that would be popped
-    // Caller is responsible for using updateras() to update the
-    // RAS once annulable resources have been allocated for this
-    // return insn.
-    //
-    if unlikely (type & BRANCH_HINT_RET) {
-#ifdef DEBUG_RAS
-      if (logable(5)) ptl_logfile << "Peeking RAS for uuid ", update.uuid, ":", endl;
-#endif
-      return ras.peek();
-    }
+  inline int bimodal_index(W64 branchaddr) const {
+    return lowbits((branchaddr >> 16) ^ branchaddr, tablebits);
+  }
 
-    BTBEntry* pbtb = btb.probe(branchaddr);
+  inline int twolevel_index(W64 branchaddr) const {
+    W64 index = shiftregs[lowbits(branchaddr, localbits)];
 
-    // if this is a jump, ignore predicted direction; we know it's taken.
-    if unlikely (!(type & BRANCH_HINT_COND)) {
-      return (pbtb ? pbtb->target : target);
+    if (localbits) {
+      index |= branchaddr << histbits;
+    } else {
+      index ^= branchaddr;
     }
 
-    //
-    // Predict conditional branch:
-    //
-    return (*(update.cp1) >= 2) ? target : branchaddr;
+    return lowbits(index, tablebits);
   }
 
-  void update(PredictorUpdate& update, W64 branchaddr, W64 target) {
-    int type = update.flags;
-
-    bool taken = (target != branchaddr);
-
-    //
-    // keep stats about JMPs; also, but don't change any pred state for JMPs
-    // which are returns.
-    //
-    if unlikely (type & BRANCH_HINT_INDIRECT) {
-      if unlikely (type & BRANCH_HINT_RET) return;
-    }
-
-    //
-    // L1 table is updated unconditionally for combining predictor too:
-    //
-    if likely (type & BRANCH_HINT_COND) {
-      int l1index = lowbits(branchaddr, log2(L1SIZE));
-      twolevel.shiftregs[l1index] = lowbits((twolevel.shiftregs[l1index] << 1) | taken, SHIFTWIDTH);
+  bool predict_cond(PredictorUpdate& update, W64 branchaddr) {
+    byte& bimodalctr = bimodal[bimodal_index(branchaddr)];
+    byte& twolevelctr = twolevel[twolevel_index(branchaddr)];
+    byte& metactr = meta[bimodal_index(branchaddr)];
+    update.cpmeta = &metactr;
+    update.meta  = (metactr >= 2);
+    update.bimodal = (bimodalctr >= 2);
+    update.twolevel  = (twolevelctr >= 2);
+    if (metactr >= 2) {
+      update.cp1 = &twolevelctr;
+      update.cp2 = &bimodalctr;
+    } else {
+      update.cp1 = &bimodalctr;
+      update.cp2 = &twolevelctr;
     }
 
-    //
-    // Find BTB entry if it's a taken branch (don't allocate for non-taken)
-    //
-    BTBEntry* pbtb = (taken) ? btb.select(branchaddr) : NULL;
-
-    //
-    // Now p is a possibly NULL pointer into the direction prediction table, 
-    // and pbtb is a possibly NULL pointer into the BTB (either to a 
-    // matched-on entry or a victim which was LRU in its set)
-    //
+    return (*update.cp1 >= 2);
+  }
 
+  void update_cond(PredictorUpdate& update, W64 branchaddr, bool taken) {
     //
-    // update state (but not for jumps)
+    // L1 table is updated unconditionally for combining predictor too:
     //
-    if likely (update.cp1) {
-      byte& counter = *update.cp1;
-      counter = clipto(counter + (taken ? +1 : -1), 0, 3);
-    }
+    int l1index = lowbits(branchaddr, localbits);
+    shiftregs[l1index] = lowbits((shiftregs[l1index] << 1) | taken, histbits);
 
     //
     // combining predictor also updates second predictor and meta predictor
-    // second direction predictor
     //
-    if likely (update.cp2) {
-      byte& counter = *update.cp2;
-      counter = clipto(counter + (taken ? +1 : -1), 0, 3);
-    }
+    satupdate(*update.cp1, taken, 0, 3);
+    satupdate(*update.cp2, taken, 0, 3);
 
     //
-    // Update meta predictor
+    // We only update meta predictor if directions were different.
+    // We increment the counter if the twolevel predictor was correct;
+    // if the bimodal predictor was correct, we decrement it.
     //
-    if likely (update.cpmeta) {
-      if (update.bimodal != update.twolevel) {
-        //
-        // We only update meta predictor if directions were different.
-        // We increment the counter if the twolevel predictor was correct; 
-        // if the bimodal predictor was correct, we decrement it.
-        //
-        byte& counter = *update.cpmeta;
-        bool twolevel_or_bimodal = (update.twolevel == taken);
-        counter = clipto(counter + (twolevel_or_bimodal ? +1 : -1), 0, 3);
-      }
+    if (update.bimodal != update.twolevel) {
+      satupdate(*update.cpmeta, (update.twolevel == taken), 0, 3);
     }
+  }
 
-    //
-    // update BTB (but only for taken branches)
-    //
-    if likely (pbtb) {
-      // Update either the entry selected above, or if not found, use the LRU entry:
-      pbtb->target = target;
-    }
+  W64 direction_bits() const {
+    return W64(3 << tablebits) * 2 + W64(1 << localbits) * histbits;
   }
 
-  //
-  // Speculative execution can corrupt the RAS, since entries will be pushed
-  // as call insns are fetched. If those call insns were along an incorrect
-  // branch path, they must be annulled.
-  //
-  void annulras(const PredictorUpdate& predinfo) {
-#ifdef DEBUG_RAS
-    if (logable(5)) ptl_logfile << "Update RAS for uuid ", predinfo.uuid, ":", endl;
-#endif
-    if (predinfo.ras_push)
-      ras.annulpush(predinfo.ras_old);
-    else ras.annulpop(predinfo.ras_old);
+  void dump_direction(YAML::Emitter& out) const {
+    YAML_KEY_VAL(out, "table_bits", tablebits);
+    YAML_KEY_VAL(out, "history", histbits);
+    YAML_KEY_VAL(out, "local_bits", localbits);
   }
 };
 
-// template <int METASIZE, int BIMODSIZE, int L1SIZE, int L2SIZE, int SHIFTWIDTH, bool HISTORYXOR, int BTBSETS, int BTBWAYS, int RASSIZE>
-// G-share constraints: METASIZE, BIMODSIZE, 1, L2SIZE, log2(L2SIZE), (HISTORYXOR = true), BTBSETS, BTBWAYS, RASSIZE
-struct BranchPredictorImplementation: public CombinedPredictor<65536, 65536, 1, 65536, 16, 1, 1024, 4, 1024> {
-  BranchPredictorImplementation(W8 coreid, W8 threadid):CombinedPredictor<65536, 65536, 1, 65536, 16, 1, 1024, 4, 1024> (coreid, threadid){}
- };
+//
+// Predictor builders
+//
+BranchPredictorBuilder::BranchPredictorBuilder(const char* name) {
+  if (!builders) builders = new Hashtable<const char*, BranchPredictorBuilder*, 1>();
+  builders->add(name, this);
+}
+
+Hashtable<const char*, BranchPredictorBuilder*, 1>* BranchPredictorBuilder::builders = NULL;
+
+BranchPredictorImplementation* BranchPredictorBuilder::create_predictor(const BranchPredictorConfig& config,
+    W8 coreid, W8 threadid) {
+  BranchPredictorBuilder** builder = (builders) ? builders->get(config.type) : NULL;
+  if (!builder) return NULL;
+  return (*builder)->get_new_predictor(config, coreid, threadid);
+}
+
+BranchPredictorImplementation* BranchPredictorBuilder::create_predictor(const char* name, W8 coreid, W8 threadid) {
+  BranchPredictorConfig config(name);
+  return create_predictor(config, coreid, threadid);
+}
+
+// name, table_bits, history, tables, local_bits, btb_sets
+PresetBranchPredictorBuilder<CombinedPredictor> combined_builder("combined", 16, 16);
+PresetBranchPredictorBuilder<CombinedPredictor> combined_16k_builder("combined_16k", 14, 14, -1, -1, 512);
+PresetBranchPredictorBuilder<CombinedPredictor> combined_4k_builder("combined_4k", 12, 12, -1, -1, 256);
+PresetBranchPredictorBuilder<CombinedPredictor> local_builder("local", 14, 10, -1, 10);
 
 void BranchPredictorInterface::destroy() {
   if (impl) delete impl;
@@ -443,11 +455,21 @@ void BranchPredictorInterface::reset() {
 }
 
 void BranchPredictorInterface::init(W8 coreid, W8 threadid) {
+  init(BranchPredictorConfig(), coreid, threadid);
+}
+
+void BranchPredictorInterface::init(const BranchPredictorConfig& config, W8 coreid, W8 threadid) {
   destroy();
-  //  impl = new BranchPredictorImplementation();
-  impl = new BranchPredictorImplementation(coreid, threadid);
+  impl = BranchPredictorBuilder::create_predictor(config, coreid, threadid);
+  if (!impl) {
+    stringbuf err;
+    err << "::ERROR::Can't find branch predictor '", config.type,
+        "'. Please check your config file.", endl;
+    ptl_logfile << err;
+    cout << err;
+    assert(impl);
+  }
   reset();
-  
 }
 
 W64 BranchPredictorInterface::predict(PredictorUpdate& update, int type, W64 branchaddr, W64 target) {
@@ -469,6 +491,121 @@ void BranchPredictorInterface::annulras(const PredictorUpdate& predinfo) {
 void BranchPredictorInterface::flush() { }
 
 ostream& operator <<(ostream& os, const BranchPredictorInterface& branchpred) {
-  os << branchpred.impl->ras;
-  return os;
+  return branchpred.impl->print(os);
+}
+
+//
+// Shadow predictors
+//
+void ShadowBranchPredictors::init(BaseMachine& machine, const char* core_name, Statable* parent,
+    StatObj<W64>* insns, W8 coreid, W8 threadid) {
+  destroy();
+
+  stringbuf spec;
+  if (!machine.get_option(core_name, "shadow_branchpred", spec)) return;
+
+  if (!add(spec.buf, parent, insns, coreid, threadid)) {
+    stringbuf err;
+    err << "::ERROR::Invalid shadow_branchpred of ", core_name, ". Please check your config file.", endl;
+    ptl_logfile << err;
+    cout << err;
+    assert(0);
+  }
+}
+
+//
+// Add the predictors listed in spec, separated by commas or spaces.
+// Returns false, after adding those before it, at an unknown predictor.
+//
+bool ShadowBranchPredictors::add(const char* spec, Statable* parent, StatObj<W64>* insns,
+    W8 coreid, W8 threadid) {
+  stringbuf sb;
+  sb << spec;
+
+  dynarray<stringbuf*> names;
+  sb.split(names, ", ");
+
+  bool ok = true;
+
+  foreach (i, names.count()) {
+    const char* name = names[i]->buf;
+    BranchPredictorConfig config;
+    BranchPredictorImplementation* p = NULL;
+
+    if (config.parse(name)) {
+      p = BranchPredictorBuilder::create_predictor(config, coreid, threadid);
+    }
+
+    if (!p) {
+      stringbuf err;
+      err << "::ERROR::Can't create branch predictor '", name, "'", endl;
+      ptl_logfile << err;
+      cout << err;
+      ok = false;
+      break;
+    }
+    p->reset();
+
+    // Keys like tage_sc_l:tables=8 become shadow_tage_sc_l_tables_8
+    stringbuf stats_name;
+    stats_name << "shadow_", name;
+    for (char* c = stats_name.buf; *c; c++) {
+      if (*c == ':' || *c == '=') *c = '_';
+    }
+
+    ShadowBranchStats* s = new ShadowBranchStats(stats_name.buf, parent, insns);
+    s->set_default_stats(user_stats);
+
+    predictors.push(p);
+    stats.push(s);
+  }
+
+  foreach (i, names.count()) delete names[i];
+  return ok;
+}
+
+void ShadowBranchPredictors::reset() {
+  foreach (i, predictors.count()) predictors[i]->reset();
+}
+
+void ShadowBranchPredictors::destroy() {
+  // Stats stay registered in the stats tree, only the tables are freed
+  foreach (i, predictors.count()) delete predictors[i];
+  predictors.clear();
+  stats.clear();
+}
+
+//
+// Predict and train every shadow with a committed branch. Its target is
+// the rip after the branch, branchaddr is the next sequential insn.
+//
+void ShadowBranchPredictors::commit(const PredictorUpdate& predinfo, W64 branchaddr, W64 riptaken, W64 target) {
+  int type = predinfo.flags;
+  bool cond = (type & BRANCH_HINT_COND);
+  bool ret = (type & BRANCH_HINT_RET);
+  bool indir = (type & BRANCH_HINT_INDIRECT) && !ret;
+
+  foreach (i, predictors.count()) {
+    BranchPredictorImplementation* p = predictors[i];
+    PredictorUpdate update = predinfo;
+
+    W64 predrip = p->predict(update, type, branchaddr, riptaken);
+    p->updateras(update, branchaddr);
+    p->update(update, branchaddr, target);
+
+    bool correct = (predrip == target);
+    ShadowBranchStats& s = *stats[i];
+    s.summary.count(correct);
+    if (cond) s.cond.count(correct);
+    if (indir) s.indir.count(correct);
+    if (ret) s.ret.count(correct);
+  }
+}
+
+void ShadowBranchPredictors::dump_configuration(YAML::Emitter& out) const {
+  if (!predictors.count()) return;
+
+  out << YAML::Key << "shadow_branchpred" << YAML::Value << YAML::BeginSeq;
+  foreach (i, predictors.count()) predictors[i]->dump_configuration(out);
+  out << YAML::EndSeq;
 }
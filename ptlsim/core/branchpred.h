@@ -12,6 +12,9 @@
 #define _BRANCHPRED_H_
 
 #include <ptlsim.h>
+#include <statsBuilder.h>
+
+struct BaseMachine;
 
 
 #define BRANCH_HINT_UNCOND      0
@@ -48,6 +51,8 @@ struct PredictorUpdate {
   byte* cpmeta;
   // predicted directions:
   W32 ctxid:8, flags:8, bimodal:1, twolevel:1, meta:1, ras_push:1;
+  // checkpoint of predictors that keep per branch state until update
+  W32 slot;
   ReturnAddressStackEntry ras_old;
 };
 
@@ -57,7 +62,67 @@ extern W64 branchpred_ras_pops;
 extern W64 branchpred_ras_underflows;
 extern W64 branchpred_ras_annuls;
 
-struct BranchPredictorImplementation;
+//
+// Predictor selection and sizes, read from the core's options:
+//
+//   branchpred:     implementation, see BranchPredictorBuilder (combined)
+//   bp_table_bits:  log2 entries of the main direction tables
+//   bp_tables:      tagged tables (TAGE) or weight tables (perceptron)
+//   bp_history:     longest global history in branches
+//   bp_local_bits:  log2 per branch histories of the combined predictor,
+//                   0 for one global history
+//   btb_sets:       rounded down to a power of two
+//   btb_ways, ras_size
+//
+// Options left at -1 take the implementation's default.
+//
+struct BranchPredictorConfig {
+  char type[32];
+  int table_bits;
+  int tables;
+  int history;
+  int local_bits;
+  int btb_sets;
+  int btb_ways;
+  int ras_size;
+
+  BranchPredictorConfig(const char* type = "combined");
+
+  void read_options(BaseMachine& machine, const char* core_name);
+  bool set(const char* key, int value);
+  void merge(const BranchPredictorConfig& other);
+  bool parse(const char* spec);
+};
+
+//
+// Predictor algorithm behind a BranchPredictorInterface. Implementations
+// register a BranchPredictorBuilder under a name, so the active predictor
+// and any shadow predictors can be picked without a rebuild.
+//
+struct BranchPredictorImplementation {
+  virtual ~BranchPredictorImplementation() { }
+  virtual void reset() = 0;
+  virtual W64 predict(PredictorUpdate& update, int type, W64 branchaddr, W64 target) = 0;
+  virtual void update(PredictorUpdate& update, W64 branchaddr, W64 target) = 0;
+  virtual void updateras(PredictorUpdate& predinfo, W64 branchaddr) = 0;
+  virtual void annulras(const PredictorUpdate& predinfo) = 0;
+  virtual ostream& print(ostream& os) = 0;
+
+  // Bits of state a hardware version would need
+  virtual W64 storage_bits() const = 0;
+  virtual void dump_configuration(YAML::Emitter& out) const = 0;
+};
+
+struct BranchPredictorBuilder {
+  BranchPredictorBuilder(const char* name);
+  virtual BranchPredictorImplementation* get_new_predictor(const BranchPredictorConfig& config,
+      W8 coreid, W8 threadid) = 0;
+  static Hashtable<const char*, BranchPredictorBuilder*, 1>* builders;
+
+  static BranchPredictorImplementation* create_predictor(const BranchPredictorConfig& config,
+      W8 coreid, W8 threadid);
+  static BranchPredictorImplementation* create_predictor(const char* name, W8 coreid, W8 threadid);
+};
 
 struct BranchPredictorInterface {
   // Pointer to private implementation:
@@ -66,6 +131,7 @@ struct BranchPredictorInterface {
   BranchPredictorInterface() { impl = NULL; }
   //  void init();
   void init(W8 coreid, W8 threadid);
+  void init(const BranchPredictorConfig& config, W8 coreid, W8 threadid);
   void reset();
   void destroy();
   W64 predict(PredictorUpdate& update, int type, W64 branchaddr, W64 target);
@@ -79,6 +145,77 @@ ostream& operator <<(ostream& os, const BranchPredictorInterface& branchpred);
 
 extern BranchPredictorInterface branchpred;
 
+//
+// Per branch type outcome of a shadow predictor. MPKI is relative to the
+// instructions committed by the thread.
+//
+struct ShadowBranchTypeStats : public Statable {
+  StatObj<W64> branches;
+  StatObj<W64> mispred;
+  StatEquation<W64, double, StatObjFormulaDiv> mispred_rate;
+  StatEquation<W64, double, StatObjFormulaPerKilo> mpki;
+
+  ShadowBranchTypeStats(const char* name, Statable* parent, StatObj<W64>* insns)
+    : Statable(name, parent)
+    , branches("branches", this)
+    , mispred("mispred", this)
+    , mispred_rate("mispred_rate", this)
+    , mpki("mpki", this)
+  {
+    mispred_rate.add_elem(&mispred);
+    mispred_rate.add_elem(&branches);
+    mpki.add_elem(&mispred);
+    mpki.add_elem(insns);
+  }
+
+  void count(bool correct) {
+    branches++;
+    if (!correct) mispred++;
+  }
+};
+
+struct ShadowBranchStats : public Statable {
+  ShadowBranchTypeStats cond;
+  ShadowBranchTypeStats indir;
+  ShadowBranchTypeStats ret;
+  ShadowBranchTypeStats summary;
+
+  ShadowBranchStats(const char* name, Statable* parent, StatObj<W64>* insns)
+    : Statable(name, parent)
+    , cond("cond", this, insns)
+    , indir("indir", this, insns)
+    , ret("ret", this, insns)
+    , summary("summary", this, insns)
+  { }
+};
+
+//
+// Predictors that see the committed branch stream next to the active one.
+// Each is trained in commit order with its own RAS, never affects fetch,
+// and reports under 'shadow_<name>' in the thread's branchpred stats. They
+// are listed in the core's 'shadow_branchpred' option, e.g.
+//
+//   shadow_branchpred: "combined_16k, local, tage_sc_l:table_bits=9"
+//
+// where each entry may set any BranchPredictorConfig key (without the bp_
+// prefix) after a colon.
+//
+struct ShadowBranchPredictors {
+  dynarray<BranchPredictorImplementation*> predictors;
+  dynarray<ShadowBranchStats*> stats;
+
+  ShadowBranchPredictors() { }
+  ~ShadowBranchPredictors() { destroy(); }
+
+  void init(BaseMachine& machine, const char* core_name, Statable* parent,
+      StatObj<W64>* insns, W8 coreid, W8 threadid);
+  bool add(const char* spec, Statable* parent, StatObj<W64>* insns, W8 coreid, W8 threadid);
+  void reset();
+  void destroy();
+  void commit(const PredictorUpdate& predinfo, W64 branchaddr, W64 riptaken, W64 target);
+  void dump_configuration(YAML::Emitter& out) const;
+};
+
 extern const char* branchpred_outcome_names[2];
 
 #endif // _BRANCHPRED_H_
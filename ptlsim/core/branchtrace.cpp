@@ -0,0 +1,344 @@
+#include <branchtrace.h>
+
+/*
+ * All threads write into one buffer, so a thread switch record is needed
+ * whenever the writer differs from the previous one.
+ */
+static byte trace_buf[BRANCH_TRACE_BUFFER];
+static int trace_used = 0;
+static const BranchTraceWriter* trace_owner = NULL;
+
+static inline void put_varint(W64 v)
+{
+	while (v >= 0x80) {
+		trace_buf[trace_used++] = byte(v | 0x80);
+		v >>= 7;
+	}
+	trace_buf[trace_used++] = byte(v);
+}
+
+static inline W64 zigzag(W64 delta)
+{
+	return (delta << 1) ^ W64(W64s(delta) >> 63);
+}
+
+static inline W64 unzigzag(W64 v)
+{
+	return (v >> 1) ^ -(v & 1);
+}
+
+void BranchTraceWriter::init(W16 coreid, W16 threadid)
+{
+	this->coreid = coreid;
+	this->threadid = threadid;
+	last_insns = 0;
+	last_addr = 0;
+}
+
+/**
+ * @brief Write the file header and forget the previous writer
+ */
+void BranchTraceWriter::start(ostream& os)
+{
+	BranchTraceHeader header;
+	setzero(header);
+	header.magic = BRANCH_TRACE_MAGIC;
+	header.version = BRANCH_TRACE_VERSION;
+
+	os.write((char*)&header, sizeof(header));
+	trace_used = 0;
+	trace_owner = NULL;
+}
+
+void BranchTraceWriter::flush(ostream& os)
+{
+	os.write((char*)trace_buf, trace_used);
+	os.flush();
+	trace_used = 0;
+}
+
+/**
+ * @brief Append a committed branch
+ *
+ * @param type BRANCH_HINT_* flags the branch was predicted with
+ * @param branchaddr Rip after the branch
+ * @param riptaken Taken target
+ * @param target Rip committed after the branch
+ * @param insns Total insns committed by the thread
+ * @param kernel Branch committed in kernel mode
+ */
+void BranchTraceWriter::record(ostream& os, int type, W64 branchaddr,
+		W64 riptaken, W64 target, W64 insns, bool kernel)
+{
+	// Longest record: switch, then tag and four 10 byte varints
+	if unlikely (trace_used > BRANCH_TRACE_BUFFER - 64)
+		flush(os);
+
+	if unlikely (trace_owner != this) {
+		trace_buf[trace_used++] = BRANCH_TRACE_SWITCH;
+		put_varint(coreid);
+		put_varint(threadid);
+		trace_owner = this;
+	}
+
+	bool taken = (target != branchaddr);
+	bool implicit = (target == (taken ? riptaken : branchaddr));
+
+	byte tag = (type & BRANCH_TRACE_TYPE);
+	if (taken) tag |= BRANCH_TRACE_TAKEN;
+	if (!implicit) tag |= BRANCH_TRACE_TARGET;
+	if (kernel) tag |= BRANCH_TRACE_KERNEL;
+	trace_buf[trace_used++] = tag;
+
+	// The thread's count restarts when its core is reset
+	put_varint((insns >= last_insns) ? insns - last_insns : insns);
+	put_varint(zigzag(branchaddr - last_addr));
+	put_varint(zigzag(riptaken - branchaddr));
+	if (!implicit)
+		put_varint(zigzag(target - branchaddr));
+
+	last_insns = insns;
+	last_addr = branchaddr;
+}
+
+BranchTraceReader::BranchTraceReader(istream& is)
+	: is(is)
+	, pos(0)
+	, len(0)
+	, current(-1)
+	, header_ok(false)
+{
+	BranchTraceHeader header;
+	is.read((char*)&header, sizeof(header));
+
+	header_ok = (is.gcount() == sizeof(header) &&
+			header.magic == BRANCH_TRACE_MAGIC &&
+			header.version == BRANCH_TRACE_VERSION);
+}
+
+bool BranchTraceReader::fill()
+{
+	if (!is)
+		return false;
+
+	is.read((char*)buf, sizeof(buf));
+	len = is.gcount();
+	pos = 0;
+	return (len > 0);
+}
+
+bool BranchTraceReader::getvarint(W64& v)
+{
+	byte b;
+	int shift = 0;
+	v = 0;
+
+	do {
+		if (!getbyte(b) || shift > 63)
+			return false;
+		v |= W64(b & 0x7f) << shift;
+		shift += 7;
+	} while (b & 0x80);
+
+	return true;
+}
+
+int BranchTraceReader::find_stream(W16 coreid, W16 threadid)
+{
+	foreach (i, streams.count()) {
+		if (streams[i].coreid == coreid && streams[i].threadid == threadid)
+			return i;
+	}
+
+	Stream s;
+	s.coreid = coreid;
+	s.threadid = threadid;
+	s.last_addr = 0;
+	streams.push(s);
+	return streams.count() - 1;
+}
+
+int BranchTraceReader::next(BranchTraceRecord& rec)
+{
+	if (!header_ok)
+		return -1;
+
+	byte tag;
+	W64 v;
+
+	if (!getbyte(tag))
+		return -1;
+
+	if (tag == BRANCH_TRACE_SWITCH) {
+		W64 coreid, threadid;
+		if (!getvarint(coreid) || !getvarint(threadid) || !getbyte(tag))
+			return -1;
+		current = find_stream(coreid, threadid);
+	}
+
+	// A truncated file or records before the first switch end the trace
+	if (current < 0 || (tag & BRANCH_TRACE_SWITCH))
+		return -1;
+
+	Stream& s = streams[current];
+
+	rec.type = tag & BRANCH_TRACE_TYPE;
+	rec.kernel = (tag & BRANCH_TRACE_KERNEL);
+
+	if (!getvarint(rec.insns)) return -1;
+	if (!getvarint(v)) return -1;
+	rec.branchaddr = s.last_addr + unzigzag(v);
+	if (!getvarint(v)) return -1;
+	rec.riptaken = rec.branchaddr + unzigzag(v);
+
+	if (tag & BRANCH_TRACE_TARGET) {
+		if (!getvarint(v)) return -1;
+		rec.target = rec.branchaddr + unzigzag(v);
+	} else {
+		rec.target = (tag & BRANCH_TRACE_TAKEN) ? rec.riptaken : rec.branchaddr;
+	}
+
+	s.last_addr = rec.branchaddr;
+	return current;
+}
+
+const char* branch_oracle_outcome_names[BRANCH_ORACLE_OUTCOMES] = {
+	"match", "skipped", "missing", "wrong"};
+
+BranchOracle::BranchOracle()
+	: reader(NULL)
+	, coreid(0)
+	, threadid(0)
+	, stream(-1)
+	, eof(true)
+	, head(0)
+	, fetch(0)
+	, tail(0)
+{
+}
+
+BranchOracle::~BranchOracle()
+{
+	close();
+}
+
+/**
+ * @brief Start predicting from the records of one thread of a trace
+ *
+ * @return false if the file isn't a branch trace
+ */
+bool BranchOracle::open(const char* filename, W16 coreid, W16 threadid)
+{
+	close();
+
+	is.open(filename, std::ios::binary);
+	if (!is)
+		return false;
+
+	reader = new BranchTraceReader(is);
+	if (!reader->valid()) {
+		close();
+		return false;
+	}
+
+	this->coreid = coreid;
+	this->threadid = threadid;
+	stream = -1;
+	eof = false;
+	window.resize(BRANCH_ORACLE_WINDOW);
+	head = fetch = tail = 0;
+	return true;
+}
+
+void BranchOracle::close()
+{
+	if (reader) {
+		delete reader;
+		reader = NULL;
+	}
+
+	if (is.is_open())
+		is.close();
+	is.clear();
+	eof = true;
+}
+
+/**
+ * @brief Read the thread's next record into the window
+ *
+ * @return false at the end of the trace or with the window full
+ */
+bool BranchOracle::fill()
+{
+	if (eof || tail - head == BRANCH_ORACLE_WINDOW)
+		return false;
+
+	BranchTraceRecord rec;
+	int s;
+
+	while ((s = reader->next(rec)) >= 0) {
+		if unlikely (stream < 0) {
+			const BranchTraceReader::Stream& st = reader->streams[s];
+			if (st.coreid == coreid && st.threadid == threadid)
+				stream = s;
+		}
+
+		if (s == stream) {
+			record(tail++) = rec;
+			return true;
+		}
+	}
+
+	eof = true;
+	return false;
+}
+
+/**
+ * @brief Find the record of a branch fetched on the correct path
+ *
+ * Records before the one found belong to branches this run did not
+ * execute and are skipped; without a record in reach the branch is left
+ * to the core's own predictor and fetch stays where it was.
+ *
+ * @param branchaddr Rip after the branch
+ * @param target Set to the rip the first run committed after the branch
+ */
+W64s BranchOracle::predict(W64 branchaddr, W64& target)
+{
+	foreach (i, BRANCH_ORACLE_LOOKAHEAD) {
+		W64 seq = fetch + i;
+		if (seq == tail && !fill())
+			break;
+
+		if (record(seq).branchaddr == branchaddr) {
+			target = record(seq).target;
+			fetch = seq + 1;
+			return seq;
+		}
+	}
+
+	return -1;
+}
+
+void BranchOracle::annul(W64s seq)
+{
+	fetch = (seq >= 0) ? max(W64(seq) + 1, head) : head;
+}
+
+int BranchOracle::commit(W64s seq, W64 branchaddr, W64 target)
+{
+	if (seq < 0 || W64(seq) < head)
+		return BRANCH_ORACLE_MISSING;
+
+	int outcome = (W64(seq) == head) ? BRANCH_ORACLE_MATCH : BRANCH_ORACLE_SKIPPED;
+	const BranchTraceRecord& rec = record(seq);
+
+	head = seq + 1;
+	if (fetch < head)
+		fetch = head;
+
+	if (rec.branchaddr != branchaddr || rec.target != target)
+		return BRANCH_ORACLE_WRONG;
+
+	return outcome;
+}
@@ -0,0 +1,186 @@
+#ifndef _BRANCHTRACE_H_
+#define _BRANCHTRACE_H_
+
+#include <ptlsim.h>
+
+/*
+ * Committed branch trace, written with -branch-trace
+ *
+ * Every committed branch becomes a tag byte followed by LEB128 varints,
+ * usually 4 to 6 bytes in all:
+ *
+ *   tag         BRANCH_HINT_* type, outcome and the flags below
+ *   insns       x86 insns the thread committed since its previous branch
+ *   branchaddr  rip after the branch, zigzag delta from the previous one
+ *   riptaken    taken target, zigzag delta from branchaddr
+ *   target      only with BRANCH_TRACE_TARGET: rip committed after the
+ *               branch, zigzag delta from branchaddr
+ *
+ * Without BRANCH_TRACE_TARGET the committed rip is riptaken when the
+ * branch was taken and branchaddr otherwise. Threads interleave in one
+ * file: a BRANCH_TRACE_SWITCH tag followed by core and thread ids starts
+ * the records of another thread, and deltas are kept per thread. The
+ * records are what the branch predictors see at commit, so
+ * tools/branch_replay.cpp can rerun any predictor on them.
+ */
+
+enum {
+	BRANCH_TRACE_TYPE	= 0x0f,	// BRANCH_HINT_* flags
+	BRANCH_TRACE_TAKEN	= 0x10,
+	BRANCH_TRACE_TARGET	= 0x20,	// committed rip follows
+	BRANCH_TRACE_KERNEL	= 0x40,
+	BRANCH_TRACE_SWITCH	= 0x80,	// core and thread ids follow
+};
+
+// Written once at the start of the file
+struct BranchTraceHeader
+{
+	W64 magic;
+	W32 version;
+	W32 reserved;
+};
+
+static const W64 BRANCH_TRACE_MAGIC = 0x3145434152545242ULL; // "BRTRACE1"
+static const W32 BRANCH_TRACE_VERSION = 1;
+
+// Bytes buffered before a write to the file
+#define BRANCH_TRACE_BUFFER (64 * 1024)
+
+struct BranchTraceRecord
+{
+	W64 insns;		// committed since the thread's previous branch
+	W64 branchaddr;
+	W64 riptaken;
+	W64 target;
+	W8 type;
+	bool kernel;
+
+	bool taken() const { return target != branchaddr; }
+};
+
+/* Records the branches committed by one thread */
+struct BranchTraceWriter
+{
+	W16 coreid;
+	W16 threadid;
+	W64 last_insns;
+	W64 last_addr;
+
+	BranchTraceWriter() { init(0, 0); }
+
+	void init(W16 coreid, W16 threadid);
+
+	void record(ostream& os, int type, W64 branchaddr, W64 riptaken,
+			W64 target, W64 insns, bool kernel);
+
+	static void start(ostream& os);
+	static void flush(ostream& os);
+};
+
+/* Reads a trace back, keeping the deltas of each thread */
+struct BranchTraceReader
+{
+	struct Stream {
+		W16 coreid;
+		W16 threadid;
+		W64 last_addr;
+	};
+
+	dynarray<Stream> streams;
+
+	BranchTraceReader(istream& is);
+
+	bool valid() const { return header_ok; }
+
+	// Index of the record's stream in 'streams', -1 at the end
+	int next(BranchTraceRecord& rec);
+
+private:
+	istream& is;
+	byte buf[BRANCH_TRACE_BUFFER];
+	int pos;
+	int len;
+	int current;
+	bool header_ok;
+
+	bool fill();
+
+	bool getbyte(byte& b) {
+		if unlikely (pos == len && !fill())
+			return false;
+		b = buf[pos++];
+		return true;
+	}
+
+	bool getvarint(W64& v);
+	int find_stream(W16 coreid, W16 threadid);
+};
+
+/*
+ * Perfect branch prediction from the trace of an earlier run
+ *
+ * A first run of the workload records its committed branches with
+ * -branch-trace, and a second run with -perfect-branch-pred -branch-oracle
+ * predicts each branch it fetches with the target the first run committed.
+ * Fetch runs ahead of commit, so the records from the oldest uncommitted
+ * branch on are kept in a window that fetch goes back into when it is
+ * redirected. A fetched branch is looked up by address in the next few
+ * records, so the runs get back in step when an interrupt lands at a
+ * different instruction; commit then checks every branch against its
+ * record and tells how the runs kept in sync.
+ */
+
+enum {
+	BRANCH_ORACLE_MATCH,	// predicted from the next record
+	BRANCH_ORACLE_SKIPPED,	// predicted after skipping records
+	BRANCH_ORACLE_MISSING,	// no record for the branch
+	BRANCH_ORACLE_WRONG,	// record had another target
+	BRANCH_ORACLE_OUTCOMES,
+};
+
+extern const char* branch_oracle_outcome_names[BRANCH_ORACLE_OUTCOMES];
+
+#define BRANCH_ORACLE_WINDOW 4096	// records kept, a power of two
+#define BRANCH_ORACLE_LOOKAHEAD 64	// records searched for a branch
+
+struct BranchOracle
+{
+	BranchOracle();
+	~BranchOracle();
+
+	bool open(const char* filename, W16 coreid, W16 threadid);
+	void close();
+	bool active() const { return reader != NULL; }
+
+	// Record number the branch is predicted from, -1 without one
+	W64s predict(W64 branchaddr, W64& target);
+
+	// Fetch restarts after record 'seq', or after the last committed one
+	void annul(W64s seq);
+
+	// BRANCH_ORACLE_* for a branch committed after predict() gave 'seq'
+	int commit(W64s seq, W64 branchaddr, W64 target);
+
+	// Committed records, counting skipped ones
+	W64 committed() const { return head; }
+
+private:
+	ifstream is;
+	BranchTraceReader* reader;
+	W16 coreid;
+	W16 threadid;
+	int stream;
+	bool eof;
+
+	dynarray<BranchTraceRecord> window;
+	W64 head;	// oldest record not committed
+	W64 fetch;	// next record for fetch
+	W64 tail;	// records read
+
+	bool fill();
+	BranchTraceRecord& record(W64 seq) {
+		return window[seq & (BRANCH_ORACLE_WINDOW - 1)];
+	}
+};
+
+#endif // _BRANCHTRACE_H_
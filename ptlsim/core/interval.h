@@ -37,7 +37,9 @@ static inline ostream& operator <<(ostream& os, const FMTEntry& fmt){
 	return fmt.print(os);
 }
 
-const int FMT_SIZE = OOO_ROB_SIZE + OOO_FETCH_Q_SIZE + 1;
+// interval.cpp is built without the core's parameters, so the table is
+// sized for the largest ROB and fetch queue a core can have
+const int FMT_SIZE = OOO_MAX_ROB_SIZE + OOO_MAX_FETCH_Q_SIZE + 1;
 
 struct Interval
 {
@@ -0,0 +1,183 @@
+//
+// Host microbenchmarks of the out-of-order core's scheduler and LSQ
+//
+// Built with each configured core, so the structures have the sizes that
+// core was built with; results are named after the core (OOO_CORE_NAME).
+//
+#include <globals.h>
+#include <ptlsim.h>
+#include <logic.h>
+#include <bench.h>
+
+#include <ooo.h>
+
+using namespace OOO_CORE_MODEL;
+
+namespace OOO_CORE_MODEL {
+
+  //
+  // Steady state of a full issue queue: every cycle select the oldest ready
+  // uop, remove it, broadcast its tag and dispatch a new uop in its place.
+  // Each uop depends on one to three of the eight uops before it.
+  //
+  struct IssueQueueCycle {
+    typedef IssueQueue<ISSUE_QUEUE_SIZE> issueq_t;
+    static const int IDS = 4096;
+
+    issueq_t* issueq;
+    byte inqueue[IDS];
+    W64 next;
+
+    IssueQueueCycle() {
+      // reset() needs a core, so clear the state it would
+      issueq = new issueq_t();
+      issueq->count = 0;
+      issueq->valid = 0;
+      issueq->issued = 0;
+      issueq->allready = 0;
+      issueq->woken = 0;
+      issueq->uopids.reset();
+      foreach (i, MAX_OPERANDS) issueq->tags[i].reset();
+
+      setzero(inqueue);
+      next = 0;
+      while (issueq->count < issueq->capacity) dispatch();
+    }
+
+    ~IssueQueueCycle() { delete issueq; }
+
+    void dispatch() {
+      issueq_tag_t uopid = next % IDS;
+      issueq_tag_t operands[MAX_OPERANDS];
+      issueq_tag_t preready[MAX_OPERANDS];
+      W64 h = next * 0x9e3779b97f4a7c15ULL;
+
+      foreach (i, MAX_OPERANDS) {
+        W64 distance = 1 + ((h >> (i * 8)) & 7);
+        bool used = (i == 0) || ((h >> (32 + i)) & 1);
+        operands[i] = (next - distance) % IDS;
+        preready[i] = !used || (next < distance) || !inqueue[operands[i]];
+      }
+
+      issueq->insert(uopid, operands, preready);
+      inqueue[uopid] = 1;
+      next++;
+    }
+
+    W64 operator()(W64 iters) {
+      W64 sum = 0;
+      for (W64 n = 0; n < iters; n++) {
+        issueq->clock();
+        int slot = issueq->issue();
+        if likely (slot >= 0) {
+          issueq_tag_t uopid = issueq->uopof(slot);
+          issueq->remove(slot);
+          issueq->broadcast(uopid);
+          inqueue[uopid] = 0;
+          sum += slot;
+        }
+        while (issueq->count < issueq->capacity) dispatch();
+      }
+      return sum;
+    }
+  };
+
+  static void bench_issueq(Benchmark& b) {
+    IssueQueueCycle body;
+    stringbuf name;
+    name << "cycle_", ISSUE_QUEUE_SIZE;
+    b.measure_simd(name, body);
+  }
+
+  BENCHMARK(OOO_CORE_NAME ".issueq", bench_issueq);
+
+  //
+  // Store forwarding search of a load against a nearly full LSQ, with the
+  // address hash and with the walk over all older entries it replaced.
+  // Addresses are spread so most searches find no store to forward from.
+  //
+  struct LSQSearch {
+    Queue<LoadStoreQueueEntry, LSQ_SIZE>* LSQ;
+    LSQAddressHash* hash;
+    bool use_hash;
+
+    LSQSearch() {
+      LSQ = new Queue<LoadStoreQueueEntry, LSQ_SIZE>();
+      hash = new LSQAddressHash();
+      use_hash = true;
+
+      W64 h = 1;
+      while (!LSQ->full()) {
+        LoadStoreQueueEntry* lsq = LSQ->alloc();
+        int i = lsq->index();
+        h = h * 6364136223846793005ULL + 1442695040888963407ULL;
+
+        lsq->store = (i % 3 == 0);
+        lsq->addrvalid = !(lsq->store && (i % 64 == 63));
+        lsq->physaddr = (h >> 40) & 4095;
+        hash->update(*lsq);
+      }
+    }
+
+    ~LSQSearch() {
+      delete LSQ;
+      delete hash;
+    }
+
+    // Same checks as the forwarding search in issueload()
+    static bool stops(const LoadStoreQueueEntry& stbuf, W64 physaddr) {
+      if likely (!stbuf.store) return false;
+      if likely (stbuf.addrvalid) {
+        if unlikely (stbuf.lfence | stbuf.sfence) return false;
+        int x = (stbuf.physaddr - physaddr);
+        return (-1 <= x && x <= 1);
+      }
+      return !(stbuf.lfence & !stbuf.sfence);
+    }
+
+    W64 operator()(W64 iters) {
+      W64 sum = 0;
+      int candidates[LSQ_SIZE];
+
+      for (W64 n = 0; n < iters; n++) {
+        W64 physaddr = (n * 2654435761ULL) & 4095;
+        int idx = add_index_modulo(LSQ->head, LSQ->count - 1 - (n % 16), LSQ_SIZE);
+        LoadStoreQueueEntry* lsq = &(*LSQ)[idx];
+        int found = -1;
+
+        if (use_hash) {
+          int count = hash->older(*LSQ, idx, physaddr, 1, candidates);
+          foreach (c, count) {
+            if (stops((*LSQ)[candidates[c]], physaddr)) {
+              found = candidates[c];
+              break;
+            }
+          }
+        } else {
+          foreach_backward_before(*LSQ, lsq, i) {
+            if (stops((*LSQ)[i], physaddr)) {
+              found = i;
+              break;
+            }
+          }
+        }
+
+        sum += found;
+      }
+      return sum;
+    }
+  };
+
+  static void bench_lsq(Benchmark& b) {
+    LSQSearch body;
+    stringbuf hashed, scan;
+    hashed << "older_", LSQ_SIZE, "/hash";
+    scan << "older_", LSQ_SIZE, "/scan";
+
+    b.measure(hashed, body);
+    body.use_hash = false;
+    b.measure(scan, body);
+  }
+
+  BENCHMARK(OOO_CORE_NAME ".lsq", bench_lsq);
+};
@@ -46,14 +46,23 @@
 //#define OOO_FETCH_Q_SIZE 48
 #endif
 
+// Largest fetch queue any core can be built with, for the same reason as
+// OOO_MAX_ROB_SIZE below
+#define OOO_MAX_FETCH_Q_SIZE 256
+
 #ifndef OOO_ISSUE_Q_SIZE
 #define OOO_ISSUE_Q_SIZE 64
 #endif
 
 #ifndef OOO_ROB_SIZE
-#define OOO_ROB_SIZE 128
+#define OOO_ROB_SIZE 64
 #endif
 
+// Largest ROB any core can be built with (MAX_ROB_IDX_BIT below). Code
+// outside the core does not see the core's OOO_ROB_SIZE, so per-ROB-entry
+// tables there are sized with this instead.
+#define OOO_MAX_ROB_SIZE 4096
+
 #ifndef OOO_FETCH_WIDTH
 #define OOO_FETCH_WIDTH 4
 #endif
@@ -170,8 +179,15 @@ namespace OOO_CORE_MODEL {
     //
 #define BIG_ROB
 
-    // const int ROB_SIZE = OOO_ROB_SIZE;
-    const int ROB_SIZE = 64;
+    //
+    // ROB_SIZE, ISSUE_QUEUE_SIZE, LDQ_SIZE, STQ_SIZE and PHYS_REG_FILE_SIZE
+    // are the compiled-in capacities of these structures. The sizes actually
+    // used are read from the core options ('rob_size', 'iq_size', 'ldq_size',
+    // 'stq_size' and 'phys_reg_file_size') at startup and may be anything up
+    // to these limits, so window size sweeps only need one build configured
+    // with the largest size of the sweep.
+    //
+    const int ROB_SIZE = OOO_ROB_SIZE;
 
     // Maximum number of branches in the pipeline at any given time
     const int MAX_BRANCHES_IN_FLIGHT = OOO_BRANCH_IN_FLIGHT;
@@ -201,6 +217,8 @@ namespace OOO_CORE_MODEL {
     // Fetch
     //
     const int FETCH_QUEUE_SIZE = OOO_FETCH_Q_SIZE;
+    // Fails to compile if the interval FMT (core/interval.h) is too small
+    typedef char fetch_queue_fits_fmt[(FETCH_QUEUE_SIZE <= OOO_MAX_FETCH_Q_SIZE) ? 1 : -1];
     const int FETCH_WIDTH = OOO_FETCH_WIDTH;
 
     //
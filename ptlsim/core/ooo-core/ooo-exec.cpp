@@ -16,7 +16,7 @@
 #include <ooo.h>
 #include <memoryHierarchy.h>
 
-#ifndef ENABLE_CHECKS
+#if !defined(ENABLE_CHECKS) && !defined(DISABLE_ASSERT)
 #undef assert
 #define assert(x) (x)
 #endif
@@ -50,6 +50,7 @@ void IssueQueue<size, operandcount>::reset(W8 coreid, OooCore* core_) {
   valid = 0;
   issued = 0;
   allready = 0;
+  woken = 0;
   foreach (i, operandcount) {
     tags[i].reset();
   }
@@ -128,18 +129,57 @@ void IssueQueue<size, operandcount>::reset(W8 coreid, W8 threadid,
 
 template <int size, int operandcount>
 void IssueQueue<size, operandcount>::clock() {
+  bitvec<size> wasready = allready;
+
   allready = (valid & (~issued));
   foreach (operand, operandcount) {
     allready &= ~tags[operand].valid;
   }
+
+  woken = allready & (~wasready);
 }	
 
+static void decode_tag(issueq_tag_t tag, int& threadid, int& idx);
+
+//
+// Move every uop whose last operand arrived in this clock() from the
+// dispatched list to its ready-to-issue list and record its ready cycle.
+// The broadcast tag match already tells us which slots woke up, so this
+// only visits those slots instead of scanning every dispatched uop.
+//
+template <int size, int operandcount>
+void IssueQueue<size, operandcount>::wakeup() {
+  if likely (!woken) return;
+
+  OooCore& core = getcore();
+
+  for (int slot = woken.lsb(-1); slot >= 0; slot = woken.nextlsb(slot)) {
+    int threadid, idx;
+    decode_tag(uopids[slot], threadid, idx);
+
+    ThreadContext* thread = core.threads[threadid];
+    ReorderBufferEntry& rob = thread->ROB[idx];
+
+    // Uops replayed out of the TLB miss path wake up here too, but they
+    // are not waiting in the dispatched list
+    if unlikely (rob.current_state_list !=
+        &thread->rob_dispatched_list[rob.cluster])
+      continue;
+
+    rob.changestate(rob.get_ready_to_issue_list());
+    if (!rob.uop.ready_cycle)
+      rob.uop.ready_cycle = sim_cycle;
+  }
+
+  woken = 0;
+}
+
 template <int size, int operandcount>
 bool IssueQueue<size, operandcount>::insert(tag_t uopid, const tag_t* operands, const tag_t* preready) {
-  if unlikely (count == size)
+  if unlikely (count == capacity)
 		return false;
 
-  assert(count < size);
+  assert(count < capacity);
 
   int slot = count++;
 
@@ -178,8 +218,11 @@ template <int size, int operandcount>
 int IssueQueue<size, operandcount>::issue(int previd) {
   if (!allready) return -1;
   int slot = allready.nextlsb(previd);
-  if(slot >= 0)
+  if(slot >= 0) {
     issued[slot] = 1;
+    // Not ready any more, so a replay in this cycle wakes it up again
+    allready[slot] = 0;
+  }
   return slot;
 }
 
@@ -232,6 +275,7 @@ bool IssueQueue<size, operandcount>::remove(int slot) {
   valid = valid.remove(slot, 1);
   issued = issued.remove(slot, 1);
   allready = allready.remove(slot, 1);
+  woken = woken.remove(slot, 1);
 
   count--;
   assert(count >= 0);
@@ -260,6 +304,119 @@ ostream& IssueQueue<size, operandcount>::print(ostream& os) const {
 // Instantiate all methods in the specific IssueQueue sizes we're using:
 declare_issueq_templates;
 
+//
+// LSQ address hash
+//
+void LSQAddressHash::reset() {
+  foreach (i, BUCKETS) bucket[i] = -1;
+  foreach (i, LSQ_SIZE) next[i] = -1;
+  hashed = 0;
+  unresolved = 0;
+}
+
+void LSQAddressHash::link(int idx, W64 physaddr) {
+  int b = slot(physaddr);
+  key[idx] = physaddr;
+  next[idx] = bucket[b];
+  bucket[b] = idx;
+  hashed[idx] = 1;
+}
+
+void LSQAddressHash::unlink(int idx) {
+  W16s* p = &bucket[slot(key[idx])];
+  while (*p != idx) {
+    assert(*p >= 0);
+    p = &next[*p];
+  }
+  *p = next[idx];
+  next[idx] = -1;
+  hashed[idx] = 0;
+}
+
+void LSQAddressHash::remove(int idx) {
+  if (hashed[idx]) unlink(idx);
+  unresolved[idx] = 0;
+}
+
+void LSQAddressHash::update(const LoadStoreQueueEntry& lsq) {
+  int idx = lsq.index();
+  remove(idx);
+
+  if (lsq.addrvalid) {
+    // Fences never match an address
+    if likely (!(lsq.lfence | lsq.sfence)) link(idx, lsq.physaddr);
+  } else if (lsq.store) {
+    unresolved[idx] = 1;
+  }
+}
+
+//
+// Gather hashed entries within +/- range of physaddr, unsorted
+//
+int LSQAddressHash::collect(int idx, W64 physaddr, int range, int* out) const {
+  int n = 0;
+  for (int d = -range; d <= range; d++) {
+    W64 k = physaddr + d;
+    for (int i = bucket[slot(k)]; i >= 0; i = next[i]) {
+      if (key[i] == k && i != idx) out[n++] = i;
+    }
+  }
+  return n;
+}
+
+// Sort candidates by age relative to the LSQ head, keeping only one side of idx
+static int sort_lsq_candidates(const Queue<LoadStoreQueueEntry, LSQ_SIZE>& LSQ,
+    int idx, int* out, int n, bool older) {
+  int myage = add_index_modulo(idx, -LSQ.head, LSQ_SIZE);
+  int age[LSQ_SIZE];
+  int m = 0;
+
+  foreach (i, n) {
+    int a = add_index_modulo(out[i], -LSQ.head, LSQ_SIZE);
+    if ((older) ? (a >= myage) : (a <= myage)) continue;
+
+    // Insertion sort: youngest first for older, oldest first for younger
+    int j = m++;
+    while (j > 0 && ((older) ? (age[j-1] < a) : (age[j-1] > a))) {
+      age[j] = age[j-1];
+      out[j] = out[j-1];
+      j--;
+    }
+    age[j] = a;
+    out[j] = (a + LSQ.head) % LSQ_SIZE;
+  }
+
+  return m;
+}
+
+int LSQAddressHash::older(const Queue<LoadStoreQueueEntry, LSQ_SIZE>& LSQ,
+    int idx, W64 physaddr, int range, int* out) const {
+  if unlikely (idx == LSQ.head) return 0;
+
+  int n = collect(idx, physaddr, range, out);
+  for (int i = unresolved.lsb(-1); i >= 0; i = unresolved.nextlsb(i))
+    out[n++] = i;
+
+  return sort_lsq_candidates(LSQ, idx, out, n, true);
+}
+
+int LSQAddressHash::older_unresolved(const Queue<LoadStoreQueueEntry, LSQ_SIZE>& LSQ,
+    int idx, int* out) const {
+  if unlikely (idx == LSQ.head) return 0;
+
+  int n = 0;
+  for (int i = unresolved.lsb(-1); i >= 0; i = unresolved.nextlsb(i))
+    out[n++] = i;
+
+  return sort_lsq_candidates(LSQ, idx, out, n, true);
+}
+
+int LSQAddressHash::younger(const Queue<LoadStoreQueueEntry, LSQ_SIZE>& LSQ,
+    int idx, W64 physaddr, int range, int* out) const {
+  int n = collect(idx, physaddr, range, out);
+  return sort_lsq_candidates(LSQ, idx, out, n, false);
+}
+
 static inline W64 x86_merge(W64 rd, W64 ra, int sizeshift) {
   union {
     W8 w8;
@@ -536,11 +693,8 @@ int ReorderBufferEntry::issue() {
 	  bool cond = bit(bptype, log2(BRANCH_HINT_COND));
 	  bool indir = bit(bptype, log2(BRANCH_HINT_INDIRECT));
 	  bool ret = bit(bptype, log2(BRANCH_HINT_RET));
-		    
-	  thread.perfbranchpred.count++;
 
 	  if unlikely (mispredicted) {
-	      thread.perfbranchpred.mispredicted++;
 	      thread.thread_stats.branchpred.summary[MISPRED]++;
 	      thread.thread_stats.branchpred.ret[MISPRED]+=ret;
 	      thread.thread_stats.branchpred.indir[MISPRED]+= (indir & !ret) ;
@@ -724,6 +878,7 @@ Waddr ReorderBufferEntry::addrgen(LoadStoreQueueEntry& state, Waddr& origaddr, W
   state.addrvalid = 1; // by vteori
   // state.addrvalid = 0; 
   state.datavalid = 0;
+  getthread().lsq_hash.update(state);
 
   //
   // Special case: if no part of the actual user load/store falls inside
@@ -922,6 +1077,7 @@ int ReorderBufferEntry::issuestore(LoadStoreQueueEntry& state, Waddr& origaddr,
   thread.thread_stats.dcache.store.size[sizeshift]++;
 
   state.physaddr = (annul) ? INVALID_PHYSADDR : (physaddr >> 3);
+  thread.lsq_hash.update(state);
 
   /***** (Trace) by vteori *****/
   // state.addrvalid = 1;  // by vteori
@@ -949,8 +1105,11 @@ int ReorderBufferEntry::issuestore(LoadStoreQueueEntry& state, Waddr& origaddr,
   // bool all_sfra_addrvalid = true;
   // bool all_sfra_datavalid = true;
 
-  foreach_backward_before(LSQ, lsq, i) {
-    LoadStoreQueueEntry& stbuf = LSQ[i];
+  int candidates[LSQ_SIZE];
+  int candidate_count = thread.lsq_hash.older(LSQ, lsq->index(), state.physaddr, 1, candidates);
+
+  foreach (c, candidate_count) {
+    LoadStoreQueueEntry& stbuf = LSQ[candidates[c]];
 
     // Skip over loads (we only care about the store queue subset):
     if likely (!stbuf.store) continue;
@@ -1063,8 +1222,10 @@ int ReorderBufferEntry::issuestore(LoadStoreQueueEntry& state, Waddr& origaddr,
   // store as invalid (EXCEPTION_LoadStoreAliasing) so it annuls
   // itself and the load after it in program order at commit time.
   //
-  foreach_forward_after (LSQ, lsq, i) {
-    LoadStoreQueueEntry& ldbuf = LSQ[i];
+  candidate_count = thread.lsq_hash.younger(LSQ, lsq->index(), state.physaddr, 1, candidates);
+
+  foreach (c, candidate_count) {
+    LoadStoreQueueEntry& ldbuf = LSQ[candidates[c]];
     //
     // (see notes on Load Replay Conditions below)
     //
@@ -1222,8 +1383,11 @@ W64 ReorderBufferEntry::get_load_data(LoadStoreQueueEntry& state, W64 data){
 
 
   // Search the store queue for the most recent store to the same address.
-  foreach_backward_before(LSQ, lsq, i) {
-    LoadStoreQueueEntry& stbuf = LSQ[i];
+  int candidates[LSQ_SIZE];
+  int candidate_count = thread.lsq_hash.older(LSQ, lsq->index(), state.physaddr, 0, candidates);
+
+  foreach (c, candidate_count) {
+    LoadStoreQueueEntry& stbuf = LSQ[candidates[c]];
 
     // Skip over loads (we only care about the store queue subset):
     if likely (!stbuf.store) continue;
@@ -1324,6 +1488,7 @@ int ReorderBufferEntry::issueload(LoadStoreQueueEntry& state, Waddr& origaddr, W
   thread.thread_stats.dcache.load.size[sizeshift]++;
 
   state.physaddr = (annul) ? INVALID_PHYSADDR : (physaddr >> 3);
+  thread.lsq_hash.update(state);
 
   /***** (Trace) by vteori *****/
   if(!load_store_second_phase)
@@ -1357,8 +1522,11 @@ int ReorderBufferEntry::issueload(LoadStoreQueueEntry& state, Waddr& origaddr, W
   bool all_sfra_addrvalid = true;
   bool all_sfra_datavalid = true;
 
-  foreach_backward_before(LSQ, lsq, i) {
-    LoadStoreQueueEntry& stbuf = LSQ[i];
+  int candidates[LSQ_SIZE];
+  int candidate_count = thread.lsq_hash.older(LSQ, lsq->index(), state.physaddr, 1, candidates);
+
+  foreach (c, candidate_count) {
+    LoadStoreQueueEntry& stbuf = LSQ[candidates[c]];
 
     // Skip over loads (we only care about the store queue subset):
     if likely (!stbuf.store) continue;
@@ -1909,6 +2077,7 @@ void ReorderBufferEntry::tlbwalk() {
   request->set_coreSignal(&core.dcache_signal);
 
   lsq->physaddr = pteaddr >> 3;
+  thread.lsq_hash.update(*lsq);
 	
   //for debug by vteori
   //ptl_logfile << "TLB walk => rob : ", index(), " addr : ", (void *) pteaddr, endl;
@@ -1941,8 +2110,11 @@ LoadStoreQueueEntry* ReorderBufferEntry::find_nearest_memory_fence() {
   bool ld = isload(uop.opcode);
   bool st = (uop.opcode == OP_st);
 
-  foreach_backward_before(thread.LSQ, lsq, i) {
-    LoadStoreQueueEntry& stbuf = thread.LSQ[i];
+  int candidates[LSQ_SIZE];
+  int candidate_count = thread.lsq_hash.older_unresolved(thread.LSQ, lsq->index(), candidates);
+
+  foreach (c, candidate_count) {
+    LoadStoreQueueEntry& stbuf = thread.LSQ[candidates[c]];
 
     // Skip over everything except fences
     if unlikely (!(stbuf.lfence | stbuf.sfence)) continue;
@@ -1994,6 +2166,7 @@ int ReorderBufferEntry::issuefence(LoadStoreQueueEntry& state) {
   state.datavalid = 0;
   state.addrvalid = 0;
   state.physaddr = bitmask(48-3);
+  thread.lsq_hash.update(state);
 
   changestate(thread.rob_memory_fence_list);
 
@@ -2240,6 +2413,7 @@ void ReorderBufferEntry::fencewakeup() {
   physreg->complete();
   lsq->datavalid = 1;
   lsq->addrvalid = 1;
+  thread.lsq_hash.update(*lsq);
 
   cycles_left = 0;
   lfrqslot = -1;
@@ -2310,7 +2484,7 @@ void ReorderBufferEntry::replay() {
   */
 
   // for reducing duplicated code
-  // ready_cycle is recoreded in readycheck function
+  // ready_cycle is recorded in IssueQueue::wakeup()
   changestate(thread.rob_dispatched_list[cluster]);
 
   issueq_operation_on_cluster(core, cluster, replay(iqslot, uopids, preready));
@@ -2350,7 +2524,7 @@ void ReorderBufferEntry::replay_locked() {
   // }
 
   // for reducing duplicated code
-  // ready_cycle is recoreded in readycheck function
+  // ready_cycle is recorded in IssueQueue::wakeup()
   changestate(thread.rob_dispatched_list[cluster]);
     
   issueq_operation_on_cluster(core, cluster, switch_to_end(iqslot,  uopids, preready));
@@ -2643,6 +2817,7 @@ W64 ReorderBufferEntry::annul(bool keep_misspec_uop, bool return_first_annulled_
 	  if (annulrob.release_mem_lock(true)) thread.flush_mem_lock_release_list(queued_locks_before);
 	  loads_in_flight -= (annulrob.lsq->store == 0);
 	  stores_in_flight -= (annulrob.lsq->store == 1);
+	  thread.lsq_hash.remove(annulrob.lsq->index());
 	  annulrob.lsq->reset();
 	  LSQ.annul(annulrob.lsq);
 
@@ -2771,6 +2946,7 @@ void ReorderBufferEntry::redispatch(const bitvec<MAX_OPERANDS>& dependent_operan
       lsq->virtaddr = 0;
       lsq->addrvalid = 0;
       lsq->datavalid = 0;
+      thread.lsq_hash.update(*lsq);
       lsq->mbtag = -1;
       lsq->data = 0;
       lsq->invalid = 0;
@@ -19,7 +19,7 @@
 #include <memoryHierarchy.h>
 #include <cacheController.h> // by vteori
 
-#ifndef ENABLE_CHECKS
+#if !defined(ENABLE_CHECKS) && !defined(DISABLE_ASSERT)
 #undef assert
 #define assert(x) (x)
 #endif
@@ -268,6 +268,8 @@ void ThreadContext::flush_pipeline() {
   rob_states.reset();
 
   ROB.reset();
+  ROB.set_capacity(core.rob_size);
+  branch_oracle.annul(-1);
   foreach (i, ROB_SIZE) {
     ROB[i].coreid = core.coreid;
     ROB[i].core = &core;
@@ -275,6 +277,8 @@ void ThreadContext::flush_pipeline() {
     ROB[i].changestate(rob_free_list);
   }
   LSQ.reset();
+  LSQ.set_capacity(core.ldq_size + core.stq_size);
+  lsq_hash.reset();
   foreach (i, LSQ_SIZE) {
     LSQ[i].coreid = core.coreid;
     LSQ[i].core = &core;
@@ -319,6 +323,18 @@ void ThreadContext::reset_fetch_unit(W64 realrip) {
   fetchq.reset();
   current_basic_block_transop_index = 0;
   unaligned_ldst_buf.reset();
+
+  // Fetch goes on after the youngest branch left in the ROB
+  if unlikely (branch_oracle.active()) {
+    W64s seq = -1;
+    foreach_backward (ROB, i) {
+      if (isbranch(ROB[i].uop.opcode)) {
+        seq = ROB[i].uop.predinfo.oracle_seq;
+        if (seq >= 0) break;
+      }
+    }
+    branch_oracle.annul(seq);
+  }
 }
 
 //
@@ -705,7 +721,9 @@ bool ThreadContext::fetch() {
     //
     if unlikely (transop.unaligned) {
 	  split_unaligned(transop, unaligned_ldst_buf);
-	  assert(unaligned_ldst_buf.get(transop, synthop));
+	  bool ok = unaligned_ldst_buf.get(transop, synthop);
+	  assert(ok);
+	  (void)ok;
     }
 
     assert(transop.bbindex == current_basic_block_transop_index);
@@ -749,13 +767,21 @@ bool ThreadContext::fetch() {
       transop.predinfo.ripafter = fetchrip + transop.bytes;
       predrip = branchpred.predict(transop.predinfo, transop.predinfo.bptype, transop.predinfo.ripafter, transop.riptaken);
 
-      //Perfect Prediction enable?
-      if (config.perfect_branch_pred){
-		bool success = true;
-		W64 pref_predrip = perfbranchpred.predict(fetchq, ROB, commitrrt, success);
-		if (success){
-	 		predrip = pref_predrip;
-		}
+      //
+      // With -perfect-branch-pred the target comes from the branches the
+      // first run committed. A record that can't be this conditional
+      // branch's outcome is only caught at commit, so the branch keeps
+      // the predicted direction.
+      //
+      transop.predinfo.oracle_seq = -1;
+      if unlikely (branch_oracle.active()) {
+        W64 target = 0;
+        transop.predinfo.oracle_seq = branch_oracle.predict(transop.predinfo.ripafter, target);
+        if (transop.predinfo.oracle_seq >= 0 &&
+            (!isclass(transop.opcode, OPCLASS_COND_BRANCH) ||
+             target == transop.riptaken || target == transop.ripseq)) {
+          predrip = target;
+        }
       }
 
       /*
@@ -925,13 +951,13 @@ void ThreadContext::rename() {
     bool st = isstore(fetchbuf.opcode);
     bool br = isbranch(fetchbuf.opcode);
 
-    if unlikely (ld && (loads_in_flight >= LDQ_SIZE)) {
+    if unlikely (ld && (loads_in_flight >= core.ldq_size)) {
 	  thread_stats.frontend.status.ldq_full++;
 	  //fetchbuf.ldq_full = true;
 	  break;
     }
 
-    if unlikely (st && (stores_in_flight >= STQ_SIZE)) {
+    if unlikely (st && (stores_in_flight >= core.stq_size)) {
 	  thread_stats.frontend.status.stq_full++;
 	  //fetchbuf.stq_full = true;
 	  break;
@@ -965,6 +991,7 @@ void ThreadContext::rename() {
 	  lsq.datavalid = 0;
 	  lsq.addrvalid = 0;
 	  lsq.invalid = 0;
+	  lsq_hash.update(lsq);
 	  loads_in_flight += (st == 0);
 	  stores_in_flight += (st == 1);
     }
@@ -1343,10 +1370,10 @@ bool ReorderBufferEntry::find_sources() {
   ThreadContext& thread = getthread();
 
 #ifndef MULTI_IQ
-  assert(thread.issueq_count >= 0 && thread.issueq_count <= ISSUE_QUEUE_SIZE);
+  assert(thread.issueq_count >= 0 && thread.issueq_count <= getcore().iq_size);
   thread.issueq_count++;
 #else
-  assert(thread.issueq_count[cluster] >= 0 && thread.issueq_count[cluster] <= ISSUE_QUEUE_SIZE*4);
+  assert(thread.issueq_count[cluster] >= 0 && thread.issueq_count[cluster] <= getcore().iq_size*4);
   thread.issueq_count[cluster]++;
 #endif
 
@@ -1486,7 +1513,7 @@ int ThreadContext::dispatch() {
 	*/
 
     // for reducing duplicated code
-    // ready_cycle is recoreded in readycheck function
+    // ready_cycle is recorded in IssueQueue::wakeup()
     rob->changestate(rob_dispatched_list[rob->cluster]);
 
     core.dispatchcount++;
@@ -1537,31 +1564,6 @@ int ThreadContext::dispatch() {
   return core.dispatchcount;
 }
 
-/***** (Trace) by vteori *****/
-// 1. Check whether a uop is ready to issue
-// 2. Change its state (dispatched -> ready to issue)
-// 3. Record its ready cycle for trace
-
-void ThreadContext::readycheck() {
-  ReorderBufferEntry *rob = NULL;
-  for_each_cluster(cluster){
-    foreach_list_mutable(rob_dispatched_list[cluster], rob, entry, nextentry){
-      // assert(rob != NULL);
-      int slot;
-      issueq_operation_on_cluster_with_result(getcore(), cluster, slot, slotof(rob->get_tag()));
-      bool allready;
-	  bool issued;
-      issueq_operation_on_cluster_with_result(getcore(), cluster, allready, allready[slot]);
-      issueq_operation_on_cluster_with_result(getcore(), cluster, issued, issued[slot]);
-	
-      if(allready && ~issued){
-		rob->changestate(rob->get_ready_to_issue_list());
-		if(!rob->uop.ready_cycle)
-  		  rob->uop.ready_cycle = sim_cycle;
-	  }
-    }	
-  }
-}
 //
 // Issue Stage
 // (see smtexec.cpp for issue stages)
@@ -1799,74 +1801,16 @@ int ThreadContext::commit() {
   // not ready to commit or has an exception.
   //
   int rc = COMMIT_RESULT_OK;
+  int commits_before = core.commitcount;
 
   foreach_forward(ROB, i) {
     ReorderBufferEntry& rob = ROB[i];
 		
     if unlikely (core.commitcount >= COMMIT_WIDTH) break;
 
-    FetchBufferEntry uop = rob.uop;
-    W64 result = rob.physreg->data;
     rc = rob.commit();
 
     if likely (rc == COMMIT_RESULT_OK) {
-	if (uop.perfbranchpred_touch){
-	  if (uop.fake_result == result){
-	    perfbranchpred.matched++;
-	    if (isload(uop.opcode)){
-	      perfbranchpred.ok_load++;
-	    }
-	  }
-	  else if (!uop.internal){
-	    perfbranchpred.notmatched++;
-	    if (isload(uop.opcode)){
-	      ptl_logfile << "LOAD :";
-	      ptl_logfile << "LOAD ADDR", uop.virtaddr == uop.dbgmsg.virtaddr, endl;	  
-	      ptl_logfile << "PAGE_FAULT", uop.pagefault, uop.dbgmsg.pagefault, endl;
-	      ptl_logfile << "BYTEMASK", endl;
-	      DebugAddr &msg = uop.dbgmsg;
-	      if (msg.unaligned){
-			ptl_logfile << '\t', hexstring(msg.bytemask_1, 8), endl,
-		  '\t', hexstring(msg.bytemask_2, 8), endl;
-	      }
-	      else{
-			ptl_logfile << '\t', hexstring(msg.bytemask, 8), endl;
-	      }
-	      ptl_logfile << "sizeshift : ", uop.size, endl;
-	      ptl_logfile << msg.type1, " ", msg.type2, " ", msg.type3, endl;
-	      ptl_logfile << uop.cond, endl;
-	      ptl_logfile << "EXTENED : ", (uop.opcode == OP_ldx), endl;
-	      ptl_logfile << "DATA1 : ", hexstring(msg.temp_data_1, 64), endl;
-	      ptl_logfile << "DATA2 : ", hexstring(msg.temp_data_2, 64), endl;
-	      ptl_logfile << "DATA3 : ", hexstring(msg.temp_data_3, 64), endl;
-
-	      perfbranchpred.miss_load++;
-	    }
-	    else if(isstore(uop.opcode)){
-	      perfbranchpred.miss_store++;
-	    }
-	    else if(isbranch(uop.opcode)){
-	      ptl_logfile << "BRANCH :";
-	      perfbranchpred.miss_branch++;
-	    }	
-	    else{
-	      ptl_logfile << "OTHER :";
-	      perfbranchpred.miss_other++;
-	    }
-
-	    if (!isstore(uop.opcode) && !uop.internal){
-	      ptl_logfile << "NOTMATCHED : ", uop.uuid," ", endl,
-		'\t', hexstring(uop.temp_radata, 64), " ", 
-		hexstring(uop.temp_rbdata, 64), " ", 
-		hexstring(uop.temp_rcdata, 64), endl,
-		'\t', hexstring(uop.radata, 64), " ", hexstring(uop.rbdata, 64), " ", 
-		hexstring(uop.rcdata, 64), endl,
-		'\t', uop.ra, " ", uop.rb, " ", uop.rc, 
-		'\t', hexstring(result, 64), " ", hexstring(uop.fake_result, 64), endl;
-	    }
-	  }
-	}	    
-	    
 	core.commitcount++;
 	last_commit_at_cycle = sim_cycle;
 	thread_stats.rob_reads++;
@@ -1936,11 +1880,47 @@ int ThreadContext::commit() {
     }		
   }
 
+  if unlikely (config.rip_profile_filename &&
+               core.commitcount == commits_before &&
+               core.commitcount < COMMIT_WIDTH)
+    profile_commit_stall();
+
   CORE_STATS(commit.width)[core.commitcount]++;
 
   return rc;
 }
 
+//
+// Charge one stalled commit cycle to the RIP blocking the ROB head, using
+// the same cause priority as the interval analysis above.
+//
+void ThreadContext::profile_commit_stall() {
+  if (ROB.empty()) {
+    rip_profile.stall(fetchrip.rip, RIP_STALL_FRONTEND);
+    return;
+  }
+
+  int idx = ROB.head;
+  ReorderBufferEntry& rob = ROB[idx];
+  Memory::MemoryHierarchy* mem = core.memoryHierarchy;
+  int cause;
+
+  if (rob.uop.dtlb || mem->is_dtlb_miss(idx))
+    cause = RIP_STALL_DTLB;
+  else if (rob.uop.l2_dcache || mem->is_l2_dcache_miss(idx))
+    cause = RIP_STALL_L2_DCACHE;
+  else if (rob.uop.l1_dcache || mem->is_l1_dcache_miss(idx))
+    cause = RIP_STALL_L1_DCACHE;
+  else if (isload(rob.uop.opcode) || isstore(rob.uop.opcode))
+    cause = RIP_STALL_DCACHE_HIT;
+  else if (fuinfo[rob.uop.opcode].latency > 1)
+    cause = RIP_STALL_LONG_LAT;
+  else
+    cause = RIP_STALL_BACKEND;
+
+  rip_profile.stall(rob.uop.rip.rip, cause);
+}
+
 void ThreadContext::flush_mem_lock_release_list(int start) {
   for (int i = start; i < queued_mem_lock_release_count; i++) {
     W64 lockaddr = queued_mem_lock_release_list[i];
@@ -2472,7 +2452,9 @@ int ReorderBufferEntry::commit() {
 			
 		//for debug by vteori
 		//ptl_logfile << "Store => rob : ", index(), " addr : ", ((void *) (lsq->physaddr << 3)), endl;
-		assert(core.memoryHierarchy->access_cache(request));
+		bool ok = core.memoryHierarchy->access_cache(request);
+		assert(ok);
+		(void)ok;
 
 		assert(lsq->virtaddr > 0xfff);
 		if(config.checker_enabled && !ctx.kernel_mode) {
@@ -2515,6 +2497,7 @@ int ReorderBufferEntry::commit() {
 	  uop.l1sharing = getcore().memoryHierarchy->get_l1cacheline_sharing(index());
 	  uop.l2sharing = getcore().memoryHierarchy->get_l2cacheline_sharing(index());
 	  */
+      thread.lsq_hash.remove(lsq->index());
       lsq->reset();
       thread.LSQ.commit(lsq);
       core.set_unaligned_hint(uop.rip, uop.ld_st_truly_unaligned);
@@ -2564,6 +2547,25 @@ int ReorderBufferEntry::commit() {
       W64 end_of_branch_x86_insn = uop.rip + uop.bytes;
 
       thread.branchpred.update(uop.predinfo, end_of_branch_x86_insn, ctx.get_cs_eip());
+      thread.shadow_branchpred.commit(uop.predinfo, end_of_branch_x86_insn, uop.riptaken, ctx.get_cs_eip());
+      if unlikely (config.branch_trace_filename)
+        thread.branch_trace.record(branch_trace_file, uop.predinfo.flags, end_of_branch_x86_insn,
+            uop.riptaken, ctx.get_cs_eip(), thread.total_insns_committed, ctx.kernel_mode);
+
+      if unlikely (thread.branch_oracle.active()) {
+        int outcome = thread.branch_oracle.commit(uop.predinfo.oracle_seq,
+            end_of_branch_x86_insn, ctx.get_cs_eip());
+        thread.thread_stats.branchpred.oracle[outcome]++;
+
+        bool in_sync = (outcome == BRANCH_ORACLE_MATCH);
+        if unlikely (!in_sync && thread.branch_oracle_in_sync) {
+          ptl_logfile << "WARNING: at cycle ", sim_cycle, ": vcpu ", ctx.cpu_index,
+            " branch at ", (void*)end_of_branch_x86_insn, " to ", (void*)ctx.get_cs_eip(),
+            " is ", branch_oracle_outcome_names[outcome], " in -branch-oracle after ",
+            thread.branch_oracle.committed(), " records", endl;
+        }
+        thread.branch_oracle_in_sync = in_sync;
+      }
       thread.thread_stats.branchpred.updates++;
   }
 
@@ -2603,6 +2605,9 @@ int ReorderBufferEntry::commit() {
   if (config.trace_filename)
     uop.print_trace(trace_file);
 
+  if unlikely (config.rip_profile_filename)
+    thread.rip_profile.commit(uop, uop.rip.rip);
+
   // //check it makes resources available
   // ThreadContext &thread = uop.getthread();
   // if (thread.loads_in_flight < LDQ_SIZE)
@@ -13,6 +13,7 @@
 
 #include <ptlhwdef.h>
 #include <branchpred.h>
+#include <branchtrace.h>
 #include <statsBuilder.h>
 #include <ooo-const.h>
 #include <decode.h>
@@ -325,6 +326,9 @@ namespace OOO_CORE_MODEL {
             StatArray<W64, 2> ret;
             StatArray<W64, 2> summary;
 
+            // How committed branches matched -branch-oracle
+            StatArray<W64, BRANCH_ORACLE_OUTCOMES> oracle;
+
             struct ras : public Statable
             {
                 StatObj<W64> pushes;
@@ -351,6 +355,7 @@ namespace OOO_CORE_MODEL {
                   , indir("indir", this, branchpred_outcome_names)
                   , ret("ret", this, branchpred_outcome_names)
                   , summary("summary", this, branchpred_outcome_names)
+                  , oracle("oracle", this, branch_oracle_outcome_names)
                   , ras(this)
             {}
         } branchpred;
@@ -21,10 +21,12 @@
 #include <ooo.h>
 
 #include <memoryHierarchy.h>
+#include <hostprof.h>
 
 #define MYDEBUG if(logable(99)) ptl_logfile
 
-#ifndef ENABLE_CHECKS
+// Without checks asserts only evaluate, unless DISABLE_ASSERT drops them
+#if !defined(ENABLE_CHECKS) && !defined(DISABLE_ASSERT)
 #undef assert
 #define assert(x) (x)
 #endif
@@ -129,14 +131,17 @@ static void init_luts() {
 
 ThreadContext::ThreadContext(OooCore& core_, W8 threadid_, Context& ctx_)
   : core(core_), threadid(threadid_), ctx(ctx_)
-  , perfbranchpred(this), thread_stats("thread", &core_)
+  , thread_stats("thread", &core_)
   , interval(core_.intervals[threadid_]) // by vteori
   , periodic_interval(core_.periodic_intervals[threadid_]) // by vteori
+  , rip_profile(core_.rip_profiles[threadid_])
 {
   stringbuf stats_name;
   stats_name << "thread" << threadid;
   thread_stats.update_name(stats_name.buf);
 
+  branch_trace.init(core.coreid, threadid);
+
   // Set decoder stats
   set_decoder_stats(&thread_stats, ctx.cpu_index);
 
@@ -194,7 +199,21 @@ void ThreadContext::reset() {
   issueq_count = 0;
 #endif
   queued_mem_lock_release_count = 0;
-  branchpred.init(coreid, threadid);
+  branchpred.init(core.bp_config, coreid, threadid);
+  shadow_branchpred.reset();
+
+  branch_oracle_in_sync = true;
+  if unlikely (config.perfect_branch_pred) {
+    if (!config.branch_oracle_filename.set() ||
+        !branch_oracle.open(config.branch_oracle_filename, core.coreid, threadid)) {
+      stringbuf err;
+      err << "::ERROR::-perfect-branch-pred needs a trace from an earlier -branch-trace run, ",
+          "can't read -branch-oracle '", config.branch_oracle_filename, "'", endl;
+      ptl_logfile << err;
+      cout << err;
+      assert(0);
+    }
+  }
 
   in_tlb_walk = 0;
   /***** by vteori *****/
@@ -246,6 +265,29 @@ void ThreadContext::init() {
 }
 
 
+//
+// Read a structure size from the core options. Sizes larger than the
+// compiled-in capacity can't be honoured without a rebuild, so they are
+// clamped with a warning.
+//
+static int get_size_option(BaseMachine& machine, const char* name,
+    const char* opt_name, int max_size) {
+  int value;
+  if (!machine.get_option(name, opt_name, value))
+    return max_size;
+
+  if (value < 2 || value > max_size) {
+    int clamped = clipto(value, 2, max_size);
+    cerr << "Warning: core ", name, " option ", opt_name, "=", value,
+         " is outside [2, ", max_size, "]; using ", clamped, endl;
+    ptl_logfile << "Warning: core ", name, " option ", opt_name, "=", value,
+                " is outside [2, ", max_size, "]; using ", clamped, endl;
+    value = clamped;
+  }
+
+  return value;
+}
+
 OooCore::OooCore(BaseMachine& machine_, W8 num_threads,
 		 const char* name)
   : BaseCore(machine_, name)
@@ -257,6 +299,14 @@ OooCore::OooCore(BaseMachine& machine_, W8 num_threads,
     threadcount = 1;
   }
 
+  rob_size = get_size_option(machine_, name, "rob_size", ROB_SIZE);
+  iq_size = get_size_option(machine_, name, "iq_size", ISSUE_QUEUE_SIZE);
+  ldq_size = get_size_option(machine_, name, "ldq_size", LDQ_SIZE);
+  stq_size = get_size_option(machine_, name, "stq_size", STQ_SIZE);
+  phys_reg_file_size = get_size_option(machine_, name,
+      "phys_reg_file_size", PHYS_REG_FILE_SIZE);
+  bp_config.read_options(machine_, name);
+
   setzero(threads);
 
   assert(num_threads > 0 && "Core has atleast 1 thread");
@@ -296,6 +346,7 @@ OooCore::OooCore(BaseMachine& machine_, W8 num_threads,
   intervalcount = threadcount; // by vteori
   intervals = new Interval[intervalcount];  // by vteori
   periodic_intervals = new Interval[intervalcount];  // by vteori
+  rip_profiles = new RIPProfile[threadcount];
 
   // Setup Threads
   foreach(i, threadcount) {
@@ -303,6 +354,8 @@ OooCore::OooCore(BaseMachine& machine_, W8 num_threads,
     ThreadContext* thread = new ThreadContext(*this, i, ctx);
     threads[i] = thread;
     thread->init();
+    thread->shadow_branchpred.init(machine_, name, &thread->thread_stats.branchpred,
+        &thread->thread_stats.commit.insns, coreid, i);
   }
 
   init();
@@ -316,26 +369,27 @@ void OooCore::reset() {
 
   setzero(robs_on_fu);
 
+  foreach_issueq(set_capacity(iq_size));
   foreach_issueq(reset(coreid, this));
 
 #ifndef MULTI_IQ
   int reserved_iq_entries_per_thread = (int)sqrt(
-						 ISSUE_QUEUE_SIZE / threadcount);
+						 iq_size / threadcount);
   reserved_iq_entries = reserved_iq_entries_per_thread * \
     threadcount;
   assert(reserved_iq_entries && reserved_iq_entries < \
-	 ISSUE_QUEUE_SIZE);
+	 iq_size);
 
   foreach_issueq(set_reserved_entries(reserved_iq_entries));
 #else
   int reserved_iq_entries_per_thread = (int)sqrt(
-						 ISSUE_QUEUE_SIZE / threadcount);
+						 iq_size / threadcount);
 
   for_each_cluster(cluster){
     reserved_iq_entries[cluster] = reserved_iq_entries_per_thread * \
       threadcount;
     assert(reserved_iq_entries[cluster] && reserved_iq_entries[cluster] < \
-	   ISSUE_QUEUE_SIZE);
+	   iq_size);
   }
 
   foreach_issueq(set_reserved_entries(
@@ -553,12 +607,12 @@ bool OooCore::runcycle(void* none) {
     }
   }
 
-  MYDEBUG << " ISSUE_QUEUE_SIZE ", ISSUE_QUEUE_SIZE, " issueq_all.count ", issueq_all.count, " issueq_all.shared_free_entries ",
+  MYDEBUG << " iq_size ", iq_size, " issueq_all.count ", issueq_all.count, " issueq_all.shared_free_entries ",
     issueq_all.shared_free_entries, " total_issueq_reserved_free ", total_issueq_reserved_free,
     " reserved_iq_entries ", reserved_iq_entries, " total_issueq_count ", total_issueq_count, endl;
 
   assert (total_issueq_count == issueq_all.count);
-  assert((ISSUE_QUEUE_SIZE - issueq_all.count) == (issueq_all.shared_free_entries + total_issueq_reserved_free));
+  assert((iq_size - issueq_all.count) == (issueq_all.shared_free_entries + total_issueq_reserved_free));
 #else
   foreach(cluster, 4){
     int total_issueq_count = 0;
@@ -581,11 +635,11 @@ bool OooCore::runcycle(void* none) {
     issueq_operation_on_cluster_with_result((*this), cluster, issueq_count, count);
     int issueq_shared_free_entries = 0;
     issueq_operation_on_cluster_with_result((*this), cluster, issueq_shared_free_entries, shared_free_entries);
-    MYDEBUG << " cluster[", cluster, "] ISSUE_QUEUE_SIZE ", ISSUE_QUEUE_SIZE, " issueq[" , cluster, "].count ", issueq_count, " issueq[" , cluster, "].shared_free_entries ",
+    MYDEBUG << " cluster[", cluster, "] iq_size ", iq_size, " issueq[" , cluster, "].count ", issueq_count, " issueq[" , cluster, "].shared_free_entries ",
       issueq_shared_free_entries, " total_issueq_reserved_free ", total_issueq_reserved_free,
       " reserved_iq_entries ", reserved_iq_entries[cluster], " total_issueq_count ", total_issueq_count, endl;
     assert (total_issueq_count == issueq_count);
-    assert((ISSUE_QUEUE_SIZE - issueq_count) == (issueq_shared_free_entries + total_issueq_reserved_free));
+    assert((iq_size - issueq_count) == (issueq_shared_free_entries + total_issueq_reserved_free));
 
   }
 
@@ -628,9 +682,18 @@ bool OooCore::runcycle(void* none) {
       continue;
     }
 
-    commitrc[tid] = thread->commit();
-    for_each_cluster(j) thread->writeback(j);
-    for_each_cluster(j) thread->transfer(j);
+    {
+      host_profile_scope(HOSTPROF_COMMIT);
+      commitrc[tid] = thread->commit();
+    }
+    {
+      host_profile_scope(HOSTPROF_WRITEBACK);
+      for_each_cluster(j) thread->writeback(j);
+    }
+    {
+      host_profile_scope(HOSTPROF_TRANSFER);
+      for_each_cluster(j) thread->transfer(j);
+    }
   }
 
   if (logable(100)) {
@@ -665,20 +728,28 @@ bool OooCore::runcycle(void* none) {
   //
   // Always clock the issue queues: they're independent of all threads
   //
-  foreach_issueq(clock());
+  {
+    host_profile_scope(HOSTPROF_WAKEUP);
+    foreach_issueq(clock());
+    foreach_issueq(wakeup());
+  }
 
-  /***** (Trace) by vteori *****/
-  foreach (i, threadcount) {
-    ThreadContext* thread = threads[i];
-    thread->readycheck();
-    for_each_cluster(j) { thread->complete(j); }
+  {
+    host_profile_scope(HOSTPROF_COMPLETE);
+    foreach (i, threadcount) {
+      ThreadContext* thread = threads[i];
+      for_each_cluster(j) { thread->complete(j); }
+    }
   }
 
   if (logable(9)) {
     ptl_logfile << "OooCore::run():issue\n";
   }
 
-  for_each_cluster(i) { issue(i); }
+  {
+    host_profile_scope(HOSTPROF_ISSUE);
+    for_each_cluster(i) { issue(i); }
+  }
 
   //
   // Most of the frontend (except fetch!) also works with round robin priority
@@ -696,9 +767,13 @@ bool OooCore::runcycle(void* none) {
 
     // for_each_cluster(j) { thread->complete(j); }
 
-    dispatchrc[tid] = thread->dispatch();
+    {
+      host_profile_scope(HOSTPROF_DISPATCH);
+      dispatchrc[tid] = thread->dispatch();
+    }
 		
     if likely (dispatchrc[tid] >= 0) {
+		host_profile_scope(HOSTPROF_FRONTEND);
 		thread->frontend();
 		thread->rename();
     }
@@ -750,6 +825,7 @@ bool OooCore::runcycle(void* none) {
       }
 
     if likely (dispatchrc[i] >= 0) {
+	host_profile_scope(HOSTPROF_FETCH);
 	fetch_exception[i] = thread->fetch();
       }
   }
@@ -1533,15 +1609,15 @@ void OooCore::dump_configuration(YAML::Emitter &out) const
 
   YAML_KEY_VAL(out, "type", "core");
   YAML_KEY_VAL(out, "threads", threadcount);
-  YAML_KEY_VAL(out, "iq_size", ISSUE_QUEUE_SIZE);
+  YAML_KEY_VAL(out, "iq_size", iq_size);
   YAML_KEY_VAL(out, "phys_reg_files", PHYS_REG_FILE_COUNT);
 #ifdef UNIFIED_INT_FP_PHYS_REG_FILE
-  YAML_KEY_VAL(out, "phys_reg_file_int_fp_size", PHYS_REG_FILE_SIZE);
+  YAML_KEY_VAL(out, "phys_reg_file_int_fp_size", phys_reg_file_size);
 #else
-  YAML_KEY_VAL(out, "phys_reg_file_int_size", PHYS_REG_FILE_SIZE);
-  YAML_KEY_VAL(out, "phys_reg_file_fp_size", PHYS_REG_FILE_SIZE);
+  YAML_KEY_VAL(out, "phys_reg_file_int_size", phys_reg_file_size);
+  YAML_KEY_VAL(out, "phys_reg_file_fp_size", phys_reg_file_size);
 #endif
-  YAML_KEY_VAL(out, "phys_reg_file_st_size", STQ_SIZE * threadcount);
+  YAML_KEY_VAL(out, "phys_reg_file_st_size", stq_size * threadcount);
   YAML_KEY_VAL(out, "phys_reg_file_br_size", MAX_BRANCHES_IN_FLIGHT *
 	       threadcount);
   YAML_KEY_VAL(out, "fetch_q_size", FETCH_QUEUE_SIZE);
@@ -1564,8 +1640,12 @@ void OooCore::dump_configuration(YAML::Emitter &out) const
 
   out << YAML::Key << "per_thread" << YAML::Value << YAML::BeginMap;
 
-  YAML_KEY_VAL(out, "rob_size", ROB_SIZE);
-  YAML_KEY_VAL(out, "lsq_size", LSQ_SIZE);
+  YAML_KEY_VAL(out, "rob_size", rob_size);
+  YAML_KEY_VAL(out, "lsq_size", ldq_size + stq_size);
+
+  out << YAML::Key << "branchpred" << YAML::Value;
+  threads[0]->branchpred.impl->dump_configuration(out);
+  threads[0]->shadow_branchpred.dump_configuration(out);
 
   out << YAML::EndMap;
 
@@ -1603,395 +1683,3 @@ namespace OOO_CORE_MODEL {
   CycleTimer ctwriteback;
   CycleTimer ctcommit;
 };
-
-void PerfectBranchPredictor::setup(const RegisterRenameTable& rrt)
-{
-  //Build temporal architecture resgister for emulating instruction in current pipeline
-  int max = rrt.length;
-  assert (rrt.length == regfile.length);
-
-  for (int i = 0; i < max; i++){
-    regfile[i].data = rrt[i]->data;
-    regfile[i].flags = rrt[i]->flags;
-  }
-
-  wbbuf.reset();
-  internal_wbbuf.reset();
-}
-
-bool PerfectBranchPredictor::emulate(FetchBufferEntry& tr, W64 &predaddr)
-{
-  //Emulate instruction
-  bool ld = isload(tr.opcode);
-  bool st = isstore(tr.opcode);
-  bool br = isbranch(tr.opcode);
-  physreg &ra = regfile[tr.ra];
-  physreg &rb = regfile[tr.rb];
-  physreg &rc = regfile[tr.rc];
-  physreg &rd = regfile[tr.rd];
-
-  W64 radata = ra.data;
-  W64 rbdata = (tr.rb == REG_imm) ? tr.rbimm : rb.data;
-  W64 rcdata = (tr.rc == REG_imm) ? tr.rcimm : rc.data;
-
-  IssueState state;
-  state.reg.rdflags = 0;
-  
-  tr.temp_radata = radata;
-  tr.temp_rbdata = rbdata;
-  tr.temp_rcdata = rcdata;
-
-  if (tr.opcode == OP_ast){
-    ast++;
-    return false;
-  }
-  else if (tr.opcode == OP_mf){
-    fence++;
-    return false;
-  }
-  else if (tr.opcode == OP_ld_pre){
-    return true;
-  }
-  else if (ld){
-    if (tr.cond == LDST_ALIGN_NORMAL || tr.cond == LDST_ALIGN_HI){
-      bool signext = tr.opcode == OP_ldx;
-      executeLoad(state, radata, rbdata, tr.internal, tr.size, signext, tr.dbgmsg);
-    }
-    else
-      return true;
-  }
-  else if (st){
-    if (tr.cond == LDST_ALIGN_NORMAL || tr.cond == LDST_ALIGN_HI){
-      executeStore(state, radata, rbdata, rcdata, tr.internal, tr.size, tr.dbgmsg);
-    }
-    else{
-      return true;
-    }
-  }
-  else {
-    if unlikely (br){
-	state.brreg.riptaken = tr.riptaken;
-	state.brreg.ripseq = tr.ripseq;
-      }
-    //exectue instrcution
-    tr.synthop(state, radata, rbdata, rcdata, ra.flags, rb.flags, rc.flags);
-  }
-
-  tr.perfbranchpred_touch = true;
-
-  //check invalid result
-  if (state.reg.rdflags & FLAG_INV){
-    invalid++;
-    return false;
-  }
-
-  //Update the result
-  rd.data = state.reg.rddata;
-  rd.flags = state.reg.rdflags;
-  tr.fake_result = rd.data;
-
-  //We should update flags register as well
-  if unlikely (!tr.nouserflags) {
-      if (tr.setflags & SETFLAG_ZF) {
-	regfile[REG_zf].data = state.reg.rddata;
-	regfile[REG_zf].flags = state.reg.rdflags;
-      }
-      if (tr.setflags & SETFLAG_CF) {
-	regfile[REG_cf].data = state.reg.rddata;
-	regfile[REG_cf].flags = state.reg.rdflags;
-      }
-      if (tr.setflags & SETFLAG_OF) {
-	regfile[REG_of].data = state.reg.rddata;
-	regfile[REG_of].flags = state.reg.rdflags;
-      }
-    }
-
-  predaddr = state.reg.rddata;
-  return true;
-}
-
-void PerfectBranchPredictor::executeStore (IssueState &state, W64 radata, W64 rbdata, W64 rcdata, bool internal, W8 sizeshift, DebugAddr &msg)
-{
-  W64 virtaddr;
-  int op_size = 1 << sizeshift;
-  W8 bytemask = (1 << op_size) - 1;
-
-  if (internal){
-    state.reg.rdflags = FLAG_INV;
-    internal++;
-    return;
-  }
-  else{
-    //address generate
-    if (!addrgen(virtaddr, radata, rbdata, true, sizeshift)){
-      //Page fault
-      state.reg.rdflags = FLAG_INV;
-      msg.virtaddr = virtaddr;
-      msg.pagefault = true;
-      pagefault++;
-      return;
-    }
-    msg.virtaddr = virtaddr;
-
-    bool unaligned = lowbits(virtaddr, 3);
-    
-    if (unaligned){
-      //unaligned case
-      //We may store two block
-      //Block crossing (we need second block access)
-      W64 addr1 = floor(virtaddr, 8);
-      W64 addr2 = floor(addr1 + op_size - 1, 8);
-      int byte_diff = virtaddr - addr1;
-
-      //addr1
-      physreg *wb_buf_entry = wbbuf.probe(addr1);
-      if (wb_buf_entry){
-	W64 old_data = wb_buf_entry->data;
-	W8 old_bytemask = wb_buf_entry->bytemask;
-	W64 bitmask = expand_8bit_to_64bit_lut[old_bytemask & ~(bytemask << byte_diff)];
-	wb_buf_entry->data = mux64(bitmask, (rcdata << byte_diff * 8), old_data);
-	wb_buf_entry->bytemask = old_bytemask | (bytemask << byte_diff);
-      }
-      else{
-	wb_buf_entry = wbbuf(addr1);
-	assert(wb_buf_entry);
-	wb_buf_entry->data = (rcdata << (byte_diff * 8));
-	wb_buf_entry->bytemask = bytemask << byte_diff;
-      }
-
-      //addr2
-      if (addr2 != addr1){
-	wb_buf_entry = wbbuf.probe(addr2);
-	int shiftwidth = 8 - byte_diff;
-	if (wb_buf_entry){
-	  W64 old_data = wb_buf_entry->data;
-	  W8 old_bytemask = wb_buf_entry->bytemask;
-	  W64 bitmask = expand_8bit_to_64bit_lut[old_bytemask & ~(bytemask >> shiftwidth)];
-	  wb_buf_entry->data = mux64(bitmask, (rcdata >> shiftwidth * 8), old_data);
-	  wb_buf_entry->bytemask = old_bytemask | (bytemask >> shiftwidth);
-	}
-	else{
-	  wb_buf_entry = wbbuf(addr2);
-	  assert(wb_buf_entry);
-	  wb_buf_entry->data = rcdata >> (shiftwidth * 8);
-	  wb_buf_entry->bytemask = bytemask >> shiftwidth;
-	}
-      }
-    }
-    else{
-      //alingend case
-      //check wb_buf
-      physreg *wb_buf_entry = wbbuf.probe(virtaddr);
-      if (wb_buf_entry){
-	W64 old_data = wb_buf_entry->data;
-	W8 old_bytemask = wb_buf_entry->bytemask;
-	W64 bitmask = expand_8bit_to_64bit_lut[old_bytemask & ~bytemask];
-	wb_buf_entry->data = mux64(bitmask, rcdata, old_data);
-	wb_buf_entry->bytemask = old_bytemask | bytemask;
-      }
-      else{
-	wb_buf_entry = wbbuf(virtaddr);
-	assert(wb_buf_entry);
-	wb_buf_entry->data = rcdata;
-	wb_buf_entry->bytemask = bytemask;
-      }
-    }
-  }
-
-  return;
-}
-
-static inline W64 extract_bytes(void* target, int SIZESHIFT, bool SIGNEXT) {
-  W64 data;
-  switch (SIZESHIFT) {
-  case 0:
-    data = (SIGNEXT) ? (W64s)(*(W8s*)target) : (*(W8*)target); break;
-  case 1:
-    data = (SIGNEXT) ? (W64s)(*(W16s*)target) : (*(W16*)target); break;
-  case 2:
-    data = (SIGNEXT) ? (W64s)(*(W32s*)target) : (*(W32*)target); break;
-  case 3:
-    data = *(W64*)target; break;
-  default:
-    ptl_logfile << "Invalid sizeshift in extract_bytes\n";
-    data = 0xdeadbeefdeadbeef;
-  }
-  return data;
-}
- 
-void PerfectBranchPredictor::executeLoad (IssueState &state, W64 radata, W64 rbdata, bool internal, W8 sizeshift, bool signext, DebugAddr &msg)
-{
-  W64 virtaddr;
-  W8 op_size = 1 << sizeshift;
-  W8 bytemask = (1 << op_size) - 1;
-  //internal register (MSR) uses virtual address (ra + rb)
-  if (internal){
-    //modeling internal instruction is left; It doesn't take much portion of code.
-    internal++;
-    state.reg.rdflags = FLAG_INV;
-    state.reg.rddata = 0;
-    return;
-  }
-  else{
-    W64 temp_data = 0;
-    W8 temp_bytemask = 0;
-    //Address generate
-    if (!addrgen(virtaddr, radata, rbdata, false, sizeshift)){
-      pagefault++;
-      state.reg.rdflags = FLAG_INV;
-      msg.virtaddr = virtaddr;
-      msg.pagefault = true;
-      return;
-    }
-    msg.virtaddr = virtaddr;
-    
-    //Unaligned access check
-    bool unaligned = lowbits(virtaddr, 3);
-    msg.unaligned = unaligned;
-    //Generate bytemask and data
-    if (unaligned){
-      //first block
-      physreg *first_wb_entry;
-      physreg *second_wb_entry;
-      W64 addr1 = floor(virtaddr, 8);
-      W64 addr2 = floor(virtaddr + op_size - 1, 8);
-      int byte_diff = virtaddr - addr1;
-      first_wb_entry = wbbuf.probe(addr1);
-
-      //How many bits does be shifted to fill data in temp_data?
-      if (first_wb_entry) {
-	temp_data = (first_wb_entry->data) >> (byte_diff * 8);
-	temp_bytemask = (first_wb_entry->bytemask) >> byte_diff;
-	msg.type1 = true;
-      }
-      msg.bytemask_1 = temp_bytemask;
-
-      //second block
-      //block crossing
-      if (addr2 != addr1){
-	int shift_width = 8 - byte_diff;
-	second_wb_entry = wbbuf.probe(addr2);
-	if (second_wb_entry){
-	  temp_data |=  (second_wb_entry->data) << (shift_width * 8);
-	  temp_bytemask |= (second_wb_entry->bytemask) << shift_width;
-	  msg.type2 = true;
-	}
-      }
-      msg.bytemask_2 = temp_bytemask;
-    }
-    else{
-      physreg *temp_wb_entry = wbbuf.probe(virtaddr);
-      if (temp_wb_entry){
-	temp_data = temp_wb_entry->data;
-	temp_bytemask = temp_wb_entry->bytemask;
-	msg.type3 = true;
-      }
-      msg.bytemask = temp_bytemask;
-    }
-
-    if (temp_bytemask != 0xff) {
-      //Load data from virtaddr
-      //Merge the data with merged_data;
-      W64 temp_bitmask = expand_8bit_to_64bit_lut[temp_bytemask];
-      W64 load_data = thread->ctx.loadvirt(virtaddr, sizeshift);
-      msg.temp_data_1 = load_data;
-      msg.temp_data_2 = temp_data;
-      temp_data = mux64(temp_bitmask, load_data, temp_data);
-      msg.temp_data_3 = temp_data;
-      state.reg.rdflags = ~FLAG_INV;
-    }
-    else{
-      state.reg.rdflags = ~FLAG_INV;
-    }
-    //Extract opsize's data from 64 bit data and sign extends if it requires
-    state.reg.rddata = extract_bytes((void *) &temp_data, sizeshift, signext);
-    return;
-  }
-}
-
-//Return : true => success, false => Page fault occurs
-bool PerfectBranchPredictor::addrgen (Waddr &virtaddr, W64 ra, W64 rb, bool st, int sizeshift)
-{
-  int exception;
-  int mmio;
-  PageFaultErrorCode pfec;
-  W64 addr1;
-  W64 addr2;
-  int op_size = 1 << sizeshift;
-
-
-  //virtual address generate
-  virtaddr = simple_addr(ra, rb);
-  //unalignedment check
-  addr1 = floor(virtaddr, 8);
-  addr2 = floor(virtaddr + op_size - 1, 8);
-
-  //Page fault check
-  //First, check hardware tlb in qemu
-  //Second, it trigger pagefault error or not  
-  //Try_hand_fault function load the page physcal address mapped to virtaddr to tlb in qemu if it can load
-  //Otherwise it generates page faults
-  thread->ctx.check_and_translate(addr1, sizeshift, st, false, exception, mmio, pfec);
-  if (exception != 0){
-    if (!(thread->ctx.try_handle_fault(virtaddr, st)))
-      return false;
-  }
-
-  //Second page testing.
-  int page_crossing = ((lowbits(virtaddr, 12) + (op_size - 1)) >> 12);
-  if (page_crossing){
-    thread->ctx.check_and_translate(addr2, sizeshift, st, false, exception, mmio, pfec);
-    if (exception != 0){
-      if (!(thread->ctx.try_handle_fault(addr2, st)))
-	return false;
-    }
-  }  
-
-  return true;
-}
-
-W64 PerfectBranchPredictor::simple_addr (W64 ra, W64 rb){
-  W64 addr;
-  addr = ra + rb;
-  addr = (W64) signext64(addr, 48);
-  addr &= thread->ctx.virt_addr_mask;
-  return addr;
-}
-
-W64 PerfectBranchPredictor::predict(Queue<FetchBufferEntry, FETCH_QUEUE_SIZE> &fetchq,     
-				    Queue<ReorderBufferEntry, ROB_SIZE> &rob,
-				    RegisterRenameTable &rrt,
-				    bool &success)
-{
-  W64 branchaddr;
-  try_count++;
-  //setup emulation environment : copy architecture register state
-  setup(rrt);
-  //We assume all branch instruction in pipeline except the lastest one is predicted perfectly.
-  //Emulate instruction in ROB first
-  foreach_forward(rob, i){
-    if(!emulate(rob[i].uop, branchaddr)){
-      failed_count++;
-      success = false;
-      return 0;
-    }
-  }
-  //Than in fetch queue.  
-  //Based on emulated state, determin last branch instruction's jump address.
-  assert (fetchq.count != 0);
-  foreach_forward(fetchq, i){
-    if (i == add_index_modulo(fetchq.tail, -1, fetchq.size)){
-      assert(isbranch(fetchq[i].opcode));
-    }
-
-    if(!emulate(fetchq[i], branchaddr)){
-      failed_count++;
-      success = false;
-      return 0;
-    }
-  }
-  success = true;
-  return branchaddr;
-}
-
-
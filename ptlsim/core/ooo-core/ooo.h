@@ -14,6 +14,7 @@
 #include <ptlsim.h>
 #include <basecore.h>
 #include <branchpred.h>
+#include <branchtrace.h>
 #include <statelist.h>
 #include <statsBuilder.h>
 #include <decode.h>
@@ -24,7 +25,9 @@
 #include <interval.h> // by vteori
 
 // With these disabled, simulation is faster
+#ifndef DISABLE_CHECKS
 #define ENABLE_CHECKS
+#endif
 #define ENABLE_LOGGING
 //#define ENABLE_CHECKS_IQ
 
@@ -565,20 +568,24 @@ namespace OOO_CORE_MODEL {
     bitvec<size> valid;
     bitvec<size> issued;
     bitvec<size> allready;
+    bitvec<size> woken;     // slots that became ready in the last clock()
     int count;
     byte coreid;
     OooCore* core;
     int shared_free_entries;
     int reserved_entries;
+    int capacity;           // usable slots, at most size
     int issueq_id;
     static int issueq_id_seq;
 
     IssueQueue(){
       issueq_id = issueq_id_seq++;
+      capacity = size;
     }
+    void set_capacity(int num) { assert(inrange(num, 1, size)); capacity = num; }
     void set_reserved_entries(int num) { reserved_entries = num; }
     bool reset_shared_entries() {
-      shared_free_entries = size - reserved_entries;
+      shared_free_entries = capacity - reserved_entries;
       return true;
     }
     bool alloc_shared_entry() {
@@ -587,8 +594,8 @@ namespace OOO_CORE_MODEL {
       return true;
     }
     bool free_shared_entry() {
-      if(logable(99)) ptl_logfile << "shared_free_entries: ", shared_free_entries, " size: ",  size, " reserved_entries: ",  reserved_entries, endl;
-      assert(shared_free_entries < size - reserved_entries);
+      if(logable(99)) ptl_logfile << "shared_free_entries: ", shared_free_entries, " size: ",  capacity, " reserved_entries: ",  reserved_entries, endl;
+      assert(shared_free_entries < capacity - reserved_entries);
       shared_free_entries++;
       return true;
     }
@@ -596,7 +603,7 @@ namespace OOO_CORE_MODEL {
       return (shared_free_entries == 0);
     }
 
-    bool remaining() const { return (size - count); }
+    bool remaining() const { return (capacity - count); }
     bool empty() const { return (!count); }
     bool full() const { return (!remaining()); }
 
@@ -611,6 +618,7 @@ namespace OOO_CORE_MODEL {
     void reset(W8 coreid, OooCore* core);
     void reset(W8 coreid, W8 threadid, OooCore* core);
     void clock();
+    void wakeup();
     bool insert(tag_t uopid, const tag_t* operands, const tag_t* preready);
     bool broadcast(tag_t uopid);
     int issue(int previd = -1);
@@ -669,33 +677,10 @@ namespace OOO_CORE_MODEL {
     int stack_recover_idx;
     int bptype;
     W64 ripafter;
+    W64s oracle_seq; // BranchOracle record predicted from, -1 if none
   };
 
 
-  struct DebugAddr{
-    W64 virtaddr;
-    W8 bytemask_1;
-    W8 bytemask_2;
-    W8 bytemask;
-    W64 temp_data_1;
-    W64 temp_data_2;
-    W64 temp_data_3;
-    bool type1;
-    bool type2;
-    bool type3;
-    bool unaligned;
-    bool pagefault;
-
-    DebugAddr(){ 
-      virtaddr = 0;
-      bytemask_1 = 0; 
-      bytemask_2 = 0; bytemask = 0; 
-      temp_data_1 = 0; temp_data_2 = 0; temp_data_3 = 0;
-      type1 = false; type2 = false; type3 = false;
-      unaligned = false; pagefault = false; 
-    }
-  };
-
   struct FetchBufferEntry: public TransOp {
     //    friend std::ostream &operator <<(std::ostream &c, const FetchBufferEntry &T);
     //    friend std::ostream &operator <<(std::ostream &c, const FetchBufferEntry *pT);
@@ -708,28 +693,19 @@ namespace OOO_CORE_MODEL {
     byte ld_st_truly_unaligned;
     
     //
-    W64 fake_result;
     W64 radata;
     W64 rbdata;
     W64 rcdata;
-    W64 temp_radata;
-    W64 temp_rbdata;
-    W64 temp_rcdata;
     W64 virtaddr;
-    bool perfbranchpred_touch;
     bool pagefault;
 
-    DebugAddr dbgmsg;
-
-    int init(int index) { this->index = index; perfbranchpred_touch = false; fake_result = 0; virtaddr = 0; pagefault = false; return 0;}
-    void validate() {perfbranchpred_touch = false; fake_result = 0; virtaddr = 0; pagefault = false;}
+    int init(int index) { this->index = index; virtaddr = 0; pagefault = false; return 0;}
+    void validate() { virtaddr = 0; pagefault = false;}
 
-    FetchBufferEntry() { perfbranchpred_touch = false; fake_result = 0; virtaddr = 0;  pagefault = false; }
+    FetchBufferEntry() { virtaddr = 0;  pagefault = false; }
 
     FetchBufferEntry(const TransOp& transop) {
       *((TransOp*)this) = transop;
-      this->perfbranchpred_touch = false;
-      this->fake_result = 0;
       this->virtaddr = 0;
       this->pagefault = false;
     }
@@ -891,6 +867,57 @@ namespace OOO_CORE_MODEL {
     return lsq.print(os);
   }
 
+  //
+  // Address index over the LSQ, used to avoid walking the whole queue
+  // when searching for forwarding stores and aliased loads.
+  //
+  // Every entry with a resolved address (other than fences) is chained in
+  // a hash bucket keyed by its 8-byte physaddr granule. Stores and fences
+  // whose address is still unknown are kept in the 'unresolved' mask since
+  // every search has to look at them. Lookups return candidate LSQ indices
+  // in program order; callers still apply their usual checks to each one,
+  // so the result is the same as the full walk.
+  //
+  // update() must be called whenever an entry's store, addrvalid or
+  // physaddr fields change, and remove() when the entry is freed.
+  //
+  struct LSQAddressHash {
+    static const int BUCKET_BITS = (LSQ_SIZE > 128) ? 10 : 8;
+    static const int BUCKETS = (1 << BUCKET_BITS);
+
+    W16s bucket[BUCKETS];
+    W16s next[LSQ_SIZE];
+    W64 key[LSQ_SIZE];
+    bitvec<LSQ_SIZE> hashed;
+    bitvec<LSQ_SIZE> unresolved;
+
+    LSQAddressHash() { reset(); }
+
+    void reset();
+    void update(const LoadStoreQueueEntry& lsq);
+    void remove(int idx);
+
+    // Resolved entries within +/- range granules plus unresolved stores
+    // that are older than idx, youngest first
+    int older(const Queue<LoadStoreQueueEntry, LSQ_SIZE>& LSQ, int idx,
+        W64 physaddr, int range, int* out) const;
+
+    // Unresolved stores and fences older than idx, youngest first
+    int older_unresolved(const Queue<LoadStoreQueueEntry, LSQ_SIZE>& LSQ,
+        int idx, int* out) const;
+
+    // Resolved entries within +/- range granules younger than idx,
+    // oldest first
+    int younger(const Queue<LoadStoreQueueEntry, LSQ_SIZE>& LSQ, int idx,
+        W64 physaddr, int range, int* out) const;
+
+  private:
+    static int slot(W64 physaddr) { return physaddr & (BUCKETS - 1); }
+    void link(int idx, W64 physaddr);
+    void unlink(int idx);
+    int collect(int idx, W64 physaddr, int range, int* out) const;
+  };
+
   struct PhysicalRegisterOperandInfo {
     W32 uuid;
     W16 physreg;
@@ -1182,100 +1209,6 @@ namespace OOO_CORE_MODEL {
   typedef TranslationLookasideBuffer<0, DTLB_SIZE> DTLB;
   typedef TranslationLookasideBuffer<1, ITLB_SIZE> ITLB;
 
-  inline void sigsegv_handler(int signo){
-    ptl_logfile.flush();
-    raise(SIGINT);
-  }
-
-
-  struct PerfectBranchPredictor{
-    struct physreg{
-      W64 data;
-      W16 flags;
-      W8 bytemask;
-      
-      void reset() { data = 0; flags = 0xff; bytemask = 0xff; }
-    };
-
-    W64 mispredicted;
-    W64 count;
-    W64 try_count;
-    W64 failed_count;
-    W64 internal;
-    W64 fence;
-    W64 invalid;
-    W64 ast;
-    W64 pagefault;
-    W64 matched;
-    W64 notmatched;
-    W64 miss_load;
-    W64 miss_store;
-    W64 miss_branch;
-    W64 miss_other;
-    W8 phys_ra;
-    W8 phys_rb;
-    W8 phys_rc;
-    W64 ok_load;
-
-    array<physreg, TRANSREG_COUNT> regfile;
-    //write buffer
-    typedef FullyAssociativeArray<W64, physreg, 2 * (LSQ_SIZE + FETCH_QUEUE_SIZE), 
-				  NullAssociativeArrayStatisticsCollector<W64, physreg> > WBbuf;
-    WBbuf wbbuf;
-    WBbuf internal_wbbuf;
-
-    ThreadContext *thread;
-    PerfectBranchPredictor(ThreadContext *thread) {
-      mispredicted = 0;
-      count = 0;
-      try_count = 0;
-      failed_count = 0;
-      fence = 0;
-      internal = 0;
-      invalid = 0;
-      ast = 0;
-      pagefault = 0;
-      matched = 0;
-      notmatched = 0;
-      miss_load = 0;
-      miss_store = 0;
-      miss_other = 0;
-      miss_branch = 0;
-      ok_load = 0;
-      signal(SIGSEGV,sigsegv_handler);
-      this->thread = thread;
-    }
-    ~PerfectBranchPredictor(void){
-      ptl_logfile << "MISS : " , mispredicted, endl,
-	"BRANCH : ", count, endl,
-	"TRY : ", try_count, endl,
-	"FAIL : ", failed_count, endl,
-	"FENCE : ", fence, endl,
-	"INTERNAL : ", internal, endl,
-	"INVALID : ", invalid, endl,
-	"AST : ", ast, endl,
-	"PAGEFAULT : ", pagefault, endl,
-	"MATCHED : ", matched, endl,
-	"LOAD : ", ok_load, endl,
-	"NOT MATCHED : ", notmatched, endl,
-	"LOAD : ", miss_load, endl,
-	"STORE : ", miss_store, endl,
-	"BRANCH : ", miss_branch, endl,
-	"OTHER : ", miss_other, endl;
-    }
-    void setup(const RegisterRenameTable& rrt);
-    W64 simple_addr(W64 ra, W64 rb);
-    bool addrgen(Waddr &virtaddr, W64 ra, W64 rb, bool st,  int sizeshift);
-    void executeLoad(IssueState &state, W64 radata, W64 rbdata, bool internal, W8 sizeshift, bool signext, DebugAddr &dbgmsg);
-    void executeStore(IssueState &state, W64 radata, W64 rbdata, W64 rcdata, bool internal, W8 sizeshift, DebugAddr &dbgmsg);
-    bool emulate(FetchBufferEntry& tr, W64 &predaddr);
-    W64 predict(Queue<FetchBufferEntry, FETCH_QUEUE_SIZE> &fetchq,     
-		Queue<ReorderBufferEntry, ROB_SIZE> &rob,
-		RegisterRenameTable &rrt,
-		bool &fail);
-  };
-
-
   struct ThreadContext {
     OooCore& core;
     OooCore& getcore() { return core; }
@@ -1287,7 +1220,10 @@ namespace OOO_CORE_MODEL {
     W8 coreid;
     Context& ctx;
     BranchPredictorInterface branchpred;
-    PerfectBranchPredictor perfbranchpred;
+    ShadowBranchPredictors shadow_branchpred;
+    BranchTraceWriter branch_trace;
+    BranchOracle branch_oracle;
+    bool branch_oracle_in_sync;
 
     Queue<FetchBufferEntry, FETCH_QUEUE_SIZE> fetchq;
 
@@ -1316,6 +1252,7 @@ namespace OOO_CORE_MODEL {
     Queue<ReorderBufferEntry, ROB_SIZE> ROB;
 
     Queue<LoadStoreQueueEntry, LSQ_SIZE> LSQ;
+    LSQAddressHash lsq_hash;
     RegisterRenameTable specrrt;
     RegisterRenameTable commitrrt;
 
@@ -1396,6 +1333,7 @@ namespace OOO_CORE_MODEL {
     ThreadContext(OooCore& core_, W8 threadid_, Context& ctx_);
 
     int commit();
+    void profile_commit_stall();
     int writeback(int cluster);
     int transfer(int cluster);
     int complete(int cluster);
@@ -1405,7 +1343,6 @@ namespace OOO_CORE_MODEL {
     bool fetch();
     void tlbwalk();
 
-    void readycheck(); // (Trace) by vteori 
 
     bool handle_barrier();
     bool handle_exception();
@@ -1434,6 +1371,7 @@ namespace OOO_CORE_MODEL {
     OooCoreThreadStats thread_stats;
     Interval& interval; // by vteori : interval analysis
     Interval& periodic_interval; // by vteori : interval analysis
+    RIPProfile& rip_profile;
   };
 
   //  class MemoryHierarchy;
@@ -1456,6 +1394,16 @@ namespace OOO_CORE_MODEL {
     int threadcount;
     ThreadContext** threads;
 
+    // Structure sizes from the core options, bounded by ooo-const.h
+    int rob_size;
+    int iq_size;
+    int ldq_size;
+    int stq_size;
+    int phys_reg_file_size;
+
+    // Branch predictor of every thread, from the core options
+    BranchPredictorConfig bp_config;
+
     ListOfStateLists rob_states;
     ListOfStateLists lsq_states;
 
@@ -1566,16 +1514,16 @@ namespace OOO_CORE_MODEL {
       // Physical register files
       //
 #ifdef UNIFIED_PHYS_REG_FILE
-      physregfiles[0]("all", coreid, 0, PHYS_REG_FILE_SIZE, this);
+      physregfiles[0]("all", coreid, 0, phys_reg_file_size, this);
 #else
 #ifdef UNIFIED_INT_FP_PHYS_REG_FILE
-      physregfiles[0]("int", coreid, 0, PHYS_REG_FILE_SIZE, this);
-      physregfiles[1]("st", coreid, 1, STQ_SIZE * threadcount, this);
+      physregfiles[0]("int", coreid, 0, phys_reg_file_size, this);
+      physregfiles[1]("st", coreid, 1, stq_size * threadcount, this);
       physregfiles[2]("br", coreid, 2, MAX_BRANCHES_IN_FLIGHT * threadcount, this);
 #else
-      physregfiles[0]("int", coreid, 0, PHYS_REG_FILE_SIZE, this);
-      physregfiles[1]("fp", coreid, 1, PHYS_REG_FILE_SIZE, this);
-      physregfiles[2]("st", coreid, 2, STQ_SIZE * threadcount, this);
+      physregfiles[0]("int", coreid, 0, phys_reg_file_size, this);
+      physregfiles[1]("fp", coreid, 1, phys_reg_file_size, this);
+      physregfiles[2]("st", coreid, 2, stq_size * threadcount, this);
       physregfiles[3]("br", coreid, 3, MAX_BRANCHES_IN_FLIGHT * threadcount, this);
 #endif
 #endif
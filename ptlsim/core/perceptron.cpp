@@ -0,0 +1,156 @@
+//
+// PTLsim: Cycle Accurate x86-64 Simulator
+// Hashed Perceptron Branch Prediction
+//
+// This program is free software; it is licensed under the
+// GNU General Public License, Version 2.
+//
+
+#include <branchpred.h>
+#include <branchpred-impl.h>
+#include <machine.h>
+
+//
+// Hashed perceptron (Tarjan and Skadron), with the adaptive training
+// threshold of Seznec's O-GEHL. Each table holds 8-bit weights indexed by
+// the branch address hashed with a global history of geometric length;
+// table 0 sees the address alone and acts as the bias weight. The sum of
+// the selected weights gives the direction, and all of them are trained
+// on a misprediction or when the sum is below the threshold.
+//
+
+#define PERCEPTRON_MAX_TABLES 16
+
+struct PerceptronCheckpoint {
+  W64 uuid;
+  W32 index[PERCEPTRON_MAX_TABLES];
+  int sum;
+};
+
+struct PerceptronPredictor: public FrontendPredictor {
+  int tablebits;
+  int ntables;
+  int maxhist;
+
+  dynarray<W8s> weights;  // ntables tables of 1 << tablebits weights
+  int hlen[PERCEPTRON_MAX_TABLES];
+  FoldedHistory fold[PERCEPTRON_MAX_TABLES];
+
+  dynarray<byte> ghist;  // ring, newest branch at ghist_ptr
+  int ghist_ptr;
+
+  int theta;
+  int theta_ctr;
+
+  PredictorCheckpoints<PerceptronCheckpoint> checkpoints;
+
+  static BranchPredictorConfig defaults(const BranchPredictorConfig& c) {
+    BranchPredictorConfig d = c;
+    if (d.table_bits < 0) d.table_bits = 11;
+    if (d.tables < 0) d.tables = 8;
+    if (d.history < 0) d.history = 128;
+    d.table_bits = clipto(d.table_bits, 6, 20);
+    d.tables = clipto(d.tables, 2, PERCEPTRON_MAX_TABLES);
+    d.history = clipto(d.history, d.tables, 1024);
+    return d;
+  }
+
+  PerceptronPredictor(const BranchPredictorConfig& config, W8 coreid, W8 threadid)
+    : FrontendPredictor(defaults(config), coreid, threadid)
+  {
+    tablebits = this->config.table_bits;
+    ntables = this->config.tables;
+    maxhist = this->config.history;
+
+    weights.resize(ntables << tablebits);
+    ghist.resize(1 << (msbindex(maxhist) + 2));
+
+    // Geometric lengths from 2 branches on table 1 up to maxhist
+    hlen[0] = 0;
+    for (int i = 1; i < ntables; i++) {
+      double ratio = (ntables > 2) ? double(i - 1) / double(ntables - 2) : 1.0;
+      hlen[i] = int(2 * pow(double(maxhist) / 2, ratio) + 0.5);
+      if (hlen[i] <= hlen[i-1]) hlen[i] = hlen[i-1] + 1;
+    }
+
+    checkpoints.setup(PREDICTOR_CHECKPOINTS);
+  }
+
+  void reset_direction() {
+    weights.fill(0);
+    ghist.fill(0);
+    ghist_ptr = 0;
+
+    foreach (i, ntables) fold[i].setup(hlen[i], tablebits);
+
+    theta = int(2.14 * ntables + 20.58);
+    theta_ctr = 0;
+
+    foreach (i, checkpoints.slots.count()) checkpoints.slots[i].uuid = W64(-1);
+  }
+
+  inline W32 table_index(W64 pc, int i) const {
+    return lowbits(pc ^ (pc >> (abs(tablebits - i) + 1)) ^ fold[i].comp, tablebits);
+  }
+
+  bool predict_cond(PredictorUpdate& update, W64 branchaddr) {
+    PerceptronCheckpoint& cp = checkpoints.alloc(update);
+
+    int sum = 0;
+    foreach (i, ntables) {
+      cp.index[i] = table_index(branchaddr, i);
+      sum += weights[(i << tablebits) + cp.index[i]];
+    }
+    cp.sum = sum;
+
+    return (sum >= 0);
+  }
+
+  void update_cond(PredictorUpdate& update, W64 branchaddr, bool taken) {
+    PerceptronCheckpoint* cp = checkpoints.find(update);
+
+    if (cp) {
+      bool pred = (cp->sum >= 0);
+      bool weak = (abs(cp->sum) <= theta);
+
+      //
+      // Raise theta on mispredictions and lower it on weak correct
+      // predictions, so both happen about as often.
+      //
+      if (pred != taken) {
+        if (++theta_ctr == 64) {
+          theta++;
+          theta_ctr = 0;
+        }
+      } else if (weak) {
+        if (--theta_ctr == -64) {
+          theta = max(theta - 1, 1);
+          theta_ctr = 0;
+        }
+      }
+
+      if (pred != taken || weak) {
+        foreach (i, ntables) {
+          satupdate(weights[(i << tablebits) + cp->index[i]], taken, -128, 127);
+        }
+      }
+    }
+
+    ghist_ptr = (ghist_ptr - 1) & (ghist.count() - 1);
+    ghist[ghist_ptr] = taken;
+    foreach (i, ntables) fold[i].update(ghist, ghist_ptr);
+  }
+
+  W64 direction_bits() const {
+    return W64(weights.count()) * 8 + maxhist;
+  }
+
+  void dump_direction(YAML::Emitter& out) const {
+    YAML_KEY_VAL(out, "table_bits", tablebits);
+    YAML_KEY_VAL(out, "tables", ntables);
+    YAML_KEY_VAL(out, "history", maxhist);
+  }
+};
+
+// name, table_bits, history, tables
+PresetBranchPredictorBuilder<PerceptronPredictor> perceptron_builder("perceptron", 11, 128, 8);
@@ -0,0 +1,87 @@
+#include <ripprofile.h>
+
+static const W64 RIP_PROFILE_INITIAL_CAPACITY = 4096;
+
+RIPProfile::RIPProfile()
+	: table(NULL), capacity(0), count(0)
+{
+	allocate(RIP_PROFILE_INITIAL_CAPACITY);
+}
+
+RIPProfile::~RIPProfile()
+{
+	delete [] table;
+}
+
+void RIPProfile::allocate(W64 new_capacity)
+{
+	table = new RIPProfileEntry[new_capacity];
+	capacity = new_capacity;
+	count = 0;
+
+	foreach (i, capacity) {
+		setzero(table[i]);
+		table[i].rip = INVALIDRIP;
+	}
+}
+
+void RIPProfile::reset()
+{
+	delete [] table;
+	allocate(RIP_PROFILE_INITIAL_CAPACITY);
+}
+
+void RIPProfile::grow()
+{
+	RIPProfileEntry* old_table = table;
+	W64 old_capacity = capacity;
+
+	allocate(capacity * 2);
+
+	foreach (i, old_capacity) {
+		RIPProfileEntry& old = old_table[i];
+		if (old.rip == INVALIDRIP)
+			continue;
+		lookup(old.rip) = old;
+	}
+
+	delete [] old_table;
+}
+
+struct RIPProfileStallComparator {
+	int operator ()(RIPProfileEntry* a, RIPProfileEntry* b) const {
+		W64 sa = a->total_stalls();
+		W64 sb = b->total_stalls();
+		if (sa == sb) return 0;
+		return (sa > sb) ? -1 : +1;
+	}
+};
+
+void RIPProfile::dump(ostream& os, W16 core_id, W16 thread_id)
+{
+	dynarray<RIPProfileEntry*> entries;
+	entries.reserve(count);
+
+	foreach (i, capacity) {
+		if (table[i].rip != INVALIDRIP)
+			entries.push(&table[i]);
+	}
+
+	sort(entries.data, entries.size(), RIPProfileStallComparator());
+
+	RIPProfileHeader header;
+	setzero(header);
+	header.magic = RIP_PROFILE_MAGIC;
+	header.version = RIP_PROFILE_VERSION;
+	header.core_id = core_id;
+	header.thread_id = thread_id;
+	header.stall_causes = RIP_STALL_COUNT;
+	header.miss_types = RIP_MISS_COUNT;
+	header.count = entries.size();
+	header.sim_cycles = sim_cycle;
+
+	os.write((char*)&header, sizeof(header));
+	foreach (i, entries.size())
+		os.write((char*)entries[i], sizeof(RIPProfileEntry));
+	os.flush();
+}
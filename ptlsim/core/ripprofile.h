@@ -0,0 +1,136 @@
+#ifndef _RIPPROFILE_H_
+#define _RIPPROFILE_H_
+
+#include <ptlsim.h>
+
+/*
+ * Per-RIP cycle attribution profile
+ *
+ * Accumulates, for every committed RIP, the cycles the commit stage spent
+ * stalled on it (split by cause), the cache/TLB misses its uops took and the
+ * branch mispredicts it caused. Entries live in a small open-addressed hash
+ * table (linear probing, power of two capacity) so the per-commit cost is a
+ * hash and a couple of increments. The table is written out in a binary form
+ * sorted by stall cycles; see tools/rip_profile.py for the reader.
+ */
+
+enum {
+	RIP_STALL_FRONTEND,		// ROB empty, charged to the next fetch RIP
+	RIP_STALL_DTLB,
+	RIP_STALL_L2_DCACHE,
+	RIP_STALL_L1_DCACHE,
+	RIP_STALL_DCACHE_HIT,
+	RIP_STALL_LONG_LAT,
+	RIP_STALL_BACKEND,
+	RIP_STALL_COUNT
+};
+
+enum {
+	RIP_MISS_ITLB,
+	RIP_MISS_L1_ICACHE,
+	RIP_MISS_L2_ICACHE,
+	RIP_MISS_DTLB,
+	RIP_MISS_L1_DCACHE,
+	RIP_MISS_L2_DCACHE,
+	RIP_MISS_COUNT
+};
+
+// Written at the start of every dump, followed by 'count' entries
+struct RIPProfileHeader
+{
+	W64 magic;
+	W32 version;
+	W16 core_id;
+	W16 thread_id;
+	W32 stall_causes;
+	W32 miss_types;
+	W64 count;
+	W64 sim_cycles;
+};
+
+struct RIPProfileEntry
+{
+	W64 rip;
+	W64 insns;
+	W64 uops;
+	W64 mispredicts;
+	W64 stalls[RIP_STALL_COUNT];
+	W64 misses[RIP_MISS_COUNT];
+
+	W64 total_stalls() const {
+		W64 total = 0;
+		foreach (i, RIP_STALL_COUNT)
+			total += stalls[i];
+		return total;
+	}
+};
+
+static const W64 RIP_PROFILE_MAGIC = 0x31464f5250504952ULL; // "RIPPROF1"
+static const W32 RIP_PROFILE_VERSION = 1;
+
+struct RIPProfile
+{
+	RIPProfileEntry* table;
+	W64 capacity;
+	W64 count;
+
+	RIPProfile();
+	~RIPProfile();
+
+	void reset();
+
+	RIPProfileEntry& lookup(W64 rip) {
+		W64 mask = capacity - 1;
+		W64 slot = hash(rip) & mask;
+
+		for (;;) {
+			RIPProfileEntry& e = table[slot];
+			if likely (e.rip == rip)
+				return e;
+			if (e.rip == INVALIDRIP)
+				break;
+			slot = (slot + 1) & mask;
+		}
+
+		// Keep the load factor under 1/2 so probe chains stay short
+		if unlikely ((count + 1) * 2 > capacity) {
+			grow();
+			return lookup(rip);
+		}
+
+		RIPProfileEntry& e = table[slot];
+		e.rip = rip;
+		count++;
+		return e;
+	}
+
+	void stall(W64 rip, int cause) {
+		lookup(rip).stalls[cause]++;
+	}
+
+	void commit(const TransOp& uop, W64 rip) {
+		RIPProfileEntry& e = lookup(rip);
+		e.uops++;
+		e.insns += uop.eom;
+		e.mispredicts += uop.branch_miss;
+		e.misses[RIP_MISS_ITLB] += uop.itlb;
+		e.misses[RIP_MISS_L1_ICACHE] += uop.l1_icache;
+		e.misses[RIP_MISS_L2_ICACHE] += uop.l2_icache;
+		e.misses[RIP_MISS_DTLB] += uop.dtlb;
+		e.misses[RIP_MISS_L1_DCACHE] += uop.l1_dcache;
+		e.misses[RIP_MISS_L2_DCACHE] += uop.l2_dcache;
+	}
+
+	void dump(ostream& os, W16 core_id, W16 thread_id);
+
+private:
+	static W64 hash(W64 rip) {
+		// Fibonacci hashing; low RIP bits are too regular to use directly
+		return (rip * 0x9e3779b97f4a7c15ULL) >> 20;
+	}
+
+	void allocate(W64 new_capacity);
+	void grow();
+};
+
+#endif // _RIPPROFILE_H_
@@ -0,0 +1,465 @@
+//
+// PTLsim: Cycle Accurate x86-64 Simulator
+// TAGE-SC-L Branch Prediction
+//
+// This program is free software; it is licensed under the
+// GNU General Public License, Version 2.
+//
+
+#include <branchpred.h>
+#include <branchpred-impl.h>
+#include <machine.h>
+
+//
+// TAGE with a loop predictor and a statistical corrector, after Seznec's
+// TAGE-SC-L. Tagged tables are indexed by geometric lengths of global
+// history; the longest matching table provides the prediction. A loop
+// predictor overrides it for branches with a constant trip count, and the
+// statistical corrector reverts it when short history GEHL tables and a
+// bias table, indexed by the TAGE prediction, disagree strongly enough.
+//
+// Like the combined predictor, histories are updated when the branch
+// commits, so fetch sees the history of the committed path only.
+//
+
+#define TAGE_MAX_TABLES 15
+#define TAGE_MIN_HISTORY 4
+#define TAGE_USEFUL_RESET_PERIOD (1 << 18)
+
+#define LOOP_TAG_BITS 10
+#define LOOP_ITER_BITS 14
+
+// Statistical corrector: bias table then GEHL tables of these histories
+#define SC_TABLES 4
+static const int sc_history[SC_TABLES] = {0, 4, 10, 16};
+
+struct TageEntry {
+  W16 tag;
+  W8s ctr;  // -4..3, taken when >= 0
+  W8 u;     // useful, 0..3
+};
+
+struct LoopEntry {
+  W16 tag;
+  W16 past;     // iterations of the last complete loop
+  W16 current;  // iterations so far
+  W8 confidence;
+  W8 age;
+  bool dir;     // direction while looping
+};
+
+struct TageCheckpoint {
+  W64 uuid;
+  W32 index[TAGE_MAX_TABLES];
+  W16 tag[TAGE_MAX_TABLES];
+  W32 base_index;
+  W32 loop_index;
+  W32 sc_index[SC_TABLES];
+  int sc_sum;
+  W8s provider;   // -1 for the base predictor
+  W8s alt;
+  bool provider_pred;
+  bool provider_weak;
+  bool alt_pred;
+  bool tage_pred;
+  bool loop_hit;
+  bool loop_valid;
+  bool loop_pred;
+  bool inter_pred;  // after the loop predictor
+  bool sc_pred;
+};
+
+struct TagePredictor: public FrontendPredictor {
+  int tablebits;
+  int ntables;
+  int maxhist;
+  int loopbits;
+
+  dynarray<TageEntry> tagged;  // ntables tables of 1 << tablebits entries
+  dynarray<byte> base;         // 2-bit counters
+  dynarray<LoopEntry> loops;
+  dynarray<W8s> sc;            // SC_TABLES tables of 6-bit counters
+
+  int hlen[TAGE_MAX_TABLES];
+  int tagbits[TAGE_MAX_TABLES];
+  FoldedHistory index_fold[TAGE_MAX_TABLES];
+  FoldedHistory tag_fold[TAGE_MAX_TABLES][2];
+
+  dynarray<byte> ghist;  // ring, newest branch at ghist_ptr
+  int ghist_ptr;
+  W64 ghist_bits;        // last 64 branches for the corrector
+  W32 phist;             // path history
+
+  int use_alt_on_na;
+  int with_loop;
+  int sc_threshold;
+  int sc_threshold_ctr;
+  W64 tick;
+  W64 random;
+
+  PredictorCheckpoints<TageCheckpoint> checkpoints;
+
+  static BranchPredictorConfig defaults(const BranchPredictorConfig& c) {
+    BranchPredictorConfig d = c;
+    if (d.table_bits < 0) d.table_bits = 10;
+    if (d.tables < 0) d.tables = 12;
+    if (d.history < 0) d.history = 640;
+    d.table_bits = clipto(d.table_bits, 6, 20);
+    d.tables = clipto(d.tables, 2, TAGE_MAX_TABLES);
+    d.history = clipto(d.history, TAGE_MIN_HISTORY * 2, 2048);
+    return d;
+  }
+
+  TagePredictor(const BranchPredictorConfig& config, W8 coreid, W8 threadid)
+    : FrontendPredictor(defaults(config), coreid, threadid)
+  {
+    tablebits = this->config.table_bits;
+    ntables = this->config.tables;
+    maxhist = this->config.history;
+    loopbits = max(tablebits - 4, 4);
+
+    tagged.resize(ntables << tablebits);
+    base.resize(1 << (tablebits + 3));
+    loops.resize(1 << loopbits);
+    sc.resize(SC_TABLES << tablebits);
+    ghist.resize(1 << (msbindex(maxhist) + 2));
+
+    //
+    // Geometric history lengths from TAGE_MIN_HISTORY to maxhist, with
+    // tags growing from 8 to 15 bits on the longer tables.
+    //
+    foreach (i, ntables) {
+      double ratio = double(i) / double(ntables - 1);
+      hlen[i] = int(TAGE_MIN_HISTORY * pow(double(maxhist) / TAGE_MIN_HISTORY, ratio) + 0.5);
+      if (i > 0 && hlen[i] <= hlen[i-1]) hlen[i] = hlen[i-1] + 1;
+      tagbits[i] = min(8 + (i * 8) / ntables, 15);
+    }
+
+    checkpoints.setup(PREDICTOR_CHECKPOINTS);
+  }
+
+  void reset_direction() {
+    TageEntry empty;
+    empty.tag = 0;
+    empty.ctr = 0;
+    empty.u = 0;
+    tagged.fill(empty);
+
+    // weakly taken
+    base.fill(2);
+
+    LoopEntry noloop;
+    memset(&noloop, 0, sizeof(noloop));
+    loops.fill(noloop);
+
+    sc.fill(0);
+
+    ghist.fill(0);
+    ghist_ptr = 0;
+    ghist_bits = 0;
+    phist = 0;
+
+    foreach (i, ntables) {
+      index_fold[i].setup(hlen[i], tablebits);
+      tag_fold[i][0].setup(hlen[i], tagbits[i]);
+      tag_fold[i][1].setup(hlen[i], tagbits[i] - 1);
+    }
+
+    use_alt_on_na = 0;
+    with_loop = -1;
+    sc_threshold = 20;
+    sc_threshold_ctr = 0;
+    tick = 0;
+    random = 0x9e3779b97f4a7c15ULL;
+
+    foreach (i, checkpoints.slots.count()) checkpoints.slots[i].uuid = W64(-1);
+  }
+
+  inline TageEntry& entry(int table, W32 index) {
+    return tagged[(table << tablebits) + index];
+  }
+
+  inline W32 table_index(W64 pc, int i) const {
+    int plen = min(hlen[i], 16);
+    W32 path = phist & ((1 << plen) - 1);
+    W32 h = W32(pc) ^ W32(pc >> (abs(tablebits - i) + 1)) ^ index_fold[i].comp ^
+      path ^ (path >> (i + 1));
+    return lowbits(h, tablebits);
+  }
+
+  inline W16 table_tag(W64 pc, int i) const {
+    W32 h = W32(pc) ^ tag_fold[i][0].comp ^ (tag_fold[i][1].comp << 1);
+    return lowbits(h, tagbits[i]);
+  }
+
+  inline W32 sc_index(W64 pc, int j, bool pred) const {
+    if (j == 0) return lowbits(((pc ^ (pc >> tablebits)) << 1) | pred, tablebits);
+    W64 h = lowbits(ghist_bits, sc_history[j]);
+    return lowbits(pc ^ (pc >> (j + 2)) ^ h ^ (h << (j + 1)), tablebits);
+  }
+
+  inline W64 next_random() {
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    return random;
+  }
+
+  bool predict_cond(PredictorUpdate& update, W64 branchaddr) {
+    TageCheckpoint& cp = checkpoints.alloc(update);
+    W64 pc = branchaddr;
+
+    cp.base_index = lowbits((pc >> 16) ^ pc, tablebits + 3);
+    cp.provider = -1;
+    cp.alt = -1;
+
+    for (int i = ntables-1; i >= 0; i--) {
+      cp.index[i] = table_index(pc, i);
+      cp.tag[i] = table_tag(pc, i);
+      if (entry(i, cp.index[i]).tag != cp.tag[i]) continue;
+      if (cp.provider < 0) cp.provider = i;
+      else if (cp.alt < 0) cp.alt = i;
+    }
+
+    bool base_pred = (base[cp.base_index] >= 2);
+    cp.alt_pred = (cp.alt >= 0) ? (entry(cp.alt, cp.index[cp.alt]).ctr >= 0) : base_pred;
+
+    int ctr = 0;
+    if (cp.provider >= 0) {
+      ctr = entry(cp.provider, cp.index[cp.provider]).ctr;
+      cp.provider_pred = (ctr >= 0);
+      cp.provider_weak = (ctr == 0 || ctr == -1);
+      cp.tage_pred = (cp.provider_weak && use_alt_on_na >= 0) ? cp.alt_pred : cp.provider_pred;
+    } else {
+      cp.provider_pred = base_pred;
+      cp.provider_weak = false;
+      cp.tage_pred = base_pred;
+    }
+
+    //
+    // Loop predictor
+    //
+    cp.loop_index = lowbits(pc ^ (pc >> loopbits), loopbits);
+    LoopEntry& loop = loops[cp.loop_index];
+    cp.loop_hit = (loop.tag == lowbits(pc >> loopbits, LOOP_TAG_BITS));
+    cp.loop_valid = cp.loop_hit && (loop.confidence == 3);
+    cp.loop_pred = (loop.current + 1 == loop.past) ? !loop.dir : loop.dir;
+    cp.inter_pred = (cp.loop_valid && with_loop >= 0) ? cp.loop_pred : cp.tage_pred;
+
+    //
+    // Statistical corrector, only trusted over a saturated provider when
+    // it is twice as sure.
+    //
+    int sum = 0;
+    foreach (j, SC_TABLES) {
+      cp.sc_index[j] = sc_index(pc, j, cp.inter_pred);
+      sum += 2 * sc[(j << tablebits) + cp.sc_index[j]] + 1;
+    }
+    cp.sc_sum = sum;
+    cp.sc_pred = (sum >= 0);
+
+    bool confident = (ctr == 3 || ctr == -4);
+    int needed = (confident) ? 2 * sc_threshold : sc_threshold;
+
+    if (cp.sc_pred != cp.inter_pred && abs(sum) >= needed) return cp.sc_pred;
+    return cp.inter_pred;
+  }
+
+  void update_sc(TageCheckpoint& cp, bool taken) {
+    if (cp.sc_pred != cp.inter_pred) {
+      satupdate(sc_threshold_ctr, (cp.sc_pred != taken), -64, 63);
+      if (sc_threshold_ctr == 63) {
+        sc_threshold = min(sc_threshold + 2, 255);
+        sc_threshold_ctr = 0;
+      } else if (sc_threshold_ctr == -64) {
+        sc_threshold = max(sc_threshold - 2, 6);
+        sc_threshold_ctr = 0;
+      }
+    }
+
+    if (cp.sc_pred != taken || abs(cp.sc_sum) < sc_threshold) {
+      foreach (j, SC_TABLES) {
+        satupdate(sc[(j << tablebits) + cp.sc_index[j]], taken, -32, 31);
+      }
+    }
+  }
+
+  void update_loop(TageCheckpoint& cp, W64 pc, bool taken) {
+    LoopEntry& loop = loops[cp.loop_index];
+
+    if (cp.loop_valid && cp.loop_pred != cp.tage_pred) {
+      satupdate(with_loop, (cp.loop_pred == taken), -64, 63);
+    }
+
+    if (!cp.loop_hit) {
+      //
+      // Allocate on a TAGE misprediction, guessing it was a loop exit.
+      // Entries age so a busy slot is taken only after several tries.
+      //
+      if (cp.tage_pred == taken || (next_random() & 3)) return;
+
+      if (loop.age == 0) {
+        loop.tag = lowbits(pc >> loopbits, LOOP_TAG_BITS);
+        loop.dir = !taken;
+        loop.past = 0;
+        loop.current = 0;
+        loop.confidence = 0;
+        loop.age = 7;
+      } else {
+        loop.age--;
+      }
+      return;
+    }
+
+    if (cp.loop_valid) {
+      if (cp.loop_pred != taken) {
+        loop.past = 0;
+        loop.current = 0;
+        loop.confidence = 0;
+        loop.age = 0;
+        return;
+      }
+      if (cp.loop_pred != cp.tage_pred && loop.age < 7) loop.age++;
+    }
+
+    loop.current = lowbits(loop.current + 1, LOOP_ITER_BITS);
+    if (loop.current > loop.past) {
+      loop.confidence = 0;
+      if (loop.past) {
+        loop.past = 0;
+        loop.age = 0;
+      }
+    }
+
+    if (taken != loop.dir) {
+      if (loop.current == loop.past) {
+        if (loop.confidence < 3) loop.confidence++;
+        // Short loops are handled well enough by TAGE
+        if (loop.past < 3) {
+          loop.dir = taken;
+          loop.past = 0;
+          loop.age = 0;
+          loop.confidence = 0;
+        }
+      } else if (loop.past == 0) {
+        loop.past = loop.current;
+        loop.confidence = 0;
+      } else {
+        loop.past = 0;
+        loop.confidence = 0;
+      }
+      loop.current = 0;
+    }
+  }
+
+  void update_tage(TageCheckpoint& cp, bool taken) {
+    // The provider may have been replaced since the prediction
+    int provider = cp.provider;
+    if (provider >= 0 && entry(provider, cp.index[provider]).tag != cp.tag[provider]) provider = -1;
+
+    bool alloc = (cp.tage_pred != taken) && (provider < ntables-1);
+
+    if (provider >= 0 && cp.provider_weak) {
+      // A fresh entry was right, a new one would not help
+      if (cp.provider_pred == taken) alloc = false;
+      if (cp.provider_pred != cp.alt_pred) satupdate(use_alt_on_na, (cp.alt_pred == taken), -8, 7);
+    }
+
+    if (alloc) {
+      int start = provider + 1;
+      if (start < ntables-1 && (next_random() & 1)) start++;
+
+      int found = -1;
+      for (int i = start; i < ntables; i++) {
+        if (entry(i, cp.index[i]).u == 0) {
+          found = i;
+          break;
+        }
+      }
+
+      if (found >= 0) {
+        TageEntry& e = entry(found, cp.index[found]);
+        e.tag = cp.tag[found];
+        e.ctr = (taken) ? 0 : -1;
+        e.u = 0;
+      } else {
+        for (int i = start; i < ntables; i++) {
+          TageEntry& e = entry(i, cp.index[i]);
+          if (e.u) e.u--;
+        }
+      }
+    }
+
+    if (provider >= 0) {
+      TageEntry& e = entry(provider, cp.index[provider]);
+      satupdate(e.ctr, taken, -4, 3);
+
+      // Train the alternate too while the provider is not known useful
+      if (e.u == 0) {
+        if (cp.alt >= 0 && entry(cp.alt, cp.index[cp.alt]).tag == cp.tag[cp.alt]) {
+          satupdate(entry(cp.alt, cp.index[cp.alt]).ctr, taken, -4, 3);
+        } else {
+          satupdate(base[cp.base_index], taken, 0, 3);
+        }
+      }
+
+      if (cp.provider_pred != cp.alt_pred) satupdate(e.u, (cp.provider_pred == taken), 0, 3);
+    } else {
+      satupdate(base[cp.base_index], taken, 0, 3);
+    }
+
+    // Age the useful bits so stale entries can be replaced
+    if ((++tick & (TAGE_USEFUL_RESET_PERIOD - 1)) == 0) {
+      foreach (i, tagged.count()) tagged[i].u >>= 1;
+    }
+  }
+
+  void update_history(W64 pc, bool taken) {
+    ghist_ptr = (ghist_ptr - 1) & (ghist.count() - 1);
+    ghist[ghist_ptr] = taken;
+    ghist_bits = (ghist_bits << 1) | taken;
+    phist = lowbits((phist << 1) ^ (W32(pc ^ (pc >> 4)) & 1), 16);
+
+    foreach (i, ntables) {
+      index_fold[i].update(ghist, ghist_ptr);
+      tag_fold[i][0].update(ghist, ghist_ptr);
+      tag_fold[i][1].update(ghist, ghist_ptr);
+    }
+  }
+
+  void update_cond(PredictorUpdate& update, W64 branchaddr, bool taken) {
+    TageCheckpoint* cp = checkpoints.find(update);
+
+    if (cp) {
+      update_sc(*cp, taken);
+      update_loop(*cp, branchaddr, taken);
+      update_tage(*cp, taken);
+    }
+
+    update_history(branchaddr, taken);
+  }
+
+  W64 direction_bits() const {
+    W64 bits = 0;
+    foreach (i, ntables) bits += W64(1 << tablebits) * (tagbits[i] + 3 + 2);
+    bits += W64(base.count()) * 2;
+    bits += W64(loops.count()) * (LOOP_TAG_BITS + 2 * LOOP_ITER_BITS + 2 + 3 + 1);
+    bits += W64(sc.count()) * 6;
+    bits += maxhist + 16;
+    return bits;
+  }
+
+  void dump_direction(YAML::Emitter& out) const {
+    YAML_KEY_VAL(out, "table_bits", tablebits);
+    YAML_KEY_VAL(out, "tables", ntables);
+    YAML_KEY_VAL(out, "history", maxhist);
+    YAML_KEY_VAL(out, "min_history", hlen[0]);
+    YAML_KEY_VAL(out, "loop_entries", loops.count());
+    YAML_KEY_VAL(out, "sc_tables", SC_TABLES);
+  }
+};
+
+// name, table_bits, history, tables
+PresetBranchPredictorBuilder<TagePredictor> tage_sc_l_builder("tage_sc_l", 10, 640, 12);
+PresetBranchPredictorBuilder<TagePredictor> tage_sc_l_8k_builder("tage_sc_l_8k", 8, 200, 8);
+PresetBranchPredictorBuilder<TagePredictor> tage_sc_l_64k_builder("tage_sc_l_64k", 11, 1000, 14);
@@ -0,0 +1,240 @@
+//
+// Host microbenchmarks of the structures in logic.h and statelist.h
+//
+// Sizes follow what the cores use: 16 to 64 entry issue queues, 32 entry
+// TLBs, 64 to 128 entry ROBs and L1 sized set associative arrays. The
+// core specific structures (issue queue, LSQ) are timed in the core models.
+//
+
+#include <globals.h>
+#include <superstl.h>
+#include <logic.h>
+#include <statelist.h>
+#include <bench.h>
+
+//
+// Tag broadcast match of the issue queue tag arrays
+//
+template <int size>
+struct Tags16Match {
+  FullyAssociativeTags16bit<size, size> tags;
+
+  Tags16Match() {
+    foreach (i, size) tags.insertslot(i, i);
+  }
+
+  W64 operator()(W64 iters) {
+    W64 sum = 0;
+    for (W64 n = 0; n < iters; n++)
+      sum += tags.match(W16(n & 63)).integer();
+    return sum;
+  }
+};
+
+// The match loop before match() packed the compares: one pmovmskw and a
+// bitvec accumulate per chunk of eight tags
+template <int size>
+struct Tags16ChunkedMatch {
+  FullyAssociativeTags16bit<size, size> tags;
+
+  Tags16ChunkedMatch() {
+    foreach (i, size) tags.insertslot(i, i);
+  }
+
+  W64 operator()(W64 iters) {
+    W64 sum = 0;
+    for (W64 n = 0; n < iters; n++) {
+      bitvec<size> m = 0;
+      vec8w target = tags.prep(W16(n & 63));
+      foreach (i, tags.chunkcount) {
+        m = m.accum(i*8, 8, x86_sse_pmovmskw(
+              x86_sse_pcmpeqw(target, tags.tags[i])));
+      }
+      sum += (m & tags.valid).integer();
+    }
+    return sum;
+  }
+};
+
+template <int size>
+struct Tags8Match {
+  FullyAssociativeTags8bit<size, size> tags;
+
+  Tags8Match() {
+    foreach (i, size) tags.insertslot(i, i);
+  }
+
+  W64 operator()(W64 iters) {
+    W64 sum = 0;
+    for (W64 n = 0; n < iters; n++)
+      sum += tags.match(byte(n & 63)).integer();
+    return sum;
+  }
+};
+
+static void bench_assoc_tags16(Benchmark& b) {
+  Tags16Match<16> t16;
+  Tags16Match<32> t32;
+  Tags16Match<64> t64;
+  b.measure_simd("match_16", t16);
+  b.measure_simd("match_32", t32);
+  b.measure_simd("match_64", t64);
+
+  Tags16ChunkedMatch<64> chunked;
+  b.measure("match_64_chunked", chunked);
+}
+
+BENCHMARK("logic.assoc_tags16", bench_assoc_tags16);
+
+static void bench_assoc_tags8(Benchmark& b) {
+  Tags8Match<16> t16;
+  Tags8Match<32> t32;
+  Tags8Match<64> t64;
+  b.measure("match_16", t16);
+  b.measure("match_32", t32);
+  b.measure("match_64", t64);
+}
+
+BENCHMARK("logic.assoc_tags8", bench_assoc_tags8);
+
+//
+// TLB style probe of a fully associative array of 64-bit tags, mostly hits
+//
+template <int ways>
+struct TagsProbe {
+  FullyAssociativeTags<W64, ways> tags;
+
+  TagsProbe() {
+    foreach (i, ways) tags.select(W64(i) << 12);
+  }
+
+  W64 operator()(W64 iters) {
+    W64 sum = 0;
+    for (W64 n = 0; n < iters; n++)
+      sum += tags.probe((n % (ways + ways / 8)) << 12);
+    return sum;
+  }
+};
+
+static void bench_assoc_tags64(Benchmark& b) {
+  TagsProbe<32> t32;
+  TagsProbe<64> t64;
+  b.measure("probe_32", t32);
+  b.measure("probe_64", t64);
+}
+
+BENCHMARK("logic.assoc_tags64", bench_assoc_tags64);
+
+//
+// Set associative lookup, 32 KB of 64 byte lines in 8 ways
+//
+struct BenchLine {
+  W64 data;
+  void reset() { data = 0; }
+};
+
+struct ArrayProbe {
+  typedef AssociativeArray<W64, BenchLine, 64, 8, 64> array_t;
+  array_t* array;
+
+  ArrayProbe() {
+    array = new array_t();
+    foreach (i, 64 * 8) array->select(W64(i) << 6)->data = i;
+  }
+
+  ~ArrayProbe() { delete array; }
+
+  W64 operator()(W64 iters) {
+    W64 sum = 0;
+    W64 addr = 0;
+    for (W64 n = 0; n < iters; n++) {
+      // Strided walk over 36 KB so about one access in nine misses
+      addr = (addr + 0x1c0) % (36 * 1024);
+      BenchLine* line = array->probe(addr);
+      sum += (line) ? line->data : 1;
+    }
+    return sum;
+  }
+};
+
+static void bench_assoc_array(Benchmark& b) {
+  ArrayProbe body;
+  b.measure("probe_64x8", body);
+}
+
+BENCHMARK("logic.assoc_array", bench_assoc_array);
+
+//
+// ROB style allocate at the tail and commit at the head, half full
+//
+struct BenchQueueEntry {
+  W16 idx;
+  W64 data;
+
+  void init(int i) { idx = i; data = 0; }
+  void validate() { }
+  int index() const { return idx; }
+};
+
+template <int size>
+struct QueueCycle {
+  Queue<BenchQueueEntry, size> queue;
+
+  QueueCycle() {
+    foreach (i, size / 2) queue.alloc()->data = i;
+  }
+
+  W64 operator()(W64 iters) {
+    W64 sum = 0;
+    for (W64 n = 0; n < iters; n++) {
+      queue.alloc()->data = n;
+      BenchQueueEntry& head = queue[queue.head];
+      sum += head.data;
+      queue.commit(head);
+    }
+    return sum;
+  }
+};
+
+static void bench_queue(Benchmark& b) {
+  QueueCycle<64> q64;
+  QueueCycle<128> q128;
+  b.measure("alloc_commit_64", q64);
+  b.measure("alloc_commit_128", q128);
+}
+
+BENCHMARK("logic.queue", bench_queue);
+
+//
+// Entries moving through a ring of state lists, like ROB changestate()
+//
+struct StateListCycle {
+  static const int ENTRIES = 128;
+  static const int LISTS = 4;
+
+  selfqueuelink entries[ENTRIES];
+  StateList lists[LISTS];
+
+  StateListCycle() {
+    foreach (i, ENTRIES) lists[i % LISTS].enqueue(&entries[i]);
+  }
+
+  W64 operator()(W64 iters) {
+    W64 sum = 0;
+    for (W64 n = 0; n < iters; n++) {
+      int from = n % LISTS;
+      StateList& list = lists[from];
+      selfqueuelink* entry = list.peek();
+      list.remove_to_list(&lists[(from + 1) % LISTS], false, entry);
+      sum += list.count;
+    }
+    return sum;
+  }
+};
+
+static void bench_statelist(Benchmark& b) {
+  StateListCycle body;
+  b.measure("move", body);
+}
+
+BENCHMARK("logic.statelist", bench_statelist);
@@ -108,12 +108,23 @@ struct FixedQueue: public array<T, SIZE> {
   int head; // used for allocation
   int tail; // used for deallocation
   int count; // count of entries
+  int capacity; // usable slots, at most SIZE (set at runtime)
 
   static const int size = SIZE;
 
   FixedQueue() {
+    capacity = SIZE;
     reset();
   }
+
+  //
+  // Limit the number of entries that can be allocated. The queue still
+  // wraps around all SIZE slots, so this only changes when it is full.
+  //
+  void set_capacity(int n) {
+    assert(inrange(n, 1, SIZE));
+    capacity = n;
+  }
  
   void flush() {
     head = tail = count = 0;
@@ -124,7 +135,7 @@ struct FixedQueue: public array<T, SIZE> {
   }
 
   int remaining() const {
-    return max((SIZE - count) - 1, 0);
+    return max((capacity - count) - 1, 0);
   }
 
   bool empty() const {
@@ -1791,6 +1802,9 @@ struct FullyAssociativeTags16bit {
   }
 
   bitvec<size> match(const vec_t target) const {
+    if (size <= 64)
+      return bitvec<size>(matchbits(target)) & valid;
+
     bitvec<size> m = 0;
 
     foreach (i, chunkcount) {
@@ -1800,6 +1814,41 @@ struct FullyAssociativeTags16bit {
     return m & valid;
   }
 
+  //
+  // Raw match mask for up to 64 tags. Uses 32-wide AVX2 compares when the
+  // host has them and otherwise packs two SSE2 compares per pmovmskb.
+  // Compares may run into the padding chunks, so callers mask with valid.
+  //
+  W64 matchbits(const vec_t target) const {
+    const int allchunks = chunkcount + padchunkcount;
+    const base_t* p = (const base_t*)&tags;
+    W64 m = 0;
+    int i = 0;
+
+#ifndef DISABLE_AVX2
+    if likely (x86_have_avx2) {
+      base_t tag = ((const base_t*)&target)[0];
+      if (chunkcount > 4 && allchunks >= 8)
+        return x86_avx2_pcmpeqw_mask64(p, tag);
+      for (; (i < chunkcount) && (i + 4 <= allchunks); i += 4)
+        m |= ((W64)x86_avx2_pcmpeqw_mask32(p + i*8, tag)) << (i*8);
+    }
+#endif
+
+    for (; i < chunkcount; i += 2) {
+      if (i + 1 < allchunks) {
+        W32 pair = x86_sse_pmovmskb(x86_sse_packsswb(
+              x86_sse_pcmpeqw(target, tags[i]),
+              x86_sse_pcmpeqw(target, tags[i+1])));
+        m |= ((W64)pair) << (i*8);
+      } else {
+        m |= ((W64)x86_sse_pmovmskw(x86_sse_pcmpeqw(target, tags[i]))) << (i*8);
+      }
+    }
+
+    return m;
+  }
+
   bitvec<size> match(base_t target) const {
     return match(prep(target));
   }
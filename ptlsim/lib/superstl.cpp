@@ -16,6 +16,34 @@
 // For debugging of messages before crashes:
 bool force_synchronous_streams = false;
 
+//
+// AVX2 needs both the CPUID feature bit and OS support for saving the
+// upper YMM state (OSXSAVE plus XCR0 bits 1 and 2).
+//
+static bool detect_avx2() {
+#ifdef DISABLE_AVX2
+  return false;
+#else
+  W32 eax, ebx, ecx, edx;
+
+  cpuid(0, eax, ebx, ecx, edx);
+  if (eax < 7) return false;
+
+  cpuid(1, eax, ebx, ecx, edx);
+  if (!bit(ecx, 27)) return false;
+
+  W32 xcr0_lo, xcr0_hi;
+  asm volatile("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+  if ((xcr0_lo & 6) != 6) return false;
+
+  eax = 7; ecx = 0;
+  asm("cpuid" : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+  return bit(ebx, 5);
+#endif
+}
+
+bool x86_have_avx2 = detect_avx2();
+
 #include <execinfo.h>
 
 struct assert_cb_t {
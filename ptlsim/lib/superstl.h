@@ -101,6 +101,8 @@ namespace superstl {
     }
 
     stringbuf(const stringbuf& sb) {
+        buf = NULL;
+        reset();
         *this << sb;
     }
 
@@ -0,0 +1,94 @@
+#include <bench.h>
+
+#include <ptlsim.h>
+#include <yaml/yaml.h>
+
+struct BenchResult
+{
+    stringbuf name;
+    W64 ops;
+    W64 ns;
+};
+
+static dynarray<BenchResult*> bench_results;
+
+Benchmark::Benchmark(const char *name, func_t func)
+    : name_(name)
+      , func_(func)
+      , sink_(0)
+{
+    registry().push(this);
+}
+
+/* Function local, so registration doesn't depend on link order */
+dynarray<Benchmark*>& Benchmark::registry()
+{
+    static dynarray<Benchmark*> benchmarks;
+    return benchmarks;
+}
+
+void Benchmark::record(const char *variant, W64 ops, W64 ns)
+{
+    BenchResult *res = new BenchResult();
+    res->name << name_;
+    if (variant)
+        res->name << "/", variant;
+    res->ops = ops;
+    res->ns = ns;
+    bench_results.push(res);
+
+    cout << "  ", padstring(res->name, -44), " ",
+         floatstring(double(ns) / max(ops, W64(1)), 10, 3), " ns/op  ",
+         floatstring(double(ops) / max(ns, W64(1)), 10, 3), " ops/ns", endl;
+}
+
+/**
+ * @brief Run the registered benchmarks and write their results
+ *
+ * @return Number of benchmarks run
+ */
+int Benchmark::run_all(const char *filter, const char *filename)
+{
+    dynarray<Benchmark*>& benchmarks = registry();
+    int n = 0;
+
+    cout << "Running benchmarks (host ", get_native_core_freq_hz() / 1000000,
+         " MHz, avx2 ", (x86_have_avx2 ? "yes" : "no"), ")", endl;
+
+    foreach (i, benchmarks.count()) {
+        Benchmark *b = benchmarks[i];
+        if (filter && !strstr(b->name(), filter))
+            continue;
+
+        b->func_(*b);
+        n++;
+    }
+
+    YAML::Emitter out;
+    out << YAML::BeginMap;
+    out << YAML::Key << "host" << YAML::Value << YAML::BeginMap;
+    out << YAML::Key << "freq_hz" << YAML::Value << get_native_core_freq_hz();
+    out << YAML::Key << "avx2" << YAML::Value << x86_have_avx2;
+    out << YAML::EndMap;
+
+    out << YAML::Key << "benchmarks" << YAML::Value << YAML::BeginSeq;
+    foreach (i, bench_results.count()) {
+        BenchResult *res = bench_results[i];
+        out << YAML::BeginMap;
+        out << YAML::Key << "name" << YAML::Value << res->name.buf;
+        out << YAML::Key << "ops" << YAML::Value << res->ops;
+        out << YAML::Key << "ns" << YAML::Value << res->ns;
+        out << YAML::Key << "ns_per_op" << YAML::Value <<
+            double(res->ns) / max(res->ops, W64(1));
+        out << YAML::Key << "ops_per_ns" << YAML::Value <<
+            double(res->ops) / max(res->ns, W64(1));
+        out << YAML::EndMap;
+    }
+    out << YAML::EndSeq << YAML::EndMap;
+
+    ofstream os(filename);
+    os << out.c_str(), endl;
+    os.close();
+
+    return n;
+}
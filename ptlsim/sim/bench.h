@@ -0,0 +1,106 @@
+
+#ifndef MARSS_BENCH_H
+#define MARSS_BENCH_H
+
+#include <globals.h>
+#include <superstl.h>
+
+/*
+ * Host microbenchmarks of the simulator's hot structures
+ *
+ * Unlike the gtest cases these are built into every binary, optimized or
+ * not, and run with '-run-bench file'. Each benchmark is a function
+ * registered with BENCHMARK() that sets up a structure and times one or
+ * more loops over it with Benchmark::measure(). Results are printed and
+ * written to the file in YAML, one entry per measured loop:
+ *
+ *   - name: logic.assoc_tags16.match_64/avx2
+ *     ops: 268435456
+ *     ns: 412345678
+ *     ns_per_op: 1.54
+ *     ops_per_ns: 0.65
+ *
+ * Benchmarks of core structures are compiled with each core model, so the
+ * sizes are the ones the configured cores are built with.
+ */
+
+// Minimum time of a measured loop, in ns
+#define BENCH_MIN_NS 50000000ULL
+
+class Benchmark
+{
+    public:
+        typedef void (*func_t)(Benchmark& b);
+
+        Benchmark(const char *name, func_t func);
+
+        const char *name() const { return name_; }
+
+        /**
+         * @brief Time 'body' over enough iterations to take BENCH_MIN_NS
+         *
+         * T provides 'W64 operator()(W64 iters)' which runs the loop iters
+         * times and returns a value depending on its work, so the compiler
+         * can't drop it.
+         *
+         * @param variant Appended to the name after a '/', may be NULL
+         * @param ops_per_iter Operations done by each iteration
+         */
+        template <typename T>
+        void measure(const char *variant, T& body, W64 ops_per_iter = 1)
+        {
+            W64 iters = 1;
+            W64 ns;
+
+            for (;;) {
+                W64 start = rdtsc();
+                sink_ += body(iters);
+                ns = W64(ticks_to_native_seconds(rdtsc() - start) * 1e9);
+
+                if (ns >= BENCH_MIN_NS || iters >= (1ULL << 40))
+                    break;
+
+                // Aim past the minimum on the next try
+                W64 scale = (ns > 0) ? (BENCH_MIN_NS * 3 / 2) / ns + 1 : 100;
+                iters *= clipto(scale, W64(2), W64(100));
+            }
+
+            record(variant, iters * ops_per_iter, ns);
+        }
+
+        // Time 'body' as name/sse2, and as name/avx2 when the host has it
+        template <typename T>
+        void measure_simd(const char *name, T& body, W64 ops_per_iter = 1)
+        {
+            bool saved_avx2 = x86_have_avx2;
+            stringbuf sse2, avx2;
+            sse2 << name, "/sse2";
+            avx2 << name, "/avx2";
+
+            x86_have_avx2 = false;
+            measure(sse2, body, ops_per_iter);
+
+            if (saved_avx2) {
+                x86_have_avx2 = true;
+                measure(avx2, body, ops_per_iter);
+            }
+
+            x86_have_avx2 = saved_avx2;
+        }
+
+        // Run the benchmarks whose name contains filter, NULL for all
+        static int run_all(const char *filter, const char *filename);
+
+    private:
+        const char *name_;
+        func_t func_;
+        W64 sink_;
+
+        void record(const char *variant, W64 ops, W64 ns);
+        static dynarray<Benchmark*>& registry();
+};
+
+#define BENCHMARK(name, func) \
+    static Benchmark bench_reg_##func(name, func)
+
+#endif // MARSS_BENCH_H
@@ -266,7 +266,7 @@ typedef float v2df __attribute__ ((vector_size(16)));
 typedef v2df vec2d;
 
 inline vec16b x86_sse_pcmpeqb(vec16b a, vec16b b) { asm("pcmpeqb %[b],%[a]" : [a] "+x" (a) : [b] "xg" (b)); return a; }
-inline vec8w x86_sse_pcmpeqw(vec8w a, vec8w b) { asm("pcmpeqw %[b],%[a]" : [a] "+x" (a) : [b] "xg" (b)); return a; }
+inline vec8w x86_sse_pcmpeqw(vec8w a, vec8w b) { asm("pcmpeqw %[b],%[a]" : [a] "+x" (a) : [b] "xm" (b)); return a; }
 inline vec4i x86_sse_pcmpeqd(vec4i a, vec4i b) { asm("pcmpeqd %[b],%[a]" : [a] "+x" (a) : [b] "xg" (b)); return a; }
 inline vec16b x86_sse_psubusb(vec16b a, vec16b b) { asm("psubusb %[b],%[a]" : [a] "+x" (a) : [b] "xg" (b)); return a; }
 inline vec16b x86_sse_paddusb(vec16b a, vec16b b) { asm("paddusb %[b],%[a]" : [a] "+x" (a) : [b] "xg" (b)); return a; }
@@ -274,7 +274,7 @@ inline vec16b x86_sse_pandb(vec16b a, vec16b b) { asm("pand %[b],%[a]" : [a] "+x
 inline vec8w x86_sse_psubusw(vec8w a, vec8w b) { asm("psubusb %[b],%[a]" : [a] "+x" (a) : [b] "xg" (b)); return a; }
 inline vec8w x86_sse_paddusw(vec8w a, vec8w b) { asm("paddsub %[b],%[a]" : [a] "+x" (a) : [b] "xg" (b)); return a; }
 inline vec8w x86_sse_pandw(vec8w a, vec8w b) { asm("pand %[b],%[a]" : [a] "+x" (a) : [b] "xg" (b)); return a; }
-inline vec16b x86_sse_packsswb(vec8w a, vec8w b) { asm("packsswb %[b],%[a]" : [a] "+x" (a) : [b] "xg" (b)); return (vec16b)a; }
+inline vec16b x86_sse_packsswb(vec8w a, vec8w b) { asm("packsswb %[b],%[a]" : [a] "+x" (a) : [b] "xm" (b)); return (vec16b)a; }
 inline W32 x86_sse_pmovmskb(vec16b vec) { W32 mask; asm("pmovmskb %[vec],%[mask]" : [mask] "=r" (mask) : [vec] "x" (vec)); return mask; }
 inline W32 x86_sse_pmovmskw(vec8w vec) { return x86_sse_pmovmskb(x86_sse_packsswb(vec, vec)) & 0xff; }
 inline vec16b x86_sse_psadbw(vec16b a, vec16b b) { asm("psadbw %[b],%[a]" : [a] "+x" (a) : [b] "xg" (b)); return a; }
@@ -422,6 +422,56 @@ static inline W64 rdtsc() {
   return ((W64)lo) | (((W64)hi) << 32);
 }
 
+//
+// AVX2 tag compare helpers. Callers must check x86_have_avx2 first; the
+// SSE2 versions above are the fallback. Build with -DDISABLE_AVX2 if the
+// host assembler does not know the AVX2 mnemonics.
+//
+extern bool x86_have_avx2;
+
+#ifndef DISABLE_AVX2
+// Compare 32 consecutive 16-bit tags against tag: one result bit per tag
+static inline W32 x86_avx2_pcmpeqw_mask32(const W16* p, W16 tag) {
+  W32 mask;
+  W32 t = tag;
+  asm("vmovd %[t],%%xmm2\n"
+      "vpbroadcastw %%xmm2,%%ymm2\n"
+      "vpcmpeqw (%[p]),%%ymm2,%%ymm0\n"
+      "vpcmpeqw 32(%[p]),%%ymm2,%%ymm1\n"
+      "vpacksswb %%ymm1,%%ymm0,%%ymm0\n"
+      "vpermq $0xd8,%%ymm0,%%ymm0\n"
+      "vpmovmskb %%ymm0,%[mask]\n"
+      "vzeroupper\n"
+      : [mask] "=r" (mask)
+      : [p] "r" (p), [t] "r" (t), "m" (*(const W16 (*)[32])p)
+      : "xmm0", "xmm1", "xmm2");
+  return mask;
+}
+
+// Same as above for 64 tags, sharing the broadcast between both halves
+static inline W64 x86_avx2_pcmpeqw_mask64(const W16* p, W16 tag) {
+  W32 lo, hi;
+  W32 t = tag;
+  asm("vmovd %[t],%%xmm2\n"
+      "vpbroadcastw %%xmm2,%%ymm2\n"
+      "vpcmpeqw (%[p]),%%ymm2,%%ymm0\n"
+      "vpcmpeqw 32(%[p]),%%ymm2,%%ymm1\n"
+      "vpacksswb %%ymm1,%%ymm0,%%ymm0\n"
+      "vpermq $0xd8,%%ymm0,%%ymm0\n"
+      "vpmovmskb %%ymm0,%[lo]\n"
+      "vpcmpeqw 64(%[p]),%%ymm2,%%ymm0\n"
+      "vpcmpeqw 96(%[p]),%%ymm2,%%ymm1\n"
+      "vpacksswb %%ymm1,%%ymm0,%%ymm0\n"
+      "vpermq $0xd8,%%ymm0,%%ymm0\n"
+      "vpmovmskb %%ymm0,%[hi]\n"
+      "vzeroupper\n"
+      : [lo] "=&r" (lo), [hi] "=r" (hi)
+      : [p] "r" (p), [t] "r" (t), "m" (*(const W16 (*)[64])p)
+      : "xmm0", "xmm1", "xmm2");
+  return ((W64)lo) | (((W64)hi) << 32);
+}
+#endif
+
 template <typename T>
 static inline T x86_ror(T r, int n) { asm("ror %%cl,%[r]" : [r] "+q" (r) : [n] "c" ((byte)n)); return r; }
 
@@ -0,0 +1,208 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ */
+
+#include <hostprof.h>
+
+static const char *hostprof_stage_names[HOSTPROF_STAGE_COUNT] = {
+    "sim_loop", "core", "fetch", "frontend", "dispatch", "wakeup",
+    "issue", "complete", "transfer", "writeback", "commit", "mem_clock",
+    "mem_event", "decode", "qemu_io", "qemu",
+};
+
+static const char *hostprof_bucket_names[HOSTPROF_BUCKETS] = {
+    "0", "32", "64", "128", "256", "512", "1k", "2k", "4k", "8k", "16k",
+    "32k", "64k", "128k", "256k", "512k",
+};
+
+HostProfile host_profile;
+HostProfileScope *HostProfileScope::current = NULL;
+
+HostProfileStats::HostProfileStats(const char *name, Statable *parent)
+    : Statable(name, parent)
+      , ticks("ticks", this)
+      , calls("calls", this)
+      , histogram("histogram", this, hostprof_bucket_names)
+{ }
+
+HostProfile::HostProfile()
+    : Statable("host_profile")
+{
+    foreach (i, HOSTPROF_STAGE_COUNT) {
+        stage_stats_[i] = new HostProfileStats(hostprof_stage_names[i],
+                this);
+    }
+
+    reset();
+}
+
+void HostProfile::reset()
+{
+    setzero(ticks_);
+    setzero(calls_);
+    setzero(histogram_);
+    setzero(signals_);
+    setzero(signal_ticks_);
+    setzero(signal_calls_);
+    qemu_start_ = 0;
+}
+
+void HostProfile::add_signal(Signal *signal, W64 ticks)
+{
+    int i = (W64(signal) >> 4) % HOSTPROF_MAX_SIGNALS;
+
+    foreach (n, HOSTPROF_MAX_SIGNALS) {
+        if likely (signals_[i] == signal)
+            break;
+
+        if (!signals_[i]) {
+            signals_[i] = signal;
+            break;
+        }
+
+        i = (i + 1) % HOSTPROF_MAX_SIGNALS;
+    }
+
+    // Table full, the time is still counted in the stage
+    if unlikely (signals_[i] != signal)
+        return;
+
+    signal_ticks_[i] += ticks;
+    signal_calls_[i]++;
+}
+
+void HostProfile::enter_qemu()
+{
+    if unlikely (config.host_profile)
+        qemu_start_ = rdtsc();
+}
+
+void HostProfile::leave_qemu()
+{
+    if unlikely (qemu_start_) {
+        if (config.host_profile)
+            add(HOSTPROF_QEMU, rdtsc() - qemu_start_);
+        qemu_start_ = 0;
+    }
+}
+
+/**
+ * @brief Copy the host profile into the stats
+ *
+ * Host time isn't split between user and kernel mode, so all three stats
+ * get the same values. Nothing is written unless profiling was enabled.
+ */
+void HostProfile::update_stats()
+{
+    W64 total = 0;
+    foreach (i, HOSTPROF_STAGE_COUNT) total += calls_[i];
+
+    if (!total) {
+        disable_dump();
+        return;
+    }
+
+    enable_dump();
+
+#define HOSTPROF_STAT(stat) \
+    set_default_stats(stat); \
+    foreach (i, HOSTPROF_STAGE_COUNT) { \
+        stage_stats_[i]->ticks = ticks_[i]; \
+        stage_stats_[i]->calls = calls_[i]; \
+        foreach (b, HOSTPROF_BUCKETS) \
+            stage_stats_[i]->histogram[b] = histogram_[i][b]; \
+    }
+
+    HOSTPROF_STAT(user_stats);
+    HOSTPROF_STAT(kernel_stats);
+    HOSTPROF_STAT(global_stats);
+#undef HOSTPROF_STAT
+}
+
+struct HostProfileCallback
+{
+    const char *name;
+    W64 ticks;
+    W64 calls;
+};
+
+// Most host time first
+struct HostProfileCallbackComparator
+{
+    int operator ()(const HostProfileCallback& a,
+            const HostProfileCallback& b) const
+    {
+        return (a.ticks < b.ticks) ? 1 : (a.ticks > b.ticks) ? -1 : 0;
+    }
+};
+
+/**
+ * @brief Print the host time breakdown by stage and by event callback
+ */
+ostream& HostProfile::print(ostream& os) const
+{
+    W64 total = 0;
+    foreach (i, HOSTPROF_STAGE_COUNT) total += ticks_[i];
+
+    if (!total)
+        return os;
+
+    os << "Host time profile (", floatstring(ticks_to_native_seconds(total),
+            0, 3), " seconds profiled):", endl;
+    os << "  ", padstring("stage", -12), " ", padstring("seconds", 10), " ",
+       padstring("share", 7), " ", padstring("calls", 14), " ",
+       padstring("ticks/call", 12), endl;
+
+    foreach (i, HOSTPROF_STAGE_COUNT) {
+        if (!calls_[i])
+            continue;
+
+        os << "  ", padstring(hostprof_stage_names[i], -12), " ",
+           floatstring(ticks_to_native_seconds(ticks_[i]), 10, 3), " ",
+           floatstring(100.0 * ticks_[i] / total, 6, 1), "% ",
+           intstring(calls_[i], 14), " ",
+           floatstring(double(ticks_[i]) / calls_[i], 12, 1), endl;
+    }
+
+    // Signals of the same name (one per controller instance) are merged
+    dynarray<HostProfileCallback> callbacks;
+    foreach (i, HOSTPROF_MAX_SIGNALS) {
+        if (!signals_[i])
+            continue;
+
+        const char *name = signals_[i]->get_name();
+        int n;
+        for (n = 0; n < callbacks.count(); n++) {
+            if (strequal(callbacks[n].name, name))
+                break;
+        }
+
+        if (n == callbacks.count()) {
+            HostProfileCallback cb = {name, 0, 0};
+            callbacks.push(cb);
+        }
+
+        callbacks[n].ticks += signal_ticks_[i];
+        callbacks[n].calls += signal_calls_[i];
+    }
+
+    if (!callbacks.count())
+        return os;
+
+    sort(callbacks.data, callbacks.count(), HostProfileCallbackComparator());
+
+    os << "  Memory event callbacks:", endl;
+    foreach (i, callbacks.count()) {
+        HostProfileCallback& cb = callbacks[i];
+        os << "    ", padstring(cb.name, -32), " ",
+           floatstring(ticks_to_native_seconds(cb.ticks), 10, 3), " ",
+           floatstring(100.0 * cb.ticks / total, 6, 1), "% ",
+           intstring(cb.calls, 14), " ",
+           floatstring(double(cb.ticks) / cb.calls, 12, 1), endl;
+    }
+
+    return os;
+}
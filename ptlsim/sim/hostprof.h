@@ -0,0 +1,156 @@
+
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ */
+
+#ifndef HOSTPROF_H
+#define HOSTPROF_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <statsBuilder.h>
+#include <ptlsim.h>
+
+/*
+ * Host time self-profiler
+ *
+ * With '-host-profile' the simulator reads the TSC around each pipeline
+ * stage of the cores, the memory hierarchy clock and event callbacks, the
+ * decoder and the time spent back in QEMU, and adds the host ticks to the
+ * stage that was running. Time is exclusive: a stage nested in another
+ * (decoding during fetch, for example) is not counted in its parent, so
+ * the stages add up to the profiled time. Each core pipeline stage has one
+ * profiled scope, so its calls count the cycles (per thread for the
+ * per-thread stages) it ran in.
+ *
+ * Each stage keeps its total ticks, number of calls and a log2 histogram of
+ * ticks per call. These are written with the stats under 'host_profile',
+ * and a breakdown by stage and by memory event callback is printed to the
+ * log when the stats are dumped.
+ *
+ * When the option is off each profiled scope costs one predicted branch.
+ */
+
+enum {
+    HOSTPROF_SIM,           // simulation loop, not in any other stage
+    HOSTPROF_CORE,          // core cycle, not in any pipeline stage
+    HOSTPROF_FETCH,
+    HOSTPROF_FRONTEND,      // frontend and rename
+    HOSTPROF_DISPATCH,
+    HOSTPROF_WAKEUP,        // issue queue clock and wakeup
+    HOSTPROF_ISSUE,
+    HOSTPROF_COMPLETE,
+    HOSTPROF_TRANSFER,
+    HOSTPROF_WRITEBACK,
+    HOSTPROF_COMMIT,
+    HOSTPROF_MEM_CLOCK,     // memory hierarchy clock of the CPU controllers
+    HOSTPROF_MEM_EVENT,     // memory hierarchy event callbacks
+    HOSTPROF_DECODE,        // basic block translation
+    HOSTPROF_QEMU_IO,       // QEMU IO events run in the simulation loop
+    HOSTPROF_QEMU,          // between returning to QEMU and coming back
+    HOSTPROF_STAGE_COUNT
+};
+
+// Ticks per call histogram: bucket 0 is below 32 ticks, then powers of 2
+#define HOSTPROF_BUCKETS 16
+#define HOSTPROF_MIN_BUCKET_LOG2 5
+
+// Memory event callbacks timed separately, by their Signal
+#define HOSTPROF_MAX_SIGNALS 512
+
+struct HostProfileStats : public Statable
+{
+    StatObj<W64> ticks;
+    StatObj<W64> calls;
+    StatArray<W64, HOSTPROF_BUCKETS> histogram;
+
+    HostProfileStats(const char *name, Statable *parent);
+};
+
+class HostProfile : public Statable
+{
+    public:
+        HostProfile();
+
+        void add(int stage, W64 ticks, Signal *signal=NULL)
+        {
+            ticks_[stage] += ticks;
+            calls_[stage]++;
+
+            int bucket = msbindex64(ticks | 1) - (HOSTPROF_MIN_BUCKET_LOG2 - 1);
+            histogram_[stage][clipto(bucket, 0, HOSTPROF_BUCKETS - 1)]++;
+
+            if (signal)
+                add_signal(signal, ticks);
+        }
+
+        // Called when the simulator returns to QEMU and when it comes back
+        void enter_qemu();
+        void leave_qemu();
+
+        void update_stats();
+        ostream& print(ostream& os) const;
+        void reset();
+
+    private:
+        W64 ticks_[HOSTPROF_STAGE_COUNT];
+        W64 calls_[HOSTPROF_STAGE_COUNT];
+        W64 histogram_[HOSTPROF_STAGE_COUNT][HOSTPROF_BUCKETS];
+        W64 qemu_start_;
+
+        // Open addressed by Signal pointer, they live as long as the
+        // controllers
+        Signal *signals_[HOSTPROF_MAX_SIGNALS];
+        W64 signal_ticks_[HOSTPROF_MAX_SIGNALS];
+        W64 signal_calls_[HOSTPROF_MAX_SIGNALS];
+
+        HostProfileStats *stage_stats_[HOSTPROF_STAGE_COUNT];
+
+        void add_signal(Signal *signal, W64 ticks);
+};
+
+extern HostProfile host_profile;
+
+/*
+ * Times the enclosing scope into a stage when '-host-profile' is on
+ */
+struct HostProfileScope
+{
+    W64 start;
+    W64 nested;
+    int stage;
+    Signal *signal;
+    HostProfileScope *outer;
+
+    static HostProfileScope *current;
+
+    HostProfileScope(int stage_, Signal *signal_=NULL)
+    {
+        start = 0;
+        if unlikely (config.host_profile) {
+            stage = stage_;
+            signal = signal_;
+            nested = 0;
+            outer = current;
+            current = this;
+            start = rdtsc();
+        }
+    }
+
+    ~HostProfileScope()
+    {
+        if unlikely (start) {
+            W64 ticks = rdtsc() - start;
+            host_profile.add(stage, ticks - nested, signal);
+            if (outer)
+                outer->nested += ticks;
+            current = outer;
+        }
+    }
+};
+
+#define host_profile_scope(stage) HostProfileScope hostprof_scope(stage)
+
+#endif // HOSTPROF_H
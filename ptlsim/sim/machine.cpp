@@ -13,8 +13,12 @@
 #include <config.h>
 
 #include <basecore.h>
+#include <branchtrace.h>
 #include <statsBuilder.h>
 #include <memoryHierarchy.h>
+#include <memoryTrace.h>
+#include <memoryRequestTrace.h>
+#include <hostprof.h>
 
 #include <cstdarg>
 
@@ -57,6 +61,31 @@ void BaseMachine::reset()
 
     cores.clear();
 
+    // Controllers and interconnects go with the hierarchy they joined, so
+    // the next setup_interconnects() only sees what is built after this
+    foreach(i, controllers.count()) {
+        delete controllers[i];
+    }
+
+    controllers.clear();
+    controller_hash.clear_and_free();
+
+    foreach(i, interconnects.count()) {
+        delete interconnects[i];
+    }
+
+    interconnects.clear();
+
+    foreach(i, connections.count()) {
+        ConnectionDef* connDef = connections[i];
+        foreach(j, connDef->connections.count()) {
+            delete connDef->connections[j];
+        }
+        delete connDef;
+    }
+
+    connections.clear();
+
     if(memoryHierarchyPtr) {
         delete memoryHierarchyPtr;
         memoryHierarchyPtr = NULL;
@@ -130,12 +159,35 @@ bool BaseMachine::init(PTLsimConfig& config)
         return 0;
     }
 
+    // The predictions come from the branches an earlier run committed, so
+    // check the trace here rather than when the cores open it
+    if(config.perfect_branch_pred) {
+        BranchOracle oracle;
+        if(!config.branch_oracle_filename.set() ||
+                !oracle.open(config.branch_oracle_filename, 0, 0)) {
+            ptl_logfile << "[ERROR] -perfect-branch-pred needs -branch-oracle, a trace from an earlier -branch-trace run, can't read '", config.branch_oracle_filename, "'", endl, flush;
+            cerr << "[ERROR] -perfect-branch-pred needs -branch-oracle, a trace from an earlier -branch-trace run, can't read '", config.branch_oracle_filename, "'", endl, flush;
+            return 0;
+        }
+    }
+
     machineBuilder.setup_machine(*this, config.machine_config.buf);
 
     foreach(i, cores.count()) {
         cores[i]->update_memory_hierarchy_ptr();
     }
 
+    // Only the out-of-order core keeps a RIP profile
+    if(config.rip_profile_filename) {
+        foreach(i, cores.count()) {
+            if(!cores[i]->rip_profiles) {
+                ptl_logfile << "[ERROR] -rip-profile is not supported by core ", i, " of machine ", config.machine_config, endl, flush;
+                cerr << "[ERROR] -rip-profile is not supported by core ", i, " of machine ", config.machine_config, endl, flush;
+                return 0;
+            }
+        }
+    }
+
     init_qemu_io_events();
 
     return 1;
@@ -228,6 +280,7 @@ int BaseMachine::run(PTLsimConfig& config)
 
     // Run each core
     bool exiting = false;
+    host_profile_scope(HOSTPROF_SIM);
 
     for (;;) {
         if unlikely ((!logenable) &&
@@ -262,6 +315,7 @@ int BaseMachine::run(PTLsimConfig& config)
 			if (logable(4))
 				ptl_logfile << "Per-Cycle-Signal : " <<
 					coremodel.per_cycle_signals[i]->get_name() << endl;
+			host_profile_scope(HOSTPROF_CORE);
 			exiting |= coremodel.per_cycle_signals[i]->emit(NULL);
 		}
 
@@ -306,6 +360,15 @@ int BaseMachine::run(PTLsimConfig& config)
 					}
 				}
 			}
+			if(config.branch_trace_filename){
+				BranchTraceWriter::flush(branch_trace_file);
+			}
+			if(config.mem_trace_filename){
+				Memory::mem_trace_writer.flush(mem_trace_file);
+			}
+			if(config.mem_req_trace_filename){
+				Memory::mem_req_tracer.flush();
+			}
 			exiting = 1;
             break;
         }
@@ -366,6 +429,23 @@ void BaseMachine::update_stats()
     }
 }
 
+/**
+ * @brief Write the RIP profile of every core thread so far
+ *
+ * Called with each stats dump, so every way the simulation ends writes it.
+ */
+void BaseMachine::dump_rip_profiles(ostream& os)
+{
+    foreach(i, cores.count()) {
+        BaseCore* core = cores[i];
+        if(!core->rip_profiles) continue;
+        foreach(t, core->intervalcount) {
+            core->rip_profiles[t].dump(os, i, t);
+        }
+    }
+    os.flush();
+}
+
 Context& BaseMachine::get_next_context()
 {
     assert(context_counter < NUM_SIM_CORES);
@@ -63,6 +63,7 @@ struct BaseMachine: public PTLsimMachine {
     virtual W8 get_num_cores();
     virtual void dump_state(ostream& os);
     virtual void update_stats();
+    virtual void dump_rip_profiles(ostream& os);
     virtual void flush_tlb(Context& ctx);
     virtual void flush_tlb_virt(Context& ctx, Waddr virtaddr);
     void flush_all_pipelines();
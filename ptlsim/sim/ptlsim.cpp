@@ -32,6 +32,11 @@
 #include <ptl-qemu.h>
 
 #include <test.h>
+#include <bench.h>
+#include <hostprof.h>
+#include <branchtrace.h>
+#include <memoryTrace.h>
+#include <memoryRequestTrace.h>
 /*
  * DEPRECATED CONFIG OPTIONS:
  perfect_cache
@@ -55,6 +60,10 @@ ofstream yaml_stats_file;
 ofstream interval_file; // by vteori
 ofstream periodic_interval_file; // by vteori
 ofstream trace_file; // by vteori
+ofstream rip_profile_file;
+ofstream branch_trace_file;
+ofstream mem_trace_file;
+ofstream mem_req_trace_file;
 bool logenable = 0;
 W64 sim_cycle = 0;
 W64 unhalted_cycle_count = 0;
@@ -184,6 +193,7 @@ void ConfigurationParser<PTLsimConfig>::reset() {
   snapshot_now.reset();
   time_stats_logfile = "";
   time_stats_period = 10000;
+  host_profile = 0;
 
   start_at_rip = INVALIDRIP;
   fast_fwd_insns = 0;
@@ -217,6 +227,19 @@ void ConfigurationParser<PTLsimConfig>::reset() {
 
   machine_config = "";
 
+  mem_trace_filename = "";
+  mem_replay_filename = "";
+  mem_synth = "";
+  mem_replay_misses = 8;
+  mem_bench_filename = "";
+
+  mem_req_trace_filename = "";
+  mem_req_trace_core = infinity;
+  mem_req_trace_addr_start = 0;
+  mem_req_trace_addr_end = infinity;
+  mem_req_trace_start = 0;
+  mem_req_trace_stop = infinity;
+
   ///
   /// memory hierarchy implementation
   ///
@@ -233,6 +256,8 @@ void ConfigurationParser<PTLsimConfig>::reset() {
 
   // Test Framework
   run_tests = 0;
+  run_bench_filename = "";
+  bench_filter = "";
 
   // Utilities/Tools
   execute_after_kill = "";
@@ -280,6 +305,7 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   add(snapshot_now,                 "snapshot-now",         "Take statistical snapshot immediately, using specified name");
   add(time_stats_logfile,           "time-stats-logfile",   "File to write time-series statistics (new)");
   add(time_stats_period,            "time-stats-period",    "Frequency of capturing time-stats (in cycles)");
+  add(host_profile,                 "host-profile",         "Profile host time per pipeline stage, memory event callback, decoder and QEMU, and add it to the stats");
   section("Trace Start/Stop Point");
   add(start_at_rip,                 "startrip",             "Start at rip <startrip>");
   add(fast_fwd_insns,               "fast-fwd-insns",       "Fast Fwd each CPU by <N> instructions");
@@ -326,6 +352,17 @@ void ConfigurationParser<PTLsimConfig>::setup() {
 
   section("Memory Hierarchy Configuration");
   //  add(memory_log,               "memory-log",               "log memory debugging info");
+  add(mem_trace_filename,       "mem-trace",                "Memory request trace output file (binary)");
+  add(mem_replay_filename,      "mem-replay",               "Replay a -mem-trace file through the memory hierarchy only, then exit");
+  add(mem_synth,                "mem-synth",                "Replay a synthetic stream, e.g. 'random:cores=4:footprint=16m:count=1m'");
+  add(mem_replay_misses,        "mem-replay-misses",        "Loads and fetches each core keeps outstanding during a replay");
+  add(mem_bench_filename,       "mem-bench",                "Time built-in memory hierarchies (no machine needed) on synthetic patterns, write host ns per request and cycle (YAML) to file, then exit");
+  add(mem_req_trace_filename,   "mem-req-trace",            "Memory request lifecycle trace output file (binary, see util/mem_req_trace.py)");
+  add(mem_req_trace_core,       "mem-req-trace-core",       "Only trace requests of this core");
+  add(mem_req_trace_addr_start, "mem-req-trace-addr-start", "Only trace requests to physical addresses from this one");
+  add(mem_req_trace_addr_end,   "mem-req-trace-addr-end",   "Only trace requests to physical addresses below this one");
+  add(mem_req_trace_start,      "mem-req-trace-start",      "Only trace requests allocated from this cycle");
+  add(mem_req_trace_stop,       "mem-req-trace-stop",       "Only trace requests allocated before this cycle");
 
   // MongoDB
   section("bus configuration");
@@ -338,6 +375,8 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   // Test Framework
   section("Unit Test Framework");
   add(run_tests,            "run-tests",            "Run Test cases");
+  add(run_bench_filename,   "run-bench",            "Run host microbenchmarks of the simulator structures, write results (YAML) to file, then exit");
+  add(bench_filter,         "bench-filter",         "Only run benchmarks whose name contains this string");
 
   // Utilities/Tools
   section("options for tools/utilities");
@@ -359,7 +398,8 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   add(perfect_l2_dcache, 	"perfect-l2-dcache", 	"Every access to L2 D$ has the same latency");
   add(perfect_itlb,		"perfect-itlb", 		"Every access to ITLB has the same latency");
   add(perfect_dtlb,		"perfect-dtlb", 		"Every access to DTLB has the same latency");
-  add(perfect_branch_pred,	"perfect-branch-pred", 	"All branch predictions are correct");
+  add(perfect_branch_pred,	"perfect-branch-pred", 	"All branch predictions are correct, taken from -branch-oracle (required)");
+  add(branch_oracle_filename,	"branch-oracle",		"Committed branch trace of an earlier -branch-trace run of the same workload");
   add(perfect_long_lat,		"perfect-long-lat",		"All function units have the same latency = 1");
 
   section("Interval analysis");
@@ -369,6 +409,10 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   
   section("Trace");
   add(trace_filename,		"trace",				"Trace file name"); 
+
+  section("Profiling");
+  add(rip_profile_filename,	"rip-profile",			"Per-RIP stall/miss profile output file (binary, ooo core only), written with each stats dump");
+  add(branch_trace_filename,	"branch-trace",			"Committed branch trace output file (binary), see tools/branch_replay");
 };
 
 #ifndef CONFIG_ONLY
@@ -432,6 +476,10 @@ stringbuf current_yaml_stats_filename;
 stringbuf current_interval_filename; // by vteori
 stringbuf current_periodic_interval_filename; // by vteori
 stringbuf current_trace_filename; // by vteori
+stringbuf current_rip_profile_filename;
+stringbuf current_branch_trace_filename;
+stringbuf current_mem_trace_filename;
+stringbuf current_mem_req_trace_filename;
 W64 current_start_sim_rip;
 
 void backup_and_reopen_logfile() {
@@ -491,6 +539,69 @@ void backup_and_reopen_trace_file() {
   }
 }
 
+void backup_and_reopen_rip_profile_file() {
+  if (config.rip_profile_filename) {
+    if (rip_profile_file) rip_profile_file.close();
+    stringbuf oldname;
+    oldname << config.rip_profile_filename, ".backup";
+    sys_unlink(oldname);
+    sys_rename(config.rip_profile_filename, oldname);
+    rip_profile_file.open(config.rip_profile_filename, std::ios::binary);
+  }
+}
+
+void backup_and_reopen_branch_trace_file() {
+  if (config.branch_trace_filename) {
+    if (branch_trace_file) {
+      BranchTraceWriter::flush(branch_trace_file);
+      branch_trace_file.close();
+    }
+    stringbuf oldname;
+    oldname << config.branch_trace_filename, ".backup";
+    sys_unlink(oldname);
+    sys_rename(config.branch_trace_filename, oldname);
+    branch_trace_file.open(config.branch_trace_filename, std::ios::binary);
+    BranchTraceWriter::start(branch_trace_file);
+  }
+}
+
+void backup_and_reopen_mem_trace_file() {
+  if (config.mem_trace_filename) {
+    if (mem_trace_file) {
+      Memory::mem_trace_writer.flush(mem_trace_file);
+      mem_trace_file.close();
+    }
+    stringbuf oldname;
+    oldname << config.mem_trace_filename, ".backup";
+    sys_unlink(oldname);
+    sys_rename(config.mem_trace_filename, oldname);
+    mem_trace_file.open(config.mem_trace_filename, std::ios::binary);
+    Memory::mem_trace_writer.start(mem_trace_file);
+  }
+}
+
+void backup_and_reopen_mem_req_trace_file() {
+  if (config.mem_req_trace_filename) {
+    if (mem_req_trace_file) {
+      Memory::mem_req_tracer.stop();
+      mem_req_trace_file.close();
+    }
+    stringbuf oldname;
+    oldname << config.mem_req_trace_filename, ".backup";
+    sys_unlink(oldname);
+    sys_rename(config.mem_req_trace_filename, oldname);
+    mem_req_trace_file.open(config.mem_req_trace_filename, std::ios::binary);
+
+    Memory::MemoryRequestTraceFilter filter;
+    filter.coreid = config.mem_req_trace_core;
+    filter.addr_start = config.mem_req_trace_addr_start;
+    filter.addr_end = config.mem_req_trace_addr_end;
+    filter.cycle_start = config.mem_req_trace_start;
+    filter.cycle_end = config.mem_req_trace_stop;
+    Memory::mem_req_tracer.start(mem_req_trace_file, filter);
+  }
+}
+
 void force_logging_enabled() {
   logenable = 1;
   config.start_log_at_iteration = 0;
@@ -557,6 +668,10 @@ static void flush_stats()
     PTLsimMachine* machine = PTLsimMachine::getmachine(config.core_name.buf);
     assert(machine);
     machine->update_stats();
+    host_profile.update_stats();
+
+    if(config.rip_profile_filename)
+        machine->dump_rip_profiles(rip_profile_file);
 
     // Call this function to setup tags and other info
     setup_sim_stats();
@@ -579,6 +694,8 @@ static void flush_stats()
 
     ptl_logfile << "Stats Summary:\n";
     (StatsBuilder::get()).dump_summary(ptl_logfile);
+
+    host_profile.print(ptl_logfile);
 }
 
 static void kill_simulation()
@@ -605,6 +722,19 @@ static void kill_simulation()
 	if (machine)
 		machine->shutdown();
 
+    if (config.mem_req_trace_filename)
+        Memory::mem_req_tracer.stop();
+
+    if (config.branch_trace_filename) {
+        BranchTraceWriter::flush(branch_trace_file);
+        branch_trace_file.close();
+    }
+
+    if (config.mem_trace_filename) {
+        Memory::mem_trace_writer.flush(mem_trace_file);
+        mem_trace_file.close();
+    }
+
     ptl_logfile.flush();
     ptl_logfile.close();
 
@@ -613,6 +743,56 @@ static void kill_simulation()
     ptl_quit();
 }
 
+/**
+ * @brief Drive the machine's memory hierarchy from -mem-replay or -mem-synth
+ *
+ * The cores and the guest never run: requests go straight to the CPU
+ * controllers, and the stats are dumped as usual before the VM is killed.
+ */
+static void run_mem_replay(PTLsimMachine* machine)
+{
+    using namespace Memory;
+
+    BaseMachine* base = (BaseMachine*)machine;
+    MemoryTraceSource* source = NULL;
+    ifstream is;
+    stringbuf err;
+
+    if (config.mem_replay_filename) {
+        is.open(config.mem_replay_filename, std::ios::binary);
+        MemoryTraceReader* reader = new MemoryTraceReader(is);
+        if (!reader->valid())
+            err << "::ERROR::", config.mem_replay_filename, " is not a memory trace", endl;
+        source = reader;
+    } else {
+        SyntheticMemoryStream* synth = new SyntheticMemoryStream();
+        if (!synth->parse(config.mem_synth))
+            err << "::ERROR::Invalid -mem-synth '", config.mem_synth, "'", endl;
+        else if (synth->cores() > base->get_num_cores())
+            err << "::ERROR::-mem-synth wants ", synth->cores(), " cores, machine has ",
+                base->get_num_cores(), endl;
+        source = synth;
+    }
+
+    if (err.size() > 0) {
+        ptl_logfile << err;
+        cerr << err;
+    } else {
+        MemoryReplay replay("mem_replay", base->memoryHierarchyPtr,
+                base->get_num_cores(), config.mem_replay_misses);
+
+        W64 cycles = replay.run(*source, config.stop_at_cycle);
+        ptl_logfile << "Memory replay finished in ", cycles, " cycles", endl;
+        cerr << "Memory replay finished in ", cycles, " cycles", endl;
+
+        flush_stats();
+    }
+
+    delete source;
+    config.kill = 1;
+    kill_simulation();
+}
+
 bool handle_config_change(PTLsimConfig& config) {
   static bool first_time = true;
 
@@ -656,6 +836,26 @@ bool handle_config_change(PTLsimConfig& config) {
     current_trace_filename = config.trace_filename;
   }
 
+  if (config.rip_profile_filename.set() && (config.rip_profile_filename != current_rip_profile_filename)) {
+    backup_and_reopen_rip_profile_file();
+    current_rip_profile_filename = config.rip_profile_filename;
+  }
+
+  if (config.branch_trace_filename.set() && (config.branch_trace_filename != current_branch_trace_filename)) {
+    backup_and_reopen_branch_trace_file();
+    current_branch_trace_filename = config.branch_trace_filename;
+  }
+
+  if (config.mem_trace_filename.set() && (config.mem_trace_filename != current_mem_trace_filename)) {
+    backup_and_reopen_mem_trace_file();
+    current_mem_trace_filename = config.mem_trace_filename;
+  }
+
+  if (config.mem_req_trace_filename.set() && (config.mem_req_trace_filename != current_mem_req_trace_filename)) {
+    backup_and_reopen_mem_req_trace_file();
+    current_mem_req_trace_filename = config.mem_req_trace_filename;
+  }
+
   if ((config.loglevel > 0) & (config.start_log_at_rip == INVALIDRIP) & (config.start_log_at_iteration == infinity)) {
     config.start_log_at_iteration = 0;
   }
@@ -970,7 +1170,8 @@ extern "C" void ptl_machine_configure(const char* config_str_) {
 
     ptl_machine.disable_dump();
 
-    if(config.run_tests) {
+    if(config.run_tests || config.run_bench_filename.set() ||
+            config.mem_bench_filename.set()) {
         in_simulation = 1;
     }
 }
@@ -1327,6 +1528,9 @@ static void dump_machine_configuration(PTLsimMachine *machine)
 extern "C" uint8_t ptl_simulate() {
 	PTLsimMachine* machine = NULL;
 	char* machinename = config.core_name;
+
+	host_profile.leave_qemu();
+
 	if likely (curr_ptl_machine != NULL) {
 		machine = curr_ptl_machine;
 	} else {
@@ -1344,6 +1548,18 @@ extern "C" uint8_t ptl_simulate() {
         run_tests();
     }
 
+    if(config.run_bench_filename.set()) {
+        Benchmark::run_all(config.bench_filter.set() ? (char*)config.bench_filter : NULL,
+                config.run_bench_filename);
+        exit(0);
+    }
+
+    if(config.mem_bench_filename.set()) {
+        bool ok = Memory::run_memory_bench(config.mem_bench_filename,
+                config.mem_replay_misses);
+        exit(ok ? 0 : 1);
+    }
+
 	if (!machine->initialized) {
 		ptl_logfile << "Initializing core '", machinename, "'", endl;
 		if (!machine->init(config)) {
@@ -1417,6 +1633,10 @@ extern "C" uint8_t ptl_simulate() {
 	 * Set ret_qemu_env to NULL, it will be set at the exit of simulation 'run'
 	 * to the Context that has interrupts/exceptions pending
      */
+    if unlikely (config.mem_replay_filename.set() || config.mem_synth.set()) {
+        run_mem_replay(machine);
+    }
+
 	machine->ret_qemu_env = NULL;
 	ptl_stable_state = 0;
 
@@ -1454,6 +1674,7 @@ extern "C" uint8_t ptl_simulate() {
         }
 
 		/* Tell QEMU that we will come back to simulate */
+		host_profile.enter_qemu();
 		return 1;
 	}
 
@@ -1604,6 +1825,7 @@ void clock_qemu_io_events()
     foreach_list_mutable(qemuIOEvents->list(), signal, entry, prev) {
         if (signal->cycle <= sim_cycle) {
             ptl_logfile << "Executing QEMU IO Event at " << sim_cycle << endl;
+            host_profile_scope(HOSTPROF_QEMU_IO);
             signal->fn(signal->arg);
             qemuIOEvents->free(signal);
         }
@@ -58,6 +58,7 @@ struct PTLsimMachine : public Statable {
   virtual bool init(PTLsimConfig& config);
   virtual int run(PTLsimConfig& config);
   virtual void update_stats();
+  virtual void dump_rip_profiles(ostream& os) {};
   virtual void dump_state(ostream& os);
   virtual void flush_tlb(Context& ctx);
   virtual void flush_tlb_virt(Context& ctx, Waddr virtaddr);
@@ -164,6 +165,10 @@ struct PTLsimStats;
 
 extern ofstream ptl_logfile;
 extern ofstream trace_file;
+extern ofstream rip_profile_file;
+extern ofstream branch_trace_file;
+extern ofstream mem_trace_file;
+extern ofstream mem_req_trace_file;
 extern ofstream trace_mem_logfile;
 extern W64 sim_cycle;
 extern W64 user_insn_commits;
@@ -224,6 +229,7 @@ struct PTLsimConfig {
   stringbuf time_stats_logfile;
   W64 time_stats_period;
   stringbuf stats_format;
+  bool host_profile;
 
   // memory model:
   bool use_memory_model;
@@ -259,6 +265,21 @@ struct PTLsimConfig {
   // Machine configurations
   stringbuf machine_config;
 
+  // Memory request trace and standalone replay
+  stringbuf mem_trace_filename;
+  stringbuf mem_replay_filename;
+  stringbuf mem_synth;
+  W64 mem_replay_misses;
+  stringbuf mem_bench_filename;
+
+  // Memory request lifecycle trace
+  stringbuf mem_req_trace_filename;
+  W64 mem_req_trace_core;
+  W64 mem_req_trace_addr_start;
+  W64 mem_req_trace_addr_end;
+  W64 mem_req_trace_start;
+  W64 mem_req_trace_stop;
+
   ///
   /// for memory hierarchy implementaion
   ///
@@ -276,6 +297,8 @@ struct PTLsimConfig {
 
   // Test Framework
   bool run_tests;
+  stringbuf run_bench_filename;
+  stringbuf bench_filter;
 
   //Utilities/Tools
   stringbuf execute_after_kill;
@@ -299,6 +322,7 @@ struct PTLsimConfig {
   bool perfect_itlb;
   bool perfect_dtlb;
   bool perfect_branch_pred;
+  stringbuf branch_oracle_filename;
   bool perfect_long_lat;
   // 2. interval analayis
   stringbuf interval_filename;
@@ -306,6 +330,10 @@ struct PTLsimConfig {
   W64 interval_insns;
   // 3. trace
   stringbuf trace_filename;
+  // 4. per-RIP profile
+  stringbuf rip_profile_filename;
+  // 5. committed branch trace
+  stringbuf branch_trace_filename;
 };
 
 extern ConfigurationParser<PTLsimConfig> config;
@@ -1585,6 +1585,25 @@ struct StatObjFormulaDiv {
     }
 };
 
+/**
+ * @brief Events per thousand of a second counter, like MPKI
+ */
+struct StatObjFormulaPerKilo {
+    typedef dynarray<StatObj<W64>* > elems_t;
+
+    static double compute(Stats* stats, const elems_t& elems)
+    {
+        assert(elems.count() == 2);
+        double val1 = double((*elems[0])(stats));
+        double val2 = double((*elems[1])(stats));
+
+        if(val2 == 0)
+            return 0;
+
+        return (val1 * 1000.0) / val2;
+    }
+};
+
 /**
  * @brief Statistics Class that supports User specific Formula's
  *
@@ -0,0 +1,167 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <branchpred.h>
+
+namespace {
+
+    const W64 BRANCH = 0x400100;   // rip after the branch
+    const W64 TARGET = 0x400800;
+
+    TEST(BranchPredictor, Registered)
+    {
+        const char *names[] = {"combined", "combined_16k", "combined_4k",
+            "local", "tage_sc_l", "tage_sc_l_8k", "tage_sc_l_64k",
+            "perceptron"};
+
+        foreach (i, lengthof(names)) {
+            BranchPredictorImplementation *p =
+                BranchPredictorBuilder::create_predictor(names[i], 0, 0);
+            ASSERT_TRUE(p != NULL);
+            delete p;
+        }
+
+        ASSERT_TRUE(BranchPredictorBuilder::create_predictor("none", 0, 0)
+                == NULL);
+    }
+
+    /* Predict and train one conditional branch, true if it was right */
+    bool predict_branch(BranchPredictorImplementation *p, W64 uuid, W64 rip,
+            bool taken)
+    {
+        PredictorUpdate predinfo;
+        memset(&predinfo, 0, sizeof(predinfo));
+        predinfo.uuid = uuid;
+
+        W64 target = (taken) ? TARGET : rip;
+        W64 predrip = p->predict(predinfo, BRANCH_HINT_COND, rip, TARGET);
+        p->update(predinfo, rip, target);
+
+        return predrip == target;
+    }
+
+    /* Mispredictions of a repeating T,T,N,T,N,N pattern after warm up */
+    int pattern_mispredicts(BranchPredictorImplementation *p)
+    {
+        const bool pattern[] = {true, true, false, true, false, false};
+        int mispred = 0;
+
+        p->reset();
+        foreach (i, 3000) {
+            bool taken = pattern[i % lengthof(pattern)];
+            if (!predict_branch(p, i, BRANCH, taken) && i >= 2000)
+                mispred++;
+        }
+
+        return mispred;
+    }
+
+    /*
+     * Mispredictions, after warm up, of a branch that repeats a random
+     * branch 'distance' branches back, the ones between always taken
+     */
+    int far_mispredicts(BranchPredictorImplementation *p, int distance)
+    {
+        RandomNumberGenerator rng(11);
+        W64 uuid = 0;
+        int mispred = 0;
+
+        p->reset();
+        foreach (i, 1000) {
+            bool taken = rng.random32() & 1;
+            predict_branch(p, uuid++, BRANCH, taken);
+            foreach (j, distance - 1)
+                predict_branch(p, uuid++, BRANCH + 0x40, true);
+
+            if (!predict_branch(p, uuid++, BRANCH + 0x80, taken) && i >= 800)
+                mispred++;
+        }
+
+        return mispred;
+    }
+
+    TEST(BranchPredictor, HistoryPredictorsLearnPattern)
+    {
+        const char *names[] = {"tage_sc_l", "perceptron"};
+
+        foreach (i, lengthof(names)) {
+            BranchPredictorImplementation *p =
+                BranchPredictorBuilder::create_predictor(names[i], 0, 0);
+            ASSERT_LE(pattern_mispredicts(p), 10) << names[i];
+            delete p;
+        }
+    }
+
+    /* The history ring has to hold the longest history of the predictor */
+    TEST(BranchPredictor, LearnsBeyond64Branches)
+    {
+        const char *specs[] = {"tage_sc_l_8k", "tage_sc_l_64k",
+            "perceptron:history=100"};
+
+        foreach (i, lengthof(specs)) {
+            BranchPredictorConfig config;
+            ASSERT_TRUE(config.parse(specs[i]));
+            BranchPredictorImplementation *p =
+                BranchPredictorBuilder::create_predictor(config, 0, 0);
+            ASSERT_LE(far_mispredicts(p, 80), 20) << specs[i];
+            delete p;
+        }
+    }
+
+    TEST(BranchPredictor, ConfigOverridesPreset)
+    {
+        BranchPredictorConfig config;
+        ASSERT_TRUE(config.parse("tage_sc_l:table_bits=8:btb_sets=256"));
+        ASSERT_STREQ("tage_sc_l", config.type);
+        ASSERT_EQ(8, config.table_bits);
+        ASSERT_EQ(-1, config.tables);
+        ASSERT_FALSE(config.parse("tage_sc_l:size=8"));
+
+        BranchPredictorImplementation *small =
+            BranchPredictorBuilder::create_predictor(config, 0, 0);
+        BranchPredictorImplementation *preset =
+            BranchPredictorBuilder::create_predictor("tage_sc_l", 0, 0);
+        ASSERT_LT(small->storage_bits(), preset->storage_bits());
+        delete small;
+        delete preset;
+    }
+
+    TEST(BranchPredictor, ShadowLearnsAndCounts)
+    {
+        Statable parent("shadow_branchpred_test");
+        StatObj<W64> insns("insns", &parent);
+        parent.set_default_stats(user_stats);
+
+        ShadowBranchPredictors shadows;
+        shadows.predictors.push(
+                BranchPredictorBuilder::create_predictor("combined_4k", 0, 0));
+        shadows.stats.push(new ShadowBranchStats("shadow_combined_4k",
+                    &parent, &insns));
+        shadows.stats[0]->set_default_stats(user_stats);
+        shadows.reset();
+
+        PredictorUpdate predinfo;
+        memset(&predinfo, 0, sizeof(predinfo));
+        predinfo.flags = BRANCH_HINT_COND;
+
+        /* An always taken branch is learnt after a couple of updates */
+        foreach (i, 100)
+            shadows.commit(predinfo, BRANCH, TARGET, TARGET);
+
+        ShadowBranchStats &s = *shadows.stats[0];
+        ASSERT_EQ(W64(100), s.cond.branches(user_stats));
+        ASSERT_EQ(W64(100), s.summary.branches(user_stats));
+        ASSERT_EQ(W64(0), s.ret.branches(user_stats));
+        ASSERT_LE(s.cond.mispred(user_stats), W64(2));
+
+        /* Returns are predicted from the shadow's own RAS */
+        predinfo.flags = BRANCH_HINT_CALL;
+        shadows.commit(predinfo, BRANCH, TARGET, TARGET);
+        predinfo.flags = BRANCH_HINT_RET | BRANCH_HINT_INDIRECT;
+        shadows.commit(predinfo, TARGET + 4, 0, BRANCH);
+        ASSERT_EQ(W64(1), s.ret.branches(user_stats));
+        ASSERT_EQ(W64(0), s.ret.mispred(user_stats));
+    }
+};
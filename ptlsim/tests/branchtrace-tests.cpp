@@ -0,0 +1,157 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <branchpred.h>
+#include <branchtrace.h>
+
+#include <sstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace {
+
+    struct Branch {
+        int writer;
+        int type;
+        W64 branchaddr;
+        W64 riptaken;
+        W64 target;
+        W64 insns;
+        bool kernel;
+    };
+
+    const Branch branches[] = {
+        {0, BRANCH_HINT_COND, 0x400105, 0x400080, 0x400080, 10, false},
+        {0, BRANCH_HINT_COND, 0x400105, 0x400080, 0x400105, 17, false},
+        {1, BRANCH_HINT_CALL, 0x7fff0010, 0x7fff9000, 0x7fff9000, 3, false},
+        {1, BRANCH_HINT_RET | BRANCH_HINT_INDIRECT, 0x7fff9020, 0x7fff9020,
+            0x7fff0010, 9, false},
+        {0, BRANCH_HINT_INDIRECT, 0xffffffff81000010ULL, 0x400000,
+            0xffffffff81234560ULL, 40, true},
+        {0, BRANCH_HINT_UNCOND, 0x400020, 0x400000, 0x400000, 41, false},
+    };
+
+    TEST(BranchTrace, RoundTrip)
+    {
+        std::stringstream ss;
+        BranchTraceWriter writers[2];
+        writers[0].init(0, 0);
+        writers[1].init(1, 0);
+
+        BranchTraceWriter::start(ss);
+        foreach (i, lengthof(branches)) {
+            const Branch &b = branches[i];
+            writers[b.writer].record(ss, b.type, b.branchaddr, b.riptaken,
+                    b.target, b.insns, b.kernel);
+        }
+        BranchTraceWriter::flush(ss);
+
+        BranchTraceReader reader(ss);
+        ASSERT_TRUE(reader.valid());
+
+        W64 last_insns[2] = {0, 0};
+        BranchTraceRecord rec;
+
+        foreach (i, lengthof(branches)) {
+            const Branch &b = branches[i];
+            ASSERT_EQ(b.writer, reader.next(rec));
+            ASSERT_EQ(W8(b.type), rec.type);
+            ASSERT_EQ(b.branchaddr, rec.branchaddr);
+            ASSERT_EQ(b.riptaken, rec.riptaken);
+            ASSERT_EQ(b.target, rec.target);
+            ASSERT_EQ(b.insns - last_insns[b.writer], rec.insns);
+            ASSERT_EQ(b.kernel, rec.kernel);
+            last_insns[b.writer] = b.insns;
+        }
+
+        ASSERT_EQ(-1, reader.next(rec));
+        ASSERT_EQ(2, reader.streams.count());
+        ASSERT_EQ(1, reader.streams[1].coreid);
+    }
+
+    TEST(BranchTrace, CompactAndChecked)
+    {
+        std::stringstream ss;
+        BranchTraceWriter writer;
+
+        BranchTraceWriter::start(ss);
+        foreach (i, 1000) {
+            W64 branchaddr = 0x400100 + (i % 8) * 0x20;
+            writer.record(ss, BRANCH_HINT_COND, branchaddr, branchaddr - 0x80,
+                    (i & 1) ? branchaddr : branchaddr - 0x80, i * 6, false);
+        }
+        BranchTraceWriter::flush(ss);
+
+        /* Tag and three one or two byte varints per branch */
+        W64 size = ss.str().size() - sizeof(BranchTraceHeader);
+        ASSERT_LE(size, W64(6000));
+
+        std::stringstream bad("not a branch trace at all");
+        BranchTraceReader reader(bad);
+        BranchTraceRecord rec;
+        ASSERT_FALSE(reader.valid());
+        ASSERT_EQ(-1, reader.next(rec));
+    }
+
+    TEST(BranchTrace, OracleFollowsFetchAndCommit)
+    {
+        char filename[] = "/tmp/branch_oracle_XXXXXX";
+        int fd = mkstemp(filename);
+        ASSERT_NE(-1, fd);
+        close(fd);
+
+        ofstream of(filename, std::ios::binary);
+        BranchTraceWriter writers[2];
+        writers[0].init(0, 0);
+        writers[1].init(0, 1);
+
+        BranchTraceWriter::start(of);
+        foreach (i, 8) {
+            W64 branchaddr = 0x400100 + i * 0x10;
+            writers[0].record(of, BRANCH_HINT_COND, branchaddr, 0x400000,
+                    (i & 1) ? 0x400000 : branchaddr, i * 5, false);
+            writers[1].record(of, BRANCH_HINT_UNCOND, 0x500000, 0x500100,
+                    0x500100, i * 3, false);
+        }
+        BranchTraceWriter::flush(of);
+        of.close();
+
+        BranchOracle oracle;
+        ASSERT_FALSE(oracle.active());
+        ASSERT_TRUE(oracle.open(filename, 0, 0));
+
+        W64 target = 0;
+        ASSERT_EQ(0, oracle.predict(0x400100, target));
+        ASSERT_EQ(W64(0x400100), target);
+        ASSERT_EQ(1, oracle.predict(0x400110, target));
+        ASSERT_EQ(W64(0x400000), target);
+
+        // A branch the first run didn't take has no record
+        ASSERT_EQ(-1, oracle.predict(0x600000, target));
+
+        // Skip the record of a branch this run didn't execute
+        ASSERT_EQ(3, oracle.predict(0x400130, target));
+
+        // Redirect after record 0: fetch sees record 1 again
+        oracle.annul(0);
+        ASSERT_EQ(1, oracle.predict(0x400110, target));
+
+        ASSERT_EQ(BRANCH_ORACLE_MATCH, oracle.commit(0, 0x400100, 0x400100));
+        ASSERT_EQ(BRANCH_ORACLE_MISSING, oracle.commit(-1, 0x600000, 0x600010));
+        ASSERT_EQ(BRANCH_ORACLE_WRONG, oracle.commit(1, 0x400110, 0x400110));
+        ASSERT_EQ(W64(2), oracle.committed());
+
+        // After a flush fetch restarts at the oldest uncommitted record
+        oracle.annul(-1);
+        ASSERT_EQ(3, oracle.predict(0x400130, target));
+        ASSERT_EQ(BRANCH_ORACLE_SKIPPED, oracle.commit(3, 0x400130, 0x400000));
+        ASSERT_EQ(W64(4), oracle.committed());
+
+        oracle.close();
+        unlink(filename);
+        ASSERT_FALSE(oracle.open(filename, 0, 0));
+        ASSERT_FALSE(oracle.active());
+    }
+};
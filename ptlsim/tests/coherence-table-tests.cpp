@@ -0,0 +1,197 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+
+#include <coherenceTable.h>
+#include <mesiLogic.h>
+
+using namespace Memory;
+using namespace Memory::CoherentCache;
+
+namespace {
+
+    struct Expected {
+        int state;
+        W32 actions;
+    };
+
+    const Expected invalid = {COH_STATE_INVALID, 0};
+
+    /*
+     * MESI behaviour as implemented by the nested switch statements in
+     * MESILogic before it moved to the transition table.
+     */
+    Expected mesi_reference(bool lp, int state, int event)
+    {
+        int group = event / NUM_MEMORY_OP;
+        int type  = event % NUM_MEMORY_OP;
+        Expected e = {state, 0};
+
+        if (group == COH_LOCAL) {
+            if (type == MEMORY_OP_EVICT) {
+                e.state = MESI_INVALID;
+                e.actions = COH_ACT_STAT_ALWAYS | COH_ACT_CLEAR;
+                return e;
+            }
+            if (type == MEMORY_OP_UPDATE && state != MESI_MODIFIED) {
+                e.actions = COH_ACT_FORWARD;
+                return e;
+            }
+            switch (state) {
+                case MESI_INVALID:
+                    e.actions = COH_ACT_MISS_STAT | COH_ACT_MISS;
+                    break;
+                case MESI_EXCLUSIVE:
+                case MESI_SHARED:
+                    if (type == MEMORY_OP_READ) {
+                        e.actions = COH_ACT_RESPOND;
+                    } else if (lp) {
+                        e.state = MESI_MODIFIED;
+                        e.actions = COH_ACT_STAT_ALWAYS | COH_ACT_RESPOND;
+                        if (state == MESI_SHARED)
+                            e.actions |= COH_ACT_EVICT_LOWER;
+                    } else {
+                        e.state = MESI_INVALID;
+                        e.actions = COH_ACT_STAT_ALWAYS | COH_ACT_MISS_STAT |
+                            COH_ACT_MISS;
+                    }
+                    break;
+                case MESI_MODIFIED:
+                    e.actions = COH_ACT_RESPOND;
+                    break;
+            }
+            return e;
+        }
+
+        if (group == COH_SNOOP) {
+            if (type == MEMORY_OP_EVICT) {
+                e.state = MESI_INVALID;
+                e.actions = COH_ACT_STAT_ALWAYS | COH_ACT_CLEAR;
+                if (lp) e.actions |= COH_ACT_EVICT_UPPER;
+                return e;
+            }
+            if (type == MEMORY_OP_UPDATE && !lp) {
+                e.state = COH_STATE_FROM_ARG;
+                e.actions = COH_ACT_STAT_ALWAYS | COH_ACT_CLEAR;
+                return e;
+            }
+
+            e.actions = COH_ACT_STAT_ALWAYS | COH_ACT_RESPOND;
+            if (state == MESI_INVALID) {
+                e.actions |= COH_ACT_NO_DATA;
+                return e;
+            }
+            if (state == MESI_MODIFIED)
+                e.actions |= COH_ACT_WRITEBACK;
+
+            if (type == MEMORY_OP_READ) {
+                e.state = MESI_SHARED;
+                e.actions |= COH_ACT_SHARED;
+                if (state == MESI_EXCLUSIVE)
+                    e.actions |= COH_ACT_UPDATE_UPPER;
+            } else if (type == MEMORY_OP_WRITE) {
+                e.state = MESI_INVALID;
+                if (lp) e.actions |= COH_ACT_EVICT_UPPER;
+            } else {
+                e.state = COH_STATE_FROM_ARG;
+            }
+            return e;
+        }
+
+        /* Fills are only looked up in the lowest private cache */
+        if (!lp || type == MEMORY_OP_UPDATE)
+            return invalid;
+
+        bool shared = (group == COH_FILL_SHARED);
+        e.actions = COH_ACT_STAT_ALWAYS;
+
+        if (type == MEMORY_OP_EVICT) {
+            e.state = MESI_INVALID;
+            e.actions |= COH_ACT_EVICT_UPPER;
+        } else if (shared) {
+            if (type == MEMORY_OP_READ) {
+                e.state = MESI_SHARED;
+            } else if (state == MESI_EXCLUSIVE) {
+                e.state = MESI_INVALID;
+                e.actions |= COH_ACT_EVICT_UPPER;
+            } else {
+                return invalid;
+            }
+        } else if (type == MEMORY_OP_READ) {
+            e.state = (state == MESI_MODIFIED) ? MESI_MODIFIED :
+                MESI_EXCLUSIVE;
+        } else {
+            e.state = MESI_MODIFIED;
+        }
+        return e;
+    }
+
+    void check_table(const CoherenceTable& table, int num_states,
+            Expected (*reference)(bool, int, int))
+    {
+        ASSERT_EQ(num_states, table.get_num_states());
+
+        foreach (lp, 2) {
+            foreach (state, num_states) {
+                foreach (event, NUM_COHERENCE_EVENTS) {
+                    const CoherenceTransition &t = table.lookup(lp, state,
+                            event);
+                    Expected e = reference(lp, state, event);
+                    int next = t.next_state;
+                    if (next == COH_STATE_SAME)
+                        next = state;
+
+                    ASSERT_EQ(e.state, next) << table.get_name() <<
+                        " lp " << lp << " state " << state << " event " <<
+                        event;
+                    if (e.state == COH_STATE_INVALID)
+                        continue;
+
+                    ASSERT_EQ(e.actions, t.actions) << table.get_name() <<
+                        " lp " << lp << " state " << state << " event " <<
+                        event;
+                    if (t.actions & COH_ACT_DIRECTORY)
+                        ASSERT_EQ(MEMORY_OP_EVICT, t.message);
+                }
+            }
+        }
+    }
+
+    TEST(CoherenceTable, MESIMatchesReference)
+    {
+        check_table(MESILogic::table, NO_MESI_STATES, mesi_reference);
+    }
+
+    TEST(CoherenceTable, FirstMatchingRuleWins)
+    {
+        const CoherenceRule rules[] = {
+            {COH_S(1), COH_E(COH_LOCAL_READ), COH_LOWEST_PRIVATE, 2,
+                COH_ACT_RESPOND},
+            {COH_ANY_STATE, COH_ANY_LOCAL, COH_ANY_LEVEL, COH_STATE_SAME,
+                COH_ACT_MISS},
+            {COH_ANY_STATE, COH_ANY_SNOOP, COH_NOT_LOWEST_PRIVATE, 0,
+                COH_ACT_DIRECTORY, MEMORY_OP_UPDATE},
+        };
+        CoherenceTable table("test", 3, rules, lengthof(rules));
+
+        ASSERT_EQ(2, table.lookup(true, 1, COH_LOCAL_READ).next_state);
+        ASSERT_EQ(COH_ACT_RESPOND,
+                table.lookup(true, 1, COH_LOCAL_READ).actions);
+        ASSERT_EQ(COH_ACT_MISS,
+                table.lookup(false, 1, COH_LOCAL_READ).actions);
+        ASSERT_EQ(COH_ACT_MISS,
+                table.lookup(true, 2, COH_LOCAL_EVICT).actions);
+
+        ASSERT_EQ(MEMORY_OP_UPDATE,
+                table.lookup(false, 0, COH_SNOOP_READ).message);
+        ASSERT_EQ(COH_STATE_INVALID,
+                table.lookup(true, 0, COH_SNOOP_READ).next_state);
+        ASSERT_EQ(COH_STATE_INVALID,
+                table.lookup(true, 0, COH_FILL_READ).next_state);
+
+        /* States beyond the protocol are never valid */
+        ASSERT_EQ(COH_STATE_INVALID,
+                table.lookup(true, 3, COH_LOCAL_READ).next_state);
+    }
+};
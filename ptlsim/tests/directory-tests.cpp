@@ -0,0 +1,136 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <directory.h>
+
+using namespace Memory;
+
+namespace {
+
+    DirectorySharers empty_sharers()
+    {
+        DirectorySharers s;
+        s.clear();
+        return s;
+    }
+
+    TEST(DirectorySharers, FullVector)
+    {
+        DirSharerFormat fmt;
+        fmt.setup(DIR_FULL_VECTOR, 16, 4, 0);
+        DirectorySharers s = empty_sharers();
+
+        ASSERT_TRUE(s.empty());
+        s.add(3, fmt);
+        s.add(9, fmt);
+        ASSERT_TRUE(s.exact(fmt));
+        ASSERT_TRUE(s.may_contain(9, fmt));
+        ASSERT_FALSE(s.may_contain(4, fmt));
+        ASSERT_EQ(1, s.candidates(3, fmt));
+
+        s.remove(9, fmt);
+        ASSERT_TRUE(s.only(3, fmt));
+        ASSERT_FALSE(s.others(3, fmt));
+    }
+
+    TEST(DirectorySharers, LimitedPointerBroadcast)
+    {
+        DirSharerFormat fmt;
+        fmt.setup(DIR_LIMITED_POINTER, 32, 2, 0);
+        DirectorySharers s = empty_sharers();
+
+        s.add(5, fmt);
+        s.add(7, fmt);
+        ASSERT_TRUE(s.exact(fmt));
+        ASSERT_EQ(2, s.candidates(-1, fmt));
+
+        /* Third sharer overflows, every core is a candidate */
+        s.add(20, fmt);
+        ASSERT_FALSE(s.exact(fmt));
+        ASSERT_TRUE(s.may_contain(0, fmt));
+        ASSERT_EQ(31, s.candidates(20, fmt));
+
+        /* Removing a core can't make an overflowed set smaller */
+        s.remove(5, fmt);
+        ASSERT_TRUE(s.may_contain(5, fmt));
+        ASSERT_FALSE(s.only(20, fmt));
+    }
+
+    TEST(DirectorySharers, CoarseVector)
+    {
+        DirSharerFormat fmt;
+        fmt.setup(DIR_COARSE_VECTOR, 32, 2, 4);
+        DirectorySharers s = empty_sharers();
+
+        s.add(1, fmt);
+        s.add(13, fmt);
+        s.add(14, fmt);
+
+        /* Groups of four cores, 0-3 and 12-15 */
+        ASSERT_FALSE(s.exact(fmt));
+        ASSERT_TRUE(s.may_contain(2, fmt));
+        ASSERT_TRUE(s.may_contain(15, fmt));
+        ASSERT_FALSE(s.may_contain(4, fmt));
+        ASSERT_EQ(8, s.candidates(-1, fmt));
+        ASSERT_EQ(0, s.first(fmt));
+    }
+
+    TEST(DirectorySharers, ManyCores)
+    {
+        /* Past 64 cores a full vector bit covers two cores */
+        DirSharerFormat fmt;
+        fmt.setup(DIR_FULL_VECTOR, 128, 4, 0);
+        DirectorySharers s = empty_sharers();
+
+        ASSERT_EQ(2, fmt.group);
+        s.add(100, fmt);
+        ASSERT_TRUE(s.may_contain(101, fmt));
+        ASSERT_FALSE(s.exact(fmt));
+    }
+
+    TEST(Directory, ReplacesLeastRecentlyUsed)
+    {
+        Directory dir(4, 2, 64);
+        W64 old_tag = InvalidTag<W64>::INVALID;
+
+        /* Lines 0, 4 and 8 share set 0 */
+        DirectoryEntry *a = dir.insert(0 << 6, old_tag);
+        a->init(dir.tag_of(0 << 6));
+        a->sharers.add(0, dir.format);
+        DirectoryEntry *b = dir.insert(4 << 6, old_tag);
+        b->init(dir.tag_of(4 << 6));
+        b->sharers.add(0, dir.format);
+        ASSERT_TRUE(old_tag == InvalidTag<W64>::INVALID);
+
+        ASSERT_EQ(a, dir.probe(0 << 6));
+        ASSERT_TRUE(dir.probe(1 << 6) == NULL);
+
+        /* Line 4 is now the least recently used */
+        ASSERT_EQ(b, dir.insert(8 << 6, old_tag));
+        ASSERT_EQ(W64(4 << 6), old_tag);
+
+        /* Locked entries are not replaced */
+        b->init(dir.tag_of(8 << 6));
+        a->locked = 1;
+        b->locked = 1;
+        ASSERT_TRUE(dir.insert(12 << 6, old_tag) == NULL);
+    }
+
+    TEST(Directory, HomeInterleave)
+    {
+        Directory dir(4, 1, 64);
+        W64 old_tag = InvalidTag<W64>::INVALID;
+
+        /* With two homes this one gets lines 0, 2, 4, 6 in sets 0 to 3 */
+        dir.set_interleave(2);
+        foreach (i, 4) {
+            W64 addr = (i * 2) << 6;
+            dir.insert(addr, old_tag)->init(dir.tag_of(addr));
+        }
+
+        foreach (i, 4)
+            ASSERT_TRUE(dir.probe((i * 2) << 6) != NULL);
+    }
+};
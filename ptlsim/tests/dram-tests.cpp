@@ -0,0 +1,159 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <dramTiming.h>
+
+using namespace Memory;
+
+namespace {
+
+    /* Small round numbers make the expected cycles easy to follow */
+    DRAMConfig test_config()
+    {
+        DRAMConfig c;
+        c.channels = 1;
+        c.ranks    = 1;
+        c.banks    = 8;
+        c.row_size = 8192;
+        c.tCL      = 10;
+        c.tCWL     = 8;
+        c.tRCD     = 10;
+        c.tRP      = 10;
+        c.tRAS     = 25;
+        c.tRRD     = 4;
+        c.tFAW     = 40;
+        c.tWR      = 12;
+        c.tWTR     = 6;
+        c.tRTP     = 5;
+        c.tBURST   = 4;
+        return c;
+    }
+
+    /* Address of 'line' in 'row' of 'bank' with the default mapping */
+    W64 address(const DRAMConfig &c, W64 row, int bank, int line = 0)
+    {
+        W64 lines_per_row = c.row_size >> c.line_bits;
+        return (((row * c.banks + bank) * lines_per_row) + line)
+            << c.line_bits;
+    }
+
+    TEST(DRAMTiming, DecodeRowInterleave)
+    {
+        DRAMConfig c = test_config();
+        DRAMTiming dram(c);
+        DRAMAddress da;
+
+        dram.decode(address(c, 5, 3, 17), da);
+        ASSERT_EQ(0, da.channel);
+        ASSERT_EQ(0, da.rank);
+        ASSERT_EQ(3, da.bank);
+        ASSERT_EQ(5U, da.row);
+
+        /* Consecutive lines go to different banks with line interleaving */
+        c.line_interleave = true;
+        DRAMTiming inter(c);
+        DRAMAddress a, b;
+        inter.decode(0x1000, a);
+        inter.decode(0x1040, b);
+        ASSERT_NE(a.bank, b.bank);
+        ASSERT_EQ(a.row, b.row);
+    }
+
+    TEST(DRAMTiming, RowBufferOutcomes)
+    {
+        DRAMConfig c = test_config();
+        DRAMTiming dram(c);
+        DRAMAddress da;
+        DRAMRowResult result;
+
+        /* Closed bank: activate, tRCD, tCL, burst */
+        dram.decode(address(c, 1, 0), da);
+        ASSERT_EQ(DRAM_ROW_CLOSED, dram.row_state(da));
+        ASSERT_EQ(24U, dram.issue(da, false, 0, result));
+        ASSERT_EQ(DRAM_ROW_CLOSED, result);
+
+        /* Same row: column command one burst later */
+        dram.decode(address(c, 1, 0, 1), da);
+        ASSERT_EQ(DRAM_ROW_HIT, dram.row_state(da));
+        ASSERT_EQ(14U, dram.ready_cycle(da, false));
+        ASSERT_EQ(28U, dram.issue(da, false, 14, result));
+        ASSERT_EQ(DRAM_ROW_HIT, result);
+
+        /* Other row: precharge waits for tRAS, then tRP and tRCD */
+        dram.decode(address(c, 2, 0), da);
+        ASSERT_EQ(DRAM_ROW_CONFLICT, dram.row_state(da));
+        ASSERT_EQ(25U, dram.ready_cycle(da, false));
+        ASSERT_EQ(59U, dram.issue(da, false, 25, result));
+        ASSERT_EQ(DRAM_ROW_CONFLICT, result);
+    }
+
+    TEST(DRAMTiming, ClosedPagePolicy)
+    {
+        DRAMConfig c = test_config();
+        c.open_page = false;
+        DRAMTiming dram(c);
+        DRAMAddress da;
+        DRAMRowResult result;
+
+        dram.decode(address(c, 1, 0), da);
+        dram.issue(da, false, 0, result);
+
+        /* Row was precharged, next activate after tRAS + tRP */
+        dram.decode(address(c, 1, 0, 1), da);
+        ASSERT_EQ(DRAM_ROW_CLOSED, dram.row_state(da));
+        ASSERT_EQ(35U, dram.ready_cycle(da, false));
+    }
+
+    TEST(DRAMTiming, ActivateWindow)
+    {
+        DRAMConfig c = test_config();
+        DRAMTiming dram(c);
+        DRAMAddress da;
+        DRAMRowResult result;
+
+        /* Four activates to different banks are tRRD apart */
+        foreach (i, 4) {
+            dram.decode(address(c, 1, i), da);
+            ASSERT_EQ(W64(i * c.tRRD), dram.ready_cycle(da, false));
+            dram.issue(da, false, i * c.tRRD, result);
+        }
+
+        /* The fifth has to wait for the tFAW window */
+        dram.decode(address(c, 1, 4), da);
+        ASSERT_EQ(W64(c.tFAW), dram.ready_cycle(da, false));
+    }
+
+    TEST(DRAMTiming, SharedDataBus)
+    {
+        DRAMConfig c = test_config();
+        c.tRRD = 0;
+        DRAMTiming dram(c);
+        DRAMAddress a, b;
+        DRAMRowResult result;
+
+        dram.decode(address(c, 1, 0), a);
+        dram.decode(address(c, 1, 1), b);
+
+        /* Both banks open together but the data can't overlap */
+        ASSERT_EQ(24U, dram.issue(a, false, 0, result));
+        ASSERT_EQ(28U, dram.issue(b, false, 0, result));
+    }
+
+    TEST(DRAMTiming, WriteToReadTurnaround)
+    {
+        DRAMConfig c = test_config();
+        DRAMTiming dram(c);
+        DRAMAddress da;
+        DRAMRowResult result;
+
+        dram.decode(address(c, 1, 0), da);
+        ASSERT_EQ(22U, dram.issue(da, true, 0, result));
+
+        /* Read to the open row waits for tWTR after the write data */
+        dram.decode(address(c, 1, 0, 1), da);
+        ASSERT_EQ(28U, dram.ready_cycle(da, false));
+        ASSERT_EQ(14U, dram.ready_cycle(da, true));
+    }
+};
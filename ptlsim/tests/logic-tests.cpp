@@ -42,6 +42,72 @@ namespace {
         }
     }
 
+    /* Reference match: one scalar compare per valid tag */
+    template <int size>
+    W64 scalar_match(const FullyAssociativeTags16bit<size, size>& tags,
+            W16 target)
+    {
+        W64 m = 0;
+        foreach(i, size) {
+            if(tags.valid[i] && tags[i] == target)
+                m |= (1ULL << i);
+        }
+        return m;
+    }
+
+    template <int size>
+    void check_tags16bit_match()
+    {
+        FullyAssociativeTags16bit<size, size> tags;
+
+        /* Few distinct tags so most searches hit several slots */
+        foreach(i, size) {
+            if(i % 5 != 3)
+                tags.insertslot(i, (i * 7) % 13);
+        }
+
+        bool saved_avx2 = x86_have_avx2;
+        foreach(pass, 2) {
+            x86_have_avx2 = (pass == 0) ? false : saved_avx2;
+            foreach(t, 16) {
+                ASSERT_EQ(scalar_match<size>(tags, t),
+                        tags.match(W16(t)).integer()) << "size " << size <<
+                    " tag " << t << " avx2 " << x86_have_avx2;
+            }
+        }
+        x86_have_avx2 = saved_avx2;
+    }
+
+    /* Broadcast match must agree with a scalar scan on both paths */
+    TEST(Logic, AssocTags16bitMatch)
+    {
+        check_tags16bit_match<8>();
+        check_tags16bit_match<16>();
+        check_tags16bit_match<24>();
+        check_tags16bit_match<32>();
+        check_tags16bit_match<48>();
+        check_tags16bit_match<64>();
+    }
+
+    /* Runtime capacity limits allocation but keeps wrapping over SIZE */
+    TEST(Logic, FixedQueueCapacity)
+    {
+        FixedQueue<int, 16> q;
+        q.set_capacity(5);
+
+        foreach(round, 10) {
+            int n = 0;
+            while(q.alloc()) n++;
+            ASSERT_EQ(4, n);
+            ASSERT_TRUE(q.full());
+            foreach(i, n) q.dequeue();
+            ASSERT_TRUE(q.empty());
+        }
+
+        q.set_capacity(16);
+        ASSERT_EQ(15, q.remaining());
+    }
+
     /* Test simulation freq related functions */
     TEST(Sim, SimFreq)
     {
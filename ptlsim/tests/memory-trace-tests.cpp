@@ -0,0 +1,183 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memoryTrace.h>
+#include <memoryHierarchy.h>
+#include <cpuController.h>
+#include <machine.h>
+
+#include <sstream>
+
+using namespace Memory;
+
+namespace {
+
+    MemoryTraceRecord make_record(int coreid, int type, W64 gap, W64 addr,
+            W64 rip, bool dependent)
+    {
+        MemoryTraceRecord rec;
+        rec.coreid = coreid;
+        rec.threadid = 0;
+        rec.type = type;
+        rec.gap = gap;
+        rec.addr = addr;
+        rec.rip = rip;
+        rec.dependent = dependent;
+        return rec;
+    }
+
+    TEST(MemoryTrace, RoundTrip)
+    {
+        const MemoryTraceRecord recs[] = {
+            make_record(0, MEM_TRACE_IFETCH, 0, 0x1000, 0x400000, false),
+            make_record(0, MEM_TRACE_READ, 3, 0x7fff0040, 0x400004, false),
+            make_record(1, MEM_TRACE_WRITE, 12, 0x20000, 0xffffffff81000000ULL,
+                    false),
+            make_record(0, MEM_TRACE_READ, 1, 0x7fff0000, 0x400004, true),
+            make_record(1, MEM_TRACE_READ, 0, 0x10000, 0xffffffff81000000ULL,
+                    false),
+        };
+
+        std::stringstream ss;
+        MemoryTraceWriter writer;
+        writer.start(ss);
+        foreach (i, lengthof(recs)) {
+            writer.record(ss, recs[i]);
+        }
+        writer.flush(ss);
+
+        MemoryTraceReader reader(ss);
+        ASSERT_TRUE(reader.valid());
+
+        MemoryTraceRecord rec;
+        foreach (i, lengthof(recs)) {
+            ASSERT_TRUE(reader.next(rec));
+            ASSERT_EQ(recs[i].coreid, rec.coreid);
+            ASSERT_EQ(recs[i].type, rec.type);
+            ASSERT_EQ(recs[i].gap, rec.gap);
+            ASSERT_EQ(recs[i].addr, rec.addr);
+            ASSERT_EQ(recs[i].rip, rec.rip);
+            ASSERT_EQ(recs[i].dependent, rec.dependent);
+        }
+
+        ASSERT_FALSE(reader.next(rec));
+
+        std::stringstream bad("not a memory trace");
+        MemoryTraceReader bad_reader(bad);
+        ASSERT_FALSE(bad_reader.valid());
+    }
+
+    TEST(MemoryTrace, SyntheticStream)
+    {
+        SyntheticMemoryStream stream;
+        ASSERT_TRUE(stream.parse("stream:cores=2:count=4:footprint=1k:stride=256"));
+        ASSERT_EQ(2, stream.cores());
+
+        MemoryTraceRecord rec;
+        foreach (i, 8) {
+            ASSERT_TRUE(stream.next(rec));
+            ASSERT_EQ(W8(i % 2), rec.coreid);
+            ASSERT_EQ(W64((i % 2) * 1024 + (i / 2) * 256), rec.addr);
+            ASSERT_EQ(W8(MEM_TRACE_READ), rec.type);
+            ASSERT_FALSE(rec.dependent);
+        }
+        ASSERT_FALSE(stream.next(rec));
+
+        SyntheticMemoryStream chase;
+        ASSERT_TRUE(chase.parse("chase:count=100:footprint=4k:shared=1"));
+        foreach (i, 100) {
+            ASSERT_TRUE(chase.next(rec));
+            ASSERT_TRUE(rec.dependent);
+            ASSERT_LT(rec.addr, W64(4096));
+            ASSERT_EQ(W64(0), rec.addr & 63);
+        }
+
+        SyntheticMemoryStream invalid;
+        ASSERT_FALSE(invalid.parse("zigzag:count=10"));
+        ASSERT_FALSE(invalid.parse("random:lines=10"));
+        ASSERT_FALSE(invalid.parse("random:footprint=12q"));
+    }
+
+    /* One core wired like single_core, built on the base machine */
+    class MemoryReplayTest : public ::testing::Test
+    {
+        public:
+            BaseMachine *machine;
+            W64 saved_cycle;
+
+            void SetUp()
+            {
+                machine = (BaseMachine*)PTLsimMachine::getmachine("base");
+                machine->reset();
+                machine->memoryHierarchyPtr = new MemoryHierarchy(*machine);
+                saved_cycle = sim_cycle;
+                sim_cycle = 0;
+
+                ControllerBuilder::add_new_cont(*machine, 0, "core_", "cpu", 0);
+                ControllerBuilder::add_new_cont(*machine, 0, "L1_I_", "wb_cache", 0);
+                ControllerBuilder::add_new_cont(*machine, 0, "L1_D_", "wb_cache", 0);
+                ControllerBuilder::add_new_cont(*machine, 0, "L2_", "wb_cache", 0);
+                ControllerBuilder::add_new_cont(*machine, 0, "MEM_", "simple_dram_cont", 0);
+
+                connect("core_0", INTERCONN_TYPE_I, "L1_I_0", INTERCONN_TYPE_UPPER);
+                connect("core_0", INTERCONN_TYPE_D, "L1_D_0", INTERCONN_TYPE_UPPER);
+                connect("L1_I_0", INTERCONN_TYPE_LOWER, "L2_0", INTERCONN_TYPE_UPPER);
+                connect("L1_D_0", INTERCONN_TYPE_LOWER, "L2_0", INTERCONN_TYPE_UPPER2);
+                connect("L2_0", INTERCONN_TYPE_LOWER, "MEM_0", INTERCONN_TYPE_UPPER);
+
+                CPUController *cpu = (CPUController*)(*machine->controller_hash.get("core_0"));
+                cpu->set_icacheLineBits(6);
+                cpu->set_dcacheLineBits(6);
+
+                machine->setup_interconnects();
+                machine->memoryHierarchyPtr->setup_full_flags();
+            }
+
+            void TearDown()
+            {
+                machine->reset();
+                sim_cycle = saved_cycle;
+            }
+
+            void connect(const char *upper, int upper_type, const char *lower,
+                    int lower_type)
+            {
+                ConnectionDef *connDef = machine->get_new_connection_def("p2p",
+                        upper, 0);
+                machine->add_new_connection(connDef, upper, upper_type);
+                machine->add_new_connection(connDef, lower, lower_type);
+            }
+
+            W64 replay(const char *spec, W64 count, int max_misses)
+            {
+                SyntheticMemoryStream stream;
+                EXPECT_TRUE(stream.parse(spec));
+
+                MemoryReplay replay("test_replay", machine->memoryHierarchyPtr,
+                        1, max_misses);
+                W64 cycles = replay.run(stream, 10000000);
+                EXPECT_EQ(count, replay.issued());
+                EXPECT_LT(cycles, W64(10000000));
+                return cycles;
+            }
+    };
+
+    /* More records than the replay window, a core sends one a cycle */
+    TEST_F(MemoryReplayTest, RunsEveryRecord)
+    {
+        W64 cycles = replay("random:footprint=8k:writes=25:count=150000",
+                150000, 8);
+        ASSERT_GE(cycles, W64(150000));
+        ASSERT_LT(cycles, W64(200000));
+    }
+
+    /* Dependent misses can't overlap, independent ones can */
+    TEST_F(MemoryReplayTest, DependentMissesWait)
+    {
+        W64 random = replay("random:footprint=64m:count=2000", 2000, 8);
+        W64 chase = replay("chase:footprint=64m:count=2000", 2000, 8);
+        ASSERT_GT(chase, random * 2);
+    }
+};
@@ -0,0 +1,156 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+
+#include <coherenceTable.h>
+#include <moesiLogic.h>
+
+using namespace Memory;
+using namespace Memory::CoherentCache;
+
+namespace {
+
+    struct Expected {
+        int state;
+        W32 actions;
+    };
+
+    const Expected invalid = {COH_STATE_INVALID, 0};
+
+    /*
+     * MOESI behaviour as implemented by the nested switch statements in
+     * MOESILogic before it moved to the transition table.
+     */
+    Expected moesi_reference(bool lp, int state, int event)
+    {
+        int group = event / NUM_MEMORY_OP;
+        int type  = event % NUM_MEMORY_OP;
+        Expected e = {state, 0};
+
+        if (group == COH_LOCAL) {
+            if (type == MEMORY_OP_EVICT) {
+                e.state = MOESI_INVALID;
+                e.actions = COH_ACT_CLEAR;
+            } else if (type == MEMORY_OP_UPDATE && state != MOESI_MODIFIED) {
+                e.actions = COH_ACT_FORWARD;
+            } else if (state == MOESI_INVALID) {
+                e.actions = COH_ACT_MISS;
+            } else if (state == MOESI_MODIFIED || type == MEMORY_OP_READ) {
+                e.actions = COH_ACT_RESPOND;
+            } else if (lp) {
+                e.actions = COH_ACT_TO_DIRECTORY;
+            } else {
+                e.state = MOESI_INVALID;
+                e.actions = COH_ACT_STAT | COH_ACT_MISS;
+            }
+            return e;
+        }
+
+        if (group == COH_SNOOP) {
+            if (!lp && type == MEMORY_OP_EVICT) {
+                e.state = MOESI_INVALID;
+                e.actions = COH_ACT_STAT_ALWAYS | COH_ACT_CLEAR;
+                return e;
+            }
+            if (!lp && type == MEMORY_OP_UPDATE) {
+                e.state = COH_STATE_FROM_ARG;
+                e.actions = COH_ACT_STAT_ALWAYS | COH_ACT_CLEAR;
+                return e;
+            }
+
+            e.actions = COH_ACT_STAT | COH_ACT_RESPOND_SRC;
+            if (state == MOESI_INVALID) {
+                e.actions |= COH_ACT_NO_DATA | COH_ACT_DIRECTORY |
+                    COH_ACT_INVALIDATE;
+                return e;
+            }
+
+            switch (type) {
+                case MEMORY_OP_READ:
+                    e.actions |= COH_ACT_SHARED;
+                    if (state == MOESI_MODIFIED || state == MOESI_OWNER)
+                        e.state = MOESI_OWNER;
+                    else
+                        e.state = MOESI_SHARED;
+                    if (lp && state != MOESI_SHARED)
+                        e.actions |= COH_ACT_UPDATE_UPPER;
+                    break;
+                case MEMORY_OP_WRITE:
+                    e.state = MOESI_INVALID;
+                    if (lp)
+                        e.actions |= COH_ACT_DIRECTORY | COH_ACT_INVALIDATE;
+                    break;
+                case MEMORY_OP_UPDATE:
+                    if (state == MOESI_MODIFIED || state == MOESI_OWNER) {
+                        e.actions |= COH_ACT_CUSTOM;
+                    } else {
+                        e.state = COH_STATE_FROM_ARG;
+                        e.actions |= COH_ACT_CLEAR;
+                    }
+                    break;
+                case MEMORY_OP_EVICT:
+                    e.state = MOESI_INVALID;
+                    e.actions |= COH_ACT_INVALIDATE;
+                    break;
+            }
+            return e;
+        }
+
+        /* Fills are only looked up in the lowest private cache */
+        if (!lp)
+            return invalid;
+
+        bool shared = (group == COH_FILL_SHARED);
+        e.actions = COH_ACT_STAT;
+
+        if (state == MOESI_INVALID) {
+            if (shared) {
+                if (type != MEMORY_OP_READ)
+                    return invalid;
+                e.state = MOESI_SHARED;
+            } else {
+                switch (type) {
+                    case MEMORY_OP_READ:  e.state = MOESI_EXCLUSIVE; break;
+                    case MEMORY_OP_WRITE: e.state = MOESI_MODIFIED; break;
+                    case MEMORY_OP_EVICT: e.state = MOESI_INVALID; break;
+                    default: return invalid;
+                }
+            }
+        } else if (state != MOESI_MODIFIED && type == MEMORY_OP_WRITE) {
+            e.state = MOESI_MODIFIED;
+        } else {
+            return invalid;
+        }
+        return e;
+    }
+
+    TEST(CoherenceTable, MOESIMatchesReference)
+    {
+        const CoherenceTable &table = MOESILogic::table;
+        ASSERT_EQ((int)NUM_MOESI_STATES, table.get_num_states());
+
+        foreach (lp, 2) {
+            foreach (state, NUM_MOESI_STATES) {
+                foreach (event, NUM_COHERENCE_EVENTS) {
+                    const CoherenceTransition &t = table.lookup(lp, state,
+                            event);
+                    Expected e = moesi_reference(lp, state, event);
+                    int next = t.next_state;
+                    if (next == COH_STATE_SAME)
+                        next = state;
+
+                    ASSERT_EQ(e.state, next) << "lp " << lp << " state " <<
+                        state << " event " << event;
+                    if (e.state == COH_STATE_INVALID)
+                        continue;
+
+                    ASSERT_EQ(e.actions, t.actions) << "lp " << lp <<
+                        " state " << state << " event " << event;
+                    if (t.actions & COH_ACT_DIRECTORY)
+                        ASSERT_EQ(MEMORY_OP_EVICT, t.message);
+                }
+            }
+        }
+    }
+};
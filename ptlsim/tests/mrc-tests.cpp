@@ -0,0 +1,131 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <missRatioCurve.h>
+
+using namespace Memory;
+
+namespace {
+
+    class MRCTest : public ::testing::Test
+    {
+        public:
+            MRCTest()
+                : parent("mrc_test")
+                  , mrc(NULL)
+            {}
+
+            ~MRCTest()
+            {
+                if (mrc) delete mrc;
+            }
+
+            /* Access lines 0 to count-1 in order, 'rounds' times */
+            void loop(int count, int rounds)
+            {
+                foreach (r, rounds) {
+                    foreach (i, count)
+                        mrc->access(W64(i) << 6, false);
+                }
+            }
+
+            W64 misses(int point)
+            {
+                return mrc->get_stats().misses(user_stats)[point];
+            }
+
+            W64 references()
+            {
+                return mrc->get_stats().references(user_stats);
+            }
+
+            W64 cold()
+            {
+                return mrc->get_stats().cold(user_stats);
+            }
+
+            Statable parent;
+            MissRatioCurve *mrc;
+    };
+
+    TEST_F(MRCTest, SizePoints)
+    {
+        ASSERT_EQ(W64(4096), MissRatioCurve::size_of(0));
+        ASSERT_EQ(W64(6144), MissRatioCurve::size_of(1));
+        ASSERT_EQ(W64(8192), MissRatioCurve::size_of(2));
+        ASSERT_EQ(W64(256) << 20, MissRatioCurve::size_of(MRC_POINTS - 1));
+    }
+
+    TEST_F(MRCTest, CyclicLoop)
+    {
+        /* Every line sampled, 128 lines of 64 bytes is 8KB */
+        mrc = new MissRatioCurve(&parent, 6, 1, 1024);
+        loop(128, 4);
+
+        ASSERT_EQ(W64(512), references());
+        ASSERT_EQ(W64(128), cold());
+
+        /* LRU thrashes below the loop size and only cold misses above */
+        ASSERT_EQ(W64(512), misses(0));
+        ASSERT_EQ(W64(512), misses(1));
+        ASSERT_EQ(W64(128), misses(2));
+        ASSERT_EQ(W64(128), misses(MRC_POINTS - 1));
+    }
+
+    TEST_F(MRCTest, DistancesSurviveCompaction)
+    {
+        /* Times wrap every 129 accesses with 64 lines tracked at most */
+        mrc = new MissRatioCurve(&parent, 6, 1, 64);
+        loop(32, 50);
+
+        ASSERT_EQ(W64(1600), references());
+        ASSERT_EQ(W64(32), misses(0));
+        ASSERT_EQ(32, mrc->tracked());
+    }
+
+    TEST_F(MRCTest, SamplingRateAdapts)
+    {
+        mrc = new MissRatioCurve(&parent, 6, 1, 64);
+        W32 start = mrc->threshold();
+
+        loop(1000, 1);
+
+        ASSERT_LE(mrc->tracked(), 64);
+        ASSERT_LT(mrc->threshold(), start);
+        ASSERT_GT(mrc->get_stats().rate_drops(user_stats), W64(0));
+
+        /* Lines left are exactly those under the threshold */
+        W64 below = 0;
+        foreach (i, 1000) {
+            if (MissRatioCurve::hash_of(i) < mrc->threshold())
+                below++;
+        }
+        ASSERT_EQ(below, W64(mrc->tracked()));
+    }
+
+    /* Lines all in the lowest bucket still leave something sampled */
+    TEST_F(MRCTest, ThresholdStaysPositive)
+    {
+        mrc = new MissRatioCurve(&parent, 6, 1, 64);
+
+        dynarray<W64> low;
+        for (W64 line = 0; low.count() < 256; line++) {
+            if (MissRatioCurve::hash_of(line) < (mrc->threshold() >> 8))
+                low.push(line);
+        }
+
+        foreach (r, 4) {
+            foreach (i, low.count())
+                mrc->access(low[i] << 6, false);
+        }
+
+        ASSERT_GT(mrc->threshold(), W32(0));
+
+        W64 sampled = mrc->get_stats().sampled(user_stats);
+        foreach (i, low.count())
+            mrc->access(low[i] << 6, false);
+        ASSERT_GT(mrc->get_stats().sampled(user_stats), sampled);
+    }
+};
@@ -0,0 +1,253 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memoryHierarchy.h>
+#include <network.h>
+#include <machine.h>
+
+using namespace Memory;
+using namespace Memory::NetworkInterconnect;
+
+namespace {
+
+    /* Records the cycle of every message delivered to it */
+    class TestController : public Controller
+    {
+        public:
+            dynarray<W64> delivered;
+
+            TestController(W8 coreid, const char *name, MemoryHierarchy *mem)
+                : Controller(coreid, name, mem)
+            {}
+
+            bool handle_interconnect_cb(void *arg)
+            {
+                delivered.push(sim_cycle);
+                return true;
+            }
+
+            void register_interconnect(Interconnect *interconnect,
+                    int conn_type) {}
+            void print_map(ostream& os) {}
+            void print(ostream& os) const {}
+            bool is_full(bool fromInterconnect = false) const { return false; }
+            void annul_request(MemoryRequest *request) {}
+            void dump_configuration(YAML::Emitter &out) const {}
+    };
+
+    /* Routers reached by following route() from one tile to another */
+    template <typename Topology>
+    class TestNetwork : public Topology
+    {
+        public:
+            TestNetwork(const char *name, MemoryHierarchy *mem)
+                : Topology(name, mem)
+            {}
+
+            using Topology::route;
+            using Topology::get_link;
+
+            int path(int router, int dest_router, int *routers) const
+            {
+                int n = 0;
+                routers[n++] = router;
+                while (router != dest_router && n < 16) {
+                    router = get_link(route(router, dest_router)).to;
+                    routers[n++] = router;
+                }
+                return n;
+            }
+    };
+
+    class NetworkTest : public ::testing::Test
+    {
+        public:
+            BaseMachine *machine;
+            MemoryHierarchy *mem;
+            MemoryHierarchy *saved_mem;
+            W64 saved_cycle;
+
+            void SetUp()
+            {
+                machine = (BaseMachine*)PTLsimMachine::getmachine("base");
+                mem = new MemoryHierarchy(*machine);
+
+                /* Network events go to this hierarchy's queue */
+                saved_mem = machine->memoryHierarchyPtr;
+                machine->memoryHierarchyPtr = mem;
+                saved_cycle = sim_cycle;
+                sim_cycle = 0;
+            }
+
+            void TearDown()
+            {
+                machine->memoryHierarchyPtr = saved_mem;
+                sim_cycle = saved_cycle;
+            }
+
+            TestController* add_controller(Network *network, const char *name,
+                    int coreid)
+            {
+                TestController *cont = new TestController(coreid, name, mem);
+                network->register_controller(cont);
+                return cont;
+            }
+
+            void send(Network *network, Controller *from, Controller *to,
+                    bool data = false)
+            {
+                MemoryRequest *request = mem->get_free_request(0);
+                request->init(0, 0, 0x1000, 0, sim_cycle, false, 0, 0,
+                        MEMORY_OP_READ);
+
+                Message msg;
+                msg.init();
+                msg.sender = from;
+                msg.dest = to;
+                msg.request = request;
+                msg.hasData = data;
+                ASSERT_TRUE(network->controller_request_cb(&msg));
+            }
+
+            void run(int cycles)
+            {
+                foreach (i, cycles) {
+                    sim_cycle++;
+                    mem->clock();
+                }
+            }
+    };
+
+    /* XY routing goes along the row first, then along the column */
+    TEST_F(NetworkTest, MeshRoute)
+    {
+        machine->add_option("test_mesh", "width", 3);
+        machine->add_option("test_mesh", "height", 3);
+        TestNetwork<Mesh> mesh("test_mesh", mem);
+
+        int p[16];
+        int path[] = {0, 1, 2, 5, 8};
+        ASSERT_EQ(lengthof(path), mesh.path(0, 8, p));
+        foreach (i, lengthof(path))
+            ASSERT_EQ(path[i], p[i]);
+
+        int back[] = {7, 6, 3};
+        ASSERT_EQ(lengthof(back), mesh.path(7, 3, p));
+        foreach (i, lengthof(back))
+            ASSERT_EQ(back[i], p[i]);
+
+        foreach (i, 9)
+            ASSERT_FALSE(mesh.get_link(mesh.route(i, (i + 4) % 9)).wrap);
+    }
+
+    /* Packets take the shorter way around, only the 0 <-> N-1 link wraps */
+    TEST_F(NetworkTest, RingRoute)
+    {
+        machine->add_option("test_ring", "tiles", 6);
+        TestNetwork<Ring> ring("test_ring", mem);
+
+        int p[16];
+        int cw[] = {1, 2, 3};
+        ASSERT_EQ(lengthof(cw), ring.path(1, 3, p));
+        foreach (i, lengthof(cw))
+            ASSERT_EQ(cw[i], p[i]);
+
+        int ccw[] = {1, 0, 5};
+        ASSERT_EQ(lengthof(ccw), ring.path(1, 5, p));
+        foreach (i, lengthof(ccw))
+            ASSERT_EQ(ccw[i], p[i]);
+
+        /* Half way around goes clockwise */
+        ASSERT_EQ(4, ring.path(1, 4, p));
+        ASSERT_EQ(2, p[1]);
+
+        ASSERT_TRUE(ring.get_link(ring.route(0, 5)).wrap);
+        ASSERT_TRUE(ring.get_link(ring.route(5, 0)).wrap);
+        ASSERT_FALSE(ring.get_link(ring.route(1, 0)).wrap);
+        ASSERT_FALSE(ring.get_link(ring.route(4, 5)).wrap);
+    }
+
+    /*
+     * A packet holds its virtual channel until it moves on or is
+     * delivered, the next one waits for the channel to be released.
+     */
+    TEST_F(NetworkTest, VirtualChannels)
+    {
+        const int hop = 1 + 2;  // link latency and router delay
+
+        machine->add_option("test_vc_one", "tiles", 4);
+        machine->add_option("test_vc_one", "vcs", 2);
+        Ring one("test_vc_one", mem);
+        TestController *a = add_controller(&one, "vc_one_a", 0);
+        TestController *b = add_controller(&one, "vc_one_b", 1);
+
+        send(&one, a, b);
+        send(&one, a, b);
+        run(20);
+        ASSERT_EQ(2, b->delivered.count());
+        ASSERT_EQ(hop + 1, b->delivered[1] - b->delivered[0]);
+
+        /* With two channels per class only the link is shared */
+        machine->add_option("test_vc_two", "tiles", 4);
+        machine->add_option("test_vc_two", "vcs", 4);
+        Ring two("test_vc_two", mem);
+        TestController *c = add_controller(&two, "vc_two_c", 0);
+        TestController *d = add_controller(&two, "vc_two_d", 1);
+
+        send(&two, c, d);
+        send(&two, c, d);
+        run(20);
+        ASSERT_EQ(2, d->delivered.count());
+        ASSERT_EQ(1, d->delivered[1] - d->delivered[0]);
+    }
+
+    /*
+     * Past the dateline a packet uses the second class of channels, so a
+     * packet holding the only first class channel doesn't block it.
+     */
+    TEST_F(NetworkTest, RingDateline)
+    {
+        const int hop = 1 + 2;
+
+        machine->add_option("test_dateline", "tiles", 4);
+        machine->add_option("test_dateline", "vcs", 2);
+        Ring ring("test_dateline", mem);
+        TestController *t0 = add_controller(&ring, "dl_0", 0);
+        TestController *t1 = add_controller(&ring, "dl_1", 1);
+        add_controller(&ring, "dl_2", 2);
+        TestController *t3 = add_controller(&ring, "dl_3", 3);
+
+        /* A line from tile 0 holds the 0 -> 1 channel for 5 flits */
+        send(&ring, t0, t1, true);
+        /* 3 -> 0 -> 1 crosses the dateline on its first hop */
+        send(&ring, t3, t1);
+        run(30);
+
+        ASSERT_EQ(2, t1->delivered.count());
+        ASSERT_LT(t1->delivered[1] - t1->delivered[0], W64(hop + 1));
+    }
+
+    /* Entries of 'tile_map' can be separated by spaces or commas */
+    TEST_F(NetworkTest, TileMap)
+    {
+        machine->add_option("test_tiles", "tiles", 4);
+        machine->add_option("test_tiles", "tile_map",
+                "tm_L2_0:3,tm_L2_1:2 tm_MEM_0:1,");
+        Ring ring("test_tiles", mem);
+
+        Controller *l2_0 = add_controller(&ring, "tm_L2_0", 0);
+        Controller *l2_1 = add_controller(&ring, "tm_L2_1", 1);
+        Controller *mem_0 = add_controller(&ring, "tm_MEM_0", 0);
+        Controller *l2_2 = add_controller(&ring, "tm_L2_2", 2);
+        Controller *l2 = add_controller(&ring, "tm_L2", 1);
+
+        ASSERT_EQ(3, ring.get_tile(l2_0));
+        ASSERT_EQ(2, ring.get_tile(l2_1));
+        ASSERT_EQ(1, ring.get_tile(mem_0));
+
+        /* Unmapped controllers and name prefixes use the core id */
+        ASSERT_EQ(2, ring.get_tile(l2_2));
+        ASSERT_EQ(1, ring.get_tile(l2));
+    }
+};
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+
+#define OOO_CORE_NAME "ooo_test"
+#define OOO_CORE_MODEL ooo_test
+#include <ooo.cpp>
+#include <ooo-exec.cpp>
+#include <ooo-pipe.cpp>
+
+namespace {
+
+    typedef IssueQueue<ISSUE_QUEUE_SIZE> issueq_t;
+
+    class IssueQueueTest : public ::testing::Test
+    {
+        public:
+            issueq_t issueq;
+            issueq_t::tag_t operands[MAX_OPERANDS];
+            issueq_t::tag_t preready[MAX_OPERANDS];
+
+            void SetUp()
+            {
+                // reset() needs a core, so clear the state it would
+                issueq.count = 0;
+                issueq.valid = 0;
+                issueq.issued = 0;
+                issueq.allready = 0;
+                issueq.woken = 0;
+                issueq.uopids.reset();
+                foreach (i, MAX_OPERANDS) issueq.tags[i].reset();
+
+                foreach (i, MAX_OPERANDS) {
+                    operands[i] = 0;
+                    preready[i] = 1;
+                }
+            }
+    };
+
+    TEST_F(IssueQueueTest, WakeupOnBroadcast)
+    {
+        ASSERT_TRUE(issueq.insert(1, operands, preready));
+
+        operands[0] = 1;
+        preready[0] = 0;
+        ASSERT_TRUE(issueq.insert(2, operands, preready));
+
+        issueq.clock();
+        ASSERT_TRUE(issueq.woken[0]);
+        ASSERT_FALSE(issueq.woken[1]);
+
+        ASSERT_EQ(0, issueq.issue());
+        ASSERT_EQ(-1, issueq.issue());
+
+        issueq.remove(0);
+        issueq.broadcast(1);
+        issueq.clock();
+        ASSERT_TRUE(issueq.woken[0]);
+        ASSERT_EQ(0, issueq.issue());
+    }
+
+    /* A uop replayed in the cycle it issued is woken up again */
+    TEST_F(IssueQueueTest, ReplaySameCycle)
+    {
+        ASSERT_TRUE(issueq.insert(1, operands, preready));
+        ASSERT_TRUE(issueq.insert(2, operands, preready));
+
+        issueq.clock();
+        ASSERT_EQ(0, issueq.issue());
+        ASSERT_FALSE(issueq.allready[0]);
+
+        ASSERT_TRUE(issueq.replay(0, operands, preready));
+        ASSERT_EQ(1, issueq.issue(0));
+
+        issueq.clock();
+        ASSERT_TRUE(issueq.woken[0]);
+        ASSERT_FALSE(issueq.woken[1]);
+        ASSERT_EQ(0, issueq.issue());
+    }
+
+    typedef Queue<LoadStoreQueueEntry, LSQ_SIZE> lsq_t;
+
+    /* The plain walk the hash replaces: older entries, youngest first */
+    int scan_older(const lsq_t& LSQ, int idx, W64 physaddr, int range,
+            int *out)
+    {
+        int n = 0;
+        for (int i = idx; i != LSQ.head; ) {
+            i = add_index_modulo(i, -1, LSQ_SIZE);
+            const LoadStoreQueueEntry& e = LSQ[i];
+
+            if (e.addrvalid) {
+                if (e.lfence | e.sfence)
+                    continue;
+                W64 diff = max(W64(e.physaddr), physaddr) -
+                    min(W64(e.physaddr), physaddr);
+                if (diff <= W64(range))
+                    out[n++] = i;
+            } else if (e.store) {
+                out[n++] = i;
+            }
+        }
+        return n;
+    }
+
+    /*
+     * Random allocate, resolve, commit and annul sequences, checking
+     * older() against the plain walk for every entry after each step
+     */
+    TEST(LSQAddressHash, OlderMatchesScan)
+    {
+        lsq_t LSQ;
+        LSQAddressHash hash;
+        RandomNumberGenerator rng(7);
+
+        // A few granules, some in the same bucket, so lookups collide
+        W64 addrs[] = {0x100, 0x101, 0x102, 0x100 + LSQAddressHash::BUCKETS,
+            0x200, 0x201};
+
+        foreach (step, 5000) {
+            int op = rng.random32() % 8;
+
+            if (op < 3 && !LSQ.full()) {
+                LoadStoreQueueEntry* lsq = LSQ.alloc();
+                lsq->reset();
+                lsq->validate();
+                lsq->store = rng.random32() & 1;
+                lsq->sfence = (rng.random32() % 8) == 0;
+                lsq->addrvalid = 0;
+                hash.update(*lsq);
+            } else if (op < 6 && !LSQ.empty()) {
+                // Resolve a random entry's address
+                int i = add_index_modulo(LSQ.head,
+                        rng.random32() % LSQ.count, LSQ_SIZE);
+                LSQ[i].addrvalid = 1;
+                LSQ[i].physaddr = addrs[rng.random32() % lengthof(addrs)];
+                hash.update(LSQ[i]);
+            } else if (op == 6 && !LSQ.empty()) {
+                LoadStoreQueueEntry* lsq = LSQ.peekhead();
+                hash.remove(lsq->index());
+                lsq->reset();
+                LSQ.commit(lsq);
+            } else if (!LSQ.empty()) {
+                LoadStoreQueueEntry* lsq = LSQ.peektail();
+                hash.remove(lsq->index());
+                lsq->reset();
+                LSQ.annul(lsq);
+            }
+
+            foreach (k, LSQ.count) {
+                int i = add_index_modulo(LSQ.head, k, LSQ_SIZE);
+                W64 physaddr = addrs[rng.random32() % lengthof(addrs)];
+                int range = rng.random32() & 1;
+
+                int expect[LSQ_SIZE], got[LSQ_SIZE];
+                int n = scan_older(LSQ, i, physaddr, range, expect);
+                ASSERT_EQ(n, hash.older(LSQ, i, physaddr, range, got));
+                foreach (j, n) ASSERT_EQ(expect[j], got[j]);
+            }
+        }
+    }
+};
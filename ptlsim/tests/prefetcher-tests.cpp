@@ -0,0 +1,202 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <prefetcher.h>
+
+using namespace Memory;
+
+namespace {
+
+    /* 64 byte lines, prefetch addresses below are in line units */
+    const W64 BASE_LINE = 0x40000;
+    const W64 RIP       = 0x400123;
+
+    W64 addr_of(W64 line) { return line << 6; }
+
+    class PrefetcherTest : public ::testing::Test
+    {
+        public:
+            PrefetcherTest()
+                : parent("prefetcher_test")
+                  , pf(NULL)
+            {}
+
+            ~PrefetcherTest()
+            {
+                if (pf) delete pf;
+            }
+
+            void create(const char *type)
+            {
+                pf = PrefetcherBuilder::create_prefetcher(type, &parent,
+                        config);
+            }
+
+            void miss(W64 line, W64 rip = RIP)
+            {
+                pf->access(addr_of(line), rip, false, false);
+            }
+
+            /* Issue and fill everything queued, lines in issue order */
+            int drain()
+            {
+                int count = 0;
+                W64 addr;
+                while (pf->next_prefetch(addr, true, false)) {
+                    if (count < lengthof(lines))
+                        lines[count] = addr >> 6;
+                    count++;
+                    pf->prefetch_complete(addr, true, false);
+                }
+                return count;
+            }
+
+            Statable parent;
+            PrefetcherConfig config;
+            Prefetcher *pf;
+            W64 lines[16];
+    };
+
+    TEST_F(PrefetcherTest, Registered)
+    {
+        const char *names[] = {"next_line", "stride", "stream", "delta"};
+
+        foreach (i, lengthof(names)) {
+            Prefetcher *p = PrefetcherBuilder::create_prefetcher(names[i],
+                    &parent, config);
+            ASSERT_TRUE(p != NULL);
+            ASSERT_STREQ(names[i], p->get_name());
+            delete p;
+        }
+    }
+
+    TEST_F(PrefetcherTest, StrideNeedsConfidence)
+    {
+        create("stride");
+
+        /* Stride of four lines, from one instruction */
+        miss(BASE_LINE);
+        miss(BASE_LINE + 4);
+        miss(BASE_LINE + 8);
+        ASSERT_EQ(0, drain());
+
+        miss(BASE_LINE + 12);
+        ASSERT_EQ(2, drain());
+        ASSERT_EQ(BASE_LINE + 16, lines[0]);
+        ASSERT_EQ(BASE_LINE + 20, lines[1]);
+
+        /* Other instructions have their own entries */
+        miss(BASE_LINE + 30, RIP + 7);
+        ASSERT_EQ(0, drain());
+    }
+
+    TEST_F(PrefetcherTest, StreamRunsAhead)
+    {
+        create("stream");
+
+        miss(BASE_LINE);
+        miss(BASE_LINE + 1);
+        ASSERT_EQ(0, drain());
+
+        miss(BASE_LINE + 2);
+        ASSERT_EQ(2, drain());
+        ASSERT_EQ(BASE_LINE + 3, lines[0]);
+        ASSERT_EQ(BASE_LINE + 4, lines[1]);
+
+        /* Hits on prefetched lines keep the stream going */
+        pf->access(addr_of(BASE_LINE + 3), RIP, true, false);
+        ASSERT_EQ(2, drain());
+        ASSERT_EQ(BASE_LINE + 5, lines[0]);
+        ASSERT_EQ(BASE_LINE + 6, lines[1]);
+
+        /* Descending streams are detected too */
+        miss(BASE_LINE + 40);
+        miss(BASE_LINE + 39);
+        miss(BASE_LINE + 38);
+        ASSERT_EQ(2, drain());
+        ASSERT_EQ(BASE_LINE + 37, lines[0]);
+        ASSERT_EQ(BASE_LINE + 36, lines[1]);
+    }
+
+    TEST_F(PrefetcherTest, DeltaReplaysPattern)
+    {
+        create("delta");
+
+        /* Deltas 1, 2, 1, 2 */
+        miss(BASE_LINE);
+        miss(BASE_LINE + 1);
+        miss(BASE_LINE + 3);
+        miss(BASE_LINE + 4);
+        ASSERT_EQ(0, drain());
+
+        miss(BASE_LINE + 6);
+        ASSERT_EQ(2, drain());
+        ASSERT_EQ(BASE_LINE + 7, lines[0]);
+        ASSERT_EQ(BASE_LINE + 9, lines[1]);
+    }
+
+    TEST_F(PrefetcherTest, StaysInPage)
+    {
+        create("next_line");
+
+        /* Last line of a 4K page */
+        miss(BASE_LINE + 63);
+        ASSERT_EQ(0, drain());
+    }
+
+    TEST_F(PrefetcherTest, BoundedQueueAndInflight)
+    {
+        config.degree       = 4;
+        config.queue_size   = 2;
+        config.max_inflight = 1;
+        create("next_line");
+
+        /* Only the two newest candidates are kept */
+        miss(BASE_LINE);
+        ASSERT_EQ(2, pf->get_queued());
+
+        W64 addr;
+        ASSERT_TRUE(pf->next_prefetch(addr, true, false));
+        ASSERT_EQ(addr_of(BASE_LINE + 3), addr);
+        ASSERT_FALSE(pf->next_prefetch(addr, true, false));
+        ASSERT_EQ(1, pf->get_inflight());
+
+        pf->prefetch_complete(addr_of(BASE_LINE + 3), true, false);
+        ASSERT_EQ(0, pf->get_inflight());
+
+        /* Controller without room holds prefetches back */
+        ASSERT_FALSE(pf->next_prefetch(addr, false, false));
+        ASSERT_TRUE(pf->next_prefetch(addr, true, false));
+        ASSERT_EQ(addr_of(BASE_LINE + 4), addr);
+
+        /* Already prefetched lines are not requested again */
+        pf->prefetch_complete(addr, true, false);
+        miss(BASE_LINE + 2);
+        ASSERT_EQ(2, pf->get_queued());
+        ASSERT_TRUE(pf->next_prefetch(addr, true, false));
+        ASSERT_EQ(addr_of(BASE_LINE + 5), addr);
+    }
+
+    TEST_F(PrefetcherTest, ThrottlesInaccurate)
+    {
+        config.degree = 4;
+        create("next_line");
+        ASSERT_EQ(4, pf->get_degree());
+
+        /* Misses every eight lines never touch the prefetched ones */
+        foreach (i, 32) {
+            miss(BASE_LINE + i * 8);
+            drain();
+        }
+        ASSERT_EQ(3, pf->get_degree());
+
+        /* Sequential misses use every prefetch, degree recovers */
+        foreach (i, 256) {
+            pf->access(addr_of(BASE_LINE + 0x1000 + i), RIP, false, false);
+            drain();
+        }
+        ASSERT_EQ(4, pf->get_degree());
+    }
+};
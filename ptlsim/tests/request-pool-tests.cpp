@@ -0,0 +1,76 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memoryRequest.h>
+
+using namespace Memory;
+
+namespace {
+
+    /* Requests go back to the free list when the last reference drops */
+    TEST(RequestPool, ReleaseOnLastReference)
+    {
+        RequestPool pool;
+        MemoryRequest* req = pool.get_free_request();
+
+        req->incRefCounter();
+        req->incRefCounter();
+        ASSERT_EQ(1, pool.used_list().count);
+
+        req->decRefCounter();
+        ASSERT_EQ(1, pool.used_list().count);
+
+        req->decRefCounter();
+        ASSERT_EQ(0, pool.used_list().count);
+    }
+
+    /* Pool grows by a slab instead of running out */
+    TEST(RequestPool, GrowsWhenExhausted)
+    {
+        RequestPool pool;
+        int count = REQUEST_POOL_SIZE * 3 + 10;
+
+        foreach (i, count) {
+            MemoryRequest* req = pool.get_free_request();
+            req->incRefCounter();
+        }
+
+        ASSERT_EQ(count, pool.used_list().count);
+        ASSERT_EQ(count, pool.get_high_water());
+        ASSERT_EQ(REQUEST_POOL_SIZE * 4, pool.get_size());
+    }
+
+    /* Never-referenced requests are recovered before the pool grows */
+    TEST(RequestPool, CollectsUnreferenced)
+    {
+        RequestPool pool;
+
+        foreach (i, REQUEST_POOL_SIZE * 3) {
+            pool.get_free_request();
+        }
+
+        ASSERT_EQ(REQUEST_POOL_SIZE, pool.get_size());
+    }
+
+    /* A request referenced again after release is not handed out twice */
+    TEST(RequestPool, SkipsResurrected)
+    {
+        RequestPool pool;
+        MemoryRequest* req = pool.get_free_request();
+        req->incRefCounter();
+        req->decRefCounter();
+
+        req->incRefCounter();
+
+        foreach (i, REQUEST_POOL_SIZE * 2) {
+            MemoryRequest* other = pool.get_free_request();
+            ASSERT_NE(req, other);
+            other->incRefCounter();
+        }
+
+        req->decRefCounter();
+        ASSERT_EQ(REQUEST_POOL_SIZE * 2, pool.used_list().count);
+    }
+};
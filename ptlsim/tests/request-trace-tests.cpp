@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memoryRequest.h>
+#include <memoryRequestTrace.h>
+
+#include <sstream>
+
+using namespace Memory;
+
+namespace {
+
+    struct TestUnit
+    {
+        const char *get_name() const { return "L1_D_0"; }
+    };
+
+    /* Reads back everything but the name records */
+    int read_events(std::stringstream& ss, MemoryRequestTraceEvent *events,
+            int max)
+    {
+        MemoryRequestTraceHeader header;
+        ss.read((char*)&header, sizeof(header));
+        if (header.magic != MEM_REQ_TRACE_MAGIC ||
+                header.event_size != sizeof(MemoryRequestTraceEvent))
+            return -1;
+
+        int count = 0;
+        MemoryRequestTraceEvent ev;
+        while (count < max && ss.read((char*)&ev, sizeof(ev))) {
+            if (ev.event == MEM_REQ_TRACE_NAME) {
+                char name[64];
+                ss.read(name, ev.arg);
+                continue;
+            }
+            events[count++] = ev;
+        }
+        return count;
+    }
+
+    /* Only matching requests and their copies are traced */
+    TEST(MemoryRequestTrace, Filter)
+    {
+        std::stringstream ss;
+        MemoryRequestTraceFilter filter;
+        filter.coreid = 1;
+        filter.addr_start = 0x1000;
+        filter.addr_end = 0x2000;
+        mem_req_tracer.start(ss, filter);
+
+        RequestPool pool;
+        TestUnit unit;
+
+        MemoryRequest *other_core = pool.get_free_request();
+        other_core->init(0, 0, 0x1040, 0, 0, false, 0, 0, MEMORY_OP_READ);
+
+        MemoryRequest *other_addr = pool.get_free_request();
+        other_addr->init(1, 0, 0x3000, 0, 0, false, 0, 0, MEMORY_OP_READ);
+
+        MemoryRequest *traced = pool.get_free_request();
+        traced->init(1, 0, 0x1040, 0, 0, true, 0, 0, MEMORY_OP_READ);
+
+        MemoryRequest *copy = pool.get_free_request();
+        copy->init(traced);
+
+        ASSERT_EQ(0, other_core->get_trace_id());
+        ASSERT_EQ(0, other_addr->get_trace_id());
+        ASSERT_EQ(1, traced->get_trace_id());
+        ASSERT_EQ(2, copy->get_trace_id());
+
+        mem_req_trace(other_core, MEM_REQ_TRACE_LOOKUP, &unit, W64(1));
+        mem_req_trace(traced, MEM_REQ_TRACE_LOOKUP, &unit, W64(1));
+        mem_req_trace(copy, MEM_REQ_TRACE_SEND, &unit, (void*)&pool);
+
+        copy->incRefCounter();
+        copy->decRefCounter();
+        mem_req_tracer.stop();
+
+        MemoryRequestTraceEvent events[8];
+        ASSERT_EQ(5, read_events(ss, events, 8));
+
+        ASSERT_EQ(MEM_REQ_TRACE_ALLOC, events[0].event);
+        ASSERT_EQ(1, events[0].id);
+        ASSERT_EQ(0x1040, events[0].addr);
+        ASSERT_EQ(1, events[0].coreid);
+        ASSERT_EQ(MEMORY_OP_READ | MEM_REQ_TRACE_IFETCH, events[0].optype);
+
+        ASSERT_EQ(MEM_REQ_TRACE_ALLOC, events[1].event);
+        ASSERT_EQ(2, events[1].id);
+        ASSERT_EQ(1, events[1].arg);
+
+        ASSERT_EQ(MEM_REQ_TRACE_LOOKUP, events[2].event);
+        ASSERT_EQ(1, events[2].id);
+        ASSERT_EQ(0, events[2].unit);
+        ASSERT_EQ(1, events[2].arg);
+
+        ASSERT_EQ(MEM_REQ_TRACE_SEND, events[3].event);
+        ASSERT_EQ(0, events[3].unit);
+        ASSERT_EQ(1, events[3].peer);
+
+        ASSERT_EQ(MEM_REQ_TRACE_FREE, events[4].event);
+        ASSERT_EQ(2, events[4].id);
+        ASSERT_EQ(MEM_REQ_TRACE_NO_UNIT, events[4].unit);
+    }
+};
@@ -0,0 +1,102 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <shadowTags.h>
+
+using namespace Memory;
+
+namespace {
+
+    /* 64 byte lines, addresses below are in line units */
+    W64 addr_of(W64 line) { return line << 6; }
+
+    class ShadowTagsTest : public ::testing::Test
+    {
+        public:
+            ShadowTagsTest()
+                : parent("shadow_test")
+            {}
+
+            Statable parent;
+    };
+
+    TEST_F(ShadowTagsTest, LRUKeepsRecentlyUsed)
+    {
+        ShadowTags lru("lru", &parent, 1, 2, 64, SHADOW_LRU);
+        ShadowTags fifo("fifo", &parent, 1, 2, 64, SHADOW_FIFO);
+
+        W64 lines[] = {0, 1, 0, 2, 0};
+        foreach (i, lengthof(lines)) {
+            lru.access(addr_of(lines[i]), false, false);
+            fifo.access(addr_of(lines[i]), false, false);
+        }
+
+        /* Line 1 was least recently used, line 0 the first filled */
+        ASSERT_TRUE(lru.probe(addr_of(0)));
+        ASSERT_FALSE(lru.probe(addr_of(1)));
+        ASSERT_TRUE(fifo.probe(addr_of(2)));
+        ASSERT_TRUE(fifo.probe(addr_of(0)));
+        ASSERT_FALSE(fifo.probe(addr_of(1)));
+    }
+
+    TEST_F(ShadowTagsTest, PseudoLRU)
+    {
+        ShadowTags plru("plru", &parent, 1, 4, 64, SHADOW_PLRU);
+
+        foreach (i, 4)
+            plru.access(addr_of(i), false, false);
+
+        /* Filling the last way cleared the others, 0 is the victim */
+        plru.access(addr_of(3), false, false);
+        plru.access(addr_of(4), false, false);
+        ASSERT_FALSE(plru.probe(addr_of(0)));
+        ASSERT_TRUE(plru.probe(addr_of(3)));
+    }
+
+    TEST_F(ShadowTagsTest, SetsAndDirtyLines)
+    {
+        ShadowTags tags("tags", &parent, 2, 1, 64, SHADOW_LRU);
+
+        /* Lines 0 and 1 go to different sets */
+        ASSERT_FALSE(tags.access(addr_of(0), true, false));
+        ASSERT_FALSE(tags.access(addr_of(1), false, false));
+        ASSERT_TRUE(tags.access(addr_of(0), false, false));
+
+        /* Line 2 replaces dirty line 0, then 1 gets a write back */
+        tags.access(addr_of(2), false, false);
+        tags.update(addr_of(1), false);
+        tags.update(addr_of(5), false);
+        tags.access(addr_of(3), false, false);
+
+        const ShadowStats &stats = tags.get_stats();
+        ASSERT_EQ(W64(4), stats.misses(user_stats));
+        ASSERT_EQ(W64(1), stats.read_hit(user_stats));
+        ASSERT_EQ(W64(1), stats.update_hit(user_stats));
+        ASSERT_EQ(W64(2), stats.evictions(user_stats));
+        ASSERT_EQ(W64(3), stats.writebacks(user_stats));
+
+        tags.invalidate(addr_of(2));
+        ASSERT_FALSE(tags.probe(addr_of(2)));
+        ASSERT_TRUE(tags.probe(addr_of(3)));
+    }
+
+    TEST_F(ShadowTagsTest, ParseSpec)
+    {
+        ShadowTagSet set;
+
+        ASSERT_TRUE(set.parse("4096x16:random, 1024x8,64x4:plru", &parent,
+                    64));
+        ASSERT_EQ(3, set.count());
+        ASSERT_EQ(4096, set.get(0)->sets());
+        ASSERT_EQ(SHADOW_RANDOM, set.get(0)->policy());
+        ASSERT_EQ(8, set.get(1)->ways());
+        ASSERT_EQ(SHADOW_LRU, set.get(1)->policy());
+        ASSERT_EQ(SHADOW_PLRU, set.get(2)->policy());
+
+        ShadowTagSet bad;
+        ASSERT_FALSE(bad.parse("4096", &parent, 64));
+        ASSERT_FALSE(bad.parse("64x4:mru", &parent, 64));
+    }
+};
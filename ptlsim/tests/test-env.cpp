@@ -0,0 +1,28 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <statsBuilder.h>
+
+namespace {
+
+    /*
+     * Stats of the controllers and predictors built by the tests are
+     * read from user_stats and kernel_stats, which the simulator only
+     * creates once a machine is configured.
+     */
+    class StatsEnvironment : public ::testing::Environment
+    {
+        public:
+            void SetUp()
+            {
+                if (!user_stats)
+                    user_stats = StatsBuilder::get().get_new_stats();
+                if (!kernel_stats)
+                    kernel_stats = StatsBuilder::get().get_new_stats();
+            }
+    };
+
+    ::testing::Environment* const stats_env =
+        ::testing::AddGlobalTestEnvironment(new StatsEnvironment);
+};
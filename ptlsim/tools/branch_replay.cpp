@@ -0,0 +1,234 @@
+/*
+ * branch_replay.cpp : Replay a committed branch trace through predictors
+ *
+ * Reads a trace written by Marss's -branch-trace option and runs every
+ * committed branch through the listed branch predictors, exactly as the
+ * shadow predictors of a core do (see 'shadow_branchpred'). Each thread in
+ * the trace gets its own copy of every predictor, and the stats come out
+ * in the same form as the core's:
+ *
+ *   core_0:
+ *     thread0:
+ *       commit: { insns }
+ *       branchpred:
+ *         shadow_<name>: { cond, indir, ret, summary:
+ *                          { branches, mispred, mispred_rate, mpki } }
+ *
+ * Usage:
+ *    branch_replay [-p predictors] [-stats file] [-text] trace
+ *
+ *    -p       Predictors to replay, as in shadow_branchpred, for example
+ *             "combined, tage_sc_l:table_bits=9, perceptron"
+ *    -stats   Write the stats to file instead of stdout
+ *    -text    Flat text stats instead of YAML
+ *
+ * It is built with Marss into ptlsim/build/tools/branch_replay.
+ */
+
+#include <ptlsim.h>
+#include <machine.h>
+#include <branchpred.h>
+#include <branchtrace.h>
+#include <statsBuilder.h>
+
+#include <sys/time.h>
+
+/* Globals the predictors and stats expect from the simulator */
+ConfigurationParser<PTLsimConfig> config;
+ofstream ptl_logfile;
+bool logenable = 0;
+W64 sim_cycle = 0;
+Stats *user_stats;
+Stats *kernel_stats;
+Stats *global_stats;
+
+template <>
+void ConfigurationParser<PTLsimConfig>::reset()
+{
+    loglevel = 0;
+}
+
+/* There is no machine here, predictors come from the command line */
+bool BaseMachine::get_option(const char*, const char*, bool&) { return false; }
+bool BaseMachine::get_option(const char*, const char*, int&) { return false; }
+bool BaseMachine::get_option(const char*, const char*, stringbuf&) { return false; }
+
+struct ReplayCommitStats : public Statable
+{
+    StatObj<W64> insns;
+
+    ReplayCommitStats(Statable *parent)
+        : Statable("commit", parent)
+          , insns("insns", this)
+    { }
+};
+
+/* Stats and predictors of one thread of the trace */
+struct ReplayThread : public Statable
+{
+    ReplayCommitStats commit;
+    Statable branchpred;
+    ShadowBranchPredictors predictors;
+    W64 uuid;
+    bool kernel;
+
+    ReplayThread(Statable *core, W16 threadid)
+        : Statable("thread", core)
+          , commit(this)
+          , branchpred("branchpred", this)
+          , uuid(0)
+          , kernel(false)
+    {
+        stringbuf name;
+        name << "thread" << threadid;
+        update_name(name.buf);
+        set_default_stats(user_stats);
+    }
+};
+
+static dynarray<Statable*> replay_cores;
+static dynarray<ReplayThread*> replay_threads;
+
+static Statable* get_core(W16 coreid)
+{
+    stringbuf name;
+    name << "core_" << coreid;
+
+    foreach (i, replay_cores.count()) {
+        if (strcmp(replay_cores[i]->get_name(), name.buf) == 0)
+            return replay_cores[i];
+    }
+
+    Statable *core = new Statable(name.buf);
+    core->set_default_stats(user_stats);
+    replay_cores.push(core);
+    return core;
+}
+
+static void usage()
+{
+    cerr << "Usage: branch_replay [-p predictors] [-stats file] [-text] "
+         << "trace" << endl;
+    exit(1);
+}
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+int main(int argc, char** argv)
+{
+    const char *spec = "combined";
+    const char *stats_file = NULL;
+    const char *trace_file = NULL;
+    bool text = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            spec = argv[++i];
+        } else if (strcmp(argv[i], "-stats") == 0 && i + 1 < argc) {
+            stats_file = argv[++i];
+        } else if (strcmp(argv[i], "-text") == 0) {
+            text = true;
+        } else if (argv[i][0] != '-' && !trace_file) {
+            trace_file = argv[i];
+        } else {
+            usage();
+        }
+    }
+
+    if (!trace_file)
+        usage();
+
+    std::ifstream is(trace_file, std::ios::binary);
+    if (!is) {
+        cerr << "branch_replay: can't open " << trace_file << endl;
+        return 1;
+    }
+
+    BranchTraceReader reader(is);
+    if (!reader.valid()) {
+        cerr << "branch_replay: " << trace_file << " is not a branch trace"
+             << endl;
+        return 1;
+    }
+
+    StatsBuilder &builder = StatsBuilder::get();
+    user_stats = builder.get_new_stats();
+    kernel_stats = builder.get_new_stats();
+    global_stats = builder.get_new_stats();
+
+    BranchTraceRecord rec;
+    PredictorUpdate predinfo;
+    W64 branches = 0;
+    double start = now();
+    int s;
+
+    while ((s = reader.next(rec)) >= 0) {
+        if unlikely (s == replay_threads.count()) {
+            const BranchTraceReader::Stream &stream = reader.streams[s];
+            ReplayThread *t = new ReplayThread(get_core(stream.coreid),
+                    stream.threadid);
+
+            if (!t->predictors.add(spec, &t->branchpred, &t->commit.insns,
+                        stream.coreid, stream.threadid)) {
+                cerr << "branch_replay: invalid predictors '" << spec << "'"
+                     << endl;
+                return 1;
+            }
+
+            replay_threads.push(t);
+        }
+
+        ReplayThread &t = *replay_threads[s];
+
+        // Count into user or kernel stats as the core would have
+        if unlikely (rec.kernel != t.kernel) {
+            t.kernel = rec.kernel;
+            t.set_default_stats(t.kernel ? kernel_stats : user_stats);
+        }
+
+        t.commit.insns += rec.insns;
+
+        memset(&predinfo, 0, sizeof(predinfo));
+        predinfo.uuid = t.uuid++;
+        predinfo.flags = rec.type;
+        t.predictors.commit(predinfo, rec.branchaddr, rec.riptaken,
+                rec.target);
+        branches++;
+    }
+
+    double elapsed = now() - start;
+
+    *global_stats += *user_stats;
+    *global_stats += *kernel_stats;
+
+    cerr << "branch_replay: " << branches << " branches of "
+         << replay_threads.count() << " threads in " << elapsed << " s ("
+         << (elapsed > 0 ? branches / elapsed / 1e6 : 0) << "M/s)" << endl;
+
+    std::ofstream out;
+    if (stats_file)
+        out.open(stats_file);
+    ostream &os = (stats_file) ? out : cout;
+
+    if (text) {
+        builder.dump(user_stats, os, "user.");
+        builder.dump(kernel_stats, os, "kernel.");
+        builder.dump(global_stats, os, "total.");
+    } else {
+        YAML::Emitter k_out, u_out, g_out;
+        builder.dump(kernel_stats, k_out);
+        os << k_out.c_str() << "\n";
+        builder.dump(user_stats, u_out);
+        os << u_out.c_str() << "\n";
+        builder.dump(global_stats, g_out);
+        os << g_out.c_str() << "\n";
+    }
+
+    os.flush();
+    return 0;
+}
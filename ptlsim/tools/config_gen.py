@@ -157,10 +157,15 @@ cache_case_stmt = '''
             return new %s(%s_READ_PORTS, %s_WRITE_PORTS);
 '''
 
+cache_name_stmt = '''
+    if (strcmp(name, "%s") == 0) return %s;
+'''
+
 cache_line_func = '''
 namespace Memory {
     struct CacheLinesBase;
     CacheLinesBase* get_cachelines(int type);
+    int get_cache_type(const char* name);
 };
 '''
 
@@ -718,6 +723,14 @@ def generate_cache_logic(config, options):
                 typedefs[cache], cache.upper(), cache.upper()))
         of.write("\t\tdefault: assert(0);\n\t}\n")
         of.write("}\n")
+
+        # And 'get_cache_type' to find a type by its name in the config
+        of.write("\nint get_cache_type(const char* name)\n")
+        of.write("{\n")
+        for cache in config["cache"].keys():
+            of.write(cache_name_stmt % (cache, cache.upper()))
+        of.write("\treturn -1;\n")
+        of.write("}\n")
         of.write("};\n")
 
 def gen_output_file(config, options):
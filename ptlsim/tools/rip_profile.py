@@ -0,0 +1,96 @@
+#!/usr/bin/env python
+#
+# Reader for the binary per-RIP profile written by the '-rip-profile' option.
+#
+# Usage: rip_profile.py [-e guest-elf] [-n top] <profile-file>
+#
+# With '-e' every RIP is symbolized using addr2line against the given guest
+# binary (kernel vmlinux or a user program).
+
+from __future__ import print_function
+
+import optparse
+import struct
+import subprocess
+import sys
+
+MAGIC = 0x31464f5250504952
+HEADER = struct.Struct('<QIHHIIQQ')
+
+STALL_NAMES = ['frontend', 'dtlb', 'l2d', 'l1d', 'dhit', 'longlat', 'backend']
+MISS_NAMES = ['itlb', 'l1i', 'l2i', 'dtlb', 'l1d', 'l2d']
+
+
+def read_profiles(f):
+    while True:
+        buf = f.read(HEADER.size)
+        if len(buf) < HEADER.size:
+            return
+        (magic, version, core, thread, nstalls, nmisses, count,
+                cycles) = HEADER.unpack(buf)
+        if magic != MAGIC:
+            raise ValueError("Not a RIP profile (bad magic %x)" % magic)
+
+        entry = struct.Struct('<%dQ' % (4 + nstalls + nmisses))
+        entries = []
+        for i in range(count):
+            v = entry.unpack(f.read(entry.size))
+            entries.append({
+                'rip' : v[0],
+                'insns' : v[1],
+                'uops' : v[2],
+                'mispredicts' : v[3],
+                'stalls' : v[4:4 + nstalls],
+                'misses' : v[4 + nstalls:],
+                })
+        yield core, thread, cycles, entries
+
+
+def symbolize(elf, rips):
+    if not elf or not rips:
+        return {}
+    args = ['addr2line', '-f', '-C', '-e', elf]
+    p = subprocess.Popen(args, stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+            universal_newlines=True)
+    out, _ = p.communicate('\n'.join(['%x' % r for r in rips]) + '\n')
+    lines = out.splitlines()
+    syms = {}
+    for i, rip in enumerate(rips):
+        func, loc = lines[2 * i], lines[2 * i + 1]
+        syms[rip] = "%s (%s)" % (func, loc)
+    return syms
+
+
+def main():
+    opt = optparse.OptionParser("%prog [options] <profile-file>")
+    opt.add_option('-e', '--elf', dest='elf', default=None,
+            help="Guest ELF used to symbolize RIPs")
+    opt.add_option('-n', '--top', dest='top', type='int', default=50,
+            help="Number of RIPs to print per thread (0 for all)")
+    (options, args) = opt.parse_args()
+
+    if len(args) != 1:
+        opt.print_help()
+        sys.exit(1)
+
+    f = open(args[0], 'rb')
+    for core, thread, cycles, entries in read_profiles(f):
+        if options.top:
+            entries = entries[:options.top]
+        syms = symbolize(options.elf, [e['rip'] for e in entries])
+
+        print("Core %d thread %d: %d cycles" % (core, thread, cycles))
+        print("%-18s %8s %10s %6s  %s  %s" % ("rip", "stall%", "insns",
+            "mispr", "  ".join(STALL_NAMES), "  ".join(MISS_NAMES)))
+        for e in entries:
+            total = sum(e['stalls'])
+            print("%-18x %7.2f%% %10d %6d  %s  %s  %s" % (e['rip'],
+                100.0 * total / max(cycles, 1), e['insns'], e['mispredicts'],
+                " ".join([str(s) for s in e['stalls']]),
+                " ".join([str(m) for m in e['misses']]),
+                syms.get(e['rip'], '')))
+        print()
+
+
+if __name__ == "__main__":
+    main()
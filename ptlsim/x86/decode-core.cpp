@@ -8,6 +8,7 @@
 #include <globals.h>
 #include <ptlsim.h>
 #include <decode.h>
+#include <hostprof.h>
 
 #include <setjmp.h>
 
@@ -1965,7 +1966,9 @@ bool assist_exec_page_fault(Context& ctx) {
     Waddr bbcache_rip = ctx.reg_ar2;
 
     ctx.eip = ctx.reg_selfrip;
-    assert(bbcache[ctx.cpu_index].invalidate(RIPVirtPhys(bbcache_rip).update(ctx), INVALIDATE_REASON_SPURIOUS));
+    bool ok = bbcache[ctx.cpu_index].invalidate(RIPVirtPhys(bbcache_rip).update(ctx), INVALIDATE_REASON_SPURIOUS);
+    assert(ok);
+    (void)ok;
     ctx.handle_page_fault(faultaddr, 2);
 
     return true;
@@ -2355,6 +2358,7 @@ BasicBlock* BasicBlockCache::translate(Context& ctx, const RIPVirtPhys& rvp) {
     bb = NULL;
 
     translate_timer.start();
+    host_profile_scope(HOSTPROF_DECODE);
 
     byte insnbuf[MAX_BB_BYTES];
 
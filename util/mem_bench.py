@@ -0,0 +1,111 @@
+#!/usr/bin/env python
+
+# mem_bench.py
+#
+# Compare the host performance of the memory hierarchy between two builds.
+# Each build writes its results with the '-mem-bench' simconfig option, for
+# example:
+#
+#   echo "-mem-bench new.yml" > mem_bench.simcfg
+#   qemu/qemu-system-x86_64 -simconfig mem_bench.simcfg -nographic
+#
+# No -machine or disk image is needed: the simulator builds a p2p, a bus
+# and a switch hierarchy (private L1s and L2, shared L3) itself, times their
+# caches, interconnects and memory controllers on a set of synthetic
+# patterns (L1 hits, streaming, sharing and random DRAM traffic), records
+# host nanoseconds per simulated request and cycle, and exits. Then:
+#
+#   mem_bench.py [--threshold 5] base.yml new.yml
+#
+# Exits with 1 if any pattern of any hierarchy got slower per request by
+# more than the threshold in percent.
+#
+
+import os
+import sys
+
+from optparse import OptionParser
+
+try:
+    import yaml
+except (ImportError, NotImplementedError):
+    path = os.path.dirname(sys.argv[0])
+    a_path = os.path.abspath(path)
+    sys.path.append("%s/../ptlsim/lib/python" % a_path)
+    import yaml
+
+def load(filename):
+    with open(filename) as f:
+        doc = yaml.safe_load(f)
+
+    hierarchies = {}
+    for h in doc['hierarchies']:
+        hierarchies[h['name']] = h
+
+    return doc, hierarchies
+
+def compare_patterns(base, new, threshold):
+    base_patterns = {}
+    for p in base['patterns']:
+        base_patterns[p['name']] = p
+    regressed = False
+
+    print("%s, %d cores" % (new['name'], new['cores']))
+    print("  %-12s %12s %12s %8s %12s" % ("pattern", "base ns/req",
+        "new ns/req", "change", "new ns/cyc"))
+
+    for p in new['patterns']:
+        name = p['name']
+        if name not in base_patterns:
+            print("  %-12s %12s %12.1f %8s %12.1f" % (name, "-",
+                p['ns_per_request'], "-", p['ns_per_cycle']))
+            continue
+
+        b = base_patterns[name]
+        change = 100.0 * (p['ns_per_request'] / b['ns_per_request'] - 1)
+        flag = ""
+        if change > threshold:
+            flag = "  SLOWER"
+            regressed = True
+
+        if b['requests'] != p['requests'] or b['cycles'] != p['cycles']:
+            flag += "  (simulated %d cycles, was %d)" % (p['cycles'],
+                    b['cycles'])
+
+        print("  %-12s %12.1f %12.1f %+7.1f%% %12.1f%s" % (name,
+            b['ns_per_request'], p['ns_per_request'], change,
+            p['ns_per_cycle'], flag))
+
+    return regressed
+
+def compare(base_file, new_file, threshold):
+    base, base_hierarchies = load(base_file)
+    new, new_hierarchies = load(new_file)
+    regressed = False
+
+    if base['max_misses'] != new['max_misses']:
+        print("Note: max_misses was %d, now %d" % (base['max_misses'],
+            new['max_misses']))
+
+    for h in new['hierarchies']:
+        if h['name'] not in base_hierarchies:
+            print("%s: not in %s" % (h['name'], base_file))
+            continue
+
+        if compare_patterns(base_hierarchies[h['name']], h, threshold):
+            regressed = True
+
+    return regressed
+
+if __name__ == "__main__":
+    opt = OptionParser("usage: %prog [options] base.yml new.yml")
+    opt.add_option("-t", "--threshold", type="float", default=5.0,
+            help="Percent slowdown per request reported as a regression")
+    (options, args) = opt.parse_args()
+
+    if len(args) != 2:
+        opt.print_help()
+        sys.exit(2)
+
+    regressed = compare(args[0], args[1], options.threshold)
+    sys.exit(1 if regressed else 0)
@@ -0,0 +1,231 @@
+#!/usr/bin/env python
+
+# mem_req_trace.py
+#
+# Convert a memory request lifecycle trace to the Chrome trace event format,
+# to view the requests on a timeline in chrome://tracing or Perfetto
+# (ui.perfetto.dev). The trace is written with the '-mem-req-trace'
+# simconfig option, optionally limited to some requests:
+#
+#   -mem-req-trace reqs.bin -mem-req-trace-core 0
+#       -mem-req-trace-addr-start 0x100000 -mem-req-trace-addr-end 0x200000
+#       -mem-req-trace-start 10m -mem-req-trace-stop 11m
+#
+# then:
+#
+#   mem_req_trace.py [options] reqs.bin reqs.json
+#
+# Each controller and interconnect is a process on the timeline, and a
+# request gets a slice in every one it passed through, from its first to its
+# last event there, so a request waiting in L1 for L2 and memory spans them.
+# A 'core N' process has a slice per request from allocation to its return
+# to the pool. The slices' arguments list the request's events. One cycle is
+# shown as one microsecond.
+#
+# The options filter the requests again, so one trace can be looked at
+# piece by piece.
+#
+
+import json
+import struct
+import sys
+
+from optparse import OptionParser
+
+MAGIC = 0x3145434152545152
+VERSION = 1
+
+HEADER = struct.Struct('<QII')
+EVENT = struct.Struct('<QQQQHHBBBB')
+
+EVENT_NAMES = ['name', 'alloc', 'access', 'queue', 'lookup', 'hit', 'miss',
+        'send', 'recv', 'done', 'free']
+NAME, ALLOC, FREE = 0, 1, 10
+
+OP_NAMES = ['read', 'write', 'update', 'evict']
+IFETCH = 0x80
+NO_UNIT = 0xffff
+
+class Request(object):
+    def __init__(self, ev):
+        self.id = ev['id']
+        self.core = ev['core']
+        self.thread = ev['thread']
+        self.addr = ev['addr']
+        self.parent = 0
+        self.events = []
+
+        if ev['optype'] & IFETCH:
+            self.op = 'ifetch'
+        else:
+            self.op = OP_NAMES[ev['optype'] & 0x7f]
+
+    def name(self):
+        return "%s 0x%x" % (self.op, self.addr)
+
+def read_trace(filename):
+    units = {}
+    requests = {}
+
+    with open(filename, 'rb') as f:
+        data = f.read(HEADER.size)
+        if len(data) < HEADER.size:
+            raise ValueError("%s is too short" % filename)
+
+        magic, version, event_size = HEADER.unpack(data)
+        if magic != MAGIC or version != VERSION or event_size != EVENT.size:
+            raise ValueError("%s is not a memory request trace" % filename)
+
+        while True:
+            data = f.read(EVENT.size)
+            # A truncated last event is dropped
+            if len(data) < EVENT.size:
+                break
+
+            (cycle, rid, addr, arg, unit, peer, event, core, thread,
+                    optype) = EVENT.unpack(data)
+
+            if event == NAME:
+                units[unit] = f.read(arg).decode('ascii', 'replace')
+                continue
+
+            ev = {'cycle': cycle, 'id': rid, 'addr': addr, 'arg': arg,
+                    'unit': unit, 'peer': peer, 'event': event, 'core': core,
+                    'thread': thread, 'optype': optype}
+
+            req = requests.get(rid)
+            if req is None:
+                req = requests[rid] = Request(ev)
+            if event == ALLOC:
+                req.parent = arg
+            req.events.append(ev)
+
+    return units, requests
+
+def unit_name(units, unit):
+    return units.get(unit, "unit_%d" % unit)
+
+def describe(units, ev):
+    s = "%d %s" % (ev['cycle'], EVENT_NAMES[ev['event']])
+    if ev['unit'] != NO_UNIT:
+        s += " @%s" % unit_name(units, ev['unit'])
+    if ev['peer'] != NO_UNIT:
+        s += " from %s" % unit_name(units, ev['peer'])
+    if EVENT_NAMES[ev['event']] == 'lookup':
+        s += " hit" if ev['arg'] else " miss"
+    return s
+
+def keep(req, options):
+    if options.core is not None and req.core != options.core:
+        return False
+    if req.addr < options.addr_start or req.addr >= options.addr_end:
+        return False
+
+    first = req.events[0]['cycle']
+    last = req.events[-1]['cycle']
+    return last >= options.start and first < options.stop
+
+def slice_events(pid, req, begin, end, args):
+    common = {'cat': 'request', 'name': req.name(), 'pid': pid,
+            'tid': req.core, 'id': "0x%x" % req.id}
+    b = dict(common, ph='b', ts=begin, args=args)
+    e = dict(common, ph='e', ts=max(end, begin + 1))
+    return [b, e]
+
+def convert(units, requests, options):
+    out = []
+    core_pid = {}
+    used_units = set()
+
+    count = 0
+    for rid in sorted(requests.keys()):
+        req = requests[rid]
+        if not keep(req, options):
+            continue
+        if options.max_requests and count == options.max_requests:
+            break
+        count += 1
+
+        args = {'id': req.id, 'core': req.core, 'thread': req.thread,
+                'events': [describe(units, ev) for ev in req.events]}
+        if req.parent:
+            args['copy_of'] = req.parent
+
+        # Whole life of the request under its core
+        if req.core not in core_pid:
+            core_pid[req.core] = 1000000 + req.core
+        out += slice_events(core_pid[req.core], req,
+                req.events[0]['cycle'], req.events[-1]['cycle'], args)
+
+        # Time at each controller and interconnect
+        spans = {}
+        order = []
+        for ev in req.events:
+            if ev['unit'] == NO_UNIT:
+                continue
+            if ev['unit'] not in spans:
+                spans[ev['unit']] = [ev['cycle'], ev['cycle'], []]
+                order.append(ev['unit'])
+            span = spans[ev['unit']]
+            span[1] = ev['cycle']
+            span[2].append(describe(units, ev))
+
+        for unit in order:
+            begin, end, events = spans[unit]
+            used_units.add(unit)
+            out += slice_events(unit, req, begin, end,
+                    {'id': req.id, 'events': events})
+
+    for unit in sorted(used_units):
+        out.append({'ph': 'M', 'name': 'process_name', 'pid': unit,
+            'args': {'name': unit_name(units, unit)}})
+        out.append({'ph': 'M', 'name': 'process_sort_index', 'pid': unit,
+            'args': {'sort_index': unit}})
+    for core, pid in core_pid.items():
+        out.append({'ph': 'M', 'name': 'process_name', 'pid': pid,
+            'args': {'name': "core %d" % core}})
+
+    return out, count
+
+if __name__ == "__main__":
+    opt = OptionParser("usage: %prog [options] trace json")
+    opt.add_option("--core", help="Only requests of this core")
+    opt.add_option("--addr-start", default="0",
+            help="Only requests to physical addresses from this one")
+    opt.add_option("--addr-end", default=str(1 << 64),
+            help="Only requests to physical addresses below this one")
+    opt.add_option("--start", default="0",
+            help="Only requests alive from this cycle")
+    opt.add_option("--stop", default=str(1 << 64),
+            help="Only requests alive before this cycle")
+    opt.add_option("-n", "--max-requests", type="int", default=0,
+            help="Convert at most this many requests")
+    (options, args) = opt.parse_args()
+
+    if len(args) != 2:
+        opt.print_help()
+        sys.exit(2)
+
+    # Addresses and cycles may be given in hex
+    try:
+        if options.core is not None:
+            options.core = int(options.core, 0)
+        for name in ['addr_start', 'addr_end', 'start', 'stop']:
+            setattr(options, name, int(getattr(options, name), 0))
+    except ValueError as e:
+        print(e)
+        sys.exit(2)
+
+    try:
+        units, requests = read_trace(args[0])
+    except (IOError, ValueError) as e:
+        print(e)
+        sys.exit(1)
+
+    events, count = convert(units, requests, options)
+
+    with open(args[1], 'w') as f:
+        json.dump({'traceEvents': events}, f)
+
+    print("%d of %d requests written to %s" % (count, len(requests),
+        args[1]))
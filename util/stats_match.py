@@ -0,0 +1,117 @@
+#!/usr/bin/env python
+
+# stats_match.py
+#
+# Check that two builds of the simulator produce the same stats, for
+# example a 'scons -Q debug=1' build and a 'scons -Q release=1' build, which
+# leaves out the consistency checks, asserts, logging and request history.
+#
+# Copy each build's qemu/qemu-system-x86_64 to the names used by the
+# 'match-debug' and 'match-release' runs in test.cfg, then run the test
+# workloads with both and compare the stats:
+#
+#   run_bench.py -c test.cfg -d /tmp/match/debug match-debug
+#   run_bench.py -c test.cfg -d /tmp/match/release match-release
+#   stats_match.py /tmp/match/debug /tmp/match/release
+#
+# Given two directories, every .yml file in the first is compared with the
+# file of the same name in the second; two files are compared directly.
+# Stats that depend on the host (simulator run time, version and tags, the
+# host profile and host_ns counters) are skipped, everything else must be
+# equal. Exits with 1 on any difference.
+#
+
+import os
+import sys
+
+from optparse import OptionParser
+
+try:
+    import yaml
+except (ImportError, NotImplementedError):
+    path = os.path.dirname(sys.argv[0])
+    a_path = os.path.abspath(path)
+    sys.path.append("%s/../ptlsim/lib/python" % a_path)
+    import yaml
+
+# Keys skipped wherever they appear
+host_keys = set(['simulator', 'host_profile', 'host_ns'])
+
+def load(filename):
+    with open(filename) as f:
+        return [d for d in yaml.safe_load_all(f) if d is not None]
+
+def compare_node(base, new, path, diffs):
+    if isinstance(base, dict) and isinstance(new, dict):
+        for key in sorted(set(base.keys()) | set(new.keys())):
+            if key in host_keys:
+                continue
+            p = "%s.%s" % (path, key) if path else str(key)
+            if key not in new:
+                diffs.append("%s: missing in new" % p)
+            elif key not in base:
+                diffs.append("%s: missing in base" % p)
+            else:
+                compare_node(base[key], new[key], p, diffs)
+    elif isinstance(base, list) and isinstance(new, list) and \
+            len(base) == len(new):
+        for i in range(len(base)):
+            compare_node(base[i], new[i], "%s[%d]" % (path, i), diffs)
+    elif base != new:
+        diffs.append("%s: %s != %s" % (path, base, new))
+
+def compare(base_file, new_file, max_diffs):
+    base = load(base_file)
+    new = load(new_file)
+    diffs = []
+
+    if len(base) != len(new):
+        diffs.append("%d stats documents, was %d" % (len(new), len(base)))
+
+    for i in range(min(len(base), len(new))):
+        compare_node(base[i], new[i], "", diffs)
+
+    if diffs:
+        print("%s: %d differences" % (new_file, len(diffs)))
+        for d in diffs[:max_diffs]:
+            print("  %s" % d)
+        if len(diffs) > max_diffs:
+            print("  ...")
+    else:
+        print("%s: match" % new_file)
+
+    return not diffs
+
+if __name__ == "__main__":
+    opt = OptionParser("usage: %prog [options] base new")
+    opt.add_option("-n", "--max-diffs", type="int", default=20,
+            help="Differences printed per stats file")
+    (options, args) = opt.parse_args()
+
+    if len(args) != 2:
+        opt.print_help()
+        sys.exit(2)
+
+    base, new = args
+    pairs = []
+    if os.path.isdir(base):
+        for name in sorted(os.listdir(base)):
+            if name.endswith('.yml'):
+                pairs.append((os.path.join(base, name),
+                    os.path.join(new, name)))
+    else:
+        pairs.append((base, new))
+
+    if not pairs:
+        print("No stats files in %s" % base)
+        sys.exit(2)
+
+    matched = True
+    for b, n in pairs:
+        if not os.path.exists(n):
+            print("%s: missing" % n)
+            matched = False
+        elif not compare(b, n, options.max_diffs):
+            matched = False
+
+    sys.exit(0 if matched else 1)